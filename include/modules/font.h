@@ -146,6 +146,8 @@ public:
 		shader.setVec3("textColor", glm::vec3(color.x, color.y, color.z));
 		glActiveTexture(GL_TEXTURE0);
 		glBindVertexArray(this->VAO);
+		// all glyphs are streamed through the same VBO
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 
 		// Iterate through all characters
 		std::string::const_iterator c;
@@ -174,17 +176,12 @@ public:
 			// Render glyph texture over quad
 			glBindTexture(GL_TEXTURE_2D, ch.TextureID);
 			// Update content of VBO memory
-			glBindBuffer(GL_ARRAY_BUFFER, VBO);
 			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices), vertices); // Be sure to use glBufferSubData and not glBufferData
-
-			glBindBuffer(GL_ARRAY_BUFFER, 0);
 			// Render quad
 			glDrawArrays(GL_TRIANGLES, 0, 6);
 			// Now advance cursors for next glyph (note that advance is number of 1/64 pixels)
 			x += (ch.Advance >> 6) * scale; // Bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels by 64 to get amount of pixels))
 		}
-		glBindVertexArray(0);
-		glBindTexture(GL_TEXTURE_2D, 0);
 	}
 
 
@@ -0,0 +1,198 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+/// <summary>
+/// The six planes of a view frustum, extracted from a projection * view matrix (Gribb/Hartmann).
+/// Normals point into the frustum and are normalized, so plane.xyz . p + plane.w is the distance of p.
+/// With projection * view * model the planes are in the object space of the model.
+/// </summary>
+struct Frustum {
+	enum Plane { PLANE_LEFT, PLANE_RIGHT, PLANE_BOTTOM, PLANE_TOP, PLANE_NEAR, PLANE_FAR, PLANE_COUNT };
+
+	glm::vec4 planes[PLANE_COUNT];
+
+	Frustum() {}
+	explicit Frustum(const glm::mat4& matrix)
+	{
+		// rows of the matrix, glm is column major
+		glm::vec4 row0(matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0]);
+		glm::vec4 row1(matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1]);
+		glm::vec4 row2(matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2]);
+		glm::vec4 row3(matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+
+		// -w <= x,y,z <= w in clip space
+		planes[PLANE_LEFT] = row3 + row0;
+		planes[PLANE_RIGHT] = row3 - row0;
+		planes[PLANE_BOTTOM] = row3 + row1;
+		planes[PLANE_TOP] = row3 - row1;
+		planes[PLANE_NEAR] = row3 + row2;
+		planes[PLANE_FAR] = row3 - row2;
+		for (int i = 0; i < PLANE_COUNT; i++)
+		{
+			float length = glm::length(glm::vec3(planes[i]));
+			if (length > 0.0f)
+				planes[i] /= length;
+		}
+	}
+
+	/// <summary>
+	/// True if the box is inside or intersects the frustum.
+	/// Conservative: boxes close to a frustum corner can pass although they are outside.
+	/// </summary>
+	bool intersects(const glm::vec3& min, const glm::vec3& max) const
+	{
+		glm::vec3 center = (min + max) * 0.5f;
+		glm::vec3 extent = (max - min) * 0.5f;
+		for (int i = 0; i < PLANE_COUNT; i++)
+		{
+			const glm::vec4& plane = planes[i];
+			// same arithmetic as FrustumCuller::cull, so both give the same results
+			float distance = plane.x * center.x + plane.y * center.y + plane.z * center.z + plane.w;
+			float radius = std::fabs(plane.x) * extent.x + std::fabs(plane.y) * extent.y + std::fabs(plane.z) * extent.z;
+			if (!(distance + radius >= 0.0f))
+				return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// True if the sphere is inside or intersects the frustum.
+	/// </summary>
+	bool intersects(const glm::vec3& center, float radius) const
+	{
+		for (int i = 0; i < PLANE_COUNT; i++)
+			if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+				return false;
+		return true;
+	}
+
+	/// <summary>
+	/// Axis aligned box enclosing the transformed box (Arvo).
+	/// </summary>
+	static void transformBounds(const glm::vec3& min, const glm::vec3& max, const glm::mat4& matrix, glm::vec3& outMin, glm::vec3& outMax)
+	{
+		glm::vec3 center = glm::vec3(matrix * glm::vec4((min + max) * 0.5f, 1.0f));
+		glm::vec3 extent = (max - min) * 0.5f;
+		glm::vec3 outExtent(0.0f);
+		for (int column = 0; column < 3; column++)
+			outExtent += glm::abs(glm::vec3(matrix[column])) * extent[column];
+		outMin = center - outExtent;
+		outMax = center + outExtent;
+	}
+};
+
+/// <summary>
+/// Bounding boxes and spheres of many objects, tested against a frustum in one pass.
+/// The bounds are stored as separate arrays (structure of arrays) and the test loops over
+/// one plane at a time without branches, so the compiler can vectorize them.
+/// </summary>
+class FrustumCuller
+{
+public:
+	enum Volume {
+		BOX,		// axis aligned bounding box, tighter
+		SPHERE,		// bounding sphere, cheaper
+	};
+
+	/// <summary>
+	/// Adds the bounds of an object, the sphere encloses the box if no radius is given.
+	/// </summary>
+	/// <returns>The index of the object in the visibility results.</returns>
+	unsigned int add(const glm::vec3& min, const glm::vec3& max, float sphereRadius = -1.0f)
+	{
+		centerX.push_back(0.0f); centerY.push_back(0.0f); centerZ.push_back(0.0f);
+		extentX.push_back(0.0f); extentY.push_back(0.0f); extentZ.push_back(0.0f);
+		radius.push_back(0.0f);
+		unsigned int index = (unsigned int)radius.size() - 1;
+		set(index, min, max, sphereRadius);
+		return index;
+	}
+
+	void set(unsigned int index, const glm::vec3& min, const glm::vec3& max, float sphereRadius = -1.0f)
+	{
+		glm::vec3 center = (min + max) * 0.5f;
+		glm::vec3 extent = (max - min) * 0.5f;
+		centerX[index] = center.x; centerY[index] = center.y; centerZ[index] = center.z;
+		extentX[index] = extent.x; extentY[index] = extent.y; extentZ[index] = extent.z;
+		radius[index] = sphereRadius >= 0.0f ? sphereRadius : glm::length(extent);
+	}
+
+	void clear()
+	{
+		centerX.clear(); centerY.clear(); centerZ.clear();
+		extentX.clear(); extentY.clear(); extentZ.clear();
+		radius.clear();
+	}
+
+	unsigned int size() const { return (unsigned int)radius.size(); }
+
+	/// <summary>
+	/// Tests all objects against the frustum, visible[i] is 1 if object i is inside or intersects it.
+	/// </summary>
+	/// <param name="accumulate">Keep objects that are already marked visible, e.g. to cull against
+	/// the union of several frustums (shadow cascades).</param>
+	/// <returns>The number of visible objects.</returns>
+	unsigned int cull(const Frustum& frustum, std::vector<unsigned char>& visible, Volume volume = BOX, bool accumulate = false) const
+	{
+		const size_t count = radius.size();
+		mask.assign(count, 1);
+
+		const float* cx = centerX.data();
+		const float* cy = centerY.data();
+		const float* cz = centerZ.data();
+		const float* ex = extentX.data();
+		const float* ey = extentY.data();
+		const float* ez = extentZ.data();
+		const float* r = radius.data();
+		uint32_t* inside = mask.data();
+
+		for (int p = 0; p < Frustum::PLANE_COUNT; p++)
+		{
+			const float nx = frustum.planes[p].x, ny = frustum.planes[p].y, nz = frustum.planes[p].z, d = frustum.planes[p].w;
+			if (volume == BOX)
+			{
+				// projected half size of the box onto the plane normal
+				const float ax = std::fabs(nx), ay = std::fabs(ny), az = std::fabs(nz);
+				for (size_t i = 0; i < count; i++)
+				{
+					float distance = nx * cx[i] + ny * cy[i] + nz * cz[i] + d;
+					float extent = ax * ex[i] + ay * ey[i] + az * ez[i];
+					inside[i] &= (uint32_t)(distance + extent >= 0.0f);
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < count; i++)
+				{
+					float distance = nx * cx[i] + ny * cy[i] + nz * cz[i] + d;
+					inside[i] &= (uint32_t)(distance + r[i] >= 0.0f);
+				}
+			}
+		}
+
+		if (!accumulate || visible.size() != count)
+			visible.assign(count, 0);
+		unsigned int visibleCount = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			visible[i] |= (unsigned char)inside[i];
+			visibleCount += visible[i];
+		}
+		return visibleCount;
+	}
+
+private:
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+	std::vector<float> radius;
+	// per object result of the plane tests, same width as the bounds so the loops vectorize
+	mutable std::vector<uint32_t> mask;
+};
+
+#endif // !FRUSTUM_H
@@ -0,0 +1,180 @@
+#ifndef JOB_POOL_H
+#define JOB_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Runs data parallel loops on a pool of worker threads.
+/// parallelFor splits the range into chunks and spreads them over one queue per thread.
+/// A thread works through its own queue from the front and steals chunks from the back
+/// of the other queues once it runs dry, so chunks of different cost are balanced.
+/// The calling thread works on the loop as well and returns when all chunks are done.
+/// </summary>
+class JobPool
+{
+public:
+	/// <summary>
+	/// Returns the pool shared by all systems of the application.
+	/// </summary>
+	static JobPool& instance()
+	{
+		static JobPool pool;
+		return pool;
+	}
+
+	/// <param name="threadCount">Threads working on a loop, including the calling thread.</param>
+	JobPool(unsigned int threadCount = std::thread::hardware_concurrency())
+	{
+		if (threadCount == 0)
+			threadCount = 1;
+		for (unsigned int i = 0; i < threadCount; i++)
+			queues.emplace_back(new Queue());
+		// queue 0 belongs to the calling thread
+		for (unsigned int i = 1; i < threadCount; i++)
+			workers.emplace_back(&JobPool::work, this, i);
+	}
+
+	~JobPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	JobPool(const JobPool&) = delete;
+	JobPool& operator=(const JobPool&) = delete;
+
+	unsigned int getThreadCount() const { return (unsigned int)queues.size(); }
+
+	/// <summary>
+	/// Calls job(begin, end) for consecutive ranges of at most grain elements covering [0, count)
+	/// and blocks until all of them are done. The ranges run concurrently, so the job may only
+	/// write to the elements of its range.
+	/// </summary>
+	/// <param name="grain">Elements per chunk, large enough to hide the cost of taking a chunk.</param>
+	void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& job)
+	{
+		if (count == 0)
+			return;
+		if (grain == 0)
+			grain = 1;
+		const size_t chunks = (count + grain - 1) / grain;
+		if (queues.size() == 1 || chunks == 1)
+		{
+			job(0, count);
+			return;
+		}
+
+		std::atomic<size_t> remaining(chunks);
+		// neighbouring chunks go to the same queue, they stay on one thread unless they are stolen
+		for (size_t c = 0; c < chunks; c++)
+		{
+			Task task;
+			task.job = &job;
+			task.begin = c * grain;
+			task.end = std::min(count, task.begin + grain);
+			task.remaining = &remaining;
+			Queue& queue = *queues[c * queues.size() / chunks];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			queue.tasks.push_back(task);
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			queued += chunks;
+		}
+		wake.notify_all();
+
+		// help until the last chunk is finished, chunks still running on workers can't be taken
+		Task task;
+		while (remaining.load(std::memory_order_acquire) > 0)
+		{
+			if (take(0, task))
+				run(task);
+			else
+				std::this_thread::yield();
+		}
+	}
+
+private:
+	struct Task {
+		const std::function<void(size_t, size_t)>* job = nullptr;
+		size_t begin = 0, end = 0;
+		std::atomic<size_t>* remaining = nullptr;	// chunks of the loop that are not done yet
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> workers;
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+	std::atomic<size_t> queued{ 0 };	// tasks in all queues, workers sleep while it is 0
+	bool stopping = false;
+
+	// takes a task of the own queue or steals one from another queue
+	bool take(unsigned int index, Task& task)
+	{
+		const unsigned int count = (unsigned int)queues.size();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Queue& queue = *queues[(index + i) % count];
+			std::lock_guard<std::mutex> lock(queue.mutex);
+			if (queue.tasks.empty())
+				continue;
+			if (i == 0)
+			{
+				task = queue.tasks.front();
+				queue.tasks.pop_front();
+			}
+			else
+			{
+				task = queue.tasks.back();
+				queue.tasks.pop_back();
+			}
+			queued.fetch_sub(1);
+			return true;
+		}
+		return false;
+	}
+
+	static void run(const Task& task)
+	{
+		(*task.job)(task.begin, task.end);
+		// the loop may return right after the last decrement, the task must not be touched afterwards
+		task.remaining->fetch_sub(1, std::memory_order_release);
+	}
+
+	// worker thread: run tasks until the pool is destroyed
+	void work(unsigned int index)
+	{
+		Task task;
+		for (;;)
+		{
+			if (take(index, task))
+			{
+				run(task);
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+			if (stopping)
+				return;
+		}
+	}
+};
+
+#endif // !JOB_POOL_H
@@ -123,10 +123,17 @@ public:
 			glm::mat4 model = glm::mat4(1.0f);
 			model = glm::translate(model, position);
 			model = glm::scale(model, glm::vec3(0.2f));
-			shader.setMat4("model", model);
-			shader.setVec3("lightColor.ambient", ambient);
-			shader.setVec3("lightColor.diffuse", diffuse);
-			shader.setVec3("lightColor.specular", specular);
+			if (shader.ID != lampUniforms.program) {
+				lampUniforms.program = shader.ID;
+				lampUniforms.model = shader.uniform<glm::mat4>("model");
+				lampUniforms.ambient = shader.uniform<glm::vec3>("lightColor.ambient");
+				lampUniforms.diffuse = shader.uniform<glm::vec3>("lightColor.diffuse");
+				lampUniforms.specular = shader.uniform<glm::vec3>("lightColor.specular");
+			}
+			shader.set(lampUniforms.model, model);
+			shader.set(lampUniforms.ambient, ambient);
+			shader.set(lampUniforms.diffuse, diffuse);
+			shader.set(lampUniforms.specular, specular);
 			//draw Lamp Object
 			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
 
@@ -210,39 +217,93 @@ public:
 
 	//Benutzung des Shaders
 	void use(Shader shader) {
+		// the uniform names depend on the type and id of the light, resolve them once per shader program
+		if (shader.ID != uniforms.program || id != uniforms.id || type != uniforms.type)
+			resolveUniforms(shader);
 		switch (type) {
-			used = true;
 			case DIRECTIONLIGHT:
-				shader.setVec3("dirLight.direction", direction);
-				shader.setVec3("dirLight.ambient", ambient);
-				shader.setVec3("dirLight.diffuse", diffuse);
-				shader.setVec3("dirLight.specular", specular);
+				shader.set(uniforms.direction, direction);
+				shader.set(uniforms.ambient, ambient);
+				shader.set(uniforms.diffuse, diffuse);
+				shader.set(uniforms.specular, specular);
 				break;
 			case POINTLIGHT:
-				shader.setVec3(std::string("pointLights[") + std::to_string(id) + std::string("].position"), position);
-				shader.setVec3(std::string("pointLights[") + std::to_string(id) + std::string("].ambient"), ambient);
-				shader.setVec3(std::string("pointLights[") + std::to_string(id) + std::string("].diffuse"), diffuse);
-				shader.setVec3(std::string("pointLights[") + std::to_string(id) + std::string("].specular"), specular);
-				shader.setFloat(std::string("pointLights[") + std::to_string(id) + std::string("].constant"), constant);
-				shader.setFloat(std::string("pointLights[") + std::to_string(id) + std::string("].linear"), linear);
-				shader.setFloat(std::string("pointLights[") + std::to_string(id) + std::string("].quadratic"), quadratic);
+				shader.set(uniforms.position, position);
+				shader.set(uniforms.ambient, ambient);
+				shader.set(uniforms.diffuse, diffuse);
+				shader.set(uniforms.specular, specular);
+				shader.set(uniforms.constant, constant);
+				shader.set(uniforms.linear, linear);
+				shader.set(uniforms.quadratic, quadratic);
 				break;
 			case SPOTLIGHT:
-				shader.setVec3("spotLight.position", position);
-				shader.setVec3("spotLight.direction", direction);
-				shader.setVec3("spotLight.ambient", ambient);
-				shader.setVec3("spotLight.diffuse", diffuse);
-				shader.setVec3("spotLight.specular", specular);
-				shader.setFloat("spotLight.constant", constant);
-				shader.setFloat("spotLight.linear", linear);
-				shader.setFloat("spotLight.quadratic", quadratic);
-				shader.setFloat("spotLight.cutOff", cutOff);
-				shader.setFloat("spotLight.outerCutOff", outerCutOff);
+				shader.set(uniforms.position, position);
+				shader.set(uniforms.direction, direction);
+				shader.set(uniforms.ambient, ambient);
+				shader.set(uniforms.diffuse, diffuse);
+				shader.set(uniforms.specular, specular);
+				shader.set(uniforms.constant, constant);
+				shader.set(uniforms.linear, linear);
+				shader.set(uniforms.quadratic, quadratic);
+				shader.set(uniforms.cutOff, cutOff);
+				shader.set(uniforms.outerCutOff, outerCutOff);
 				break;
 		}
 	}
 private:
-	
+	// handles of the light struct uniforms, members a light type doesn't have stay invalid
+	struct LightUniforms {
+		unsigned int program = 0;
+		int id = -1;
+		Lighttypes type = TYPE;
+		Uniform<glm::vec3> position, direction, ambient, diffuse, specular;
+		Uniform<float> constant, linear, quadratic, cutOff, outerCutOff;
+	} uniforms;
 
+	struct LampUniforms {
+		unsigned int program = 0;
+		Uniform<glm::mat4> model;
+		Uniform<glm::vec3> ambient, diffuse, specular;
+	} lampUniforms;
+
+	void resolveUniforms(const Shader& shader) {
+		uniforms = LightUniforms();
+		uniforms.program = shader.ID;
+		uniforms.id = id;
+		uniforms.type = type;
+		switch (type) {
+			case DIRECTIONLIGHT: {
+				uniforms.direction = shader.uniform<glm::vec3>("dirLight.direction");
+				uniforms.ambient = shader.uniform<glm::vec3>("dirLight.ambient");
+				uniforms.diffuse = shader.uniform<glm::vec3>("dirLight.diffuse");
+				uniforms.specular = shader.uniform<glm::vec3>("dirLight.specular");
+				break;
+			}
+			case POINTLIGHT: {
+				std::string prefix = std::string("pointLights[") + std::to_string(id) + std::string("].");
+				uniforms.position = shader.uniform<glm::vec3>(prefix + "position");
+				uniforms.ambient = shader.uniform<glm::vec3>(prefix + "ambient");
+				uniforms.diffuse = shader.uniform<glm::vec3>(prefix + "diffuse");
+				uniforms.specular = shader.uniform<glm::vec3>(prefix + "specular");
+				uniforms.constant = shader.uniform<float>(prefix + "constant");
+				uniforms.linear = shader.uniform<float>(prefix + "linear");
+				uniforms.quadratic = shader.uniform<float>(prefix + "quadratic");
+				break;
+			}
+			case SPOTLIGHT: {
+				uniforms.position = shader.uniform<glm::vec3>("spotLight.position");
+				uniforms.direction = shader.uniform<glm::vec3>("spotLight.direction");
+				uniforms.ambient = shader.uniform<glm::vec3>("spotLight.ambient");
+				uniforms.diffuse = shader.uniform<glm::vec3>("spotLight.diffuse");
+				uniforms.specular = shader.uniform<glm::vec3>("spotLight.specular");
+				uniforms.constant = shader.uniform<float>("spotLight.constant");
+				uniforms.linear = shader.uniform<float>("spotLight.linear");
+				uniforms.quadratic = shader.uniform<float>("spotLight.quadratic");
+				uniforms.cutOff = shader.uniform<float>("spotLight.cutOff");
+				uniforms.outerCutOff = shader.uniform<float>("spotLight.outerCutOff");
+				break;
+			}
+		}
+	}
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#ifndef LIGHT_BUFFER_H
+#define LIGHT_BUFFER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "light.h"
+#include "shader_m.h"
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+/// <summary>
+/// A light as stored in a LightBuffer (96 bytes).
+/// Only vec4 members, so the std140 and the std430 layout are identical.
+/// GLSL:
+///		struct GPULight {
+///			vec4 position;		// xyz position, w type (0 directional, 1 point, 2 spot)
+///			vec4 direction;		// xyz direction, w cos(cutOff)
+///			vec4 ambient;		// rgb ambient, w cos(outerCutOff)
+///			vec4 diffuse;		// rgb diffuse, w constant
+///			vec4 specular;		// rgb specular, w linear
+///			vec4 attenuation;	// x quadratic, y radius of the light volume
+///		};
+/// </summary>
+struct GPULight {
+	glm::vec4 position;
+	glm::vec4 direction;
+	glm::vec4 ambient;
+	glm::vec4 diffuse;
+	glm::vec4 specular;
+	glm::vec4 attenuation;
+};
+
+/// <summary>
+/// All lights of a scene in one uniform or shader storage buffer.
+/// The buffer starts with the number of lights, followed by the light array:
+///		layout (std140) uniform LightBlock {			// GL_UNIFORM_BUFFER, array size = capacity
+///			ivec4 lightCount;
+///			GPULight lights[MAX_LIGHTS];
+///		};
+///		layout (std430) buffer LightBlock {				// GL_SHADER_STORAGE_BUFFER
+///			ivec4 lightCount;
+///			GPULight lights[];
+///		};
+/// Changes are collected on a CPU copy and only the dirty range is written in update().
+/// With GL 4.4 the buffer is persistently mapped and split into REGIONS copies, so the CPU
+/// writes the next copy while the GPU may still read the previous ones (guarded by fences).
+/// Otherwise the dirty range is uploaded with glBufferSubData.
+/// </summary>
+class LightBuffer
+{
+public:
+	// number of copies of a persistently mapped buffer (frames in flight)
+	static const unsigned int REGIONS = 3;
+	// bytes in front of the light array (ivec4 lightCount)
+	static const unsigned int HEADER_SIZE = 16;
+
+	LightBuffer(unsigned int capacity, GLenum target = GL_UNIFORM_BUFFER, GLuint binding = 0)
+		: target(target), binding(binding), capacity(capacity)
+	{
+		dataSize = HEADER_SIZE + capacity * sizeof(GPULight);
+		shadow.assign(dataSize, 0);
+
+		// every region must start at a valid offset for glBindBufferRange
+		GLint alignment = 1;
+		glGetIntegerv(target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < 1)
+			alignment = 1;
+		regionSize = (dataSize + alignment - 1) / alignment * alignment;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+#ifdef GL_VERSION_4_4
+		if (GLAD_GL_VERSION_4_4)
+		{
+			regionCount = REGIONS;
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, regionSize * regionCount, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(target, 0, regionSize * regionCount, flags);
+		}
+#endif
+		if (!mapped)
+		{
+			regionCount = 1;
+			glBufferData(target, regionSize, NULL, GL_DYNAMIC_DRAW);
+		}
+		glBindBuffer(target, 0);
+
+		for (unsigned int i = 0; i < REGIONS; i++)
+		{
+			fences[i] = 0;
+			// the first update writes the whole buffer
+			dirtyBegin[i] = 0;
+			dirtyEnd[i] = dataSize;
+		}
+	}
+
+	~LightBuffer()
+	{
+		for (unsigned int i = 0; i < REGIONS; i++)
+			if (fences[i])
+				glDeleteSync(fences[i]);
+		if (mapped)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	LightBuffer(const LightBuffer&) = delete;
+	LightBuffer& operator=(const LightBuffer&) = delete;
+
+	/// <summary>
+	/// Converts a Light into the buffer layout.
+	/// </summary>
+	/// <param name="radius">Radius of the light volume, can be used to skip fragments outside of it.</param>
+	static GPULight pack(const Light& light, float radius = 0.0f)
+	{
+		GPULight gpu;
+		gpu.position = glm::vec4(light.position, (float)light.type);
+		gpu.direction = glm::vec4(light.direction, light.cutOff);
+		gpu.ambient = glm::vec4(light.ambient, light.outerCutOff);
+		gpu.diffuse = glm::vec4(light.diffuse, light.constant);
+		gpu.specular = glm::vec4(light.specular, light.linear);
+		gpu.attenuation = glm::vec4(light.quadratic, radius, 0.0f, 0.0f);
+		return gpu;
+	}
+
+	void set(unsigned int index, const GPULight& light)
+	{
+		if (index >= capacity)
+		{
+			std::cout << "ERROR::LIGHTBUFFER::INDEX_OUT_OF_RANGE " << index << std::endl;
+			return;
+		}
+		unsigned int offset = HEADER_SIZE + index * sizeof(GPULight);
+		std::memcpy(&shadow[offset], &light, sizeof(GPULight));
+		markDirty(offset, sizeof(GPULight));
+		if (index >= count)
+			setCount(index + 1);
+	}
+	void set(unsigned int index, const Light& light, float radius = 0.0f)
+	{
+		set(index, pack(light, radius));
+	}
+
+	const GPULight& get(unsigned int index) const
+	{
+		return *(const GPULight*)&shadow[HEADER_SIZE + index * sizeof(GPULight)];
+	}
+
+	/// <summary>
+	/// Sets the number of lights the shaders iterate over (lightCount.x).
+	/// </summary>
+	void setCount(unsigned int lightCount)
+	{
+		count = lightCount < capacity ? lightCount : capacity;
+		int header[4] = { (int)count, 0, 0, 0 };
+		std::memcpy(&shadow[0], header, sizeof(header));
+		markDirty(0, HEADER_SIZE);
+	}
+
+	unsigned int size() const { return count; }
+	unsigned int getCapacity() const { return capacity; }
+	bool isPersistent() const { return mapped != nullptr; }
+	GLuint getBuffer() const { return buffer; }
+
+	/// <summary>
+	/// Writes the changes since the last update and binds the current copy to the binding point.
+	/// Call once per frame before the draws that read the lights.
+	/// </summary>
+	void update()
+	{
+		if (mapped)
+		{
+			// the draws issued since the last update read the current region
+			if (fences[region])
+				glDeleteSync(fences[region]);
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region = (region + 1) % regionCount;
+			if (fences[region])
+			{
+				glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				glDeleteSync(fences[region]);
+				fences[region] = 0;
+			}
+		}
+
+		if (dirtyEnd[region] > dirtyBegin[region])
+		{
+			unsigned int begin = dirtyBegin[region];
+			unsigned int length = dirtyEnd[region] - begin;
+			if (mapped)
+			{
+				std::memcpy(mapped + region * regionSize + begin, &shadow[begin], length);
+			}
+			else
+			{
+				glBindBuffer(target, buffer);
+				glBufferSubData(target, begin, length, &shadow[begin]);
+				glBindBuffer(target, 0);
+			}
+			dirtyBegin[region] = dataSize;
+			dirtyEnd[region] = 0;
+		}
+
+		glBindBufferRange(target, binding, buffer, region * regionSize, dataSize);
+	}
+
+	/// <summary>
+	/// Connects the light block of a shader to the binding point of the buffer.
+	/// Not needed if the shader declares layout(binding = N) itself (GL 4.2+).
+	/// </summary>
+	void bindBlock(const Shader& shader, const char* blockName) const
+	{
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			GLuint index = glGetUniformBlockIndex(shader.ID, blockName);
+			if (index != GL_INVALID_INDEX)
+				glUniformBlockBinding(shader.ID, index, binding);
+		}
+		else
+		{
+			GLuint index = glGetProgramResourceIndex(shader.ID, GL_SHADER_STORAGE_BLOCK, blockName);
+			if (index != GL_INVALID_INDEX)
+				glShaderStorageBlockBinding(shader.ID, index, binding);
+		}
+	}
+
+private:
+	GLenum target;
+	GLuint binding;
+	GLuint buffer = 0;
+	unsigned int capacity;
+	unsigned int count = 0;
+	unsigned int dataSize;		// header + light array
+	unsigned int regionSize;	// dataSize rounded up to the offset alignment
+	unsigned int regionCount = 1;
+	unsigned int region = 0;	// region bound by the last update
+	unsigned char* mapped = nullptr;
+	GLsync fences[REGIONS];
+	// byte range each region is missing, a change has to reach every copy
+	unsigned int dirtyBegin[REGIONS], dirtyEnd[REGIONS];
+	std::vector<unsigned char> shadow;
+
+	void markDirty(unsigned int begin, unsigned int length)
+	{
+		for (unsigned int i = 0; i < regionCount; i++)
+		{
+			if (begin < dirtyBegin[i])
+				dirtyBegin[i] = begin;
+			if (begin + length > dirtyEnd[i])
+				dirtyEnd[i] = begin + length;
+		}
+	}
+};
+
+#endif // !LIGHT_BUFFER_H
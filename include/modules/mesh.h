@@ -5,15 +5,38 @@
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
 
 #include "shader_m.h"
 
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
 #include <string>
 #include <vector>
 using namespace std;
 
 #define MAX_BONE_INFLUENCE 4
 
+// Flags to select the layout a mesh is uploaded with.
+// Attribute locations stay the same for every layout, so shaders don't have to be changed:
+// 0 position | 1 normal | 2 texCoords | 3 tangent | 4 bitangent | 5 bone ids | 6 weights
+enum VertexFormatFlags {
+	VERTEX_SKINNED = 1 << 0,			// upload bone ids & weights, static meshes can omit them
+	VERTEX_PACKED = 1 << 1,				// 10:10:10:2 snorm normals/tangents, half float texCoords, 
+										// 8 bit bone ids & unorm8 weights
+	VERTEX_POSITION_STREAM = 1 << 2,	// positions in a separate buffer, which is also used by 
+										// the position-only VAO for depth/shadow passes
+};
+
+// layout of the Vertex struct, uploaded without conversion (88 bytes per vertex)
+const unsigned int VERTEX_FORMAT_DEFAULT = VERTEX_SKINNED;
+// compact layout for static geometry: 12 byte position stream + 16 byte attribute stream
+const unsigned int VERTEX_FORMAT_COMPACT = VERTEX_PACKED | VERTEX_POSITION_STREAM;
+// compact layout for skinned geometry: 12 byte position stream + 24 byte attribute stream
+const unsigned int VERTEX_FORMAT_COMPACT_SKINNED = VERTEX_PACKED | VERTEX_POSITION_STREAM | VERTEX_SKINNED;
+
 struct Vertex {
 	/* Position */
 	glm::vec3 Position;
@@ -44,10 +67,18 @@ public:
 	vector<unsigned int> indices;
 	vector<Texture> textures;
 	unsigned int VAO;
+	unsigned int depthVAO = 0;		// position-only VAO (VERTEX_POSITION_STREAM), otherwise equal to VAO
+	unsigned int format;			// combination of VertexFormatFlags
+	unsigned int vertexSize = 0;	// bytes per vertex over all vertex streams
+	unsigned int materialID = 0;	// equal for meshes with the same textures, 0 for meshes without textures
+	glm::vec3 boundsMin = glm::vec3(0.0f);	// object space bounding box
+	glm::vec3 boundsMax = glm::vec3(0.0f);
+	float boundsRadius = 0.0f;				// bounding sphere around the center of the box
 
 	/* Functions */
 	// Constructor
-	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+	Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, unsigned int format = VERTEX_FORMAT_DEFAULT)
+		: format(format)
 	{
 		this->vertices = vertices;
 		this->indices = indices;
@@ -55,21 +86,120 @@ public:
 		// now that we have all the required data, set the vertex buffers and its attribute pointers.
 		setupMesh();
 	}
+	// Constructor for data that is already laid out like the GL buffers (e.g. a mapped model cache).
+	// With the default format the buffers are uploaded straight from the given memory, the CPU copies are filled by a block copy.
+	Mesh(const Vertex* vertices, size_t vertexCount, const unsigned int* indices, size_t indexCount, vector<Texture> textures, unsigned int format = VERTEX_FORMAT_DEFAULT)
+		: format(format)
+	{
+		this->vertices.assign(vertices, vertices + vertexCount);
+		this->indices.assign(indices, indices + indexCount);
+		this->textures = textures;
+		setupMesh(vertices, indices);
+	}
 	// Draw Mesh
 	void Draw(Shader shader)
 	{
+		BindMaterial(shader);
+		DrawGeometry();
+
+		// samples bind textures after drawing a model without selecting a unit, so unit 0 is restored
+		glActiveTexture(GL_TEXTURE0);
+	};
+	// Binds the textures of the mesh and sets the material uniforms of the (active) shader.
+	// Meshes with the same materialID can be drawn with DrawGeometry() afterwards.
+	void BindMaterial(const Shader& shader)
+	{
+		// sampler locations are resolved once per shader program, not per frame
+		SamplerUniforms* uniforms = &samplerUniforms[0];
+		if (samplerUniforms[1].program == shader.ID)
+			uniforms = &samplerUniforms[1];
+		else if (samplerUniforms[0].program != shader.ID)
+		{
+			uniforms = &samplerUniforms[nextSamplerUniforms];
+			nextSamplerUniforms ^= 1;
+			resolveSamplers(shader, *uniforms);
+		}
+
 		// bind appropriate textures
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+			// now set the sampler to the correct texture unit
+			glUniform1i(uniforms->locations[i], i);
+			// and finally bind the texture
+			glBindTexture(GL_TEXTURE_2D, textures[i].id);
+		}
+		if (!textures.empty())
+			glUniform1f(uniforms->shininess, 16.0f);
+	};
+	// Draws the mesh with the currently bound material
+	void DrawGeometry()
+	{
+		// the VAO stays bound, unbinding it per draw only doubles the binds
+		glBindVertexArray(VAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	};
+	// Draw Mesh without materials, e.g. for depth or shadow passes.
+	// Only reads the position stream if the mesh has one.
+	void DrawDepth()
+	{
+		glBindVertexArray(depthVAO);
+		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+	};
+	// Deletes the VAOs and buffers of the mesh. Meshes are copied by value, so this is never done implicitly.
+	void release()
+	{
+		if (depthVAO != VAO)
+			glDeleteVertexArrays(1, &depthVAO);
+		glDeleteVertexArrays(1, &VAO);
+		glDeleteBuffers(1, &VBO);
+		glDeleteBuffers(1, &EBO);
+		if (positionVBO != 0)
+			glDeleteBuffers(1, &positionVBO);
+		VAO = depthVAO = VBO = EBO = positionVBO = 0;
+	};
+private:
+	/* Render data */
+	unsigned int VBO, EBO;
+	unsigned int positionVBO = 0;
+	/* Sampler uniforms of the last two shader programs the mesh was drawn with, e.g. a depth pre-pass and the main pass */
+	struct SamplerUniforms {
+		unsigned int program = 0;
+		vector<int> locations;
+		int shininess = -1;
+	};
+	SamplerUniforms samplerUniforms[2];
+	unsigned int nextSamplerUniforms = 0;
+	/*  Functions    */
+	// returns the same id for every mesh with the same texture set, shared by all models
+	static unsigned int registerMaterial(const vector<Texture>& textures)
+	{
+		static map<vector<unsigned int>, unsigned int> materials;
+		if (textures.empty())
+			return 0;
+		vector<unsigned int> ids(textures.size());
+		for (unsigned int i = 0; i < textures.size(); i++)
+			ids[i] = textures[i].id;
+		auto material = materials.find(ids);
+		if (material != materials.end())
+			return material->second;
+		unsigned int id = (unsigned int)materials.size() + 1;
+		materials[ids] = id;
+		return id;
+	}
+	// looks up "material.<type><N>" for every texture (N in diffuse_textureN counts per type)
+	void resolveSamplers(const Shader& shader, SamplerUniforms& uniforms)
+	{
 		unsigned int diffuseNr	= 1;
 		unsigned int specularNr = 1;
 		unsigned int normalNr	= 1;
 		unsigned int heightNr	= 1;
 
+		uniforms.locations.resize(textures.size());
 		for (unsigned int i = 0; i < textures.size(); i++)
 		{
-			glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-											  // retrieve texture number (the N in diffuse_textureN)
 			string number;
-			string name = textures[i].type;
+			const string& name = textures[i].type;
 			if (name == "texture_diffuse")
 				number = std::to_string(diffuseNr++);
 			else if (name == "texture_specular")
@@ -78,44 +208,78 @@ public:
 				number = std::to_string(normalNr++); // transfer unsigned int to stream
 			else if (name == "texture_height")
 				number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-													 // now set the sampler to the correct texture unit
-			glUniform1i(glGetUniformLocation(shader.ID, ("material." + name + number).c_str()), i);
-			glUniform1f(glGetUniformLocation(shader.ID, "material.shininess"), 16.0f);
-			// and finally bind the texture
-			glBindTexture(GL_TEXTURE_2D, textures[i].id);
-
+			uniforms.locations[i] = shader.getLocation("material." + name + number);
 		}
-			// draw mesh
-		glBindVertexArray(VAO);
-		glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-		glBindVertexArray(0);
-
-		// always good practice to set everything back to defaults once configured.
-		glActiveTexture(GL_TEXTURE0);
-	};
-private:
-	/* Render data */
-	unsigned int VBO, EBO;
-	/*  Functions    */
+		uniforms.shininess = shader.getLocation("material.shininess");
+		uniforms.program = shader.ID;
+	}
 	// initializes all the buffer objects/arrays
 	void setupMesh()
 	{
+		setupMesh(vertices.data(), indices.data());
+	}
+
+	void setupMesh(const Vertex* vertexData, const unsigned int* indexData)
+	{
+		materialID = registerMaterial(textures);
+		if (!vertices.empty())
+		{
+			boundsMin = boundsMax = vertexData[0].Position;
+			for (size_t i = 1; i < vertices.size(); i++)
+			{
+				boundsMin = glm::min(boundsMin, vertexData[i].Position);
+				boundsMax = glm::max(boundsMax, vertexData[i].Position);
+			}
+			// tighter than the half diagonal of the box
+			glm::vec3 center = (boundsMin + boundsMax) * 0.5f;
+			float radius2 = 0.0f;
+			for (size_t i = 0; i < vertices.size(); i++)
+			{
+				glm::vec3 offset = vertexData[i].Position - center;
+				radius2 = glm::max(radius2, glm::dot(offset, offset));
+			}
+			boundsRadius = std::sqrt(radius2);
+		}
+
 		// create buffers/arrays
 		glGenVertexArrays(1, &VAO);
 		glGenBuffers(1, &VBO);
 		glGenBuffers(1, &EBO);
 
 		glBindVertexArray(VAO);
+		if (format == VERTEX_FORMAT_DEFAULT)
+			setupDefaultStream(vertexData);
+		else
+			setupPackedStreams(vertexData);
+
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indexData, GL_STATIC_DRAW);
+		glBindVertexArray(0);
+
+		depthVAO = VAO;
+		if (format & VERTEX_POSITION_STREAM)
+		{
+			// second VAO which only fetches the tightly packed positions
+			glGenVertexArrays(1, &depthVAO);
+			glBindVertexArray(depthVAO);
+			glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+			glBindVertexArray(0);
+		}
+	}
+
+	// uploads the Vertex structs as they are
+	void setupDefaultStream(const Vertex* vertexData)
+	{
+		vertexSize = sizeof(Vertex);
 		// load data into vertex buffers
 		glBindBuffer(GL_ARRAY_BUFFER, VBO);
 		// A great thing about structs is that their memory layout is sequential for all its items.
 		// The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
 		// again translates to 3/2 floats which translates to a byte array.
-		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertexData, GL_STATIC_DRAW);
 		
 		// set the vertex attribute pointers
 		// vertex Positions
@@ -140,7 +304,163 @@ private:
 		// weights
 		glEnableVertexAttribArray(6);
 		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Weights));
-		glBindVertexArray(0);
+	}
+
+	// converts the Vertex structs into the selected layout and uploads them
+	//
+	// attribute stream of VERTEX_FORMAT_COMPACT_SKINNED:
+	// +--------+--------+---------+-----------+---------+---------+
+	// | normal | uv     | tangent | bitangent | ids     | weights |
+	// | 10:10: | 2x     | 10:10:  | 10:10:    | 4x      | 4x      |
+	// | 10:2   | half   | 10:2    | 10:2      | uint8   | unorm8  |
+	// +--------+--------+---------+-----------+---------+---------+
+	// 0        4        8         12          16        20        24 Byte
+	void setupPackedStreams(const Vertex* vertexData)
+	{
+		const bool packed = (format & VERTEX_PACKED) != 0;
+		const bool skinned = (format & VERTEX_SKINNED) != 0;
+		const bool split = (format & VERTEX_POSITION_STREAM) != 0;
+		const size_t count = vertices.size();
+
+		// fall back to 16 bit bone ids for skeletons with more than 256 bones
+		bool wideIDs = false;
+		if (packed && skinned)
+			for (size_t i = 0; i < count && !wideIDs; i++)
+				for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+					wideIDs |= vertexData[i].BoneIDs[b] > 255;
+
+		// sizes of the attributes in the attribute stream
+		const size_t positionSize = split ? 0 : sizeof(glm::vec3);
+		const size_t normalSize = packed ? sizeof(uint32_t) : sizeof(glm::vec3);
+		const size_t uvSize = packed ? sizeof(uint32_t) : sizeof(glm::vec2);
+		const size_t idSize = !skinned ? 0 : packed ? (wideIDs ? 4 * sizeof(uint16_t) : 4 * sizeof(uint8_t)) : sizeof(Vertex::BoneIDs);
+		const size_t weightSize = !skinned ? 0 : packed ? 4 * sizeof(uint8_t) : sizeof(Vertex::Weights);
+
+		const size_t normalOffset = positionSize;
+		const size_t uvOffset = normalOffset + normalSize;
+		const size_t tangentOffset = uvOffset + uvSize;
+		const size_t bitangentOffset = tangentOffset + normalSize;
+		const size_t idOffset = bitangentOffset + normalSize;
+		const size_t weightOffset = idOffset + idSize;
+		const GLsizei stride = (GLsizei)(weightOffset + weightSize);
+
+		vertexSize = stride + (split ? sizeof(glm::vec3) : 0);
+
+		// interleave the attribute stream
+		vector<unsigned char> stream(count * stride);
+		vector<glm::vec3> positions;
+		if (split)
+			positions.resize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			const Vertex& vertex = vertexData[i];
+			unsigned char* dst = &stream[i * stride];
+
+			if (split)
+				positions[i] = vertex.Position;
+			else
+				memcpy(dst, &vertex.Position, sizeof(glm::vec3));
+
+			if (packed)
+			{
+				writePacked(dst + normalOffset, glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f)));
+				writePacked(dst + uvOffset, glm::packHalf2x16(vertex.TexCoords));
+				writePacked(dst + tangentOffset, glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, 0.0f)));
+				writePacked(dst + bitangentOffset, glm::packSnorm3x10_1x2(glm::vec4(vertex.Bitangent, 0.0f)));
+			}
+			else
+			{
+				memcpy(dst + normalOffset, &vertex.Normal, sizeof(glm::vec3));
+				memcpy(dst + uvOffset, &vertex.TexCoords, sizeof(glm::vec2));
+				memcpy(dst + tangentOffset, &vertex.Tangent, sizeof(glm::vec3));
+				memcpy(dst + bitangentOffset, &vertex.Bitangent, sizeof(glm::vec3));
+			}
+
+			if (skinned && packed)
+			{
+				// unused influences (-1) become bone 0 with weight 0
+				for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+				{
+					int id = vertex.BoneIDs[b] < 0 ? 0 : vertex.BoneIDs[b];
+					if (wideIDs)
+						((uint16_t*)(dst + idOffset))[b] = (uint16_t)id;
+					else
+						dst[idOffset + b] = (uint8_t)id;
+				}
+				packWeights(vertex, dst + weightOffset);
+			}
+			else if (skinned)
+			{
+				memcpy(dst + idOffset, vertex.BoneIDs, sizeof(Vertex::BoneIDs));
+				memcpy(dst + weightOffset, vertex.Weights, sizeof(Vertex::Weights));
+			}
+		}
+
+		// vertex Positions
+		if (split)
+		{
+			glGenBuffers(1, &positionVBO);
+			glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+			glBufferData(GL_ARRAY_BUFFER, count * sizeof(glm::vec3), positions.data(), GL_STATIC_DRAW);
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+		}
+
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, stream.size(), stream.data(), GL_STATIC_DRAW);
+
+		if (!split)
+		{
+			glEnableVertexAttribArray(0);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+		}
+		// normals, tangents & bitangents: packed ones are still read as vec3 (w is ignored)
+		const GLenum directionType = packed ? GL_INT_2_10_10_10_REV : GL_FLOAT;
+		const GLint directionSize = packed ? 4 : 3;
+		const GLboolean directionNormalized = packed ? GL_TRUE : GL_FALSE;
+		glEnableVertexAttribArray(1);
+		glVertexAttribPointer(1, directionSize, directionType, directionNormalized, stride, (void*)normalOffset);
+		// vertex texture coords
+		glEnableVertexAttribArray(2);
+		glVertexAttribPointer(2, 2, packed ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)uvOffset);
+		// vertex tangent
+		glEnableVertexAttribArray(3);
+		glVertexAttribPointer(3, directionSize, directionType, directionNormalized, stride, (void*)tangentOffset);
+		// vertex bitangent
+		glEnableVertexAttribArray(4);
+		glVertexAttribPointer(4, directionSize, directionType, directionNormalized, stride, (void*)bitangentOffset);
+		if (skinned)
+		{
+			// bone ids stay integer attributes (ivec4 in the shader) for every type
+			const GLenum idType = !packed ? GL_INT : (wideIDs ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE);
+			glEnableVertexAttribArray(5);
+			glVertexAttribIPointer(5, 4, idType, stride, (void*)idOffset);
+			// weights
+			glEnableVertexAttribArray(6);
+			glVertexAttribPointer(6, 4, packed ? GL_UNSIGNED_BYTE : GL_FLOAT, packed ? GL_TRUE : GL_FALSE, stride, (void*)weightOffset);
+		}
+	}
+
+	static void writePacked(unsigned char* dst, uint32_t value)
+	{
+		memcpy(dst, &value, sizeof(uint32_t));
+	}
+
+	// quantizes the weights to unorm8, the rounding error is added to the largest weight so they still sum up to one
+	static void packWeights(const Vertex& vertex, unsigned char* dst)
+	{
+		int sum = 0;
+		int largest = 0;
+		for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+		{
+			float weight = vertex.BoneIDs[b] < 0 ? 0.0f : glm::clamp(vertex.Weights[b], 0.0f, 1.0f);
+			dst[b] = (unsigned char)(weight * 255.0f + 0.5f);
+			sum += dst[b];
+			if (dst[b] > dst[largest])
+				largest = b;
+		}
+		if (sum > 0)
+			dst[largest] = (unsigned char)glm::clamp(dst[largest] + 255 - sum, 0, 255);
 	}
 
 };
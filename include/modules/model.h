@@ -12,13 +12,21 @@
 
 #include "stb_image.h"
 #include "mesh.h"
+#include "model_batch.h"
+#include "model_cache.h"
+#include "frustum.h"
+#include "render_queue.h"
 #include "shader_m.h"
+#include "texture_loader.h"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
@@ -30,33 +38,152 @@ class Model
 		/* Model Data */
 		vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
 		vector<Mesh> meshes;
+		vector<ModelCache::Node> nodes;		// node hierarchy of the source scene, meshes of a node are stored contiguously
 		string directory;
 		bool gammaCorrection;
+		bool loadedFromCache = false;		// true if the meshes were read from the binary mesh cache instead of assimp
+		bool asyncTextures = false;			// if true, textures keep streaming in after the constructor returned
+		unsigned int vertexFormat = VERTEX_FORMAT_DEFAULT;	// VertexFormatFlags the meshes are uploaded with
+		shared_ptr<ModelBatch> batch;		// set by Merge(), Draw & DrawDepth use the merged buffers afterwards
+
+		// post-processing options the model is imported with, part of the mesh cache key
+		static const unsigned int POST_PROCESS_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
 
 		/* Functions */
 		Model() {}
 
 		// constructor, expects a filepath to a 3D model.
-		Model(const char *path, bool gamma = false) : gammaCorrection(gamma)
+		// Texture images are decoded on the worker threads of the TextureLoader. By default the constructor 
+		// waits for all of them, with asyncTexture the textures show a placeholder until they are 
+		// uploaded by TextureLoader::instance().update() in the render loop.
+		// vertexFormat selects the vertex layout of the meshes, see VertexFormatFlags.
+		Model(const char *path, bool gamma = false, bool asyncTexture = false, unsigned int vertexFormat = VERTEX_FORMAT_DEFAULT) 
+			: gammaCorrection(gamma), asyncTextures(asyncTexture), vertexFormat(vertexFormat)
 		{
 			loadModel(path);
+			if (!asyncTextures)
+				TextureLoader::instance().finish();
 		}
 
+		// draws the meshes grouped by material, so the textures of a material are bound once
 		void Draw(Shader shader) {
+			if (batch)
+			{
+				batch->Draw(shader);
+				return;
+			}
+			if (drawOrder.size() != meshes.size())
+				sortByMaterial();
+			bool bound = false;
+			unsigned int material = 0;
+			for (unsigned int i = 0; i < drawOrder.size(); i++)
+			{
+				if (!isVisible(drawOrder[i]))
+					continue;
+				Mesh& mesh = meshes[drawOrder[i]];
+				if (!bound || mesh.materialID != material)
+					mesh.BindMaterial(shader);
+				bound = true;
+				material = mesh.materialID;
+				mesh.DrawGeometry();
+			}
+			// same as Mesh::Draw
+			glActiveTexture(GL_TEXTURE0);
+		};
+
+		// packs all meshes into shared vertex/index buffers which are drawn with multi draw indirect,
+		// see ModelBatch. The meshes are kept for Submit and the CPU data.
+		// With bindless textures the shader has to read the materials from the buffer at materialBinding.
+		void Merge(GLuint materialBinding = 2, bool useBindless = true) {
+			batch = make_shared<ModelBatch>(meshes, vertexFormat, materialBinding, useBindless);
+			if (culled)
+				batch->setVisibility(visibleMeshes);
+		};
+
+		// queues all meshes with the given model matrix, they are drawn by RenderQueue::flush()
+		void Submit(RenderQueue& queue, const Shader& shader, const glm::mat4& model, RenderPass pass = RENDER_PASS_OPAQUE) {
+			unsigned int transform = queue.addTransform(model);
 			for (unsigned int i = 0; i < meshes.size(); i++)
-				meshes[i].Draw(shader);
+				if (isVisible(i))
+					queue.submit(meshes[i], shader, transform, pass);
+		};
+
+		// tests the bounds of the meshes against the frustum of viewProjection (camera or light space matrix),
+		// Draw, DrawDepth and Submit skip the meshes outside until the next Cull or ResetCulling.
+		// returns the number of visible meshes.
+		unsigned int Cull(const glm::mat4& viewProjection, const glm::mat4& model, FrustumCuller::Volume volume = FrustumCuller::BOX) {
+			if (culler.size() != meshes.size())
+			{
+				culler.clear();
+				for (unsigned int i = 0; i < meshes.size(); i++)
+					culler.add(meshes[i].boundsMin, meshes[i].boundsMax, meshes[i].boundsRadius);
+			}
+			// the planes are transformed into model space, so the bounds of the meshes can be used as they are
+			unsigned int visibleCount = culler.cull(Frustum(viewProjection * model), visibleMeshes, volume);
+			culled = true;
+			if (batch)
+				batch->setVisibility(visibleMeshes);
+			return visibleCount;
+		};
+
+		void ResetCulling() {
+			culled = false;
+			if (batch)
+				batch->setVisibility(vector<unsigned char>());
+		};
+
+		bool isVisible(unsigned int mesh) const {
+			return !culled || visibleMeshes[mesh];
+		};
+
+		// draws only the geometry, e.g. for depth or shadow passes
+		void DrawDepth() {
+			if (batch)
+			{
+				batch->DrawDepth();
+				return;
+			}
+			for (unsigned int i = 0; i < meshes.size(); i++)
+				if (isVisible(i))
+					meshes[i].DrawDepth();
 		};
 	private:
+		/* Model Data */
+		unordered_map<string, size_t> textureLookup;	// texture path -> index into textures_loaded
+		vector<unsigned int> drawOrder;					// mesh indices sorted by materialID
+		FrustumCuller culler;							// bounds of the meshes
+		vector<unsigned char> visibleMeshes;			// result of the last Cull
+		bool culled = false;
 
 		/* Functions */
+		void sortByMaterial()
+		{
+			drawOrder.resize(meshes.size());
+			for (unsigned int i = 0; i < meshes.size(); i++)
+				drawOrder[i] = i;
+			stable_sort(drawOrder.begin(), drawOrder.end(), [this](unsigned int a, unsigned int b) {
+				return meshes[a].materialID < meshes[b].materialID;
+			});
+		}
+
 		// loads a model with supported ASSIMP extensions from file and 
 		// stores the resulting meshes in the meshes vector.
+		// A binary mesh cache next to the file is used instead of assimp if it is up to date,
+		// otherwise it is (re-)written after the import.
 		void loadModel(string path)
 		{
+			// retrieve the directory path of the filepath
+			directory = path.substr(0, path.find_last_of('/'));
+
+			uint64_t sourceHash = 0;
+			bool hashed = ModelCache::sourceKey(path, sourceHash);
+			if (hashed && loadCache(path, sourceHash))
+				return;
+
 			//read file via ASSIMP
 			Assimp::Importer import;
 			//Importer Object
-			const aiScene *scene = import.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+			const aiScene *scene = import.ReadFile(path, POST_PROCESS_FLAGS);
 			//file path & post-processing options
 			// aiProcess_Triangulate -> if model does not (entirely) consist of triangles it should
 			//							transform all the model's primitive shapes to triangles
@@ -77,17 +204,82 @@ class Model
 				cout << "ERROR::ASSIMP::" << import.GetErrorString() << endl;
 				return;
 			}
-			// retrieve the directory path of the filepath
-			directory = path.substr(0, path.find_last_of('/'));
 			
 			// process ASSIMP's root node recursively
-			processNode(scene->mRootNode, scene);
+			processNode(scene->mRootNode, scene, -1);
+
+			// store the processed data for the next start
+			if (hashed)
+				ModelCache::write(path, sourceHash, POST_PROCESS_FLAGS, meshes, textures_loaded, nodes);
 		};
 
+		// reads meshes, textures and node hierarchy from a valid mesh cache.
+		// vertex and index data is uploaded directly from the mapped file.
+		bool loadCache(const string &path, uint64_t sourceHash)
+		{
+			MappedFile cache;
+			if (!ModelCache::open(cache, path, sourceHash, POST_PROCESS_FLAGS))
+				return false;
+
+			const ModelCache::Header* header = ModelCache::getHeader(cache);
+
+			// load every referenced texture exactly once
+			const ModelCache::TextureRecord* textureRecords = ModelCache::getTextures(cache);
+			for (uint32_t i = 0; i < header->textureCount; i++)
+			{
+				Texture texture;
+				texture.type = ModelCache::getString(cache, textureRecords[i].typeOffset, textureRecords[i].typeLength);
+				texture.path = ModelCache::getString(cache, textureRecords[i].pathOffset, textureRecords[i].pathLength);
+				texture.id = TextureFromFile(texture.path.c_str(), this->directory, this->gammaCorrection);
+				textureLookup[texture.path] = textures_loaded.size();
+				textures_loaded.push_back(texture);
+			}
+
+			const ModelCache::MeshRecord* meshRecords = ModelCache::getMeshes(cache);
+			const uint32_t* textureRefs = ModelCache::getTextureRefs(cache);
+			meshes.reserve(header->meshCount);
+			for (uint32_t i = 0; i < header->meshCount; i++)
+			{
+				const ModelCache::MeshRecord& record = meshRecords[i];
+				vector<Texture> textures;
+				for (uint32_t t = 0; t < record.textureRefCount; t++)
+					textures.push_back(textures_loaded[textureRefs[record.firstTextureRef + t]]);
+
+				meshes.push_back(Mesh(ModelCache::getVertices(cache, record), record.vertexCount,
+									  ModelCache::getIndices(cache, record), record.indexCount, textures, vertexFormat));
+			}
+
+			const ModelCache::NodeRecord* nodeRecords = ModelCache::getNodes(cache);
+			nodes.resize(header->nodeCount);
+			for (uint32_t i = 0; i < header->nodeCount; i++)
+			{
+				nodes[i].parent = nodeRecords[i].parent;
+				nodes[i].firstMesh = nodeRecords[i].firstMesh;
+				nodes[i].meshCount = nodeRecords[i].meshCount;
+				nodes[i].name = ModelCache::getString(cache, nodeRecords[i].nameOffset, nodeRecords[i].nameLength);
+				memcpy(nodes[i].transformation, nodeRecords[i].transformation, sizeof(nodes[i].transformation));
+			}
+
+			loadedFromCache = true;
+			return true;
+		}
+
 		// processes a node in a recursive fashion. Processes each 
 		// individual mesh located at the node and repeats this process on its children 
 		// nodes (if any).
-		void processNode(aiNode *node, const aiScene *scene) {
+		void processNode(aiNode *node, const aiScene *scene, int parent) {
+			// remember the node for the mesh cache
+			ModelCache::Node cacheNode;
+			cacheNode.parent = parent;
+			cacheNode.firstMesh = (unsigned int)meshes.size();
+			cacheNode.meshCount = node->mNumMeshes;
+			cacheNode.name = node->mName.C_Str();
+			for (unsigned int c = 0; c < 4; c++)
+				for (unsigned int r = 0; r < 4; r++)
+					cacheNode.transformation[c * 4 + r] = node->mTransformation[r][c];
+			int nodeIndex = (int)nodes.size();
+			nodes.push_back(cacheNode);
+
 			//process all the current node's meshes (if any)
 			for (unsigned int i = 0; i < node->mNumMeshes; i++)
 			{
@@ -101,7 +293,7 @@ class Model
 			// then do the same for each of its children
 			for (unsigned int i = 0; i < node->mNumChildren; i++)
 			{
-				processNode(node->mChildren[i], scene);
+				processNode(node->mChildren[i], scene, nodeIndex);
 				// iterate through all of the node's children and call the same processNode function for
 				//each of the node's children
 				//stops once a node no longer has any children
@@ -119,6 +311,12 @@ class Model
 			{
 				
 				Vertex vertex;
+				// static models have no bones, mark all influences as unused
+				for (int b = 0; b < MAX_BONE_INFLUENCE; b++)
+				{
+					vertex.BoneIDs[b] = -1;
+					vertex.Weights[b] = 0.0f;
+				}
 
 				// process vertex positions, normals and texture coordinates
 				
@@ -211,7 +409,7 @@ class Model
 			}
 
 			// return a mesh object created from the extracted mesh data
-			return Mesh(vertices, indices, textures);
+			return Mesh(vertices, indices, textures, vertexFormat);
 		};
 
 		// checks all material textures of a given type and loads the textures if they're 
@@ -226,79 +424,41 @@ class Model
 				aiString str;
 				//GetTextureCount => check amount of textures stored int the material
 				mat->GetTexture(type, i, &str);
-				// check if texture was loaded before and if so, continue to next iteration: 
+				// check if texture was loaded before and if so, reuse it: 
 				// skip loading a new texture
-				bool skip = false;
-				//check for doubles 
-				for (unsigned int j = 0; j < textures_loaded.size(); j++) {
-					if (std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-					{
-						textures.push_back(textures_loaded[j]);
-						skip = true;
-						// a texture with the same filepath has already been loaded, 
-						// continue to next one. (optimization)
-						break;
-					}
-				}
-
-				if (!skip) {
-					// if texture hasn't been loaded already, load it
-
-					//stores the result (texture's file locations) in an aiString,
-					//retrieves the texture's location and then loads and generates the texture 
-					Texture texture;
-					texture.id = TextureFromFile(str.C_Str(), this->directory, this->gammaCorrection);
-					//loads a texture (with SOIL), returns the texture's ID
-					texture.type = typeName;
-					texture.path = str.C_Str();
-					textures.push_back(texture); // add to loaded textures
-					//stores the information
-					textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
+				auto loaded = textureLookup.find(str.C_Str());
+				if (loaded != textureLookup.end())
+				{
+					// a texture with the same filepath has already been loaded, 
+					// continue to next one. (optimization)
+					textures.push_back(textures_loaded[loaded->second]);
+					continue;
 				}
 
-				
+				// if texture hasn't been loaded already, load it
+
+				//stores the result (texture's file locations) in an aiString,
+				//retrieves the texture's location and then queues the texture for loading 
+				Texture texture;
+				texture.id = TextureFromFile(str.C_Str(), this->directory, this->gammaCorrection);
+				texture.type = typeName;
+				texture.path = str.C_Str();
+				textures.push_back(texture); // add to loaded textures
+				//stores the information
+				textureLookup[texture.path] = textures_loaded.size();
+				textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
 			}
 			return textures;
 		};
 
+		// creates the texture and queues its image for decoding on the worker threads of the TextureLoader,
+		// the texture holds a placeholder until the decoded image has been uploaded.
 		unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 		{
 			string filename = string(path);
 			filename = directory + '/' + filename;
 
-			unsigned int textureID;
-			glGenTextures(1, &textureID);
-
-			int width, height, nrComponents;
-			unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-			if (data)
-			{
-				GLenum format;
-				if (nrComponents == 1)
-					format = GL_RED;
-				else if (nrComponents == 3)
-					format = GL_RGB;
-				else if (nrComponents == 4)
-					format = GL_RGBA;
-
-				glBindTexture(GL_TEXTURE_2D, textureID);
-				glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-				glGenerateMipmap(GL_TEXTURE_2D);
-
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-				stbi_image_free(data);
-			}
-			else
-			{
-				std::cout << "Texture failed to load at path: " << filename << std::endl;
-				stbi_image_free(data);
-			}
-
-			return textureID;
+			return TextureLoader::instance().request(filename);
 		};
 
 };
@@ -0,0 +1,331 @@
+#ifndef MODEL_BATCH_H
+#define MODEL_BATCH_H
+
+#include <glad/glad.h>
+
+#include "mesh.h"
+#include "shader_m.h"
+#include "texture_loader.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <map>
+#include <vector>
+using namespace std;
+
+// layout of the commands in a GL_DRAW_INDIRECT_BUFFER
+struct DrawElementsIndirectCommand {
+	GLuint count;
+	GLuint instanceCount;
+	GLuint firstIndex;
+	GLint baseVertex;
+	GLuint baseInstance;
+};
+
+/// <summary>
+/// Bindless texture handles of a material, 0 if the material has no texture of the type.
+/// GLSL (std430, uvec2 can be converted to sampler2D with GL_ARB_bindless_texture):
+///		struct GPUMaterial {
+///			uvec2 diffuse;
+///			uvec2 specular;
+///			uvec2 normal;
+///			uvec2 height;
+///		};
+/// </summary>
+struct GPUMaterial {
+	GLuint64 diffuse;
+	GLuint64 specular;
+	GLuint64 normal;
+	GLuint64 height;
+};
+
+/// <summary>
+/// All meshes of a model in one vertex and one index buffer, drawn with glMultiDrawElementsIndirect.
+/// Every mesh becomes an indirect command with its first index and base vertex, the commands are
+/// ordered by material. The baseInstance of a command is its draw index and selects the material index
+/// from an instanced vertex attribute (location MATERIAL_ATTRIBUTE, uint), so shaders can read:
+///		layout (location = 7) in uint vMaterial;
+/// Texture binding depends on the context:
+///	- GL_ARB_bindless_texture: the handles of all materials are stored in a shader storage buffer
+///	  (binding materialBinding, GPUMaterial array indexed by vMaterial) and the whole model is one call.
+///	- GL 4.3: one multi draw per material, the textures are bound like Mesh::Draw does.
+///	- otherwise: one glDrawElementsBaseVertex per mesh, the VAO is still bound only once.
+/// </summary>
+class ModelBatch
+{
+public:
+	static const GLuint MATERIAL_ATTRIBUTE = 7;
+
+	/// <summary>
+	/// Merges the meshes, they keep their textures and must not be moved while the batch is used.
+	/// </summary>
+	/// <param name="useBindless">Use bindless textures if supported. Handles make textures immutable,
+	/// so the textures still streaming in are finished first.</param>
+	ModelBatch(vector<Mesh>& meshes, unsigned int vertexFormat, GLuint materialBinding = 2, bool useBindless = true)
+		: materialBinding(materialBinding)
+	{
+		// draw order grouped by material
+		vector<unsigned int> order(meshes.size());
+		for (unsigned int i = 0; i < meshes.size(); i++)
+			order[i] = i;
+		stable_sort(order.begin(), order.end(), [&meshes](unsigned int a, unsigned int b) {
+			return meshes[a].materialID < meshes[b].materialID;
+		});
+
+		size_t vertexCount = 0, indexCount = 0;
+		for (const Mesh& mesh : meshes)
+		{
+			vertexCount += mesh.vertices.size();
+			indexCount += mesh.indices.size();
+		}
+		vector<Vertex> vertices;
+		vector<unsigned int> indices;
+		vertices.reserve(vertexCount);
+		indices.reserve(indexCount);
+
+		vector<GLuint> drawMaterials;
+		for (unsigned int i = 0; i < order.size(); i++)
+		{
+			Mesh& mesh = meshes[order[i]];
+			if (ranges.empty() || mesh.materialID != ranges.back().material->materialID)
+			{
+				Range range;
+				range.firstDraw = i;
+				range.drawCount = 0;
+				range.visibleCount = 0;
+				range.material = &mesh;
+				ranges.push_back(range);
+			}
+			ranges.back().drawCount++;
+			ranges.back().visibleCount++;
+			drawMeshes.push_back(order[i]);
+			drawMaterials.push_back((GLuint)ranges.size() - 1);
+
+			DrawElementsIndirectCommand command;
+			command.count = (GLuint)mesh.indices.size();
+			command.instanceCount = 1;
+			command.firstIndex = (GLuint)indices.size();
+			command.baseVertex = (GLint)vertices.size();
+			command.baseInstance = i;
+			commands.push_back(command);
+
+			// indices stay relative to the mesh, the base vertex offsets them
+			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+			indices.insert(indices.end(), mesh.indices.begin(), mesh.indices.end());
+		}
+
+		// the merged mesh converts the vertices into the format of the model, its CPU copies are not needed
+		merged = new Mesh(std::move(vertices), std::move(indices), vector<Texture>(), vertexFormat);
+		merged->vertices = vector<Vertex>();
+		merged->indices = vector<unsigned int>();
+
+		// per draw material index, fetched with the baseInstance of the command
+		glGenBuffers(1, &materialIndexBuffer);
+		glBindVertexArray(merged->VAO);
+		glBindBuffer(GL_ARRAY_BUFFER, materialIndexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, drawMaterials.size() * sizeof(GLuint), drawMaterials.data(), GL_STATIC_DRAW);
+		glEnableVertexAttribArray(MATERIAL_ATTRIBUTE);
+		glVertexAttribIPointer(MATERIAL_ATTRIBUTE, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void*)0);
+		glVertexAttribDivisor(MATERIAL_ATTRIBUTE, 1);
+		glBindVertexArray(0);
+
+		if (GLAD_GL_VERSION_4_3)
+		{
+			glGenBuffers(1, &commandBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STATIC_DRAW);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+		}
+
+#ifdef GL_ARB_bindless_texture
+		if (useBindless && commandBuffer && GLAD_GL_ARB_bindless_texture)
+			setupBindless();
+#endif
+	}
+
+	~ModelBatch()
+	{
+#ifdef GL_ARB_bindless_texture
+		for (GLuint64 handle : residentHandles)
+			glMakeTextureHandleNonResidentARB(handle);
+#endif
+		glDeleteBuffers(1, &materialIndexBuffer);
+		if (commandBuffer)
+			glDeleteBuffers(1, &commandBuffer);
+		if (materialBuffer)
+			glDeleteBuffers(1, &materialBuffer);
+		delete merged;
+	}
+
+	ModelBatch(const ModelBatch&) = delete;
+	ModelBatch& operator=(const ModelBatch&) = delete;
+
+	/// <summary>
+	/// Draws all meshes. With bindless textures the shader has to read the GPUMaterial buffer,
+	/// otherwise it uses the material samplers like Mesh::Draw.
+	/// </summary>
+	void Draw(const Shader& shader)
+	{
+		uploadCommands();
+		glBindVertexArray(merged->VAO);
+		if (materialBuffer)
+		{
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, materialBinding, materialBuffer);
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)0, (GLsizei)commands.size(), 0);
+			drawCalls = 1;
+			return;
+		}
+
+		drawCalls = 0;
+		if (commandBuffer)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		for (const Range& range : ranges)
+		{
+			if (range.visibleCount == 0)
+				continue;
+			range.material->BindMaterial(shader);
+			drawRange(range.firstDraw, range.drawCount);
+		}
+		// same as Mesh::Draw
+		glActiveTexture(GL_TEXTURE0);
+	}
+
+	/// <summary>
+	/// Draws all meshes without materials, e.g. for depth or shadow passes.
+	/// </summary>
+	void DrawDepth()
+	{
+		uploadCommands();
+		glBindVertexArray(merged->depthVAO);
+		drawCalls = 0;
+		if (commandBuffer)
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		drawRange(0, (unsigned int)commands.size());
+	}
+
+	/// <summary>
+	/// Skips the meshes with visible[mesh] == 0 (indices of the source meshes, see Model::Cull)
+	/// by setting the instance count of their commands to 0. An empty vector draws all meshes.
+	/// </summary>
+	void setVisibility(const vector<unsigned char>& visible)
+	{
+		for (Range& range : ranges)
+		{
+			range.visibleCount = 0;
+			for (unsigned int i = range.firstDraw; i < range.firstDraw + range.drawCount; i++)
+			{
+				GLuint instanceCount = visible.empty() || visible[drawMeshes[i]] ? 1 : 0;
+				commandsDirty |= commands[i].instanceCount != instanceCount;
+				commands[i].instanceCount = instanceCount;
+				range.visibleCount += instanceCount;
+			}
+		}
+	}
+
+	bool isIndirect() const { return commandBuffer != 0; }
+	bool isBindless() const { return materialBuffer != 0; }
+	// number of meshes and number of draw calls issued by the last Draw/DrawDepth
+	unsigned int getDrawCount() const { return (unsigned int)commands.size(); }
+	unsigned int getDrawCalls() const { return drawCalls; }
+
+private:
+	// consecutive draws with the same material
+	struct Range {
+		unsigned int firstDraw;
+		unsigned int drawCount;
+		unsigned int visibleCount;	// draws with instanceCount 1
+		Mesh* material;			// first mesh of the range, binds the textures
+	};
+
+	Mesh* merged = nullptr;
+	vector<DrawElementsIndirectCommand> commands;
+	vector<unsigned int> drawMeshes;	// source mesh of each command
+	bool commandsDirty = false;
+	vector<Range> ranges;
+	GLuint materialIndexBuffer = 0;
+	GLuint commandBuffer = 0;
+	GLuint materialBuffer = 0;
+	GLuint materialBinding;
+	vector<GLuint64> residentHandles;
+	unsigned int drawCalls = 0;
+
+	// writes the instance counts changed by setVisibility
+	void uploadCommands()
+	{
+		if (!commandsDirty)
+			return;
+		commandsDirty = false;
+		if (commandBuffer)
+		{
+			glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		}
+	}
+
+	void drawRange(unsigned int firstDraw, unsigned int drawCount)
+	{
+		if (commandBuffer)
+		{
+			glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+				(void*)(firstDraw * sizeof(DrawElementsIndirectCommand)), (GLsizei)drawCount, 0);
+			drawCalls++;
+			return;
+		}
+		for (unsigned int i = firstDraw; i < firstDraw + drawCount; i++)
+		{
+			const DrawElementsIndirectCommand& command = commands[i];
+			if (command.instanceCount == 0)
+				continue;
+			glDrawElementsBaseVertex(GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+				(void*)(command.firstIndex * sizeof(unsigned int)), command.baseVertex);
+			drawCalls++;
+		}
+	}
+
+#ifdef GL_ARB_bindless_texture
+	// creates the resident handles of every material texture and the material buffer
+	void setupBindless()
+	{
+		TextureLoader::instance().finish();
+
+		map<GLuint, GLuint64> handles;
+		auto handle = [&](GLuint texture) -> GLuint64 {
+			auto found = handles.find(texture);
+			if (found != handles.end())
+				return found->second;
+			GLuint64 h = glGetTextureHandleARB(texture);
+			glMakeTextureHandleResidentARB(h);
+			residentHandles.push_back(h);
+			handles[texture] = h;
+			return h;
+		};
+
+		vector<GPUMaterial> materials(ranges.size());
+		for (unsigned int i = 0; i < ranges.size(); i++)
+		{
+			GPUMaterial& material = materials[i];
+			material = GPUMaterial();
+			// the first texture of each type, like material.texture_<type>1 of Mesh::Draw
+			for (const Texture& texture : ranges[i].material->textures)
+			{
+				if (texture.type == "texture_diffuse" && !material.diffuse)
+					material.diffuse = handle(texture.id);
+				else if (texture.type == "texture_specular" && !material.specular)
+					material.specular = handle(texture.id);
+				else if (texture.type == "texture_normal" && !material.normal)
+					material.normal = handle(texture.id);
+				else if (texture.type == "texture_height" && !material.height)
+					material.height = handle(texture.id);
+			}
+		}
+
+		glGenBuffers(1, &materialBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, materialBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, materials.size() * sizeof(GPUMaterial), materials.data(), GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+#endif
+};
+
+#endif // !MODEL_BATCH_H
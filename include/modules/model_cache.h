@@ -0,0 +1,526 @@
+#ifndef MODEL_CACHE_H
+#define MODEL_CACHE_H
+
+#include "mesh.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#undef near
+#undef far
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/// <summary>
+/// Read-only memory mapping of a whole file.
+/// The mapping is released as soon as the object goes out of scope.
+/// </summary>
+class MappedFile
+{
+public:
+	MappedFile() {}
+
+	MappedFile(const std::string& path)
+	{
+		open(path);
+	}
+
+	~MappedFile()
+	{
+		close();
+	}
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	bool open(const std::string& path)
+	{
+		close();
+#ifdef _WIN32
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+			close();
+			return false;
+		}
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL) {
+			close();
+			return false;
+		}
+		bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		length = (size_t)fileSize.QuadPart;
+#else
+		file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0) {
+			close();
+			return false;
+		}
+		void* view = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		bytes = (view == MAP_FAILED) ? nullptr : (const unsigned char*)view;
+		length = (size_t)info.st_size;
+#endif
+		if (bytes == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if (bytes != nullptr)
+			UnmapViewOfFile(bytes);
+		if (mapping != NULL)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		mapping = NULL;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (bytes != nullptr)
+			munmap((void*)bytes, length);
+		if (file >= 0)
+			::close(file);
+		file = -1;
+#endif
+		bytes = nullptr;
+		length = 0;
+	}
+
+	bool isOpen() const { return bytes != nullptr; }
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes = nullptr;
+	size_t length = 0;
+#ifdef _WIN32
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int file = -1;
+#endif
+};
+
+/// <summary>
+/// Binary mesh cache written next to a source asset (e.g. sponza.obj -> sponza.obj.meshcache).
+///
+/// File layout (all offsets are relative to the start of the file):
+/// +--------+-------------+-----------------+-------------+-------------+----------+--------------+
+/// | Header | MeshRecords | TextureRecords  | TextureRefs | NodeRecords | Strings  | Vertex/Index |
+/// +--------+-------------+-----------------+-------------+-------------+----------+--------------+
+/// Vertex and index blocks are stored exactly in the layout of the GL buffers, aligned to 16 bytes,
+/// so a warm start can upload them straight from the mapping.
+/// The cache is keyed by a hash of the source file (including the material libraries of an .obj)
+/// and the assimp post-process flags and is invalidated as soon as one of them, the format version
+/// or sizeof(Vertex) changes.
+/// </summary>
+class ModelCache
+{
+public:
+	static const uint32_t MAGIC = 0x4843534D; // "MSCH"
+	static const uint32_t VERSION = 1;
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		uint32_t postProcessFlags;
+		uint32_t vertexStride;
+		uint32_t meshCount;
+		uint32_t textureCount;
+		uint32_t textureRefCount;
+		uint32_t nodeCount;
+		uint64_t meshOffset;
+		uint64_t textureOffset;
+		uint64_t textureRefOffset;
+		uint64_t nodeOffset;
+		uint64_t stringOffset;
+		uint64_t stringSize;
+	};
+
+	struct MeshRecord {
+		uint64_t vertexOffset;
+		uint64_t indexOffset;
+		uint32_t vertexCount;
+		uint32_t indexCount;
+		uint32_t firstTextureRef;	// first index into the texture reference table
+		uint32_t textureRefCount;
+	};
+
+	struct TextureRecord {
+		uint32_t typeOffset;		// offsets/lengths into the string block
+		uint32_t typeLength;
+		uint32_t pathOffset;
+		uint32_t pathLength;
+	};
+
+	struct NodeRecord {
+		int32_t parent;				// -1 for the root node
+		uint32_t firstMesh;			// meshes of a node are stored contiguously in Model::meshes
+		uint32_t meshCount;
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		float transformation[16];	// column major
+	};
+
+	/// <summary>
+	/// Node of the source scene hierarchy as it is collected while processing the assimp scene.
+	/// </summary>
+	struct Node {
+		int parent;
+		unsigned int firstMesh;
+		unsigned int meshCount;
+		std::string name;
+		float transformation[16];
+	};
+
+	/// <summary>
+	/// Returns the path of the cache file belonging to a source asset.
+	/// </summary>
+	static std::string cachePath(const std::string& sourcePath)
+	{
+		return sourcePath + ".meshcache";
+	}
+
+	/// <summary>
+	/// 64 bit FNV-1a hash.
+	/// </summary>
+	static uint64_t hash(const unsigned char* data, size_t size, uint64_t seed = 14695981039346656037ull)
+	{
+		uint64_t h = seed;
+		for (size_t i = 0; i < size; i++) {
+			h ^= data[i];
+			h *= 1099511628211ull;
+		}
+		return h;
+	}
+
+	/// <summary>
+	/// Computes the cache key of a source asset.
+	/// The material libraries (mtllib) of an .obj are part of the key, so an edited .mtl invalidates the cache.
+	/// </summary>
+	/// <param name="sourcePath">The path of the source asset.</param>
+	/// <param name="key">The resulting key.</param>
+	/// <returns>false if the source asset could not be read.</returns>
+	static bool sourceKey(const std::string& sourcePath, uint64_t& key)
+	{
+		MappedFile source;
+		if (!source.open(sourcePath))
+			return false;
+		key = hash(source.data(), source.size());
+		if (sourcePath.size() < 4 || sourcePath.compare(sourcePath.size() - 4, 4, ".obj") != 0)
+			return true;
+
+		const char* text = (const char*)source.data();
+		size_t size = source.size();
+		size_t slash = sourcePath.find_last_of("/\\");
+		std::string directory = slash == std::string::npos ? std::string() : sourcePath.substr(0, slash + 1);
+		for (size_t line = 0; line < size; ) {
+			size_t end = line;
+			while (end < size && text[end] != '\n')
+				end++;
+			static const char MTLLIB[] = "mtllib";
+			const size_t keyword = sizeof(MTLLIB) - 1;
+			if (end - line > keyword + 1 && strncmp(text + line, MTLLIB, keyword) == 0 &&
+				(text[line + keyword] == ' ' || text[line + keyword] == '\t'))
+			{
+				// the rest of the line is the file name, like assimp reads it
+				size_t first = line + keyword + 1, last = end;
+				while (first < last && (text[first] == ' ' || text[first] == '\t'))
+					first++;
+				while (last > first && (text[last - 1] == ' ' || text[last - 1] == '\t' || text[last - 1] == '\r'))
+					last--;
+				std::string name(text + first, last - first);
+				key = hash((const unsigned char*)name.data(), name.size(), key);
+				// a missing library still changes the key once it shows up
+				MappedFile library;
+				if (library.open(directory + name))
+					key = hash(library.data(), library.size(), key);
+			}
+			line = end + 1;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Maps the cache file of a source asset and validates it against the given key.
+	/// </summary>
+	/// <returns>true if the mapped cache can be used.</returns>
+	static bool open(MappedFile& cache, const std::string& sourcePath, uint64_t sourceHash, unsigned int postProcessFlags)
+	{
+		if (!cache.open(cachePath(sourcePath)))
+			return false;
+
+		// a truncated or corrupt cache is treated like a missing one
+		if (!validate(cache, sourceHash, postProcessFlags)) {
+			cache.close();
+			return false;
+		}
+		return true;
+	}
+
+	static const Header* getHeader(const MappedFile& cache)
+	{
+		return (const Header*)cache.data();
+	}
+
+	static const MeshRecord* getMeshes(const MappedFile& cache)
+	{
+		return (const MeshRecord*)(cache.data() + getHeader(cache)->meshOffset);
+	}
+
+	static const TextureRecord* getTextures(const MappedFile& cache)
+	{
+		return (const TextureRecord*)(cache.data() + getHeader(cache)->textureOffset);
+	}
+
+	static const uint32_t* getTextureRefs(const MappedFile& cache)
+	{
+		return (const uint32_t*)(cache.data() + getHeader(cache)->textureRefOffset);
+	}
+
+	static const NodeRecord* getNodes(const MappedFile& cache)
+	{
+		return (const NodeRecord*)(cache.data() + getHeader(cache)->nodeOffset);
+	}
+
+	static std::string getString(const MappedFile& cache, uint32_t offset, uint32_t length)
+	{
+		const char* strings = (const char*)(cache.data() + getHeader(cache)->stringOffset);
+		return std::string(strings + offset, length);
+	}
+
+	static const Vertex* getVertices(const MappedFile& cache, const MeshRecord& mesh)
+	{
+		return (const Vertex*)(cache.data() + mesh.vertexOffset);
+	}
+
+	static const unsigned int* getIndices(const MappedFile& cache, const MeshRecord& mesh)
+	{
+		return (const unsigned int*)(cache.data() + mesh.indexOffset);
+	}
+
+	/// <summary>
+	/// Writes the cache of a loaded model next to its source asset.
+	/// </summary>
+	/// <param name="sourcePath">The path of the source asset.</param>
+	/// <param name="sourceHash">The hash of the source asset.</param>
+	/// <param name="postProcessFlags">The assimp post-process flags the model was loaded with.</param>
+	/// <param name="meshes">The meshes of the model.</param>
+	/// <param name="textures">All unique textures of the model.</param>
+	/// <param name="nodes">The node hierarchy of the model.</param>
+	/// <returns>true if the cache was written successfully.</returns>
+	static bool write(const std::string& sourcePath, uint64_t sourceHash, unsigned int postProcessFlags,
+		const std::vector<Mesh>& meshes, const std::vector<Texture>& textures, const std::vector<Node>& nodes)
+	{
+		Header header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.sourceHash = sourceHash;
+		header.postProcessFlags = postProcessFlags;
+		header.vertexStride = sizeof(Vertex);
+		header.meshCount = (uint32_t)meshes.size();
+		header.textureCount = (uint32_t)textures.size();
+		header.nodeCount = (uint32_t)nodes.size();
+
+		// string block
+		std::string strings;
+		auto addString = [&strings](const std::string& s, uint32_t& offset, uint32_t& length) {
+			offset = (uint32_t)strings.size();
+			length = (uint32_t)s.size();
+			strings += s;
+		};
+
+		std::vector<TextureRecord> textureRecords(textures.size());
+		for (size_t i = 0; i < textures.size(); i++) {
+			addString(textures[i].type, textureRecords[i].typeOffset, textureRecords[i].typeLength);
+			addString(textures[i].path, textureRecords[i].pathOffset, textureRecords[i].pathLength);
+		}
+
+		// resolve the textures of each mesh to indices of the texture table
+		std::vector<MeshRecord> meshRecords(meshes.size());
+		std::vector<uint32_t> textureRefs;
+		for (size_t i = 0; i < meshes.size(); i++) {
+			meshRecords[i].firstTextureRef = (uint32_t)textureRefs.size();
+			meshRecords[i].textureRefCount = 0;
+			for (const Texture& texture : meshes[i].textures) {
+				for (size_t t = 0; t < textures.size(); t++) {
+					if (textures[t].path == texture.path && textures[t].type == texture.type) {
+						textureRefs.push_back((uint32_t)t);
+						meshRecords[i].textureRefCount++;
+						break;
+					}
+				}
+			}
+		}
+		header.textureRefCount = (uint32_t)textureRefs.size();
+
+		std::vector<NodeRecord> nodeRecords(nodes.size());
+		for (size_t i = 0; i < nodes.size(); i++) {
+			nodeRecords[i].parent = nodes[i].parent;
+			nodeRecords[i].firstMesh = nodes[i].firstMesh;
+			nodeRecords[i].meshCount = nodes[i].meshCount;
+			addString(nodes[i].name, nodeRecords[i].nameOffset, nodeRecords[i].nameLength);
+			memcpy(nodeRecords[i].transformation, nodes[i].transformation, sizeof(nodeRecords[i].transformation));
+		}
+
+		// calculate layout
+		uint64_t offset = sizeof(Header);
+		header.meshOffset = offset;
+		offset += meshRecords.size() * sizeof(MeshRecord);
+		header.textureOffset = offset;
+		offset += textureRecords.size() * sizeof(TextureRecord);
+		header.textureRefOffset = offset;
+		offset += textureRefs.size() * sizeof(uint32_t);
+		header.nodeOffset = align(offset);
+		offset = header.nodeOffset + nodeRecords.size() * sizeof(NodeRecord);
+		header.stringOffset = offset;
+		header.stringSize = strings.size();
+		offset += strings.size();
+
+		for (size_t i = 0; i < meshes.size(); i++) {
+			meshRecords[i].vertexCount = (uint32_t)meshes[i].vertices.size();
+			meshRecords[i].indexCount = (uint32_t)meshes[i].indices.size();
+			meshRecords[i].vertexOffset = align(offset);
+			offset = meshRecords[i].vertexOffset + meshes[i].vertices.size() * sizeof(Vertex);
+			meshRecords[i].indexOffset = align(offset);
+			offset = meshRecords[i].indexOffset + meshes[i].indices.size() * sizeof(unsigned int);
+		}
+
+		// write to a temporary file first, so a crash never leaves a half written cache behind
+		std::string path = cachePath(sourcePath);
+		std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file) {
+				std::cout << "ERROR::MODEL_CACHE::COULD_NOT_WRITE " << tmpPath << std::endl;
+				return false;
+			}
+			file.write((const char*)&header, sizeof(Header));
+			file.write((const char*)meshRecords.data(), meshRecords.size() * sizeof(MeshRecord));
+			file.write((const char*)textureRecords.data(), textureRecords.size() * sizeof(TextureRecord));
+			file.write((const char*)textureRefs.data(), textureRefs.size() * sizeof(uint32_t));
+			pad(file, header.nodeOffset);
+			file.write((const char*)nodeRecords.data(), nodeRecords.size() * sizeof(NodeRecord));
+			file.write(strings.data(), strings.size());
+			for (size_t i = 0; i < meshes.size(); i++) {
+				pad(file, meshRecords[i].vertexOffset);
+				file.write((const char*)meshes[i].vertices.data(), meshes[i].vertices.size() * sizeof(Vertex));
+				pad(file, meshRecords[i].indexOffset);
+				file.write((const char*)meshes[i].indices.data(), meshes[i].indices.size() * sizeof(unsigned int));
+			}
+			if (!file) {
+				std::cout << "ERROR::MODEL_CACHE::COULD_NOT_WRITE " << tmpPath << std::endl;
+				return false;
+			}
+		}
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+private:
+	/// <summary>
+	/// Checks that count elements of elementSize bytes at offset lie inside a block of the given size.
+	/// </summary>
+	static bool fits(uint64_t offset, uint64_t count, uint64_t elementSize, uint64_t size)
+	{
+		return offset <= size && count <= (size - offset) / elementSize;
+	}
+
+	/// <summary>
+	/// Checks the key of a mapped cache and every offset and count in it against the size of the mapping,
+	/// so no table, string or vertex/index block is read outside the file.
+	/// </summary>
+	static bool validate(const MappedFile& cache, uint64_t sourceHash, unsigned int postProcessFlags)
+	{
+		const uint64_t size = cache.size();
+		if (size < sizeof(Header))
+			return false;
+		const Header* header = getHeader(cache);
+		if (header->magic != MAGIC ||
+			header->version != VERSION ||
+			header->sourceHash != sourceHash ||
+			header->postProcessFlags != postProcessFlags ||
+			header->vertexStride != sizeof(Vertex))
+			return false;
+
+		// tables
+		if (!fits(header->meshOffset, header->meshCount, sizeof(MeshRecord), size) ||
+			!fits(header->textureOffset, header->textureCount, sizeof(TextureRecord), size) ||
+			!fits(header->textureRefOffset, header->textureRefCount, sizeof(uint32_t), size) ||
+			!fits(header->nodeOffset, header->nodeCount, sizeof(NodeRecord), size) ||
+			!fits(header->stringOffset, header->stringSize, 1, size))
+			return false;
+
+		const MeshRecord* meshes = getMeshes(cache);
+		for (uint32_t i = 0; i < header->meshCount; i++) {
+			if (!fits(meshes[i].vertexOffset, meshes[i].vertexCount, sizeof(Vertex), size) ||
+				!fits(meshes[i].indexOffset, meshes[i].indexCount, sizeof(unsigned int), size) ||
+				!fits(meshes[i].firstTextureRef, meshes[i].textureRefCount, 1, header->textureRefCount))
+				return false;
+		}
+		const uint32_t* textureRefs = getTextureRefs(cache);
+		for (uint32_t i = 0; i < header->textureRefCount; i++) {
+			if (textureRefs[i] >= header->textureCount)
+				return false;
+		}
+		const TextureRecord* textures = getTextures(cache);
+		for (uint32_t i = 0; i < header->textureCount; i++) {
+			if (!fits(textures[i].typeOffset, textures[i].typeLength, 1, header->stringSize) ||
+				!fits(textures[i].pathOffset, textures[i].pathLength, 1, header->stringSize))
+				return false;
+		}
+		const NodeRecord* nodes = getNodes(cache);
+		for (uint32_t i = 0; i < header->nodeCount; i++) {
+			if (nodes[i].parent < -1 || nodes[i].parent >= (int32_t)i ||
+				!fits(nodes[i].firstMesh, nodes[i].meshCount, 1, header->meshCount) ||
+				!fits(nodes[i].nameOffset, nodes[i].nameLength, 1, header->stringSize))
+				return false;
+		}
+		return true;
+	}
+
+	static uint64_t align(uint64_t offset)
+	{
+		return (offset + 15) & ~(uint64_t)15;
+	}
+
+	static void pad(std::ofstream& file, uint64_t offset)
+	{
+		static const char zeros[16] = {};
+		uint64_t position = (uint64_t)file.tellp();
+		if (offset > position)
+			file.write(zeros, offset - position);
+	}
+};
+
+#endif // ! MODEL_CACHE_H
@@ -0,0 +1,264 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+
+#include "mesh.h"
+#include "shader_m.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// passes are drawn in this order
+enum RenderPass {
+	RENDER_PASS_OPAQUE = 0,			// front-to-back inside a material
+	RENDER_PASS_TRANSPARENT = 1,	// back-to-front, drawn with alpha blending and without depth writes
+};
+
+/// <summary>
+/// Collects the draws of a frame and issues them sorted by a 64 bit key,
+/// so consecutive draws share shader programs and textures:
+///
+///	opaque:			| pass 2 | program 12 | material 24 | depth 24 | 2 |
+///	transparent:	| pass 2 | program 12 | ~depth 24 | material 24 | 2 |
+///
+/// The depth bucket is the top 24 bits of the (positive) float view space distance of the
+/// mesh bounds, whose bit pattern grows with the value. Opaque draws are ordered by material first
+/// and front-to-back inside a material, transparent draws back-to-front.
+/// Usage per frame: begin(view), submit(...) / Model::Submit(...), flush().
+/// </summary>
+class RenderQueue
+{
+public:
+	// state changes of the last flush, in submission order and after sorting
+	struct Stats {
+		unsigned int draws = 0;
+		unsigned int programChangesSubmitted = 0;
+		unsigned int materialChangesSubmitted = 0;
+		unsigned int textureBindsSubmitted = 0;
+		unsigned int programChanges = 0;
+		unsigned int materialChanges = 0;
+		unsigned int textureBinds = 0;
+	};
+
+	/// <summary>
+	/// The queue writes the model matrix of every transform to the shaders.
+	/// </summary>
+	/// <param name="modelUniform">Name of the model matrix uniform the transforms are written to.</param>
+	/// <param name="normalUniform">Name of a mat3 normal matrix uniform, nullptr if the shaders have none.</param>
+	RenderQueue(const char* modelUniform = "model", const char* normalUniform = nullptr)
+		: modelUniform(modelUniform), normalUniform(normalUniform ? normalUniform : "")
+	{
+	}
+
+	/// <summary>
+	/// Starts a new frame, the view matrix is used for the depth of the draws.
+	/// </summary>
+	void begin(const glm::mat4& view)
+	{
+		this->view = view;
+		items.clear();
+		transforms.clear();
+	}
+
+	/// <summary>
+	/// Adds a model matrix that is shared by the following submits.
+	/// </summary>
+	/// <returns>The index to pass to submit().</returns>
+	unsigned int addTransform(const glm::mat4& model)
+	{
+		Transform transform;
+		transform.model = model;
+		glm::mat4 viewModel = view * model;
+		// only the view space z of the bounds is needed
+		transform.depthRow = glm::vec4(viewModel[0][2], viewModel[1][2], viewModel[2][2], viewModel[3][2]);
+		transforms.push_back(transform);
+		return (unsigned int)transforms.size() - 1;
+	}
+
+	/// <summary>
+	/// Queues a mesh. Mesh and shader have to stay alive until flush().
+	/// </summary>
+	void submit(Mesh& mesh, const Shader& shader, unsigned int transform, RenderPass pass = RENDER_PASS_OPAQUE)
+	{
+		glm::vec3 center = (mesh.boundsMin + mesh.boundsMax) * 0.5f;
+		float depth = -glm::dot(transforms[transform].depthRow, glm::vec4(center, 1.0f));
+		if (!(depth > 0.0f))
+			depth = 0.0f;
+		uint32_t depthBits;
+		memcpy(&depthBits, &depth, sizeof(depthBits));
+		uint64_t depthBucket = depthBits >> 8;
+		uint64_t material = mesh.materialID & 0xFFFFFF;
+
+		uint64_t key = (uint64_t)(pass & 0x3) << 62 | (uint64_t)(shader.ID & 0xFFF) << 50;
+		if (pass == RENDER_PASS_TRANSPARENT)
+			key |= (~depthBucket & 0xFFFFFF) << 26 | material << 2;
+		else
+			key |= material << 26 | depthBucket << 2;
+
+		Item item;
+		item.key = key;
+		item.mesh = &mesh;
+		item.shader = &shader;
+		item.transform = transform;
+		items.push_back(item);
+	}
+
+	/// <summary>
+	/// Sorts the queued draws and issues them. The queue is empty afterwards.
+	/// </summary>
+	void flush()
+	{
+		stats = Stats();
+		stats.draws = (unsigned int)items.size();
+		if (items.empty())
+			return;
+
+		order.resize(items.size());
+		for (unsigned int i = 0; i < items.size(); i++)
+		{
+			order[i].key = items[i].key;
+			order[i].index = i;
+		}
+		countChanges(stats.programChangesSubmitted, stats.materialChangesSubmitted, stats.textureBindsSubmitted);
+		sort();
+		countChanges(stats.programChanges, stats.materialChanges, stats.textureBinds);
+
+		const Shader* shader = nullptr;
+		const Mesh* material = nullptr;
+		unsigned int transform = UINT32_MAX;
+		int modelLocation = -1, normalLocation = -1;
+		bool blending = false;
+		for (const SortEntry& entry : order)
+		{
+			Item& item = items[entry.index];
+			if ((entry.key >> 62) == RENDER_PASS_TRANSPARENT && !blending)
+			{
+				blending = true;
+				glEnable(GL_BLEND);
+				glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+				glDepthMask(GL_FALSE);
+			}
+			if (!shader || item.shader->ID != shader->ID)
+			{
+				shader = item.shader;
+				shader->use();
+				modelLocation = shader->getLocation(modelUniform);
+				normalLocation = normalUniform.empty() ? -1 : shader->getLocation(normalUniform);
+				// samplers and transform have to be set again for the new program
+				material = nullptr;
+				transform = UINT32_MAX;
+			}
+			if (!material || item.mesh->materialID != material->materialID)
+			{
+				material = item.mesh;
+				item.mesh->BindMaterial(*shader);
+			}
+			if (item.transform != transform)
+			{
+				transform = item.transform;
+				const glm::mat4& model = transforms[transform].model;
+				glUniformMatrix4fv(modelLocation, 1, GL_FALSE, &model[0][0]);
+				if (normalLocation >= 0)
+				{
+					glm::mat3 normal = glm::inverseTranspose(glm::mat3(model));
+					glUniformMatrix3fv(normalLocation, 1, GL_FALSE, &normal[0][0]);
+				}
+			}
+			item.mesh->DrawGeometry();
+		}
+
+		if (blending)
+		{
+			glDisable(GL_BLEND);
+			glDepthMask(GL_TRUE);
+		}
+		// same as Mesh::Draw
+		glActiveTexture(GL_TEXTURE0);
+
+		items.clear();
+		transforms.clear();
+	}
+
+	/// <summary>
+	/// State changes of the last flush.
+	/// </summary>
+	const Stats& getStats() const { return stats; }
+
+private:
+	struct Item {
+		uint64_t key;
+		Mesh* mesh;
+		const Shader* shader;
+		unsigned int transform;
+	};
+	struct Transform {
+		glm::mat4 model;
+		glm::vec4 depthRow;		// third row of view * model
+	};
+	struct SortEntry {
+		uint64_t key;
+		unsigned int index;
+	};
+
+	std::string modelUniform;
+	std::string normalUniform;
+	glm::mat4 view = glm::mat4(1.0f);
+	std::vector<Item> items;
+	std::vector<Transform> transforms;
+	// sorted draw order and the scratch buffer of the radix sort, kept to avoid allocations per frame
+	std::vector<SortEntry> order, scratch;
+	Stats stats;
+
+	// LSD radix sort over the 8 bytes of the keys, stable, so equal keys keep the submission order.
+	// Bytes that are equal for all keys (e.g. the pass or the unused low bits) are skipped.
+	void sort()
+	{
+		scratch.resize(order.size());
+		for (unsigned int shift = 0; shift < 64; shift += 8)
+		{
+			unsigned int offsets[256] = {};
+			for (const SortEntry& entry : order)
+				offsets[(entry.key >> shift) & 0xFF]++;
+			if (offsets[(order[0].key >> shift) & 0xFF] == order.size())
+				continue;
+
+			unsigned int sum = 0;
+			for (unsigned int b = 0; b < 256; b++)
+			{
+				unsigned int count = offsets[b];
+				offsets[b] = sum;
+				sum += count;
+			}
+			for (const SortEntry& entry : order)
+				scratch[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+			order.swap(scratch);
+		}
+	}
+
+	// counts the changes the current order causes when drawn
+	void countChanges(unsigned int& programChanges, unsigned int& materialChanges, unsigned int& textureBinds) const
+	{
+		const Item* previous = nullptr;
+		for (const SortEntry& entry : order)
+		{
+			const Item& item = items[entry.index];
+			bool programChanged = !previous || item.shader->ID != previous->shader->ID;
+			if (programChanged)
+				programChanges++;
+			if (programChanged || item.mesh->materialID != previous->mesh->materialID)
+			{
+				materialChanges++;
+				textureBinds += (unsigned int)item.mesh->textures.size();
+			}
+			previous = &item;
+		}
+	}
+};
+
+#endif // !RENDER_QUEUE_H
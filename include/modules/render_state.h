@@ -0,0 +1,523 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+/// <summary>
+/// Filters redundant state changes before they reach the driver.
+/// install() replaces the glad function pointers of the tracked calls (program, vertex array,
+/// buffer and texture binds, enable/disable, blend/depth/cull state) with wrappers that remember
+/// the current value and skip calls that would not change it. Because every call made through
+/// glad goes through the wrappers, samples and modules keep using plain GL calls and the cache
+/// can't get out of sync with the context.
+/// Counters of issued and filtered calls are kept per frame, set LOGL_STATE_STATS=1 to print them.
+/// </summary>
+class RenderState
+{
+public:
+	enum Category {
+		PROGRAM,
+		VERTEX_ARRAY,
+		BUFFER,
+		TEXTURE,
+		FIXED_FUNCTION,		// enable/disable, blend, depth & cull state
+		CATEGORY_COUNT
+	};
+
+	struct Counters {
+		unsigned long long issued[CATEGORY_COUNT] = {};
+		unsigned long long filtered[CATEGORY_COUNT] = {};
+
+		unsigned long long totalIssued() const {
+			unsigned long long total = 0;
+			for (int i = 0; i < CATEGORY_COUNT; i++)
+				total += issued[i];
+			return total;
+		}
+		unsigned long long totalFiltered() const {
+			unsigned long long total = 0;
+			for (int i = 0; i < CATEGORY_COUNT; i++)
+				total += filtered[i];
+			return total;
+		}
+	};
+
+	/// <summary>
+	/// Installs the wrappers, call it right after gladLoadGLLoader.
+	/// </summary>
+	static void install()
+	{
+		State& s = state();
+		if (s.installed)
+			return;
+		s.installed = true;
+		s.report = std::getenv("LOGL_STATE_STATS") != nullptr;
+		s.lastReport = std::chrono::steady_clock::now();
+		invalidate();
+
+		hook(glad_glUseProgram, s.real.useProgram, useProgram);
+		hook(glad_glBindVertexArray, s.real.bindVertexArray, bindVertexArray);
+		hook(glad_glBindBuffer, s.real.bindBuffer, bindBuffer);
+		hook(glad_glBindBufferBase, s.real.bindBufferBase, bindBufferBase);
+		hook(glad_glBindBufferRange, s.real.bindBufferRange, bindBufferRange);
+		hook(glad_glActiveTexture, s.real.activeTexture, activeTexture);
+		hook(glad_glBindTexture, s.real.bindTexture, bindTexture);
+		hook(glad_glEnable, s.real.enable, enable);
+		hook(glad_glDisable, s.real.disable, disable);
+		hook(glad_glEnablei, s.real.enablei, enablei);
+		hook(glad_glDisablei, s.real.disablei, disablei);
+		hook(glad_glBlendFunc, s.real.blendFunc, blendFunc);
+		hook(glad_glBlendFuncSeparate, s.real.blendFuncSeparate, blendFuncSeparate);
+		hook(glad_glBlendFunci, s.real.blendFunci, blendFunci);
+		hook(glad_glBlendFuncSeparatei, s.real.blendFuncSeparatei, blendFuncSeparatei);
+		hook(glad_glBlendEquation, s.real.blendEquation, blendEquation);
+		hook(glad_glBlendEquationSeparate, s.real.blendEquationSeparate, blendEquationSeparate);
+		hook(glad_glBlendEquationi, s.real.blendEquationi, blendEquationi);
+		hook(glad_glBlendEquationSeparatei, s.real.blendEquationSeparatei, blendEquationSeparatei);
+		hook(glad_glDepthFunc, s.real.depthFunc, depthFunc);
+		hook(glad_glDepthMask, s.real.depthMask, depthMask);
+		hook(glad_glCullFace, s.real.cullFace, cullFace);
+		hook(glad_glDeleteBuffers, s.real.deleteBuffers, deleteBuffers);
+		hook(glad_glDeleteTextures, s.real.deleteTextures, deleteTextures);
+		hook(glad_glDeleteVertexArrays, s.real.deleteVertexArrays, deleteVertexArrays);
+	}
+
+	/// <summary>
+	/// Forgets the cached state, the next call of every tracked function reaches the driver.
+	/// Needed if the context is modified without going through glad (e.g. by another library).
+	/// </summary>
+	static void invalidate()
+	{
+		State& s = state();
+		s.program = UNKNOWN;
+		s.vertexArray = UNKNOWN;
+		for (GLuint& buffer : s.buffers)
+			buffer = UNKNOWN;
+		s.activeUnit = UNKNOWN;
+		for (auto& unit : s.textures)
+			for (GLuint& texture : unit)
+				texture = UNKNOWN;
+		for (signed char& capability : s.capabilities)
+			capability = -1;
+		s.blendSrc = s.blendDst = s.blendEquation = UNKNOWN;
+		s.depthFunc = s.depthMask = s.cullFace = UNKNOWN;
+	}
+
+	/// <summary>
+	/// Marks the end of a frame (call before glfwSwapBuffers).
+	/// </summary>
+	static void endFrame()
+	{
+		State& s = state();
+		s.lastFrame = s.frame;
+		s.frame = Counters();
+		for (int i = 0; i < CATEGORY_COUNT; i++)
+		{
+			s.interval.issued[i] += s.lastFrame.issued[i];
+			s.interval.filtered[i] += s.lastFrame.filtered[i];
+		}
+		s.intervalFrames++;
+
+		if (!s.report)
+			return;
+		auto now = std::chrono::steady_clock::now();
+		if (now - s.lastReport < std::chrono::seconds(1))
+			return;
+
+		// average over the frames since the last report
+		const char* names[CATEGORY_COUNT] = { "program", "vertex array", "buffer", "texture", "fixed function" };
+		double frames = (double)s.intervalFrames;
+		std::cout << "state changes per frame: issued " << s.interval.totalIssued() / frames
+			<< ", filtered " << s.interval.totalFiltered() / frames << " (";
+		for (int i = 0; i < CATEGORY_COUNT; i++)
+			std::cout << (i ? ", " : "") << names[i] << " " << s.interval.issued[i] / frames << "/" << s.interval.filtered[i] / frames;
+		std::cout << ")" << std::endl;
+
+		s.interval = Counters();
+		s.intervalFrames = 0;
+		s.lastReport = now;
+	}
+
+	/// <summary>
+	/// Returns the counters of the last finished frame.
+	/// </summary>
+	static const Counters& lastFrame()
+	{
+		return state().lastFrame;
+	}
+
+	/// <summary>
+	/// Returns the counters of the frame in progress.
+	/// </summary>
+	static const Counters& currentFrame()
+	{
+		return state().frame;
+	}
+
+	static bool isInstalled()
+	{
+		return state().installed;
+	}
+
+private:
+	static const GLuint UNKNOWN = 0xFFFFFFFF;
+	static const unsigned int MAX_TEXTURE_UNITS = 32;
+
+	// cached targets, others (e.g. GL_ELEMENT_ARRAY_BUFFER, which is vertex array state) are passed through
+	enum BufferTarget {
+		ARRAY_BUFFER, COPY_READ_BUFFER, COPY_WRITE_BUFFER, DRAW_INDIRECT_BUFFER, DISPATCH_INDIRECT_BUFFER,
+		PIXEL_PACK_BUFFER, PIXEL_UNPACK_BUFFER, SHADER_STORAGE_BUFFER, TEXTURE_BUFFER, UNIFORM_BUFFER,
+		ATOMIC_COUNTER_BUFFER, BUFFER_TARGET_COUNT
+	};
+	enum TextureTarget {
+		TEXTURE_1D, TEXTURE_2D, TEXTURE_3D, TEXTURE_CUBE_MAP, TEXTURE_1D_ARRAY, TEXTURE_2D_ARRAY,
+		TEXTURE_CUBE_MAP_ARRAY, TEXTURE_RECTANGLE, TEXTURE_BUFFER_TARGET, TEXTURE_2D_MULTISAMPLE,
+		TEXTURE_2D_MULTISAMPLE_ARRAY, TEXTURE_TARGET_COUNT
+	};
+	enum Capability {
+		BLEND, CULL_FACE, DEPTH_TEST, STENCIL_TEST, SCISSOR_TEST, MULTISAMPLE, FRAMEBUFFER_SRGB,
+		POLYGON_OFFSET_FILL, PROGRAM_POINT_SIZE, RASTERIZER_DISCARD, DEPTH_CLAMP, TEXTURE_CUBE_MAP_SEAMLESS,
+		CAPABILITY_COUNT
+	};
+
+	struct State {
+		bool installed = false;
+		bool report = false;
+
+		// the driver functions behind the wrappers
+		struct {
+			PFNGLUSEPROGRAMPROC useProgram;
+			PFNGLBINDVERTEXARRAYPROC bindVertexArray;
+			PFNGLBINDBUFFERPROC bindBuffer;
+			PFNGLBINDBUFFERBASEPROC bindBufferBase;
+			PFNGLBINDBUFFERRANGEPROC bindBufferRange;
+			PFNGLACTIVETEXTUREPROC activeTexture;
+			PFNGLBINDTEXTUREPROC bindTexture;
+			PFNGLENABLEPROC enable;
+			PFNGLDISABLEPROC disable;
+			PFNGLENABLEIPROC enablei;
+			PFNGLDISABLEIPROC disablei;
+			PFNGLBLENDFUNCPROC blendFunc;
+			PFNGLBLENDFUNCSEPARATEPROC blendFuncSeparate;
+			PFNGLBLENDFUNCIPROC blendFunci;
+			PFNGLBLENDFUNCSEPARATEIPROC blendFuncSeparatei;
+			PFNGLBLENDEQUATIONPROC blendEquation;
+			PFNGLBLENDEQUATIONSEPARATEPROC blendEquationSeparate;
+			PFNGLBLENDEQUATIONIPROC blendEquationi;
+			PFNGLBLENDEQUATIONSEPARATEIPROC blendEquationSeparatei;
+			PFNGLDEPTHFUNCPROC depthFunc;
+			PFNGLDEPTHMASKPROC depthMask;
+			PFNGLCULLFACEPROC cullFace;
+			PFNGLDELETEBUFFERSPROC deleteBuffers;
+			PFNGLDELETETEXTURESPROC deleteTextures;
+			PFNGLDELETEVERTEXARRAYSPROC deleteVertexArrays;
+		} real = {};
+
+		// cached context state
+		GLuint program, vertexArray;
+		GLuint buffers[BUFFER_TARGET_COUNT];
+		GLuint activeUnit;
+		GLuint textures[MAX_TEXTURE_UNITS][TEXTURE_TARGET_COUNT];
+		signed char capabilities[CAPABILITY_COUNT];		// -1 unknown, 0 disabled, 1 enabled
+		GLuint blendSrc, blendDst, blendEquation;
+		GLuint depthFunc, depthMask, cullFace;
+
+		Counters frame, lastFrame, interval;
+		unsigned long long intervalFrames = 0;
+		std::chrono::steady_clock::time_point lastReport;
+	};
+
+	static State& state()
+	{
+		static State s;
+		return s;
+	}
+
+	template<typename Fn>
+	static void hook(Fn& gladPointer, Fn& real, Fn wrapper)
+	{
+		real = gladPointer;
+		if (gladPointer)
+			gladPointer = wrapper;
+	}
+
+	// returns true if the call has to be issued, counts it either way
+	static bool changed(GLuint& cached, GLuint value, Category category)
+	{
+		State& s = state();
+		if (cached == value)
+		{
+			s.frame.filtered[category]++;
+			return false;
+		}
+		cached = value;
+		s.frame.issued[category]++;
+		return true;
+	}
+	static void issued(Category category)
+	{
+		state().frame.issued[category]++;
+	}
+
+	static int bufferTarget(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_ARRAY_BUFFER: return ARRAY_BUFFER;
+		case GL_COPY_READ_BUFFER: return COPY_READ_BUFFER;
+		case GL_COPY_WRITE_BUFFER: return COPY_WRITE_BUFFER;
+		case GL_DRAW_INDIRECT_BUFFER: return DRAW_INDIRECT_BUFFER;
+		case GL_DISPATCH_INDIRECT_BUFFER: return DISPATCH_INDIRECT_BUFFER;
+		case GL_PIXEL_PACK_BUFFER: return PIXEL_PACK_BUFFER;
+		case GL_PIXEL_UNPACK_BUFFER: return PIXEL_UNPACK_BUFFER;
+		case GL_SHADER_STORAGE_BUFFER: return SHADER_STORAGE_BUFFER;
+		case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER;
+		case GL_UNIFORM_BUFFER: return UNIFORM_BUFFER;
+		case GL_ATOMIC_COUNTER_BUFFER: return ATOMIC_COUNTER_BUFFER;
+		default: return -1;
+		}
+	}
+	static int textureTarget(GLenum target)
+	{
+		switch (target)
+		{
+		case GL_TEXTURE_1D: return TEXTURE_1D;
+		case GL_TEXTURE_2D: return TEXTURE_2D;
+		case GL_TEXTURE_3D: return TEXTURE_3D;
+		case GL_TEXTURE_CUBE_MAP: return TEXTURE_CUBE_MAP;
+		case GL_TEXTURE_1D_ARRAY: return TEXTURE_1D_ARRAY;
+		case GL_TEXTURE_2D_ARRAY: return TEXTURE_2D_ARRAY;
+		case GL_TEXTURE_CUBE_MAP_ARRAY: return TEXTURE_CUBE_MAP_ARRAY;
+		case GL_TEXTURE_RECTANGLE: return TEXTURE_RECTANGLE;
+		case GL_TEXTURE_BUFFER: return TEXTURE_BUFFER_TARGET;
+		case GL_TEXTURE_2D_MULTISAMPLE: return TEXTURE_2D_MULTISAMPLE;
+		case GL_TEXTURE_2D_MULTISAMPLE_ARRAY: return TEXTURE_2D_MULTISAMPLE_ARRAY;
+		default: return -1;
+		}
+	}
+	static int capability(GLenum cap)
+	{
+		switch (cap)
+		{
+		case GL_BLEND: return BLEND;
+		case GL_CULL_FACE: return CULL_FACE;
+		case GL_DEPTH_TEST: return DEPTH_TEST;
+		case GL_STENCIL_TEST: return STENCIL_TEST;
+		case GL_SCISSOR_TEST: return SCISSOR_TEST;
+		case GL_MULTISAMPLE: return MULTISAMPLE;
+		case GL_FRAMEBUFFER_SRGB: return FRAMEBUFFER_SRGB;
+		case GL_POLYGON_OFFSET_FILL: return POLYGON_OFFSET_FILL;
+		case GL_PROGRAM_POINT_SIZE: return PROGRAM_POINT_SIZE;
+		case GL_RASTERIZER_DISCARD: return RASTERIZER_DISCARD;
+		case GL_DEPTH_CLAMP: return DEPTH_CLAMP;
+		case GL_TEXTURE_CUBE_MAP_SEAMLESS: return TEXTURE_CUBE_MAP_SEAMLESS;
+		default: return -1;
+		}
+	}
+
+	// wrappers
+	// --------
+	static void APIENTRY useProgram(GLuint program)
+	{
+		if (changed(state().program, program, PROGRAM))
+			state().real.useProgram(program);
+	}
+	static void APIENTRY bindVertexArray(GLuint array)
+	{
+		if (changed(state().vertexArray, array, VERTEX_ARRAY))
+			state().real.bindVertexArray(array);
+	}
+	static void APIENTRY bindBuffer(GLenum target, GLuint buffer)
+	{
+		int index = bufferTarget(target);
+		if (index < 0)
+			issued(BUFFER);
+		else if (!changed(state().buffers[index], buffer, BUFFER))
+			return;
+		state().real.bindBuffer(target, buffer);
+	}
+	// indexed binds also set the generic binding point
+	static void APIENTRY bindBufferBase(GLenum target, GLuint index, GLuint buffer)
+	{
+		int cached = bufferTarget(target);
+		if (cached >= 0)
+			state().buffers[cached] = buffer;
+		issued(BUFFER);
+		state().real.bindBufferBase(target, index, buffer);
+	}
+	static void APIENTRY bindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+	{
+		int cached = bufferTarget(target);
+		if (cached >= 0)
+			state().buffers[cached] = buffer;
+		issued(BUFFER);
+		state().real.bindBufferRange(target, index, buffer, offset, size);
+	}
+	static void APIENTRY activeTexture(GLenum texture)
+	{
+		if (changed(state().activeUnit, texture - GL_TEXTURE0, TEXTURE))
+			state().real.activeTexture(texture);
+	}
+	static void APIENTRY bindTexture(GLenum target, GLuint texture)
+	{
+		State& s = state();
+		int index = textureTarget(target);
+		if (index < 0 || s.activeUnit >= MAX_TEXTURE_UNITS)
+			issued(TEXTURE);
+		else if (!changed(s.textures[s.activeUnit][index], texture, TEXTURE))
+			return;
+		s.real.bindTexture(target, texture);
+	}
+	static void APIENTRY enable(GLenum cap)
+	{
+		State& s = state();
+		int index = capability(cap);
+		if (index >= 0)
+		{
+			if (s.capabilities[index] == 1)
+			{
+				s.frame.filtered[FIXED_FUNCTION]++;
+				return;
+			}
+			s.capabilities[index] = 1;
+		}
+		issued(FIXED_FUNCTION);
+		s.real.enable(cap);
+	}
+	static void APIENTRY disable(GLenum cap)
+	{
+		State& s = state();
+		int index = capability(cap);
+		if (index >= 0)
+		{
+			if (s.capabilities[index] == 0)
+			{
+				s.frame.filtered[FIXED_FUNCTION]++;
+				return;
+			}
+			s.capabilities[index] = 0;
+		}
+		issued(FIXED_FUNCTION);
+		s.real.disable(cap);
+	}
+	// per draw buffer state makes the cached global value unreliable
+	static void APIENTRY enablei(GLenum cap, GLuint index)
+	{
+		int cached = capability(cap);
+		if (cached >= 0)
+			state().capabilities[cached] = -1;
+		issued(FIXED_FUNCTION);
+		state().real.enablei(cap, index);
+	}
+	static void APIENTRY disablei(GLenum cap, GLuint index)
+	{
+		int cached = capability(cap);
+		if (cached >= 0)
+			state().capabilities[cached] = -1;
+		issued(FIXED_FUNCTION);
+		state().real.disablei(cap, index);
+	}
+	static void APIENTRY blendFunc(GLenum sfactor, GLenum dfactor)
+	{
+		State& s = state();
+		if (s.blendSrc == sfactor && s.blendDst == dfactor)
+		{
+			s.frame.filtered[FIXED_FUNCTION]++;
+			return;
+		}
+		s.blendSrc = sfactor;
+		s.blendDst = dfactor;
+		issued(FIXED_FUNCTION);
+		s.real.blendFunc(sfactor, dfactor);
+	}
+	static void APIENTRY blendFuncSeparate(GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+	{
+		state().blendSrc = state().blendDst = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendFuncSeparate(srcRGB, dstRGB, srcAlpha, dstAlpha);
+	}
+	static void APIENTRY blendFunci(GLuint buf, GLenum src, GLenum dst)
+	{
+		state().blendSrc = state().blendDst = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendFunci(buf, src, dst);
+	}
+	static void APIENTRY blendFuncSeparatei(GLuint buf, GLenum srcRGB, GLenum dstRGB, GLenum srcAlpha, GLenum dstAlpha)
+	{
+		state().blendSrc = state().blendDst = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendFuncSeparatei(buf, srcRGB, dstRGB, srcAlpha, dstAlpha);
+	}
+	static void APIENTRY blendEquation(GLenum mode)
+	{
+		if (changed(state().blendEquation, mode, FIXED_FUNCTION))
+			state().real.blendEquation(mode);
+	}
+	static void APIENTRY blendEquationSeparate(GLenum modeRGB, GLenum modeAlpha)
+	{
+		state().blendEquation = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendEquationSeparate(modeRGB, modeAlpha);
+	}
+	static void APIENTRY blendEquationi(GLuint buf, GLenum mode)
+	{
+		state().blendEquation = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendEquationi(buf, mode);
+	}
+	static void APIENTRY blendEquationSeparatei(GLuint buf, GLenum modeRGB, GLenum modeAlpha)
+	{
+		state().blendEquation = UNKNOWN;
+		issued(FIXED_FUNCTION);
+		state().real.blendEquationSeparatei(buf, modeRGB, modeAlpha);
+	}
+	static void APIENTRY depthFunc(GLenum func)
+	{
+		if (changed(state().depthFunc, func, FIXED_FUNCTION))
+			state().real.depthFunc(func);
+	}
+	static void APIENTRY depthMask(GLboolean flag)
+	{
+		if (changed(state().depthMask, flag, FIXED_FUNCTION))
+			state().real.depthMask(flag);
+	}
+	static void APIENTRY cullFace(GLenum mode)
+	{
+		if (changed(state().cullFace, mode, FIXED_FUNCTION))
+			state().real.cullFace(mode);
+	}
+	// deleting a bound object resets the binding to 0, the name may be reused afterwards
+	static void APIENTRY deleteBuffers(GLsizei n, const GLuint* buffers)
+	{
+		State& s = state();
+		for (GLsizei i = 0; i < n; i++)
+			for (GLuint& bound : s.buffers)
+				if (bound == buffers[i])
+					bound = 0;
+		s.real.deleteBuffers(n, buffers);
+	}
+	static void APIENTRY deleteTextures(GLsizei n, const GLuint* textures)
+	{
+		State& s = state();
+		for (GLsizei i = 0; i < n; i++)
+			for (auto& unit : s.textures)
+				for (GLuint& bound : unit)
+					if (bound == textures[i])
+						bound = 0;
+		s.real.deleteTextures(n, textures);
+	}
+	static void APIENTRY deleteVertexArrays(GLsizei n, const GLuint* arrays)
+	{
+		State& s = state();
+		for (GLsizei i = 0; i < n; i++)
+			if (s.vertexArray == arrays[i])
+				s.vertexArray = 0;
+		s.real.deleteVertexArrays(n, arrays);
+	}
+};
+
+#endif // !RENDER_STATE_H
@@ -8,6 +8,21 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+/// Typed handle of a uniform location.
+/// Resolve it once with Shader::uniform and set it every frame without string operations or driver lookups.
+/// </summary>
+template<typename T>
+struct Uniform
+{
+	int location = -1;
+
+	bool valid() const { return location >= 0; }
+};
 
 class Shader
 {
@@ -142,6 +157,7 @@ public:
 			glAttachShader(ID, geometry);
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -195,6 +211,7 @@ public:
 
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
 
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(compute);
@@ -203,6 +220,7 @@ public:
 	void link() {
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(vertex);
 		glDeleteShader(fragment);
@@ -224,7 +242,7 @@ public:
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        glUniform1i(getLocation(name), (int)value); 
     }
 	void setBool(const int id, bool value) const
 	{
@@ -233,7 +251,7 @@ public:
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1i(getLocation(name), value); 
     }
 	void setInt(const int id, int value) const
 	{
@@ -242,16 +260,25 @@ public:
 	// ------------------------------------------------------------------------
 	void setInt2(const std::string& name, int value1, int value2) const
 	{
-		glUniform2i(glGetUniformLocation(ID, name.c_str()), value1, value2);
+		glUniform2i(getLocation(name), value1, value2);
 	}
 	void setInt2(const int id, int value1, int value2) const
 	{
 		glUniform2i(id, value1, value2);
 	}
+	// ------------------------------------------------------------------------
+	void setInt3(const std::string& name, int value1, int value2, int value3) const
+	{
+		glUniform3i(getLocation(name), value1, value2, value3);
+	}
+	void setInt3(const int id, int value1, int value2, int value3) const
+	{
+		glUniform3i(id, value1, value2, value3);
+	}
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        glUniform1f(getLocation(name), value); 
     }
 	void setFloat(const int id, float value) const
 	{
@@ -260,7 +287,7 @@ public:
 	// ------------------------------------------------------------------------
 	void setVec2(const std::string &name, const glm::vec2 &value) const
 	{
-		glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform2fv(getLocation(name), 1, &value[0]);
 	}
 	void setVec2(const int id, const glm::vec2& value) const
 	{
@@ -268,7 +295,7 @@ public:
 	}
 	void setVec2(const std::string &name, float x, float y) const
 	{
-		glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+		glUniform2f(getLocation(name), x, y);
 	}
 	void setVec2(const int id, float x, float y) const
 	{
@@ -277,7 +304,7 @@ public:
 	// ------------------------------------------------------------------------
 	void setVec3(const std::string &name, const glm::vec3 &value) const
 	{
-		glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform3fv(getLocation(name), 1, &value[0]);
 	}
 	void setVec3(const int id, const glm::vec3& value) const
 	{
@@ -285,7 +312,7 @@ public:
 	}
 	void setVec3(const std::string &name, float x, float y, float z) const
 	{
-		glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+		glUniform3f(getLocation(name), x, y, z);
 	}
 	void setVec3(const int id, float x, float y, float z) const
 	{
@@ -294,7 +321,7 @@ public:
 	// ------------------------------------------------------------------------
 	void setVec4(const std::string &name, const glm::vec4 &value) const
 	{
-		glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+		glUniform4fv(getLocation(name), 1, &value[0]);
 	}
 	void setVec4(const int id, const glm::vec4& value) const
 	{
@@ -302,7 +329,7 @@ public:
 	}
 	void setVec4(const std::string &name, float x, float y, float z, float w) const
 	{
-		glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+		glUniform4f(getLocation(name), x, y, z, w);
 	}
 	void setVec4(const int id, float x, float y, float z, float w) const
 	{
@@ -311,7 +338,7 @@ public:
 	// ------------------------------------------------------------------------
 	void setMat2(const std::string &name, const glm::mat2 &mat) const
 	{
-		glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix2fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	void setMat2(const int id, const glm::mat2& mat) const
 	{
@@ -320,7 +347,7 @@ public:
 	// ------------------------------------------------------------------------
 	void setMat3(const std::string &name, const glm::mat3 &mat) const
 	{
-		glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix3fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	void setMat3(const int id, const glm::mat3 &mat) const
 	{
@@ -329,15 +356,72 @@ public:
 	// ------------------------------------------------------------------------
 	void setMat4(const std::string &name, const glm::mat4 &mat) const
 	{
-		glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+		glUniformMatrix4fv(getLocation(name), 1, GL_FALSE, &mat[0][0]);
 	}
 	void setMat4(const int id, const glm::mat4& mat) const
 	{
 		glUniformMatrix4fv(id, 1, GL_FALSE, &mat[0][0]);
 	}
 
-	int getLocation(const std::string& name) {
-		return glGetUniformLocation(ID, name.c_str());
+	// ------------------------------------------------------------------------
+	void set(Uniform<bool> uniform, bool value) const
+	{
+		glUniform1i(uniform.location, (int)value);
+	}
+	void set(Uniform<int> uniform, int value) const
+	{
+		glUniform1i(uniform.location, value);
+	}
+	void set(Uniform<float> uniform, float value) const
+	{
+		glUniform1f(uniform.location, value);
+	}
+	void set(Uniform<glm::vec2> uniform, const glm::vec2& value) const
+	{
+		glUniform2fv(uniform.location, 1, &value[0]);
+	}
+	void set(Uniform<glm::vec3> uniform, const glm::vec3& value) const
+	{
+		glUniform3fv(uniform.location, 1, &value[0]);
+	}
+	void set(Uniform<glm::vec4> uniform, const glm::vec4& value) const
+	{
+		glUniform4fv(uniform.location, 1, &value[0]);
+	}
+	void set(Uniform<glm::mat2> uniform, const glm::mat2& mat) const
+	{
+		glUniformMatrix2fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+	}
+	void set(Uniform<glm::mat3> uniform, const glm::mat3& mat) const
+	{
+		glUniformMatrix3fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+	}
+	void set(Uniform<glm::mat4> uniform, const glm::mat4& mat) const
+	{
+		glUniformMatrix4fv(uniform.location, 1, GL_FALSE, &mat[0][0]);
+	}
+
+	/// <summary>
+	/// Returns the location of a uniform from the table built after linking,
+	/// e.g. "model", "lights[3].Position" or "finalBonesMatrices[12]".
+	/// Only falls back to the driver if the program was not linked through this class.
+	/// </summary>
+	/// <returns>The location or -1 if the uniform is not active.</returns>
+	int getLocation(const std::string& name) const {
+		if (!uniforms)
+			return glGetUniformLocation(ID, name.c_str());
+		auto it = uniforms->find(name);
+		return it != uniforms->end() ? it->second : -1;
+	}
+
+	/// <summary>
+	/// Resolves a typed handle, meant to be called once at setup and not per frame.
+	/// </summary>
+	template<typename T>
+	Uniform<T> uniform(const std::string& name) const {
+		Uniform<T> handle;
+		handle.location = getLocation(name);
+		return handle;
 	}
 protected:
     // utility function for checking shader compilation/linking errors.
@@ -371,7 +455,46 @@ protected:
 		char result[MAX_PATH];
 		return std::string(result, GetModuleFileName(NULL, result, MAX_PATH));
 	} */
+	/// <summary>
+	/// Builds the name -> location table of all active uniforms.
+	/// Arrays are reported as "name[0]", so the plain name and every element are added as well.
+	/// The table is shared, copying a Shader (e.g. passing it by value to Draw) doesn't copy it.
+	/// </summary>
+	void reflectUniforms()
+	{
+		auto table = std::make_shared<std::unordered_map<std::string, int>>();
+		int count = 0, maxLength = 0;
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+		glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+		std::vector<char> buffer(maxLength > 0 ? maxLength : 1);
+		for (int i = 0; i < count; i++)
+		{
+			GLsizei length = 0;
+			GLint size = 0;
+			GLenum type = 0;
+			glGetActiveUniform(ID, i, (GLsizei)buffer.size(), &length, &size, &type, buffer.data());
+			std::string name(buffer.data(), length);
+			int location = glGetUniformLocation(ID, name.c_str());
+			if (location < 0)
+				continue; // member of a uniform block
+			(*table)[name] = location;
+
+			if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+			{
+				std::string base = name.substr(0, name.size() - 3);
+				(*table)[base] = location;
+				for (int element = 1; element < size; element++)
+				{
+					std::string elementName = base + "[" + std::to_string(element) + "]";
+					(*table)[elementName] = glGetUniformLocation(ID, elementName.c_str());
+				}
+			}
+		}
+		uniforms = table;
+	}
+
 	private:
+		std::shared_ptr<const std::unordered_map<std::string, int>> uniforms;
 		unsigned int vertex = -1, fragment = -1;
 		unsigned int tessCont = -1, tessEval = -1;
 		unsigned int geometry = -1;
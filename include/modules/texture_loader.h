@@ -0,0 +1,199 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <glad/glad.h>
+
+#include "stb_image.h"
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// <summary>
+/// Loads 2D textures asynchronously.
+/// Image files are decoded by a pool of worker threads, only the final upload
+/// (glTexImage2D + mipmap generation) is done on the thread owning the GL context.
+/// Every requested texture gets its GL name immediately and holds a 1x1 placeholder
+/// until its image has been uploaded, so it can be bound right away.
+/// </summary>
+class TextureLoader
+{
+public:
+	/// <summary>
+	/// Returns the loader shared by all models of the application.
+	/// </summary>
+	static TextureLoader& instance()
+	{
+		static TextureLoader loader;
+		return loader;
+	}
+
+	TextureLoader(unsigned int threadCount = defaultThreadCount())
+	{
+		for (unsigned int i = 0; i < threadCount; i++)
+			workers.emplace_back(&TextureLoader::work, this);
+	}
+
+	~TextureLoader()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAvailable.notify_all();
+		for (std::thread& worker : workers)
+			worker.join();
+		// free decoded images that were never uploaded
+		for (Job& job : decoded)
+			stbi_image_free(job.data);
+	}
+
+	// keep one core for the GL thread
+	static unsigned int defaultThreadCount()
+	{
+		unsigned int cores = std::thread::hardware_concurrency();
+		return cores > 1 ? cores - 1 : 1;
+	}
+
+	TextureLoader(const TextureLoader&) = delete;
+	TextureLoader& operator=(const TextureLoader&) = delete;
+
+	/// <summary>
+	/// Creates a texture with placeholder content and queues the decoding of its image.
+	/// Must be called on the GL thread.
+	/// </summary>
+	/// <param name="filename">The path of the image file.</param>
+	/// <param name="wrap">The wrap mode of the texture.</param>
+	/// <returns>The GL name of the texture.</returns>
+	unsigned int request(const std::string& filename, GLenum wrap = GL_REPEAT)
+	{
+		unsigned int textureID;
+		glGenTextures(1, &textureID);
+
+		const unsigned char placeholder[4] = { 255, 255, 255, 255 };
+		glBindTexture(GL_TEXTURE_2D, textureID);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, placeholder);
+
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+		Job job;
+		job.textureID = textureID;
+		job.filename = filename;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			pending.push_back(job);
+			outstanding++;
+		}
+		jobAvailable.notify_one();
+		return textureID;
+	}
+
+	/// <summary>
+	/// Uploads all images decoded so far. Must be called on the GL thread,
+	/// typically once per frame while textures are still streaming in.
+	/// </summary>
+	/// <returns>The number of textures that are still pending.</returns>
+	unsigned int update()
+	{
+		std::vector<Job> finished;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			finished.swap(decoded);
+		}
+		for (Job& job : finished)
+			upload(job);
+
+		std::lock_guard<std::mutex> lock(mutex);
+		outstanding -= (unsigned int)finished.size();
+		return outstanding;
+	}
+
+	/// <summary>
+	/// Blocks until all requested textures are uploaded.
+	/// Images are uploaded as soon as they are decoded, so uploads overlap with the remaining decodes.
+	/// </summary>
+	void finish()
+	{
+		while (update() > 0)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobDone.wait(lock, [this] { return !decoded.empty(); });
+		}
+	}
+
+private:
+	struct Job {
+		unsigned int textureID = 0;
+		std::string filename;
+		unsigned char* data = nullptr;
+		int width = 0, height = 0, nrComponents = 0;
+	};
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobAvailable;
+	std::condition_variable jobDone;
+	std::deque<Job> pending;		// waiting for a worker
+	std::vector<Job> decoded;		// waiting for the upload on the GL thread
+	unsigned int outstanding = 0;	// requested but not yet uploaded
+	bool stopping = false;
+
+	// worker thread: decode images until the loader is destroyed
+	void work()
+	{
+		for (;;)
+		{
+			Job job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAvailable.wait(lock, [this] { return stopping || !pending.empty(); });
+				if (stopping)
+					return;
+				job = pending.front();
+				pending.pop_front();
+			}
+
+			job.data = stbi_load(job.filename.c_str(), &job.width, &job.height, &job.nrComponents, 0);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				decoded.push_back(job);
+			}
+			jobDone.notify_all();
+		}
+	}
+
+	void upload(Job& job)
+	{
+		if (job.data)
+		{
+			GLenum format = GL_RGB;
+			if (job.nrComponents == 1)
+				format = GL_RED;
+			else if (job.nrComponents == 3)
+				format = GL_RGB;
+			else if (job.nrComponents == 4)
+				format = GL_RGBA;
+
+			glBindTexture(GL_TEXTURE_2D, job.textureID);
+			glTexImage2D(GL_TEXTURE_2D, 0, format, job.width, job.height, 0, format, GL_UNSIGNED_BYTE, job.data);
+			glGenerateMipmap(GL_TEXTURE_2D);
+
+			stbi_image_free(job.data);
+			job.data = nullptr;
+		}
+		else
+		{
+			std::cout << "Texture failed to load at path: " << job.filename << std::endl;
+		}
+	}
+};
+
+#endif // ! TEXTURE_LOADER_H
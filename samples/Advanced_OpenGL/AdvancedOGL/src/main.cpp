@@ -20,6 +20,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 
@@ -93,6 +94,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -643,6 +645,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// ------------------------------------------------------------------------------_
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -25,6 +25,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 
@@ -99,6 +100,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -206,6 +208,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 	}
 
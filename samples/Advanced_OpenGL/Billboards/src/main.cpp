@@ -19,6 +19,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 
@@ -114,6 +115,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -244,6 +246,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
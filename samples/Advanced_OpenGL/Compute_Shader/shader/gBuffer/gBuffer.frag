@@ -29,7 +29,7 @@ in vec2 fTexCoord;                                  /**< Textur-Koordinate */
 
 layout (location = 0) out vec3 FragColor;           /**< Farbe des Fragments (auf Attachment 0) */
 layout (location = 1) out vec4 FragReflection;      /**< Reflexionseigenschaften des Materials */
-layout (location = 2) out vec3 FragNormal;          /**< Normale des Fragments im Welt-Koordinatensystem */
+layout (location = 2) out vec2 FragNormal;          /**< Normale des Fragments im Welt-Koordinatensystem (oktaedrisch kodiert) */
 
 // ----------------------------------------------------------------------------
 //
@@ -47,6 +47,34 @@ layout (binding = 0) uniform sampler2D ObjectMaterialTexture;   /**< Textur mit
 //
 // ----------------------------------------------------------------------------
 
+/**
+ * Oktaedrische Kodierung einer Normalen: die Normale wird auf einen Oktaeder projiziert
+ * und in das Quadrat [0, 1]^2 ausgeklappt, zwei 16 Bit Kanle reichen fr die Genauigkeit
+ *
+ * @param n                     Normierte Normale
+ *
+ * @return Kodierte Normale
+ */
+vec2 encodeNormal(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    vec2 e = n.xy;
+    if (n.z < 0) {
+        e = (vec2(1) - abs(n.yx))*vec2(n.x >= 0 ? 1 : -1, n.y >= 0 ? 1 : -1);
+    }
+    return 0.5*e + vec2(0.5);
+}
+
+/**
+ * Kodiert den Glanz-Exponenten logarithmisch fr einen 8 Bit Kanal (Werte von 0 bis 255)
+ *
+ * @param shininess             Glanz-Exponent
+ *
+ * @return Wert fr den Alpha-Kanal des Reflection-Buffers
+ */
+float encodeShininess(float shininess) {
+    return log2(shininess + 1) / 8;
+}
+
 /**
  * Einsprungpunkt fr den Fragment-Shader
  */
@@ -58,6 +86,6 @@ void main() {
     FragReflection  = vec4(ObjectMaterial.ambientReflection,
                            ObjectMaterial.diffuseReflection,
                            ObjectMaterial.specularReflection,
-                           ObjectMaterial.shininess);
-    FragNormal      = 0.5*fWorldNormal + vec3(0.5);
+                           encodeShininess(ObjectMaterial.shininess));
+    FragNormal      = encodeNormal(normalize(fWorldNormal));
 }
@@ -110,6 +110,32 @@ vec4 shadeDirectionalLight(Material material,
     return i_amb + attenuation*(i_diff + i_spec);
 }
 
+/**
+ * Dekodiert eine oktaedrisch kodierte Normale (siehe gBuffer.frag)
+ *
+ * @param e                     Kodierte Normale aus dem Normal-Buffer
+ *
+ * @return Normale im Welt-Koordinatensystem
+ */
+vec3 decodeNormal(vec2 e) {
+    e = 2*e - vec2(1);
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+    return normalize(n);
+}
+
+/**
+ * Dekodiert den logarithmisch gespeicherten Glanz-Exponenten (siehe gBuffer.frag)
+ *
+ * @param a                     Alpha-Kanal des Reflection-Buffers
+ *
+ * @return Glanz-Exponent
+ */
+float decodeShininess(float a) {
+    return exp2(8*a) - 1;
+}
+
 /**
  * Inverse Depth-Range Transformation
  *
@@ -132,23 +158,24 @@ void main() {
     // Buffer auslesen
     vec3 color      = texture(ColorBuffer, bufferTexCoord).rgb;
     vec4 reflection = texture(ReflectionBuffer, bufferTexCoord);
-    vec3 normal     = texture(NormalBuffer, bufferTexCoord).rgb;
+    vec2 normal     = texture(NormalBuffer, bufferTexCoord).rg;
+    float depthFromDepthBuffer = texture(DepthBuffer, bufferTexCoord).r;
+
+    // Hintergrund (kein Fragment im G-Buffer)
+    if (depthFromDepthBuffer == 1.0) {
+        discard;
+    }
 
     Material material;
     material.color              = vec4(color, 1);
     material.ambientReflection  = reflection.r;
     material.diffuseReflection  = reflection.g;
     material.specularReflection = reflection.b;
-    material.shininess          = reflection.a;
+    material.shininess          = decodeShininess(reflection.a);
     material.hasTexture         = false;
 
-    vec3 worldNormal = 2*normal - vec3(1);
+    vec3 worldNormal = decodeNormal(normal);
 
-    if (dot(worldNormal, worldNormal) < 0.001) {
-        discard;
-    }
-
-    float depthFromDepthBuffer = texture(DepthBuffer, bufferTexCoord).r;
     float depth = inverseDepthRangeTransformation(depthFromDepthBuffer);
     vec4 fragmentDcPosition = vec4(2*bufferTexCoord - vec2(1), depth, 1);
     vec4 fragmentWorldPosition4 = ViewerInverseViewProjectionMatrix*fragmentDcPosition;
@@ -123,6 +123,32 @@ vec4 shadeDirectionalLight(Material material,
     return i_amb + attenuation*(i_diff + i_spec);
 }
 
+/**
+ * Dekodiert eine oktaedrisch kodierte Normale (siehe gBuffer.frag)
+ *
+ * @param e                     Kodierte Normale aus dem Normal-Buffer
+ *
+ * @return Normale im Welt-Koordinatensystem
+ */
+vec3 decodeNormal(vec2 e) {
+    e = 2*e - vec2(1);
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += vec2(n.x >= 0 ? -t : t, n.y >= 0 ? -t : t);
+    return normalize(n);
+}
+
+/**
+ * Dekodiert den logarithmisch gespeicherten Glanz-Exponenten (siehe gBuffer.frag)
+ *
+ * @param a                     Alpha-Kanal des Reflection-Buffers
+ *
+ * @return Glanz-Exponent
+ */
+float decodeShininess(float a) {
+    return exp2(8*a) - 1;
+}
+
 /**
  * Inverse Depth-Range Transformation
  *
@@ -158,17 +184,17 @@ vec4 shade(vec2 bufferTexCoord) {
     // Buffer auslesen
     vec3 color      = texture(ColorBuffer, bufferTexCoord).rgb;
     vec4 reflection = texture(ReflectionBuffer, bufferTexCoord);
-    vec3 normal     = texture(NormalBuffer, bufferTexCoord).rgb;
+    vec2 normal     = texture(NormalBuffer, bufferTexCoord).rg;
 
     Material material;
     material.color              = vec4(color, 1);
     material.ambientReflection  = reflection.r;
     material.diffuseReflection  = reflection.g;
     material.specularReflection = reflection.b;
-    material.shininess          = reflection.a;
+    material.shininess          = decodeShininess(reflection.a);
     material.hasTexture         = false;
 
-    vec3 worldNormal = 2*normal - vec3(1);
+    vec3 worldNormal = decodeNormal(normal);
 
     vec3 fragmentWorldPosition = gBufferWorldPosition(bufferTexCoord);
 
@@ -68,8 +68,8 @@ class GBuffer {
 
 			// creates the storage area of the texture (without initializing it)
 			glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_REFLECTION]);
-			//if texture id is ALBEDOSPEC using RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, WindowWidth, WindowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+			// Koeffizienten in [0, 1], der Glanz-Exponent logarithmisch im Alpha-Kanal (siehe gBuffer.frag)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowWidth, WindowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // prevents unnecessary interpolation between the texels that might create some fine distortions
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -81,8 +81,8 @@ class GBuffer {
 
 			// creates the storage area of the texture (without initializing it)
 			glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_NORMAL]);
-			//if texture id is ALBEDOSPEC using RGBA
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowWidth, WindowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+			// oktaedrisch kodierte Normale, 16 Bit pro Kanal (genauer als RGBA8 bei gleicher Gre)
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, WindowWidth, WindowHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // prevents unnecessary interpolation between the texels that might create some fine distortions
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -150,26 +150,15 @@ class GBuffer {
 			// now we keep changing the FBO, config the draw buffers for the attributes !
 			glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
 
-			// initialise color- & reflection-buffer to 0
-			GLenum drawBuffer[] = { GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_COLOR,
-									GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_REFLECTION
-								  };
-
-			glDrawBuffers(sizeof(drawBuffer) / sizeof(drawBuffer[0]), drawBuffer); // supplying array if attchment locations 
-			glClearColor(0, 0, 0, 1);
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			// initialise Normal-Buffer to (0.5, 0.5, 0.5)
-			glDrawBuffer(GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_NORMAL);
-			glClearColor(0.5f, 0.5f, 0.5f, 1);
-			glClear(GL_COLOR_BUFFER_BIT);
-
+			// initialise all buffers to 0, the light pass detects the background by the depth
 			GLuint attachments[] = {
 				 GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_COLOR,
 				 GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_REFLECTION,
 				 GL_COLOR_ATTACHMENT0 + GBUFFER_TEXTURE_TYPE_NORMAL,
 			};
 			glDrawBuffers(sizeof(attachments) / sizeof(attachments[0]), attachments);
+			glClearColor(0, 0, 0, 1);
+			glClear(GL_COLOR_BUFFER_BIT);
 		};
 
 		void bindForLightPass() {
@@ -22,6 +22,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include "gBuffer.h"
 
@@ -179,6 +180,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	std::cout << "OpenGL-Version: " << glGetString(GL_VERSION) << std::endl;
 
@@ -472,6 +474,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
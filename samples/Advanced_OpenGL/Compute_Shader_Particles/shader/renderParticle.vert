@@ -2,12 +2,23 @@
 
 // ----------------------------------------------------------------------------
 //
-// Attribute
+// Buffer
 //
 // ----------------------------------------------------------------------------
 
-layout (location = 0) in vec4 vPosition;                    /**< Position des Partikels */
-layout (location = 1) in vec2 vVelocity;                    /**< Geschwindigkeit des Partikels */
+/** Positionen und Geschwindigkeiten werden ber den Index des lebenden Partikels gelesen */
+layout (std430, binding = 0) buffer PositionBuffer {
+    vec2 positions[];
+};
+
+layout (std430, binding = 1) buffer VelocitiesBuffer {
+    vec2 velocities[];
+};
+
+/** Lebende Partikel nach der Simulation, gezeichnet mit glDrawArraysIndirect */
+layout (std430, binding = 6) buffer AliveList {
+    uint aliveIndices[];
+};
 
 out vec2 fVelocity;
 out vec2 fPosition;
@@ -30,7 +41,8 @@ layout (location = 0) uniform mat4 ProjectionMatrix;        /**< Transformation
  * Einsprungpunkt fr den Vertex-Shader
  */
 void main() {
-    fVelocity = vVelocity;
-    fPosition = vPosition.xy;
-    gl_Position = ProjectionMatrix*vPosition;
+    uint slot = aliveIndices[gl_VertexID];
+    fVelocity = velocities[slot];
+    fPosition = positions[slot];
+    gl_Position = ProjectionMatrix*vec4(fPosition, 0.0, 1.0);
 }
@@ -0,0 +1,44 @@
+#version 430 core
+
+// ----------------------------------------------------------------------------
+//
+// Buffers
+//
+// ----------------------------------------------------------------------------
+
+/** the particles are drawn in the order of the sort buffer, their data is read by index */
+layout (std430, binding = 0) buffer PositionBuffer {
+    vec2 positions[];
+};
+
+layout (std430, binding = 1) buffer VelocitiesBuffer {
+    vec2 velocities[];
+};
+
+layout (std430, binding = 2) buffer SortBuffer {
+    uvec2 pairs[];
+};
+
+out vec2 fVelocity;
+out vec2 fPosition;
+
+// ----------------------------------------------------------------------------
+//
+// Uniforms
+//
+// ----------------------------------------------------------------------------
+
+layout (location = 0) uniform mat4 ProjectionMatrix;        /**< camera to clip space */
+
+// ----------------------------------------------------------------------------
+//
+// Functions
+//
+// ----------------------------------------------------------------------------
+
+void main() {
+    uint index = pairs[gl_VertexID].y;
+    fVelocity = velocities[index];
+    fPosition = positions[index];
+    gl_Position = ProjectionMatrix*vec4(fPosition, 0.0, 1.0);
+}
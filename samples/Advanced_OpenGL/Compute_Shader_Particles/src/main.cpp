@@ -2,10 +2,8 @@
  *	Compute Shader - Particles
  */
 
- /** Particel Count */
+ /** Particel Count: capacity, only the alive particles are simulated and drawn */
 #define NUM_PARTICLES 1000000
-#define NUM_PARTICLES_PER_LOCAL_WORK_GROUP 1000 
-			// Has to be inserted correctly in the Compute Shader
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -23,8 +21,13 @@
 #include "modules/model.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
+#include "particle_sort.h"
+
+#include <cstddef>
 #include <iostream>
+#include <vector>
 
 // callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -39,10 +42,35 @@ void renderCube();
 void renderSphere(); 
 float randomFloat();
 
+// Particle counters, layout of the ParticleCounters block of the compute shaders
+struct DrawArraysIndirectCommand {
+	GLuint count;			// length of the alive list
+	GLuint instanceCount;
+	GLuint first;
+	GLuint baseInstance;
+};
+
+struct ParticleCounters {
+	DrawArraysIndirectCommand draws[2];
+	GLuint emitGroups[3];	// indirect dispatch of the emission
+	GLuint simulateGroups[3];	// indirect dispatch of the simulation
+	GLuint deadCount;
+	GLuint emitCount;
+};
+
 // Particle attractor
 glm::vec2 attractor;		// point of attraction
 float attractorForce;		// Multiplicator for velocity to attractor
 
+// Emission: about NUM_PARTICLES alive at the default rate
+const float LIFETIME_MIN = 4.0f;	// seconds
+const float LIFETIME_MAX = 8.0f;
+float emissionRate = NUM_PARTICLES / (0.5f * (LIFETIME_MIN + LIFETIME_MAX));	// particles per second, up/down: double/halve
+bool Uppressed = false, Downpressed = false;
+
+bool sortedParticles = false;	// S: sort the particles back to front and draw them alpha blended
+bool Spressed = false;
+
 // settings
 const unsigned int SCR_WIDTH = 1280;
 const unsigned int SCR_HEIGHT = 720;
@@ -102,6 +130,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -117,45 +146,59 @@ int main()
 
 	// Particle VAO
 	// ------------
+	// the shaders read the particles from the storage buffers, the draw only needs a VAO
 	GLuint particlesVertexArrayObject;
 	glGenVertexArrays(1, &particlesVertexArrayObject);
 	glBindVertexArray(particlesVertexArrayObject);
 
-	GLuint particlePositionBuffer, particleVelocityBuffer;
-	// create Position Buffer & fill with data
+	// Particle buffers, indexed by slot
+	// ---------------------------------
+	GLuint particlePositionBuffer, particleVelocityBuffer, particleLifetimeBuffer;
 	glGenBuffers(1, &particlePositionBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, particlePositionBuffer);
-	glBufferData(GL_ARRAY_BUFFER, NUM_PARTICLES * sizeof(glm::vec2), NULL, GL_STREAM_DRAW);
-	GLvoid * pointer = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-
-	for (int i = 0; i < NUM_PARTICLES; ++i) {
-		glm::vec2 pos = glm::vec2(randomFloat()*win_width, randomFloat()*win_height);
-		memcpy((glm::vec2*)pointer + i, &pos, sizeof(glm::vec2));
-	}
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-	
-	glEnableVertexAttribArray(0);
-	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (void*)(intptr_t)0);
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-
-
-	// create Position Buffer & fill with data
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, particlePositionBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PARTICLES * sizeof(glm::vec2), NULL, GL_DYNAMIC_COPY);
 	glGenBuffers(1, &particleVelocityBuffer);
-	glBindBuffer(GL_ARRAY_BUFFER, particleVelocityBuffer);
-	glBufferData(GL_ARRAY_BUFFER, NUM_PARTICLES * sizeof(glm::vec2), NULL, GL_STREAM_DRAW);
-	GLvoid * pointer2 = glMapBuffer(GL_ARRAY_BUFFER, GL_READ_WRITE);
-	srand((unsigned)time(NULL));
-	for (int i = 0; i < NUM_PARTICLES; ++i) {
-		glm::vec2 pos = glm::vec2(i / NUM_PARTICLES * randomFloat()*(float)win_width/*i/NUM_PARTICLES*win_width*/, i / NUM_PARTICLES * randomFloat()* (float)win_height /*i / NUM_PARTICLES * win_width*/);
-		memcpy((glm::vec2*)pointer2 + i, &pos, sizeof(glm::vec2));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleVelocityBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PARTICLES * sizeof(glm::vec2), NULL, GL_DYNAMIC_COPY);
+	glGenBuffers(1, &particleLifetimeBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, particleLifetimeBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PARTICLES * sizeof(GLfloat), NULL, GL_DYNAMIC_COPY);
+
+	// Particle lists
+	// --------------
+	// dead list: stack of the free slots, all slots at the start
+	std::vector<GLuint> slots(NUM_PARTICLES);
+	for (GLuint i = 0; i < NUM_PARTICLES; ++i)
+		slots[i] = i;
+	GLuint deadListBuffer;
+	glGenBuffers(1, &deadListBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, deadListBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PARTICLES * sizeof(GLuint), slots.data(), GL_DYNAMIC_COPY);
+	// alive lists: the simulation reads one and appends the survivors to the other, they swap every frame
+	GLuint aliveListBuffers[2];
+	glGenBuffers(2, aliveListBuffers);
+	for (GLuint buffer : aliveListBuffers)
+	{
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, NUM_PARTICLES * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
 	}
+	// counters of the lists, written on the GPU and used as the indirect dispatch and draw commands
+	ParticleCounters counters = {};
+	for (DrawArraysIndirectCommand& draw : counters.draws)
+		draw.instanceCount = 1;
+	counters.emitGroups[1] = counters.emitGroups[2] = 1;
+	counters.simulateGroups[1] = counters.simulateGroups[2] = 1;
+	counters.deadCount = NUM_PARTICLES;
+	GLuint counterBuffer;
+	glGenBuffers(1, &counterBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ParticleCounters), &counters, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBuffer(GL_DISPATCH_INDIRECT_BUFFER, counterBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, counterBuffer);
+	GLuint currentList = 0;
+	float births = 0.0f;	// particles due to be spawned
 
-	glUnmapBuffer(GL_ARRAY_BUFFER);
-
-	glEnableVertexAttribArray(1);
-	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (void*)(intptr_t)0);
-	
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	// 1D-Lookup Tabelle erstellen
 	GLuint colorLookup;
 	glGenTextures(1, &colorLookup);
@@ -177,16 +220,49 @@ int main()
 	// build and compile shader program(s)
 	// ------------------------------------
 	Shader renderParticleShader(FileSystem::getSamplePath("shader/renderparticle.vert").c_str(), FileSystem::getSamplePath("shader/renderparticle.frag").c_str());
+	// draws the particles in the order of the sort buffer
+	Shader renderSortedParticleShader(FileSystem::getSamplePath("shader/renderParticleSorted.vert").c_str(), FileSystem::getSamplePath("shader/renderParticle.frag").c_str());
 	const GLuint renderParticlesProgram_ProjectionMatrix = 0;
+	Shader prepareEmissionShader(FileSystem::getSamplePath("shader/prepareEmission.comp").c_str());
+	const GLuint prepareEmissionProgram_Current = 0;
+	const GLuint prepareEmissionProgram_EmitRequest = 1;
+	Shader emitParticleShader(FileSystem::getSamplePath("shader/emitParticles.comp").c_str());
+	const GLuint emitParticlesProgram_FramebufferSize = 0;
+	const GLuint emitParticlesProgram_Seed = 1;
+	const GLuint emitParticlesProgram_Current = 2;
+	const GLuint emitParticlesProgram_LifetimeMin = 3;
+	const GLuint emitParticlesProgram_LifetimeMax = 4;
 	Shader simulateParticleShader(FileSystem::getSamplePath("shader/simulateparticle.comp").c_str());
 	const GLuint simulateParticlesProgram_Dt = 0;
 	const GLuint simulateParticlesProgram_FramebufferSize = 1;
 	const GLuint simulateParticlesProgram_Attractor = 2;
 	const GLuint simulateParticlesProgram_AttractorForce = 3;
+	const GLuint simulateParticlesProgram_Current = 4;
 	const GLuint simulateParticlesProgram_PositionsBuffer = 0;
 	const GLuint simulateParticlesProgram_VelocitiesBuffer = 1;
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, particlePositionBuffer);
-	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, particleVelocityBuffer);
+	const GLuint simulateParticlesProgram_LifetimesBuffer = 3;
+	const GLuint simulateParticlesProgram_DeadList = 4;
+	const GLuint simulateParticlesProgram_AliveList = 5;
+	const GLuint simulateParticlesProgram_SurvivorList = 6;
+	const GLuint simulateParticlesProgram_Counters = 7;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_PositionsBuffer, particlePositionBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_VelocitiesBuffer, particleVelocityBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_LifetimesBuffer, particleLifetimeBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_DeadList, deadListBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_Counters, counterBuffer);
+	// the sample is seen from above: the particles nearest to the attractor, in the core of the vortex, are drawn last
+	ParticleSort particleSort(NUM_PARTICLES, FileSystem::getSamplePath("shader/"));
+
+	// timer queries of the sort, read one frame later
+	unsigned int timerQueries[2];
+	glGenQueries(2, timerQueries);
+	bool queryIssued[2] = { false, false };
+	unsigned int frameIndex = 0;
+	double sortTime = 0.0;
+	unsigned int timedFrames = 0;
+
+	int frameCount = 0;
+	double previousTime = glfwGetTime();
 
 	// shader configuration
 	// --------------------
@@ -204,8 +280,57 @@ int main()
 		deltaTime = currentFrame - lastFrame;
 		lastFrame = currentFrame;
 
+		// fps
+		frameCount++;
+		// If a second has passed.
+		if (currentFrame - previousTime >= 1.0)
+		{
+			std::cout << "FPS:" << frameCount;
+			// reading the counter waits for the last simulation, once per second is fine
+			GLuint alive = 0;
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, counterBuffer);
+			glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, currentList * sizeof(DrawArraysIndirectCommand), sizeof(GLuint), &alive);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+			std::cout << " | alive: " << alive << "/" << NUM_PARTICLES;
+			if (timedFrames > 0)
+				std::cout << " | sort: " << sortTime / timedFrames << "ms";
+			std::cout << std::endl;
+			frameCount = 0;
+			sortTime = 0.0;
+			timedFrames = 0;
+			previousTime = currentFrame;
+		}
+
 		glm::vec2 framebufferSize(win_width, win_height);
 
+		// the survivors of this frame are the alive particles of the next one
+		const GLuint survivorList = 1 - currentList;
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_AliveList, aliveListBuffers[currentList]);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, simulateParticlesProgram_SurvivorList, aliveListBuffers[survivorList]);
+
+		// Emit Particles
+		// --------------
+		// the fraction of a particle is carried over to the next frame
+		births += emissionRate * deltaTime;
+		GLuint emitRequest = (GLuint)births;
+		births -= emitRequest;
+
+		prepareEmissionShader.use();
+		prepareEmissionShader.setInt(prepareEmissionProgram_Current, currentList);
+		prepareEmissionShader.setInt(prepareEmissionProgram_EmitRequest, emitRequest);
+		glDispatchCompute(1, 1, 1);
+		// the counters are the arguments of the indirect dispatches
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		emitParticleShader.use();
+		emitParticleShader.setVec2(emitParticlesProgram_FramebufferSize, framebufferSize);
+		emitParticleShader.setInt(emitParticlesProgram_Seed, frameIndex);
+		emitParticleShader.setInt(emitParticlesProgram_Current, currentList);
+		emitParticleShader.setFloat(emitParticlesProgram_LifetimeMin, LIFETIME_MIN);
+		emitParticleShader.setFloat(emitParticlesProgram_LifetimeMax, LIFETIME_MAX);
+		glDispatchComputeIndirect(offsetof(ParticleCounters, emitGroups));
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
 		// Update Particle Simulation
 		// --------------------------
 		simulateParticleShader.use();
@@ -213,27 +338,62 @@ int main()
 		simulateParticleShader.setVec2(simulateParticlesProgram_FramebufferSize, framebufferSize);
 		simulateParticleShader.setVec2(simulateParticlesProgram_Attractor, attractor);
 		simulateParticleShader.setFloat(simulateParticlesProgram_AttractorForce, attractorForce);
+		simulateParticleShader.setInt(simulateParticlesProgram_Current, currentList);
 
-		// Number of local Workgroups
-		glDispatchCompute(NUM_PARTICLES / NUM_PARTICLES_PER_LOCAL_WORK_GROUP, 1, 1);
+		// one invocation per alive particle, the dead ones go back to the dead list
+		glDispatchComputeIndirect(offsetof(ParticleCounters, simulateGroups));
+
+		// Sort back to front
+		// ------------------
+		unsigned int query = timerQueries[frameIndex % 2];
+		queryIssued[frameIndex % 2] = sortedParticles;
+		if (sortedParticles)
+		{
+			glBeginQuery(GL_TIME_ELAPSED, query);
+			// the survivor count is the count of its draw command
+			particleSort.sort(particlePositionBuffer, aliveListBuffers[survivorList], counterBuffer,
+				survivorList * sizeof(DrawArraysIndirectCommand) / sizeof(GLuint), attractor);
+			glEndQuery(GL_TIME_ELAPSED);
+		}
 
 		glClear(GL_COLOR_BUFFER_BIT);
 
-		renderParticleShader.use();
+		Shader& particleShader = sortedParticles ? renderSortedParticleShader : renderParticleShader;
+		particleShader.use();
 
 		glm::mat4 projectionMatrix = glm::ortho(0.0f, (float) win_width, (float)win_height, 0.0f, -1.0f, 1.0f);
-		renderParticleShader.setMat4(renderParticlesProgram_ProjectionMatrix, projectionMatrix);
-
-		// wait until Compute Shader has finished writing to Shader Storage Buffer
-		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-
-		glDrawArrays(GL_POINTS, 0, NUM_PARTICLES);
+		particleShader.setMat4(renderParticlesProgram_ProjectionMatrix, projectionMatrix);
+
+		// wait until Compute Shader has finished writing to Shader Storage Buffer and the counters
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT | GL_COMMAND_BARRIER_BIT);
+
+		// additive blending doesn't depend on the order, blending over needs the sorted order
+		if (sortedParticles)
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		else
+			glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		// as many points as survivors, the render shaders read the slot from the survivor list or the sort buffer
+		glDrawArraysIndirect(GL_POINTS, (void*)(intptr_t)(survivorList * sizeof(DrawArraysIndirectCommand)));
+		currentList = survivorList;
+
+		// sort time of the previous frame
+		unsigned int previous = (frameIndex + 1) % 2;
+		if (queryIssued[previous])
+		{
+			GLuint64 sortNanoseconds = 0;
+			glGetQueryObjectui64v(timerQueries[previous], GL_QUERY_RESULT, &sortNanoseconds);
+			sortTime += sortNanoseconds / 1000000.0;
+			timedFrames++;
+			queryIssued[previous] = false;
+		}
+		frameIndex++;
 
 		// Check and call events
 		processInput(window);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -241,6 +401,11 @@ int main()
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
 	// TODO clear particlesVertexArrayObject particlePositionBuffer particleVelocityBuffer
+	glDeleteQueries(2, timerQueries);
+	glDeleteBuffers(1, &particleLifetimeBuffer);
+	glDeleteBuffers(1, &deadListBuffer);
+	glDeleteBuffers(2, aliveListBuffers);
+	glDeleteBuffers(1, &counterBuffer);
 	
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -478,6 +643,36 @@ void processInput(GLFWwindow *window)
 	else {
 		attractorForce = 0;
 	}
+
+	if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS) {
+		Spressed = true;
+	}
+
+	if (Spressed && glfwGetKey(window, GLFW_KEY_S) == GLFW_RELEASE) {
+		Spressed = false;
+		sortedParticles = !sortedParticles;
+		std::cout << (sortedParticles ? "sorted particles, alpha blended" : "unsorted particles, additive") << std::endl;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+		Uppressed = true;
+	}
+
+	if (Uppressed && glfwGetKey(window, GLFW_KEY_UP) == GLFW_RELEASE) {
+		Uppressed = false;
+		emissionRate *= 2.0f;
+		std::cout << "emission: " << emissionRate << " particles/s" << std::endl;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+		Downpressed = true;
+	}
+
+	if (Downpressed && glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_RELEASE) {
+		Downpressed = false;
+		emissionRate *= 0.5f;
+		std::cout << "emission: " << emissionRate << " particles/s" << std::endl;
+	}
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -0,0 +1,129 @@
+#ifndef PARTICLE_SORT_H
+#define PARTICLE_SORT_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <string>
+
+#include "modules/shader_m.h"
+
+/// <summary>
+/// Sorts the particles back to front on the GPU, so they can be drawn with alpha blending.
+/// Every frame a key/value pair (depth key, particle index) is written for each particle of an index
+/// list, whose length is only known on the GPU, and the pairs are sorted with a bitonic sort in
+/// compute shaders:
+///	- stage 0 sorts every block of BLOCK_SIZE pairs in shared memory
+///	- the merges larger than a block run one global compare and exchange step per dispatch for the
+///	  distances >= BLOCK_SIZE (stage 1), then finish the distances within a block in shared memory (stage 2)
+/// The pairs are padded to a power of two with keys behind all particles, the cost depends on the
+/// capacity, not on the number of particles. The sort buffer is bound as shader storage buffer
+/// BINDING, the sorted indices are read from it by the render shader.
+/// </summary>
+class ParticleSort {
+public:
+	static const GLuint GROUP_SIZE = 512;		// has to match bitonicSort.comp
+	static const GLuint BLOCK_SIZE = 1024;		// pairs sorted by a work group, 2 per invocation
+	static const GLuint KEY_GROUP_SIZE = 256;	// has to match particleSortKeys.comp
+	static const GLuint BINDING = 2;
+	static const GLuint POSITION_BINDING = 0;
+	static const GLuint INDEX_BINDING = 6;
+	static const GLuint COUNT_BINDING = 7;
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="ParticleSort"/> class.
+	/// </summary>
+	/// <param name="capacity">Largest number of particles to sort.</param>
+	/// <param name="shaderDirectory">Directory of particleSortKeys.comp and bitonicSort.comp, ending with a separator.</param>
+	ParticleSort(GLuint capacity, const std::string& shaderDirectory)
+		: keyShader((shaderDirectory + "particleSortKeys.comp").c_str()),
+		sortShader((shaderDirectory + "bitonicSort.comp").c_str())
+	{
+		paddedCount = BLOCK_SIZE;
+		while (paddedCount < capacity)
+			paddedCount <<= 1;
+		glGenBuffers(1, &sortBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, sortBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, paddedCount * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	}
+
+	~ParticleSort()
+	{
+		glDeleteBuffers(1, &sortBuffer);
+	}
+
+	ParticleSort(const ParticleSort&) = delete;
+	ParticleSort& operator=(const ParticleSort&) = delete;
+
+	/// <summary>
+	/// Sorts the listed particles by descending distance to depthOrigin.
+	/// Binds the buffers to POSITION_BINDING, INDEX_BINDING, COUNT_BINDING and BINDING.
+	/// </summary>
+	/// <param name="positionBuffer">Buffer of vec2 positions.</param>
+	/// <param name="indexBuffer">Indices of the particles to sort.</param>
+	/// <param name="countBuffer">Buffer of uint with the number of indices, at most the capacity.</param>
+	/// <param name="countIndex">Element of countBuffer with the number of indices.</param>
+	/// <param name="depthOrigin">The point nearest to the viewer.</param>
+	void sort(GLuint positionBuffer, GLuint indexBuffer, GLuint countBuffer, GLuint countIndex, glm::vec2 depthOrigin)
+	{
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, POSITION_BINDING, positionBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, INDEX_BINDING, indexBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COUNT_BINDING, countBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BINDING, sortBuffer);
+
+		// the positions and the list are written by the simulation
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+		keyShader.use();
+		keyShader.setInt(KEYS_COUNT_INDEX, (int)countIndex);
+		keyShader.setVec2(KEYS_DEPTH_ORIGIN, depthOrigin);
+		glDispatchCompute(paddedCount / KEY_GROUP_SIZE, 1, 1);
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+		sortShader.use();
+		dispatch(STAGE_BLOCK, 0, 0, paddedCount / BLOCK_SIZE);
+		for (GLuint k = 2 * BLOCK_SIZE; k <= paddedCount; k <<= 1)
+		{
+			for (GLuint j = k / 2; j >= BLOCK_SIZE; j >>= 1)
+				dispatch(STAGE_GLOBAL_STEP, k, j, paddedCount / 2 / GROUP_SIZE);
+			dispatch(STAGE_BLOCK_MERGE, k, 0, paddedCount / BLOCK_SIZE);
+		}
+	}
+
+	/// <summary>
+	/// Buffer of uvec2 (key, particle index), sorted by ascending key after sort().
+	/// </summary>
+	GLuint getBuffer() const { return sortBuffer; }
+
+	/// <summary>
+	/// Number of pairs in the sort buffer, the capacity rounded up to a power of two.
+	/// </summary>
+	GLuint getPaddedCount() const { return paddedCount; }
+
+private:
+	enum Stage { STAGE_BLOCK = 0, STAGE_GLOBAL_STEP = 1, STAGE_BLOCK_MERGE = 2 };
+
+	// uniform locations
+	static const GLuint KEYS_COUNT_INDEX = 0;
+	static const GLuint KEYS_DEPTH_ORIGIN = 1;
+	static const GLuint SORT_STAGE = 0;
+	static const GLuint SORT_K = 1;
+	static const GLuint SORT_J = 2;
+
+	Shader keyShader;
+	Shader sortShader;
+	GLuint sortBuffer = 0;
+	GLuint paddedCount;
+
+	void dispatch(Stage stage, GLuint k, GLuint j, GLuint groups)
+	{
+		sortShader.setInt(SORT_STAGE, stage);
+		sortShader.setInt(SORT_K, (int)k);
+		sortShader.setInt(SORT_J, (int)j);
+		glDispatchCompute(groups, 1, 1);
+		// every step reads the result of the one before
+		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+	}
+};
+
+#endif // !PARTICLE_SORT_H
@@ -1,15 +1,26 @@
-#version 330 core
+#version 430 core
 layout (location = 0) in vec3 aPos;
 layout (location = 2) in vec2 aTexCoords;
-layout (location = 3) in mat4 aInstanceMatrix;
 
 out vec2 TexCoords;
 
 uniform mat4 projection;
 uniform mat4 view;
+// if false all instances are drawn and the visible list is not used
+uniform bool culling;
+
+// model matrices of all asteroids
+layout (std430, binding = 0) readonly buffer InstanceBuffer {
+    mat4 instanceMatrices[];
+};
+// indices of the asteroids that passed the culling stage (cull.comp)
+layout (std430, binding = 1) readonly buffer VisibleBuffer {
+    uint visibleInstances[];
+};
 
 void main()
 {
+    uint instance = culling ? visibleInstances[gl_InstanceID] : uint(gl_InstanceID);
     TexCoords = aTexCoords;
-    gl_Position = projection * view * aInstanceMatrix * vec4(aPos, 1.0f); 
+    gl_Position = projection * view * instanceMatrices[instance] * vec4(aPos, 1.0f); 
 }
\ No newline at end of file
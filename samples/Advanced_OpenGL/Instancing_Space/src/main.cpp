@@ -1,5 +1,7 @@
 /* 
 	Instancing - Space
+	the asteroids are culled against the view frustum in a compute shader,
+	which writes the visible instances and the instance count of an indirect draw
 */
 
 #include <glad/glad.h>
@@ -18,8 +20,12 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
+#include "modules/frustum.h"
 
+#include <cstddef>
 #include <iostream>
+#include <vector>
 
 // callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -40,6 +46,13 @@ float lastX = SCR_WIDTH / 2.0;
 float lastY = SCR_HEIGHT / 2.0;
 bool firstMouse = true;
 
+// number of asteroids
+const unsigned int ASTEROID_COUNT = 1000000;
+// work group size of cull.comp
+const unsigned int CULL_GROUP_SIZE = 256;
+bool culling = true;		// C: toggle GPU culling
+bool c_pressed = false;
+
 // timing 
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f; // time of last frame
@@ -49,7 +62,8 @@ int main()
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	// compute shaders & shader storage buffers
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
@@ -83,6 +97,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -96,15 +111,17 @@ int main()
 	// ------------------------------------
 	Shader asteroidShader(FileSystem::getSamplePath("shader/asteroids.vert").c_str(), FileSystem::getSamplePath("shader/asteroids.frag").c_str());
 	Shader planetShader(FileSystem::getSamplePath("shader/planet.vert").c_str(), FileSystem::getSamplePath("shader/planet.frag").c_str());
+	Shader cullShader(FileSystem::getSamplePath("shader/cull.comp").c_str());
 	
 	// load models
 	// -----------
-	Model rock(FileSystem::getPath("content/models/rock/rock.obj").c_str());
+	// the asteroid shader only reads positions & texCoords, the instance matrices come from a storage buffer
+	Model rock(FileSystem::getPath("content/models/rock/rock.obj").c_str(), false, false, VERTEX_FORMAT_COMPACT);
 	Model planet(FileSystem::getPath("content/models/planet/planet.obj").c_str());
 
 	// generate a large list of semi-random model transformation matrices
 	// ------------------------------------------------------------------
-	unsigned int amount = 100000;
+	unsigned int amount = ASTEROID_COUNT;
 	glm::mat4* modelMatrices;
 	modelMatrices = new glm::mat4[amount];
 	srand(glfwGetTime()); // initialize random seed	
@@ -135,42 +152,62 @@ int main()
 		modelMatrices[i] = model;
 	}
 
-	// configure instanced array
-    // -------------------------
-	unsigned int buffer;
-	glGenBuffers(1, &buffer);
-	glBindBuffer(GL_ARRAY_BUFFER, buffer);
-	glBufferData(GL_ARRAY_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
-
-	// set transformation matrices as an instance vertex attribute (with divisor 1)
-	// note: we're cheating a little by taking the, now publicly declared, VAO of the model's mesh(es) and adding new vertexAttribPointers
-	// normally you'd want to do this in a more organized fashion, but for learning purposes this will do.
-	// -----------------------------------------------------------------------------------------------------------------------------------
+	// instance buffers
+	// ----------------
+	// model matrices of all asteroids
+	unsigned int instanceBuffer;
+	glGenBuffers(1, &instanceBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, amount * sizeof(glm::mat4), &modelMatrices[0], GL_STATIC_DRAW);
+	delete[] modelMatrices;
+
+	// indices of the visible asteroids, written by the culling stage
+	unsigned int visibleBuffer;
+	glGenBuffers(1, &visibleBuffer);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, amount * sizeof(GLuint), NULL, GL_DYNAMIC_COPY);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+
+	// one indirect command per mesh of the rock, the culling stage counts the instances of the first one
+	std::vector<DrawElementsIndirectCommand> commands(rock.meshes.size());
+	glm::vec3 rockMin = rock.meshes[0].boundsMin, rockMax = rock.meshes[0].boundsMax;
 	for (unsigned int i = 0; i < rock.meshes.size(); i++)
 	{
-		unsigned int VAO = rock.meshes[i].VAO;
-		glBindVertexArray(VAO);
-		// set attribute pointers for matrix (4 times vec4)
-		glEnableVertexAttribArray(3);
-		glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)0);
-		glEnableVertexAttribArray(4);
-		glVertexAttribPointer(4, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4)));
-		glEnableVertexAttribArray(5);
-		glVertexAttribPointer(5, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(2 * sizeof(glm::vec4)));
-		glEnableVertexAttribArray(6);
-		glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(3 * sizeof(glm::vec4)));
-
-		// by setting this attribute to 1 we're telling OpenGL that we want to update 
-		// the content of the vertex attribute when we start to render a new instance.
-		// By setting it to 2 we'd update the content every 2 instances and so on. 
-		// By setting the attribute divisor to 1 we're effectively telling OpenGL that the vertex attribute at attribute location 2 is an instanced array.
-		glVertexAttribDivisor(3, 1);
-		glVertexAttribDivisor(4, 1);
-		glVertexAttribDivisor(5, 1);
-		glVertexAttribDivisor(6, 1);
-
-		glBindVertexArray(0);
+		commands[i].count = (GLuint)rock.meshes[i].indices.size();
+		commands[i].instanceCount = 0;
+		commands[i].firstIndex = 0;
+		commands[i].baseVertex = 0;
+		commands[i].baseInstance = 0;
+		rockMin = glm::min(rockMin, rock.meshes[i].boundsMin);
+		rockMax = glm::max(rockMax, rock.meshes[i].boundsMax);
 	}
+	unsigned int commandBuffer;
+	glGenBuffers(1, &commandBuffer);
+	glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+	glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+
+	// bounding sphere of the whole rock
+	glm::vec3 rockCenter = (rockMin + rockMax) * 0.5f;
+	float rockRadius = 0.0f;
+	for (const Mesh& mesh : rock.meshes)
+		rockRadius = glm::max(rockRadius, glm::length((mesh.boundsMin + mesh.boundsMax) * 0.5f - rockCenter) + mesh.boundsRadius);
+
+	cullShader.use();
+	cullShader.setVec4("boundingSphere", glm::vec4(rockCenter, rockRadius));
+	glUniform1ui(cullShader.getLocation("instanceCount"), amount);
+	int frustumPlanesLocation = cullShader.getLocation("frustumPlanes");
+
+	// timer queries of the culling stage and the asteroid draw, read one frame later
+	unsigned int timerQueries[2][2];
+	glGenQueries(4, &timerQueries[0][0]);
+	unsigned int frameIndex = 0;
+	double cullTime = 0.0, drawTime = 0.0;
+	unsigned int timedFrames = 0;
+
 	int frameCount = 0;
 	double previousTime = glfwGetTime();
 	// render loop
@@ -188,8 +225,23 @@ int main()
 		// If a second has passed.
 		if (currentFrame - previousTime >= 1.0)
 		{
-			std::cout << "FPS:" << frameCount << std::endl;
+			std::cout << "FPS:" << frameCount;
+			if (timedFrames > 0)
+			{
+				// reading the counter waits for the last culling stage, once per second is fine
+				GLuint visible = amount;
+				if (culling)
+				{
+					glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+					glGetBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint), &visible);
+				}
+				std::cout << " | visible: " << visible << "/" << amount
+					<< " | cull: " << cullTime / timedFrames << "ms | draw: " << drawTime / timedFrames << "ms";
+			}
+			std::cout << std::endl;
 			frameCount = 0;
+			timedFrames = 0;
+			cullTime = drawTime = 0.0;
 			previousTime = currentFrame;
 		}
 
@@ -220,26 +272,78 @@ int main()
 		planetShader.setMat4("model", model);
 		planet.Draw(planetShader);
 
+		// cull meteorites
+		unsigned int* queries = timerQueries[frameIndex % 2];
+		glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+		glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+		if (culling)
+		{
+			// reset the counter, the compute shader increments it for every visible asteroid
+			GLuint zero = 0;
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint), &zero);
+
+			Frustum frustum(projection * view);
+			cullShader.use();
+			glUniform4fv(frustumPlanesLocation, Frustum::PLANE_COUNT, &frustum.planes[0][0]);
+			glDispatchCompute((amount + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE, 1, 1);
+			glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+			// the other meshes of the rock draw the same instances
+			for (unsigned int i = 1; i < commands.size(); i++)
+				glCopyBufferSubData(GL_DRAW_INDIRECT_BUFFER, GL_DRAW_INDIRECT_BUFFER,
+					offsetof(DrawElementsIndirectCommand, instanceCount),
+					i * sizeof(DrawElementsIndirectCommand) + offsetof(DrawElementsIndirectCommand, instanceCount), sizeof(GLuint));
+			if (commands.size() > 1)
+				glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+		}
+		else
+		{
+			for (unsigned int i = 0; i < commands.size(); i++)
+				commands[i].instanceCount = amount;
+			glBufferSubData(GL_DRAW_INDIRECT_BUFFER, 0, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data());
+		}
+		glEndQuery(GL_TIME_ELAPSED);
+
 		// draw meteorites
+		glBeginQuery(GL_TIME_ELAPSED, queries[1]);
 		asteroidShader.use();
 		asteroidShader.setInt("texture_diffuse1", 0);
+		asteroidShader.setBool("culling", culling);
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, rock.textures_loaded[0].id); // note: we also made the textures_loaded vector public (instead of private) from the model class.
 		for (unsigned int i = 0; i < rock.meshes.size(); i++)
 		{
 			glBindVertexArray(rock.meshes[i].VAO);
-			glDrawElementsInstanced(GL_TRIANGLES, rock.meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
-			glBindVertexArray(0);
+			glDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, (void*)(i * sizeof(DrawElementsIndirectCommand)));
 		}
+		glEndQuery(GL_TIME_ELAPSED);
+
+		// results of the previous frame
+		if (frameIndex > 0)
+		{
+			unsigned int* previous = timerQueries[(frameIndex + 1) % 2];
+			GLuint64 cullNanoseconds = 0, drawNanoseconds = 0;
+			glGetQueryObjectui64v(previous[0], GL_QUERY_RESULT, &cullNanoseconds);
+			glGetQueryObjectui64v(previous[1], GL_QUERY_RESULT, &drawNanoseconds);
+			cullTime += cullNanoseconds / 1000000.0;
+			drawTime += drawNanoseconds / 1000000.0;
+			timedFrames++;
+		}
+		frameIndex++;
 		
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
+	glDeleteQueries(4, &timerQueries[0][0]);
+	glDeleteBuffers(1, &instanceBuffer);
+	glDeleteBuffers(1, &visibleBuffer);
+	glDeleteBuffers(1, &commandBuffer);
 	
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -262,6 +366,15 @@ void processInput(GLFWwindow *window)
 		camera.ProcessKeyboard(LEFT, deltaTime);
 	if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS)
 		camera.ProcessKeyboard(RIGHT, deltaTime);
+
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS)
+		c_pressed = true;
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE && c_pressed)
+	{
+		culling = !culling;
+		std::cout << "GPU culling " << (culling ? "on" : "off") << std::endl;
+		c_pressed = false;
+	}
 }
 
 // glfw: whenever the mouse moves, this callback is called
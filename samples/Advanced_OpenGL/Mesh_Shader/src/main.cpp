@@ -18,6 +18,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 
@@ -118,6 +119,7 @@ public:
 
 		glLinkProgram(ID);
 		checkCompileErrors(ID, "PROGRAM");
+		reflectUniforms();
 		// delete the shaders as they're linked into our program now and no longer necessary
 		glDeleteShader(task);
 		glDeleteShader(mesh);
@@ -168,6 +170,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 	
@@ -226,6 +229,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -0,0 +1,26 @@
+#version 330 core
+layout (location = 0) in vec4 vertex; // <vec2 position, vec2 texCoords>
+// per instance: position of the particle, streamed by the CPU particle system
+layout (location = 1) in float offsetX;
+layout (location = 2) in float offsetY;
+layout (location = 3) in float offsetZ;
+
+out vec2 TexCoord;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform vec3 gCameraPos;
+uniform float gBillboardSize;
+
+void main()
+{
+	// same billboard as particleBillboard.geom: turned towards the camera around the y axis
+	vec3 Pos = vec3(offsetX, offsetY, offsetZ);
+	vec3 toCamera = normalize(gCameraPos - Pos);
+	vec3 right = cross(toCamera, vec3(0.0, 1.0, 0.0)) * gBillboardSize;
+
+	Pos += right * (vertex.x - 1.0);
+	Pos.y += gBillboardSize * vertex.y;
+	gl_Position = projection * view * vec4(Pos, 1.0);
+	TexCoord = vertex.zw;
+}
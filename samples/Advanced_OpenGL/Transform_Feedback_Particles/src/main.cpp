@@ -19,6 +19,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include "particles.h"
 #include "particlesTransformFeedback.h"
@@ -42,6 +43,8 @@ const unsigned int SCR_HEIGHT = 720;
 float heightScale = 1.0;
 bool Wpressed = false;
 bool wireframe = false;
+bool Cpressed = false;
+bool cpuParticles = false;	// C: CPU particle system instead of transform feedback
 
 // camera
 Camera camera(glm::vec3(0.05f, 0.20f, 0.8f));
@@ -95,6 +98,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -112,6 +116,9 @@ int main()
 	// handles the update of the particles
 	Shader particlesVis(FileSystem::getSamplePath("shader/particleBillboard.vert").c_str(), FileSystem::getSamplePath("shader/particleBillboard.frag").c_str(), FileSystem::getSamplePath("shader/particleBillboard.geom").c_str());
 	particlesVis.link();
+	// instanced quads of the CPU particle system
+	Shader particlesInstanced(FileSystem::getSamplePath("shader/particleInstanced.vert").c_str(), FileSystem::getSamplePath("shader/particleBillboard.frag").c_str());
+	particlesInstanced.link();
 	// load textures
 	// -------------
 	//GLuint particleTex = loadTexture(FileSystem::getPath("content/images/particle.png").c_str(), false);
@@ -122,8 +129,8 @@ int main()
 	
 	// create Particle System
 	// ----------------------
-	//ParticleSystem ps(500, glm::vec3(0));
 	ParticleSystemTF ps(500, glm::vec3(0,0,0));
+	ParticleSystem cpuPs(10000, glm::vec3(0));
 
 	// shader configuration
 	// --------------------
@@ -147,27 +154,42 @@ int main()
 
 		// Check and call events
 		processInput(window);
-		ps.update(deltaTime);
+		if (cpuParticles)
+			cpuPs.update(deltaTime);
+		else
+			ps.update(deltaTime);
 	
 		// render
 		// ------
 		glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		particlesVis.use();
+		Shader& particleShader = cpuParticles ? particlesInstanced : particlesVis;
+		particleShader.use();
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (GLfloat)SCR_WIDTH / (GLfloat)SCR_HEIGHT, 0.1f, 100.0f);
-		particlesVis.setMat4("projection", projection);
+		particleShader.setMat4("projection", projection);
 
-		particlesVis.setMat4("view", camera.GetViewMatrix());
-		particlesVis.setVec3("gCameraPos", camera.Position);
+		particleShader.setMat4("view", camera.GetViewMatrix());
+		particleShader.setVec3("gCameraPos", camera.Position);
 		
 		glActiveTexture(GL_TEXTURE0);
 		glBindTexture(GL_TEXTURE_2D, particleTex);
-		particlesVis.setInt("gColorMap", 0);
+		particleShader.setInt("gColorMap", 0);
 
-		ps.draw(&particlesVis);
+		if (cpuParticles)
+		{
+			particleShader.setFloat("gBillboardSize", 0.01f);
+			cpuPs.draw(&particleShader);
+		}
+		else
+		{
+			// the transform feedback buffers are read through the sample's vao
+			glBindVertexArray(vao);
+			ps.draw(&particleShader);
+		}
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -211,6 +233,16 @@ void processInput(GLFWwindow *window)
 		wireframe = !wireframe;
 	}
 
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+		Cpressed = true;
+	}
+
+	if (Cpressed && glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) {
+		Cpressed = false;
+		cpuParticles = !cpuParticles;
+		std::cout << (cpuParticles ? "CPU particle system (instanced)" : "transform feedback particle system") << std::endl;
+	}
+
 	if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
 		if (heightScale > 0.0f) {
 			heightScale -= 0.0005f;
@@ -0,0 +1,238 @@
+#ifndef PARTICLE_SIMULATION_H
+#define PARTICLE_SIMULATION_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "modules/job_pool.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define PARTICLES_SSE
+#endif
+
+/// <summary>
+/// CPU simulation of the particles of ParticleSystem, without any GL state.
+/// The particles are stored as structure of arrays (one array per component) with the alive
+/// particles packed at the front. The update runs in chunks of PARTICLES_PER_CHUNK particles
+/// on a job pool:
+///	- births are initialized in parallel, every chunk with its own generator seeded from the
+///	  seed of the simulation and the number of particles spawned before it
+///	- position, velocity and lifetime are integrated 4 particles at a time with SSE (the arrays are
+///	  padded to a multiple of 4) and the survivors of each chunk are counted
+///	- the survivors are copied to the second set of arrays at the offset of their chunk, so the
+///	  compaction keeps the order of the particles
+/// No step depends on the thread a chunk runs on, the result is the same for every thread count.
+/// </summary>
+class ParticleSimulation {
+public:
+	// particles per job: the 7 components of a chunk (56 KB) stay in the L2 cache of the core
+	static const unsigned int PARTICLES_PER_CHUNK = 2048;
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="ParticleSimulation"/> class.
+	/// </summary>
+	/// <param name="maxParticles">Capacity of the pool.</param>
+	/// <param name="pos">Center of the emitter.</param>
+	/// <param name="birthRate">Particles spawned per second.</param>
+	/// <param name="lifetime">Mean lifetime of a particle in seconds.</param>
+	/// <param name="seed">Seed of the spawn positions and lifetimes.</param>
+	ParticleSimulation(unsigned int maxParticles, glm::vec3 pos, float birthRate = 120.0f, float lifetime = 1.0f, uint64_t seed = 1)
+		: emitter(pos), maxParticles(maxParticles), birthRate(birthRate), lifetime(lifetime), seed(seed)
+	{
+		capacity = (maxParticles + 3) & ~3u;
+		particles[0].resize(capacity);
+		particles[1].resize(capacity);
+	}
+
+	/// <summary>
+	/// Number of alive particles, they are stored at [0, size()).
+	/// </summary>
+	unsigned int size() const { return aliveCount; }
+
+	/// <summary>
+	/// Length of the component arrays, maxParticles rounded up to a multiple of 4.
+	/// </summary>
+	unsigned int getCapacity() const { return capacity; }
+
+	const float* getX() const { return particles[current].px.data(); }
+	const float* getY() const { return particles[current].py.data(); }
+	const float* getZ() const { return particles[current].pz.data(); }
+	const float* getLife() const { return particles[current].life.data(); }
+
+	/// <summary>
+	/// Spawns up to count particles at once, limited by the capacity.
+	/// </summary>
+	void emit(unsigned int count, JobPool& pool = JobPool::instance())
+	{
+		const unsigned int first = aliveCount;
+		const unsigned int end = count > maxParticles - first ? maxParticles : first + count;
+		const uint64_t firstSerial = spawned;
+		Components& p = particles[current];
+		const size_t chunkCount = (end - first + PARTICLES_PER_CHUNK - 1) / PARTICLES_PER_CHUNK;
+		pool.parallelFor(chunkCount, 1, [this, &p, first, end, firstSerial](size_t firstChunk, size_t lastChunk) {
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				// the generator only depends on the particles spawned before the chunk, not on the thread
+				const unsigned int begin = first + (unsigned int)chunk * PARTICLES_PER_CHUNK;
+				const unsigned int last = std::min(end, begin + PARTICLES_PER_CHUNK);
+				std::minstd_rand generator(chunkSeed(firstSerial + (begin - first)));
+				for (unsigned int i = begin; i < last; i++)
+					RespawnParticle(p, i, generator);
+			}
+		});
+		spawned += end - first;
+		aliveCount = end;
+	}
+
+	/// <summary>
+	/// Spawns the particles due since the last update, moves all particles and removes the dead ones.
+	/// Blocks until the update is complete.
+	/// </summary>
+	void update(float dt, JobPool& pool = JobPool::instance())
+	{
+		// add new particles, the fraction of a particle is carried over to the next frame
+		births += birthRate * dt;
+		unsigned int count = (unsigned int)births;
+		births -= count;
+		emit(count, pool);
+
+		Components& source = particles[current];
+		Components& destination = particles[1 - current];
+		// chunks at fixed boundaries, independent of the ranges the pool hands to its threads
+		const size_t chunkCount = (aliveCount + PARTICLES_PER_CHUNK - 1) / PARTICLES_PER_CHUNK;
+		chunkOffsets.resize(chunkCount);
+
+		// integrate and count the survivors of every chunk
+		pool.parallelFor(chunkCount, 1, [this, &source, dt](size_t firstChunk, size_t lastChunk) {
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				const unsigned int begin = (unsigned int)chunk * PARTICLES_PER_CHUNK;
+				const unsigned int end = std::min(aliveCount, begin + PARTICLES_PER_CHUNK);
+				integrate(source, begin, end, dt);
+				unsigned int alive = 0;
+				for (unsigned int i = begin; i < end; i++)
+					alive += source.life[i] > 0.0f;
+				chunkOffsets[chunk] = alive;
+			}
+		});
+
+		// first survivor of every chunk in the compacted arrays
+		unsigned int survivors = 0;
+		for (unsigned int& offset : chunkOffsets)
+		{
+			unsigned int alive = offset;
+			offset = survivors;
+			survivors += alive;
+		}
+
+		pool.parallelFor(chunkCount, 1, [this, &source, &destination](size_t firstChunk, size_t lastChunk) {
+			for (size_t chunk = firstChunk; chunk < lastChunk; chunk++)
+			{
+				const unsigned int begin = (unsigned int)chunk * PARTICLES_PER_CHUNK;
+				const unsigned int end = std::min(aliveCount, begin + PARTICLES_PER_CHUNK);
+				unsigned int out = chunkOffsets[chunk];
+				for (unsigned int i = begin; i < end; i++)
+				{
+					if (source.life[i] <= 0.0f)
+						continue;
+					destination.px[out] = source.px[i];
+					destination.py[out] = source.py[i];
+					destination.pz[out] = source.pz[i];
+					destination.vx[out] = source.vx[i];
+					destination.vy[out] = source.vy[i];
+					destination.vz[out] = source.vz[i];
+					destination.life[out] = source.life[i];
+					out++;
+				}
+			}
+		});
+
+		current = 1 - current;
+		aliveCount = survivors;
+	}
+
+private:
+	struct Components {
+		std::vector<float> px, py, pz;	// position
+		std::vector<float> vx, vy, vz;	// velocity
+		std::vector<float> life;		// remaining lifetime in seconds
+
+		void resize(unsigned int count)
+		{
+			for (std::vector<float>* component : { &px, &py, &pz, &vx, &vy, &vz, &life })
+				component->assign(count, 0.0f);
+		}
+	};
+
+	glm::vec3 emitter;
+	unsigned int maxParticles;
+	unsigned int capacity;
+	unsigned int aliveCount = 0;
+	float birthRate;
+	float lifetime;
+	float births = 0.0f;		// particles due to be spawned
+	uint64_t seed;
+	uint64_t spawned = 0;		// particles spawned so far, selects the generator of a chunk of births
+	// the alive particles are in particles[current], the update compacts them into the other set
+	Components particles[2];
+	unsigned int current = 0;
+	std::vector<unsigned int> chunkOffsets;
+
+	// splitmix64 of the seed and the serial number of the first particle of a chunk
+	uint32_t chunkSeed(uint64_t serial) const
+	{
+		uint64_t z = seed + (serial + 1) * 0x9E3779B97F4A7C15ull;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return (uint32_t)(z ^ (z >> 31));
+	}
+
+	/// <summary>
+	/// Respawns the particle.
+	/// Resets Values
+	/// </summary>
+	void RespawnParticle(Components& p, unsigned int i, std::minstd_rand& generator) const
+	{
+		std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+		std::uniform_real_distribution<float> age(0.5f, 1.5f);
+		p.px[i] = emitter.x + offset(generator);
+		p.py[i] = emitter.y + offset(generator);
+		p.pz[i] = emitter.z + offset(generator);
+		p.vx[i] = 0.0f;
+		p.vy[i] = -0.1f;	// initial vertical velocity, the particles slowly sink
+		p.vz[i] = 0.0f;
+		// spread the lifetimes so the particles don't die in bursts
+		p.life[i] = lifetime * age(generator);
+	}
+
+	// moves the particles of [begin, end) and reduces their life, begin is a multiple of 4
+	static void integrate(Components& p, unsigned int begin, unsigned int end, float dt)
+	{
+		unsigned int i = begin;
+#ifdef PARTICLES_SSE
+		// the padding behind the last alive particle is integrated as well, it is overwritten on spawn
+		const unsigned int padded = (end + 3) & ~3u;
+		const __m128 step = _mm_set1_ps(dt);
+		for (; i < padded; i += 4)
+		{
+			_mm_storeu_ps(&p.px[i], _mm_add_ps(_mm_loadu_ps(&p.px[i]), _mm_mul_ps(_mm_loadu_ps(&p.vx[i]), step)));
+			_mm_storeu_ps(&p.py[i], _mm_add_ps(_mm_loadu_ps(&p.py[i]), _mm_mul_ps(_mm_loadu_ps(&p.vy[i]), step)));
+			_mm_storeu_ps(&p.pz[i], _mm_add_ps(_mm_loadu_ps(&p.pz[i]), _mm_mul_ps(_mm_loadu_ps(&p.vz[i]), step)));
+			_mm_storeu_ps(&p.life[i], _mm_sub_ps(_mm_loadu_ps(&p.life[i]), step));
+		}
+#endif
+		for (; i < end; i++)
+		{
+			p.px[i] += p.vx[i] * dt;
+			p.py[i] += p.vy[i] * dt;
+			p.pz[i] += p.vz[i] * dt;
+			p.life[i] -= dt;
+		}
+	}
+};
+
+#endif // !PARTICLE_SIMULATION_H
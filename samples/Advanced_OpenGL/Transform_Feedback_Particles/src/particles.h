@@ -1,71 +1,31 @@
 #ifndef PARTICLES_H
 #define PARTICLES_H
 
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
-#include <vector>
-#include "particle.h"
+#include <glm/glm.hpp>
+
+#include "modules/shader_m.h"
+#include "particle_simulation.h"
 
 /// <summary>
-/// 
+/// CPU particle system: the particles are simulated by a ParticleSimulation on the job pool and
+/// rendered with a single draw call. The positions are streamed into an instance buffer, one block
+/// per coordinate straight from the component arrays, and all particles are drawn as instanced quads.
 /// </summary>
 class ParticleSystem {
-private:
-	std::vector<Particle> particles;
-	GLuint birthRate = 2;
-	GLuint maxParticles = 10000;
-	GLuint particleVAO;
-	GLuint lastUsedParticle = 0;
-	
-	GLuint FirstUnusedParticle()
-	{
-		// Search from last used particle, this will usually return almost instantly
-		for (GLuint i = lastUsedParticle; i < particles.size(); ++i) {
-			if (particles[i].LifetimeMillis <= 0.0f) {
-				lastUsedParticle = i;
-				return i;
-			}
-		}
-
-		// Otherwise, do a linear search
-		for (GLuint i = 0; i < lastUsedParticle; ++i) {
-			if (particles[i].LifetimeMillis <= 0.0f) {
-				lastUsedParticle = i;
-				return i;
-			}
-		}
-
-		// create new Particle if 
-		if (particles.size() < maxParticles) {
-			particles.push_back(Particle());
-			return particles.size() - 1;
-		}
-
-
-		// return -1 if maximum amount of particles is reached 
-		return -1;
-	}
-	
+public:
 	/// <summary>
-	/// Respawns the particle.
-	/// Resets Values
+	/// Initializes a new instance of the <see cref="ParticleSystem"/> class.
 	/// </summary>
-	void RespawnParticle(Particle & particle)
+	/// <param name="maxParticles">Capacity of the pool.</param>
+	/// <param name="pos">Center of the emitter.</param>
+	/// <param name="birthRate">Particles spawned per second.</param>
+	/// <param name="lifetime">Mean lifetime of a particle in seconds.</param>
+	ParticleSystem(GLuint maxParticles, glm::vec3 pos, float birthRate = 120.0f, float lifetime = 1.0f)
+		: simulation(maxParticles, pos, birthRate, lifetime)
 	{
-		GLfloat random = ((rand()  % 100)-50) / 10.0f;
-		GLfloat rColor = 0.5 + (rand() % 100) / 100;
-		particle.P = glm::vec3(0) + random;
-		particle.LifetimeMillis = 1;
-		particle.v = glm::vec3(0,1,0) * 0.1f;	// initial vertical velocity
-	}
-
-public:
-	ParticleSystem(GLuint nr_particles, glm::vec3 pos)
-	{	// todo use pos
-		for(GLuint i = 0; i < nr_particles; ++i)
-			particles.push_back(Particle());
-
 		// Set up mesh and attribute properties
-		GLuint VBO;
 		GLfloat particle_quad[] = {
 			0.0f, 1.0f, 0.0f, 1.0f,
 			1.0f, 0.0f, 1.0f, 0.0f,
@@ -75,60 +35,96 @@ public:
 			1.0f, 1.0f, 1.0f, 1.0f,
 			1.0f, 0.0f, 1.0f, 0.0f
 		};
-		glGenVertexArrays(1, &this->particleVAO);
-		glGenBuffers(1, &VBO);
-		glBindVertexArray(this->particleVAO);
+		glGenVertexArrays(1, &particleVAO);
+		glGenBuffers(1, &quadVBO);
+		glGenBuffers(1, &instanceVBO);
+		glBindVertexArray(particleVAO);
 		// Fill mesh buffer
-		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
 		glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
 		// Set mesh attributes
 		glEnableVertexAttribArray(0);
 		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+		// instance buffer: x of all particles, then y, then z
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, instanceBufferSize(), NULL, GL_STREAM_DRAW);
+		for (GLuint i = 0; i < 3; i++)
+		{
+			glEnableVertexAttribArray(1 + i);
+			glVertexAttribPointer(1 + i, 1, GL_FLOAT, GL_FALSE, sizeof(GLfloat), (GLvoid*)(size_t)(i * simulation.getCapacity() * sizeof(GLfloat)));
+			glVertexAttribDivisor(1 + i, 1);
+		}
 		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 
-	void update(float dt)
+	~ParticleSystem()
 	{
-		// add new particles
-		for (GLuint i = 0; i < birthRate; i++)
-		{
-			int unusedParticle = FirstUnusedParticle();
-			if(unusedParticle >= 0)
-				RespawnParticle(particles[unusedParticle]);
-		}
+		glDeleteVertexArrays(1, &particleVAO);
+		glDeleteBuffers(1, &quadVBO);
+		glDeleteBuffers(1, &instanceVBO);
+	}
 
-		// Update all particles 
-		for (GLuint i = 0; i < particles.size(); ++i)
-		{
-			Particle& p = particles[i];
-			p.LifetimeMillis -= dt; // reduce life
-			if (p.LifetimeMillis > 0.0f)
-			{
-
-				// particle is alive, thus update
-				p.P -= p.v * dt;
-				// p.Cd.a -= dt * 2.5;	// decrease alpha, slowly disapear over time
-			}
-		}
+	ParticleSystem(const ParticleSystem&) = delete;
+	ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+	/// <summary>
+	/// Number of alive particles.
+	/// </summary>
+	GLuint size() const { return simulation.size(); }
+
+	ParticleSimulation& getSimulation() { return simulation; }
+
+	/// <summary>
+	/// Spawns up to count particles at once, limited by the capacity.
+	/// </summary>
+	void emit(GLuint count)
+	{
+		simulation.emit(count);
+	}
 
+	void update(float dt)
+	{
+		simulation.update(dt);
 	}
 
-	void draw(Shader* shader) {
+	void draw(Shader* shader)
+	{
+		const GLuint aliveCount = simulation.size();
+		if (aliveCount == 0)
+			return;
+
+		// stream the positions, orphaning the buffer so the driver doesn't wait for the draw of the last frame
+		glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+		glBufferData(GL_ARRAY_BUFFER, instanceBufferSize(), NULL, GL_STREAM_DRAW);
+		const GLsizeiptr bytes = aliveCount * sizeof(GLfloat);
+		const GLsizeiptr block = simulation.getCapacity() * sizeof(GLfloat);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, simulation.getX());
+		glBufferSubData(GL_ARRAY_BUFFER, block, bytes, simulation.getY());
+		glBufferSubData(GL_ARRAY_BUFFER, 2 * block, bytes, simulation.getZ());
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE); // use GL_ONE blending mode to create glow effect
+		// the quads are seen from both sides
+		GLboolean culling = glIsEnabled(GL_CULL_FACE);
+		glDisable(GL_CULL_FACE);
 		shader->use();
-		
-		for (Particle particle : particles) {
-			if (particle.LifetimeMillis > 0.0f)
-			{
-				shader->setVec3("offset", particle.P);
-				//shader->setVec4("color", particle.Cd);
-				glBindVertexArray(particleVAO);
-				glDrawArrays(GL_TRIANGLES, 0, 6);
-				glBindVertexArray(0);
-			}
-		}
+		glBindVertexArray(particleVAO);
+		glDrawArraysInstanced(GL_TRIANGLES, 0, 6, aliveCount);
+		glBindVertexArray(0);
+		if (culling)
+			glEnable(GL_CULL_FACE);
 		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	}
+
+private:
+	ParticleSimulation simulation;
+
+	GLuint particleVAO = 0;
+	GLuint quadVBO = 0;
+	GLuint instanceVBO = 0;
+
+	GLsizeiptr instanceBufferSize() const { return 3 * simulation.getCapacity() * sizeof(GLfloat); }
 };
 
-#endif // !PARTICLES_H
\ No newline at end of file
+#endif // !PARTICLES_H
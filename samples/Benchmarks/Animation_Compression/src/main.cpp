@@ -0,0 +1,171 @@
+/*
+ * Animation Compression Benchmark
+ * encodes the bundled vampire dance clip at several error tolerances and reports the compression ratio,
+ * the kind of the stored tracks and the largest error, then compares loading the clip through assimp
+ * to decoding the mapped clip file
+ */
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "../../../Model/Skeletal_Animation/src/animation_clip.h"
+#include "modules/filesystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+const char* CLIP = "content/models/vampire/dancing_vampire.dae";
+// number of measured loads per mode
+const int ITERATIONS = 20;
+
+struct Preset {
+	const char* name;
+	float scale;	// of the default tolerances
+};
+
+const Preset PRESETS[] = {
+	{ "none", 0.0f },
+	{ "fine", 0.1f },
+	{ "default", 1.0f },
+	{ "coarse", 10.0f },
+};
+
+AnimationClip::Settings scaledSettings(float scale)
+{
+	AnimationClip::Settings settings;
+	settings.positionTolerance *= scale;
+	settings.rotationTolerance *= scale;
+	settings.scaleTolerance *= scale;
+	return settings;
+}
+
+int main()
+{
+	std::string path = FileSystem::getPath(CLIP);
+	if (!std::ifstream(path).good())
+	{
+		std::cout << CLIP << " not found" << std::endl;
+		return -1;
+	}
+	uint64_t sourceHash = 0;
+	ModelCache::sourceKey(path, sourceHash);
+
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+	if (!scene || !scene->mRootNode || scene->mNumAnimations == 0)
+	{
+		std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+		return -1;
+	}
+	const aiAnimation* animation = scene->mAnimations[0];
+
+	// compression
+	// -----------
+	std::cout << CLIP << ": " << animation->mNumChannels << " channels, "
+		<< animation->mDuration << " ticks" << std::endl;
+	std::cout << std::left << std::setw(10) << "Preset"
+		<< std::right << std::setw(14) << "Source [KB]"
+		<< std::setw(12) << "Clip [KB]"
+		<< std::setw(8) << "Ratio"
+		<< std::setw(16) << "const/uni/sparse"
+		<< std::setw(14) << "Stored keys"
+		<< std::setw(12) << "Pos err"
+		<< std::setw(14) << "Rot err [deg]"
+		<< std::setw(12) << "Scale err" << std::endl;
+
+	std::vector<unsigned char> bytes;
+	AnimationClip::Stats stats;
+	for (const Preset& preset : PRESETS)
+	{
+		AnimationClip::Settings settings = scaledSettings(preset.scale);
+		AnimationClip::Stats presetStats;
+		std::vector<unsigned char> presetBytes = AnimationClip::encode(animation, scene->mRootNode, sourceHash, settings, &presetStats);
+
+		std::string tracks = std::to_string(presetStats.constantTracks) + "/" + std::to_string(presetStats.uniformTracks) + "/" + std::to_string(presetStats.sparseTracks);
+		std::cout << std::left << std::setw(10) << preset.name
+			<< std::right << std::fixed << std::setprecision(1)
+			<< std::setw(14) << presetStats.sourceBytes / 1024.0
+			<< std::setw(12) << presetStats.compressedBytes / 1024.0
+			<< std::setw(7) << (double)presetStats.sourceBytes / presetStats.compressedBytes << "x"
+			<< std::setw(16) << tracks
+			<< std::setw(14) << presetStats.storedKeys
+			<< std::setprecision(5)
+			<< std::setw(12) << presetStats.maxPositionError
+			<< std::setw(14) << glm::degrees(presetStats.maxRotationError)
+			<< std::setw(12) << presetStats.maxScaleError << std::endl;
+
+		// the default preset is the one the sample writes
+		if (preset.scale == 1.0f)
+		{
+			bytes = presetBytes;
+			stats = presetStats;
+		}
+	}
+
+	// loading
+	// -------
+	std::string clipPath = AnimationClip::clipPath(path);
+	if (!AnimationClip::write(clipPath, bytes))
+	{
+		std::cout << "ERROR: failed to write " << clipPath << std::endl;
+		return -1;
+	}
+
+	double assimpTime = 0.0, mappedTime = 0.0;
+	bool valid = true;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		// assimp: import the file and read the channels, as Animation(path, model) does
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			Assimp::Importer sourceImporter;
+			const aiScene* source = sourceImporter.ReadFile(path, aiProcess_Triangulate);
+			std::map<std::string, BoneInfo> boneInfoMap;
+			int boneCount = 0;
+			Animation loaded(source->mAnimations[0], source->mRootNode, boneInfoMap, boneCount);
+			auto end = std::chrono::high_resolution_clock::now();
+			assimpTime += std::chrono::duration<double, std::milli>(end - start).count();
+		}
+		// clip: map, validate and decode
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			MappedFile clip;
+			if (!clip.open(clipPath) || !AnimationClip::validate(clip.data(), clip.size(), sourceHash))
+			{
+				std::cout << "ERROR: " << clipPath << " is not a valid clip" << std::endl;
+				return -1;
+			}
+			std::map<std::string, BoneInfo> boneInfoMap;
+			int boneCount = 0;
+			Animation decoded = AnimationClip::decode(clip.data(), boneInfoMap, boneCount);
+			auto end = std::chrono::high_resolution_clock::now();
+			mappedTime += std::chrono::duration<double, std::milli>(end - start).count();
+			valid &= decoded.GetBones().size() == animation->mNumChannels;
+		}
+	}
+	assimpTime /= ITERATIONS;
+	mappedTime /= ITERATIONS;
+
+	std::cout << std::endl << std::left << std::setw(10) << "Load"
+		<< std::right << std::setw(12) << "ms"
+		<< std::setw(12) << "MB/s"
+		<< std::setw(12) << "keys/ms" << std::endl;
+	std::cout << std::left << std::setw(10) << "assimp"
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << assimpTime
+		<< std::setw(12) << std::setprecision(1) << stats.sourceBytes / 1048576.0 / (assimpTime / 1000.0)
+		<< std::setw(12) << std::setprecision(0) << stats.sourceKeys / assimpTime << std::endl;
+	std::cout << std::left << std::setw(10) << "clip"
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << mappedTime
+		<< std::setw(12) << std::setprecision(1) << stats.compressedBytes / 1048576.0 / (mappedTime / 1000.0)
+		<< std::setw(12) << std::setprecision(0) << stats.storedKeys / mappedTime
+		<< std::setprecision(2) << "   (" << assimpTime / mappedTime << "x)"
+		<< (valid ? "" : "  (channels missing)") << std::endl;
+
+	return 0;
+}
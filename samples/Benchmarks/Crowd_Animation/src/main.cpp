@@ -0,0 +1,230 @@
+/*
+ * Crowd Animation Benchmark
+ * updates thousands of animators playing synthetic clips at different times and speeds
+ * on a job pool with an increasing number of threads and reports characters per millisecond,
+ * then compares the CPU cost per frame of live animators to clips baked into a bone texture
+ */
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include "../../../Model/Skeletal_Animation/src/crowd.h"
+#include "../../../Model/Skeletal_Animation/src/baked_animation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <vector>
+
+const int BONE_COUNT = 60;
+const unsigned int CHARACTER_COUNT = 4096;
+// clips of different length, one key per tick at 30 ticks per second
+const int CLIP_KEYS[] = { 30, 60, 120, 240 };
+const int CLIP_COUNT = sizeof(CLIP_KEYS) / sizeof(CLIP_KEYS[0]);
+// crowd sizes of the live / baked comparison
+const unsigned int COMPARISON_COUNTS[] = { 1000, 10000 };
+// measured frames per thread count
+const int FRAMES = 60;
+const float FRAME_TIME = 1.0f / 60.0f;
+
+std::string boneName(int bone)
+{
+	return "bone" + std::to_string(bone);
+}
+
+// skeleton with every bone attached to one of the few bones before it, like limbs along a spine
+aiNode* createSkeleton(std::mt19937& generator)
+{
+	std::vector<aiNode*> nodes;
+	std::vector<int> parents;
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		nodes.push_back(new aiNode(boneName(bone)));
+		parents.push_back(bone == 0 ? -1 : std::uniform_int_distribution<int>(std::max(0, bone - 4), bone - 1)(generator));
+	}
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		std::vector<aiNode*> children;
+		for (int child = bone + 1; child < BONE_COUNT; child++)
+			if (parents[child] == bone)
+				children.push_back(nodes[child]);
+		if (children.empty())
+			continue;
+		nodes[bone]->mNumChildren = (unsigned int)children.size();
+		nodes[bone]->mChildren = new aiNode*[children.size()];
+		for (size_t i = 0; i < children.size(); i++)
+		{
+			nodes[bone]->mChildren[i] = children[i];
+			children[i]->mParent = nodes[bone];
+		}
+	}
+	return nodes[0];
+}
+
+aiAnimation* createClip(int keyCount, std::mt19937& generator)
+{
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+	aiAnimation* clip = new aiAnimation();
+	clip->mDuration = keyCount - 1;
+	clip->mTicksPerSecond = 30.0;
+	clip->mNumChannels = BONE_COUNT;
+	clip->mChannels = new aiNodeAnim*[BONE_COUNT];
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		aiNodeAnim* channel = new aiNodeAnim();
+		channel->mNodeName = aiString(boneName(bone));
+		channel->mNumPositionKeys = channel->mNumRotationKeys = channel->mNumScalingKeys = keyCount;
+		channel->mPositionKeys = new aiVectorKey[keyCount];
+		channel->mRotationKeys = new aiQuatKey[keyCount];
+		channel->mScalingKeys = new aiVectorKey[keyCount];
+		for (int key = 0; key < keyCount; key++)
+		{
+			channel->mPositionKeys[key] = aiVectorKey(key, aiVector3D(value(generator), value(generator), value(generator)));
+			aiQuaternion rotation(value(generator), value(generator), value(generator), value(generator));
+			rotation.Normalize();
+			channel->mRotationKeys[key] = aiQuatKey(key, rotation);
+			channel->mScalingKeys[key] = aiVectorKey(key, aiVector3D(1.0f));
+		}
+		clip->mChannels[bone] = channel;
+	}
+	return clip;
+}
+
+int main()
+{
+	std::mt19937 generator(42);
+	std::unique_ptr<aiNode> root(createSkeleton(generator));
+
+	std::map<std::string, BoneInfo> boneInfoMap;
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		boneInfoMap[boneName(bone)].id = bone;
+		boneInfoMap[boneName(bone)].offset = glm::mat4(1.0f);
+	}
+	int boneCount = BONE_COUNT;
+
+	std::vector<std::unique_ptr<Animation>> animations;
+	std::vector<Animation*> clips;
+	for (int keys : CLIP_KEYS)
+	{
+		std::unique_ptr<aiAnimation> clip(createClip(keys, generator));
+		animations.emplace_back(new Animation(clip.get(), root.get(), boneInfoMap, boneCount));
+		clips.push_back(animations.back().get());
+	}
+
+	std::vector<unsigned int> threadCounts;
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	std::cout << CHARACTER_COUNT << " characters, " << BONE_COUNT << " bones, " << CLIP_COUNT << " clips, " << FRAMES << " frames" << std::endl;
+	std::cout << std::left << std::setw(12) << "Threads"
+		<< std::right << std::setw(14) << "ms/frame"
+		<< std::setw(18) << "characters/ms"
+		<< std::setw(12) << "speedup" << std::endl;
+
+	std::vector<glm::mat4> reference;
+	double singleThreaded = 0.0;
+	for (unsigned int threads : threadCounts)
+	{
+		JobPool pool(threads);
+		// same seed, every thread count animates the same crowd
+		Crowd crowd(clips, CHARACTER_COUNT, boneCount);
+		crowd.Update(FRAME_TIME, pool);	// warm up the threads
+
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+			crowd.Update(FRAME_TIME, pool);
+		auto end = std::chrono::high_resolution_clock::now();
+		double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+		if (threads == 1)
+			singleThreaded = milliseconds;
+
+		std::cout << std::left << std::setw(12) << threads
+			<< std::right << std::fixed << std::setprecision(3)
+			<< std::setw(14) << milliseconds
+			<< std::setw(18) << std::setprecision(0) << CHARACTER_COUNT / milliseconds
+			<< std::setw(11) << std::setprecision(2) << singleThreaded / milliseconds << "x" << std::endl;
+
+		// characters are independent, the palettes have to match bit for bit
+		const std::vector<glm::mat4>& palettes = crowd.GetBonePalettes();
+		if (reference.empty())
+			reference = palettes;
+		else if (memcmp(reference.data(), palettes.data(), palettes.size() * sizeof(glm::mat4)) != 0)
+			std::cout << "ERROR: palettes differ from the single threaded update" << std::endl;
+	}
+
+	// baked clips: sampled once, afterwards the vertex shader only needs the time
+	auto bakeStart = std::chrono::high_resolution_clock::now();
+	BakedAnimation baked(boneCount);
+	for (Animation* clip : clips)
+		baked.AddClip(clip);
+	auto bakeEnd = std::chrono::high_resolution_clock::now();
+	std::cout << std::endl << "baked " << CLIP_COUNT << " clips in " << std::setprecision(1)
+		<< std::chrono::duration<double, std::milli>(bakeEnd - bakeStart).count() << " ms, texture "
+		<< baked.GetWidth() << "x" << baked.GetRowCount() << " RGBA32F ("
+		<< baked.GetTexels().size() * sizeof(glm::vec4) / 1024 << " KB)" << std::endl;
+
+	std::cout << std::left << std::setw(12) << "Characters"
+		<< std::right << std::setw(20) << "live ms/frame"
+		<< std::setw(20) << "live upload KB"
+		<< std::setw(20) << "baked ms/frame"
+		<< std::setw(20) << "baked upload KB" << std::endl;
+	JobPool pool(cores);
+	for (unsigned int count : COMPARISON_COUNTS)
+	{
+		// live: animate on all threads and copy the palettes to the upload buffer, as the sample does per frame
+		Crowd crowd(clips, count, boneCount);
+		std::vector<glm::mat4> upload(crowd.GetBonePalettes().size());
+		auto start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			crowd.Update(FRAME_TIME, pool);
+			memcpy(upload.data(), crowd.GetBonePalettes().data(), upload.size() * sizeof(glm::mat4));
+		}
+		auto end = std::chrono::high_resolution_clock::now();
+		double live = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+
+		// baked: the CPU only writes the per instance clip data of the sample (first row, frame count,
+		// frames per second with speed, start frame), here every frame as if the characters switched clips,
+		// plus the time uniform
+		std::mt19937 instanceGenerator(1);
+		std::uniform_int_distribution<unsigned int> clipIndex(0, baked.GetClipCount() - 1);
+		std::uniform_real_distribution<float> speed(0.75f, 1.25f);
+		std::uniform_real_distribution<float> startFrame(0.0f, 1.0f);
+		std::vector<unsigned int> instanceClips(count);
+		std::vector<float> instanceSpeeds(count), instanceStarts(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			instanceClips[i] = clipIndex(instanceGenerator);
+			instanceSpeeds[i] = speed(instanceGenerator);
+			instanceStarts[i] = startFrame(instanceGenerator);
+		}
+		std::vector<glm::vec4> instanceUpload(count);
+		start = std::chrono::high_resolution_clock::now();
+		for (int frame = 0; frame < FRAMES; frame++)
+		{
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const BakedAnimation::Clip& clip = baked.GetClip(instanceClips[i]);
+				instanceUpload[i] = glm::vec4((float)clip.firstRow, (float)clip.frameCount, clip.framesPerSecond * instanceSpeeds[i], instanceStarts[i] * clip.frameCount);
+			}
+		}
+		end = std::chrono::high_resolution_clock::now();
+		double bakedTime = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+
+		std::cout << std::left << std::setw(12) << count
+			<< std::right << std::fixed << std::setprecision(3)
+			<< std::setw(20) << live
+			<< std::setw(20) << std::setprecision(0) << upload.size() * sizeof(glm::mat4) / 1024.0
+			<< std::setw(20) << std::setprecision(3) << bakedTime
+			<< std::setw(20) << std::setprecision(1) << (instanceUpload.size() * sizeof(glm::vec4) + sizeof(float)) / 1024.0 << std::endl;
+	}
+	return 0;
+}
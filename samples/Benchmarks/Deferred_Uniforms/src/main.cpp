@@ -0,0 +1,466 @@
+/*
+ * Deferred Uniforms Benchmark
+ * counts heap allocations and GL calls per frame for the uniform traffic of the
+ * Deferred_Shading sample (geometry pass + both lighting pass variants, 32 lights)
+ * with per-frame string lookups compared to precomputed uniform handles,
+ * both variants upload the lights through the light buffer
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "stb_image.h"
+
+#include "modules/shader_m.h"
+#include "modules/model.h"
+#include "modules/filesystem.h"
+#include "modules/light_buffer.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+// allocation counting
+// -------------------
+std::atomic<unsigned long long> allocations(0);
+
+void* operator new(std::size_t size)
+{
+	allocations++;
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+void operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
+
+// GL call counting: the glad function pointers are replaced by wrappers
+// -------------------------------------------------------------------------
+unsigned long long glCalls = 0;
+unsigned long long glLocationQueries = 0;
+
+#define COUNTED_GL(type, function, ret, params, args)			\
+	static type real_##function = nullptr;						\
+	static ret APIENTRY counted_##function params				\
+	{ glCalls++; return real_##function args; }
+
+#define INSTALL_GL(function)									\
+	real_##function = function;									\
+	function = counted_##function;
+
+COUNTED_GL(PFNGLUSEPROGRAMPROC, glad_glUseProgram, void, (GLuint p), (p))
+COUNTED_GL(PFNGLUNIFORM1IPROC, glad_glUniform1i, void, (GLint l, GLint v), (l, v))
+COUNTED_GL(PFNGLUNIFORM1FPROC, glad_glUniform1f, void, (GLint l, GLfloat v), (l, v))
+COUNTED_GL(PFNGLUNIFORM2FVPROC, glad_glUniform2fv, void, (GLint l, GLsizei c, const GLfloat* v), (l, c, v))
+COUNTED_GL(PFNGLUNIFORM3FVPROC, glad_glUniform3fv, void, (GLint l, GLsizei c, const GLfloat* v), (l, c, v))
+COUNTED_GL(PFNGLUNIFORMMATRIX4FVPROC, glad_glUniformMatrix4fv, void, (GLint l, GLsizei c, GLboolean t, const GLfloat* v), (l, c, t, v))
+COUNTED_GL(PFNGLACTIVETEXTUREPROC, glad_glActiveTexture, void, (GLenum t), (t))
+COUNTED_GL(PFNGLBINDTEXTUREPROC, glad_glBindTexture, void, (GLenum t, GLuint n), (t, n))
+COUNTED_GL(PFNGLBINDVERTEXARRAYPROC, glad_glBindVertexArray, void, (GLuint a), (a))
+COUNTED_GL(PFNGLDRAWELEMENTSPROC, glad_glDrawElements, void, (GLenum m, GLsizei c, GLenum t, const void* i), (m, c, t, i))
+COUNTED_GL(PFNGLBINDBUFFERPROC, glad_glBindBuffer, void, (GLenum t, GLuint b), (t, b))
+COUNTED_GL(PFNGLBINDBUFFERRANGEPROC, glad_glBindBufferRange, void, (GLenum t, GLuint i, GLuint b, GLintptr o, GLsizeiptr s), (t, i, b, o, s))
+COUNTED_GL(PFNGLBUFFERSUBDATAPROC, glad_glBufferSubData, void, (GLenum t, GLintptr o, GLsizeiptr s, const void* d), (t, o, s, d))
+
+static PFNGLGETUNIFORMLOCATIONPROC real_glad_glGetUniformLocation = nullptr;
+static GLint APIENTRY counted_glad_glGetUniformLocation(GLuint p, const GLchar* name)
+{
+	glCalls++;
+	glLocationQueries++;
+	return real_glad_glGetUniformLocation(p, name);
+}
+
+void installCounters()
+{
+	INSTALL_GL(glad_glUseProgram)
+	INSTALL_GL(glad_glUniform1i)
+	INSTALL_GL(glad_glUniform1f)
+	INSTALL_GL(glad_glUniform2fv)
+	INSTALL_GL(glad_glUniform3fv)
+	INSTALL_GL(glad_glUniformMatrix4fv)
+	INSTALL_GL(glad_glActiveTexture)
+	INSTALL_GL(glad_glBindTexture)
+	INSTALL_GL(glad_glBindVertexArray)
+	INSTALL_GL(glad_glDrawElements)
+	INSTALL_GL(glad_glBindBuffer)
+	INSTALL_GL(glad_glBindBufferRange)
+	INSTALL_GL(glad_glBufferSubData)
+	INSTALL_GL(glad_glGetUniformLocation)
+}
+
+// scene of the Deferred_Shading sample
+// ------------------------------------
+const unsigned int SCR_WIDTH = 800;
+const unsigned int SCR_HEIGHT = 600;
+const unsigned int NR_LIGHTS = 32;
+const int FRAMES = 1000;
+
+const float CONSTANT = 1.0f;
+const float LINEAR = 0.7f;
+const float QUADRATIC = 1.8f;
+
+struct Scene {
+	Shader gBufferShader, lightingPassShader, pointLightShader, stencilTestShader, dirLightShader;
+	Model* object = nullptr;
+	LightBuffer* lightBuffer = nullptr;
+	std::vector<glm::vec3> objectPositions;
+	std::vector<glm::vec3> lightPositions, lightColors;
+	std::vector<float> lightRadii;
+	glm::mat4 projection, view;
+	glm::vec3 viewPos;
+};
+
+std::string shaderPath(const char* file)
+{
+	return FileSystem::getPath(std::string("samples/Lighting/Deferred_Shading/shader/") + file);
+}
+
+// the former Shader::setX(const std::string&) lookup: a string per call (temporary for literals) and a driver query
+int location(const Shader& shader, const std::string& name)
+{
+	return glGetUniformLocation(shader.ID, name.c_str());
+}
+
+// Mesh::Draw as it was before the sampler locations were cached
+void drawModelWithStrings(Model& model, Shader& shader)
+{
+	for (Mesh& mesh : model.meshes)
+	{
+		unsigned int diffuseNr = 1, specularNr = 1, normalNr = 1, heightNr = 1;
+		for (unsigned int i = 0; i < mesh.textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			std::string number;
+			std::string name = mesh.textures[i].type;
+			if (name == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (name == "texture_specular")
+				number = std::to_string(specularNr++);
+			else if (name == "texture_normal")
+				number = std::to_string(normalNr++);
+			else if (name == "texture_height")
+				number = std::to_string(heightNr++);
+			glUniform1i(location(shader, "material." + name + number), i);
+			glUniform1f(location(shader, "material.shininess"), 16.0f);
+			glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+		}
+		glBindVertexArray(mesh.VAO);
+		glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+}
+
+/// <summary>
+/// One frame of uniform traffic the way the sample did it before: names are built
+/// per frame and every location is queried from the driver.
+/// </summary>
+void frameWithStrings(Scene& scene)
+{
+	// the light passes reconstruct the position from the depth buffer
+	glm::mat4 inverseViewProjection = glm::inverse(scene.projection * scene.view);
+
+	Shader& g = scene.gBufferShader;
+	g.use();
+	glUniformMatrix4fv(location(g, "projection"), 1, GL_FALSE, &scene.projection[0][0]);
+	glUniformMatrix4fv(location(g, "view"), 1, GL_FALSE, &scene.view[0][0]);
+	for (const glm::vec3& position : scene.objectPositions)
+	{
+		glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.25f));
+		glUniformMatrix4fv(location(g, "model"), 1, GL_FALSE, &model[0][0]);
+		if (scene.object)
+			drawModelWithStrings(*scene.object, g);
+	}
+
+	// learnopengl lighting pass, the lights are uploaded through the light buffer like in the handle variant,
+	// so both variants only differ in the uniform lookups
+	Shader& l = scene.lightingPassShader;
+	l.use();
+	scene.lightBuffer->update();
+	glUniform3fv(location(l, "viewPos"), 1, &scene.viewPos[0]);
+	glUniformMatrix4fv(location(l, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+
+	// ogldev lighting pass
+	Shader& p = scene.pointLightShader;
+	Shader& s = scene.stencilTestShader;
+	glm::vec2 screenSize(SCR_WIDTH, SCR_HEIGHT);
+	p.use();
+	glUniformMatrix4fv(location(p, "projection"), 1, GL_FALSE, &scene.projection[0][0]);
+	glUniformMatrix4fv(location(p, "view"), 1, GL_FALSE, &scene.view[0][0]);
+	glUniform3fv(location(p, "viewPos"), 1, &scene.viewPos[0]);
+	glUniformMatrix4fv(location(p, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+	glUniform1i(location(p, "gDepth"), 0);
+	glUniform1i(location(p, "gNormal"), 1);
+	glUniform1i(location(p, "gAlbedoSpec"), 2);
+	glUniform2fv(location(p, "gScreenSize"), 1, &screenSize[0]);
+	s.use();
+	glUniformMatrix4fv(location(s, "projection"), 1, GL_FALSE, &scene.projection[0][0]);
+	glUniformMatrix4fv(location(s, "view"), 1, GL_FALSE, &scene.view[0][0]);
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), scene.lightPositions[i]), glm::vec3(scene.lightRadii[i]));
+		s.use();
+		glUniformMatrix4fv(location(s, "model"), 1, GL_FALSE, &model[0][0]);
+		p.use();
+		glUniformMatrix4fv(location(p, "model"), 1, GL_FALSE, &model[0][0]);
+		glUniform3fv(location(p, "gPointLight.Base.Color"), 1, &scene.lightColors[i][0]);
+		glUniform1f(location(p, "gPointLight.Base.AmbientIntensity"), 0.1f);
+		glUniform1f(location(p, "gPointLight.Base.DiffuseIntensity"), 0.1f);
+		glUniform3fv(location(p, "gPointLight.Position"), 1, &scene.lightPositions[i][0]);
+		glUniform1f(location(p, "gPointLight.Atten.Constant"), CONSTANT);
+		glUniform1f(location(p, "gPointLight.Atten.Linear"), LINEAR);
+		glUniform1f(location(p, "gPointLight.Atten.Exp"), QUADRATIC);
+	}
+	Shader& d = scene.dirLightShader;
+	glm::vec3 white(1.0f), direction(0.0f, 0.0f, -1.0f);
+	d.use();
+	glUniform3fv(location(d, "viewPos"), 1, &scene.viewPos[0]);
+	glUniformMatrix4fv(location(d, "inverseViewProjection"), 1, GL_FALSE, &inverseViewProjection[0][0]);
+	glUniform1i(location(d, "gDepth"), 0);
+	glUniform1i(location(d, "gNormal"), 1);
+	glUniform1i(location(d, "gAlbedoSpec"), 2);
+	glUniform2fv(location(d, "gScreenSize"), 1, &screenSize[0]);
+	glUniform3fv(location(d, "gDirectionalLight.Base.Color"), 1, &white[0]);
+	glUniform1f(location(d, "gDirectionalLight.Base.AmbientIntensity"), 0.1f);
+	glUniform1f(location(d, "gDirectionalLight.Base.DiffuseIntensity"), 0.1f);
+	glUniform3fv(location(d, "gDirectionalLight.Direction"), 1, &direction[0]);
+}
+
+// handles as resolved by the sample before its render loop
+struct Handles {
+	Uniform<glm::mat4> gBufferProjection, gBufferView, gBufferModel;
+	Uniform<glm::vec3> lightingPassViewPos;
+	Uniform<glm::mat4> lightingPassInverseViewProjection;
+	Uniform<glm::mat4> pointLightProjection, pointLightView, pointLightModel, pointLightInverseViewProjection;
+	Uniform<glm::vec3> pointLightViewPos, pointLightColor, pointLightPosition;
+	Uniform<glm::mat4> stencilProjection, stencilView, stencilModel;
+	Uniform<glm::vec3> dirLightViewPos;
+	Uniform<glm::mat4> dirLightInverseViewProjection;
+};
+
+Handles resolveHandles(Scene& scene)
+{
+	Handles h;
+	h.gBufferProjection = scene.gBufferShader.uniform<glm::mat4>("projection");
+	h.gBufferView = scene.gBufferShader.uniform<glm::mat4>("view");
+	h.gBufferModel = scene.gBufferShader.uniform<glm::mat4>("model");
+	h.lightingPassViewPos = scene.lightingPassShader.uniform<glm::vec3>("viewPos");
+	h.lightingPassInverseViewProjection = scene.lightingPassShader.uniform<glm::mat4>("inverseViewProjection");
+	h.pointLightProjection = scene.pointLightShader.uniform<glm::mat4>("projection");
+	h.pointLightView = scene.pointLightShader.uniform<glm::mat4>("view");
+	h.pointLightModel = scene.pointLightShader.uniform<glm::mat4>("model");
+	h.pointLightViewPos = scene.pointLightShader.uniform<glm::vec3>("viewPos");
+	h.pointLightInverseViewProjection = scene.pointLightShader.uniform<glm::mat4>("inverseViewProjection");
+	h.pointLightColor = scene.pointLightShader.uniform<glm::vec3>("gPointLight.Base.Color");
+	h.pointLightPosition = scene.pointLightShader.uniform<glm::vec3>("gPointLight.Position");
+	h.stencilProjection = scene.stencilTestShader.uniform<glm::mat4>("projection");
+	h.stencilView = scene.stencilTestShader.uniform<glm::mat4>("view");
+	h.stencilModel = scene.stencilTestShader.uniform<glm::mat4>("model");
+	h.dirLightViewPos = scene.dirLightShader.uniform<glm::vec3>("viewPos");
+	h.dirLightInverseViewProjection = scene.dirLightShader.uniform<glm::mat4>("inverseViewProjection");
+	return h;
+}
+
+/// <summary>
+/// One frame of uniform traffic the way the sample does it now: per-frame values through
+/// precomputed handles, constant values were set once before the loop and the lights of
+/// the learnopengl pass are in a LightBuffer.
+/// </summary>
+void frameWithHandles(Scene& scene, const Handles& h)
+{
+	// the light passes reconstruct the position from the depth buffer
+	glm::mat4 inverseViewProjection = glm::inverse(scene.projection * scene.view);
+
+	Shader& g = scene.gBufferShader;
+	g.use();
+	g.set(h.gBufferProjection, scene.projection);
+	g.set(h.gBufferView, scene.view);
+	for (const glm::vec3& position : scene.objectPositions)
+	{
+		glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.25f));
+		g.set(h.gBufferModel, model);
+		if (scene.object)
+			scene.object->Draw(g);
+	}
+
+	Shader& l = scene.lightingPassShader;
+	l.use();
+	scene.lightBuffer->update();
+	l.set(h.lightingPassViewPos, scene.viewPos);
+	l.set(h.lightingPassInverseViewProjection, inverseViewProjection);
+
+	Shader& p = scene.pointLightShader;
+	Shader& s = scene.stencilTestShader;
+	p.use();
+	p.set(h.pointLightProjection, scene.projection);
+	p.set(h.pointLightView, scene.view);
+	p.set(h.pointLightViewPos, scene.viewPos);
+	p.set(h.pointLightInverseViewProjection, inverseViewProjection);
+	s.use();
+	s.set(h.stencilProjection, scene.projection);
+	s.set(h.stencilView, scene.view);
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), scene.lightPositions[i]), glm::vec3(scene.lightRadii[i]));
+		s.use();
+		s.set(h.stencilModel, model);
+		p.use();
+		p.set(h.pointLightModel, model);
+		p.set(h.pointLightColor, scene.lightColors[i]);
+		p.set(h.pointLightPosition, scene.lightPositions[i]);
+	}
+	Shader& d = scene.dirLightShader;
+	d.use();
+	d.set(h.dirLightViewPos, scene.viewPos);
+	d.set(h.dirLightInverseViewProjection, inverseViewProjection);
+}
+
+struct Result {
+	double allocations, glCalls, locationQueries, microseconds;
+};
+
+template<typename Frame>
+Result measure(Frame frame)
+{
+	// warm up (first draw resolves the cached sampler locations of the meshes)
+	frame();
+	glFinish();
+
+	unsigned long long allocationsBefore = allocations, callsBefore = glCalls, queriesBefore = glLocationQueries;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < FRAMES; i++)
+		frame();
+	auto end = std::chrono::high_resolution_clock::now();
+	glFinish();
+
+	Result result;
+	result.allocations = (double)(allocations - allocationsBefore) / FRAMES;
+	result.glCalls = (double)(glCalls - callsBefore) / FRAMES;
+	result.locationQueries = (double)(glLocationQueries - queriesBefore) / FRAMES;
+	result.microseconds = std::chrono::duration<double, std::micro>(end - start).count() / FRAMES;
+	return result;
+}
+
+void print(const char* name, const Result& result)
+{
+	std::cout << std::left << std::setw(24) << name
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(14) << result.allocations
+		<< std::setw(12) << result.glCalls
+		<< std::setw(16) << result.locationQueries
+		<< std::setw(14) << result.microseconds << std::endl;
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);	// the lighting pass reads the lights from a storage buffer
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// the benchmark only needs a context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+	installCounters();
+
+	// scene setup as in the sample
+	// ----------------------------
+	Scene scene;
+	scene.gBufferShader = Shader(shaderPath("gBufferShader.vert").c_str(), shaderPath("gBufferShader.frag").c_str());
+	scene.lightingPassShader = Shader(shaderPath("lightingPassShader.vert").c_str(), shaderPath("lightingPassShader.frag").c_str());
+	scene.pointLightShader = Shader(shaderPath("pointLightShader.vert").c_str(), shaderPath("pointLightShader.frag").c_str());
+	scene.stencilTestShader = Shader(shaderPath("stencilTestShader.vert").c_str(), shaderPath("stencilTestShader.frag").c_str());
+	scene.dirLightShader = Shader(shaderPath("dirLightShader.vert").c_str(), shaderPath("dirLightShader.frag").c_str());
+
+	std::string modelPath = FileSystem::getPath("content/models/nanosuit/nanosuit.obj");
+	if (std::ifstream(modelPath).good())
+		scene.object = new Model(modelPath.c_str());
+	else
+		std::cout << "nanosuit not found, geometry pass without model draws" << std::endl;
+
+	for (int x = -1; x <= 1; x++)
+		for (int z = -1; z <= 1; z++)
+			scene.objectPositions.push_back(glm::vec3(3.0f * x, -3.0f, 3.0f * z));
+
+	srand(13);
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+		float yPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 4.0);
+		float zPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
+		scene.lightPositions.push_back(glm::vec3(xPos, yPos, zPos));
+		float rColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5);
+		float gColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5);
+		float bColor = static_cast<float>(((rand() % 100) / 200.0f) + 0.5);
+		scene.lightColors.push_back(glm::vec3(rColor, gColor, bColor));
+		float lightMax = std::fmax(std::fmax(rColor, gColor), bColor);
+		scene.lightRadii.push_back(
+			(-LINEAR + std::sqrt(LINEAR * LINEAR - 4 * QUADRATIC * (CONSTANT - (256.0f / 5.0f) * lightMax))) / (2 * QUADRATIC));
+	}
+	scene.projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+	scene.viewPos = glm::vec3(0.0f, 0.0f, 5.0f);
+	scene.view = glm::lookAt(scene.viewPos, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	// same binding as the LightBlock of lightingPassShader.frag
+	scene.lightBuffer = new LightBuffer(NR_LIGHTS, GL_SHADER_STORAGE_BUFFER, 0);
+	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	{
+		GPULight light = {};
+		light.position = glm::vec4(scene.lightPositions[i], POINTLIGHT);
+		light.diffuse = glm::vec4(scene.lightColors[i], CONSTANT);
+		light.specular = glm::vec4(scene.lightColors[i], LINEAR);
+		light.attenuation = glm::vec4(QUADRATIC, scene.lightRadii[i], 0.0f, 0.0f);
+		scene.lightBuffer->set(i, light);
+	}
+
+	Handles handles = resolveHandles(scene);
+
+	std::cout << "Uniform traffic per frame (" << NR_LIGHTS << " lights, " << FRAMES << " frames)" << std::endl;
+	std::cout << std::left << std::setw(24) << "Mode"
+		<< std::right << std::setw(14) << "Allocations"
+		<< std::setw(12) << "GL calls"
+		<< std::setw(16) << "Location qry"
+		<< std::setw(14) << "CPU [us]" << std::endl;
+
+	print("strings", measure([&] { frameWithStrings(scene); }));
+	print("handles + light buffer", measure([&] { frameWithHandles(scene, handles); }));
+
+	delete scene.lightBuffer;
+	delete scene.object;
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * Frustum Culling Benchmark
+ * tests 100k random boxes against a moving camera frustum and compares a per-object
+ * test with early out (array of structures) to the plane-by-plane FrustumCuller pass
+ * over separate bound arrays (structure of arrays)
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "modules/frustum.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const unsigned int OBJECT_COUNT = 100000;
+// camera poses, every variant is measured over the same sequence
+const int FRAMES = 200;
+// extent of the world the boxes are scattered in
+const float WORLD_SIZE = 200.0f;
+
+struct Box {
+	glm::vec3 min;
+	glm::vec3 max;
+};
+
+struct Result {
+	double milliseconds = 0.0;			// per frame
+	unsigned long long visible = 0;		// summed over all frames
+};
+
+// camera circling the center of the world
+glm::mat4 cameraMatrix(int frame)
+{
+	float angle = glm::radians(360.0f * frame / FRAMES);
+	glm::vec3 position(std::cos(angle) * WORLD_SIZE * 0.25f, 5.0f, std::sin(angle) * WORLD_SIZE * 0.25f);
+	glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(position, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	return projection * view;
+}
+
+template<typename Cull>
+Result measure(Cull cull)
+{
+	Result result;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < FRAMES; frame++)
+		result.visible += cull(Frustum(cameraMatrix(frame)));
+	auto end = std::chrono::high_resolution_clock::now();
+	result.milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+	return result;
+}
+
+void print(const char* name, const Result& result)
+{
+	std::cout << std::left << std::setw(32) << name
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(14) << result.milliseconds
+		<< std::setw(18) << std::setprecision(0) << OBJECT_COUNT / result.milliseconds
+		<< std::setw(12) << std::setprecision(1) << 100.0 * result.visible / ((double)OBJECT_COUNT * FRAMES) << "%" << std::endl;
+}
+
+int main()
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> position(-WORLD_SIZE * 0.5f, WORLD_SIZE * 0.5f);
+	std::uniform_real_distribution<float> size(0.25f, 2.5f);
+
+	std::vector<Box> boxes(OBJECT_COUNT);
+	FrustumCuller culler;
+	for (Box& box : boxes)
+	{
+		glm::vec3 center(position(generator), position(generator) * 0.1f, position(generator));
+		glm::vec3 extent(size(generator), size(generator), size(generator));
+		box.min = center - extent;
+		box.max = center + extent;
+		culler.add(box.min, box.max);
+	}
+
+	std::vector<unsigned char> visible(OBJECT_COUNT);
+
+	std::cout << OBJECT_COUNT << " objects, " << FRAMES << " frames" << std::endl;
+	std::cout << std::left << std::setw(32) << "Variant"
+		<< std::right << std::setw(14) << "ms/frame"
+		<< std::setw(18) << "objects/ms"
+		<< std::setw(13) << "visible" << std::endl;
+
+	Result aos = measure([&](const Frustum& frustum) {
+		unsigned int count = 0;
+		for (unsigned int i = 0; i < OBJECT_COUNT; i++)
+		{
+			visible[i] = frustum.intersects(boxes[i].min, boxes[i].max);
+			count += visible[i];
+		}
+		return count;
+	});
+	print("box, per object (AoS)", aos);
+
+	Result soaBox = measure([&](const Frustum& frustum) {
+		return culler.cull(frustum, visible, FrustumCuller::BOX);
+	});
+	print("box, per plane (SoA)", soaBox);
+
+	Result soaSphere = measure([&](const Frustum& frustum) {
+		return culler.cull(frustum, visible, FrustumCuller::SPHERE);
+	});
+	print("sphere, per plane (SoA)", soaSphere);
+
+	if (aos.visible != soaBox.visible)
+		std::cout << "ERROR: box results differ (" << aos.visible << " / " << soaBox.visible << ")" << std::endl;
+	std::cout << "SoA box speedup: " << std::setprecision(2) << aos.milliseconds / soaBox.milliseconds << "x" << std::endl;
+	return 0;
+}
@@ -0,0 +1,35 @@
+#version 330 core
+// stands in for a full-screen light pass: reads every texel of the layout once
+out vec4 FragColor;
+
+uniform sampler2D target0;
+uniform sampler2D target1;
+uniform sampler2D target2;
+uniform sampler2D target3;
+uniform sampler2D depth;
+
+// number of color targets of the layout
+uniform int targetCount;
+// the layout has no position target, the position is reconstructed from the depth
+uniform bool reconstruct;
+// transformation from clipping to world space
+uniform mat4 inverseViewProjection;
+
+void main() {
+	ivec2 pixel = ivec2(gl_FragCoord.xy);
+	vec4 sum = vec4(0.0);
+	if (targetCount > 0)
+		sum += texelFetch(target0, pixel, 0);
+	if (targetCount > 1)
+		sum += texelFetch(target1, pixel, 0);
+	if (targetCount > 2)
+		sum += texelFetch(target2, pixel, 0);
+	if (targetCount > 3)
+		sum += texelFetch(target3, pixel, 0);
+	if (reconstruct) {
+		vec2 uv = (vec2(pixel) + 0.5) / vec2(textureSize(depth, 0));
+		vec4 position = inverseViewProjection * vec4(vec3(uv, texelFetch(depth, pixel, 0).r) * 2.0 - 1.0, 1.0);
+		sum.xyz += position.xyz / position.w;
+	}
+	FragColor = sum;
+}
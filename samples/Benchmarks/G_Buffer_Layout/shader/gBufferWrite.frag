@@ -0,0 +1,16 @@
+#version 330 core
+// stands in for the geometry pass: every output gets a value that changes per pixel,
+// the draw buffers of the layout decide which of them reach a texture
+layout (location = 0) out vec4 target0;
+layout (location = 1) out vec4 target1;
+layout (location = 2) out vec4 target2;
+layout (location = 3) out vec4 target3;
+
+void main() {
+	vec2 p = gl_FragCoord.xy;
+	vec4 v = fract(vec4(p.x * 0.013, p.y * 0.017, (p.x + p.y) * 0.011, p.x * p.y * 0.0001));
+	target0 = v;
+	target1 = v.yzwx;
+	target2 = v.zwxy;
+	target3 = v.wxyz;
+}
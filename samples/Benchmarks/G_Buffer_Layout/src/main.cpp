@@ -0,0 +1,404 @@
+/*
+ * G-Buffer Layout Benchmark
+ * memory and bandwidth report of the G-buffer layouts of Deferred_Shading, SSAO and Compute_Shader
+ * before and after the compact layout (position reconstructed from the depth buffer, octahedral normals
+ * in RG16, albedo/specular in RGBA8) at 1080p and 4K: bytes per pixel, memory of the targets and GPU time
+ * of a pass that writes every target (clear + full-screen fill) and a pass that reads every texel once,
+ * plus the angular error of the normal encodings
+ *
+ * The sizes are the nominal sizes of the formats, drivers usually pad RGB formats to four channels,
+ * so the old layouts take even more memory than listed.
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "modules/shader_m.h"
+#include "modules/filesystem.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+const int WARM_UP_ITERATIONS = 3;
+const int ITERATIONS = 20;
+const int NORMAL_SAMPLES = 1000000;
+const int MAX_TARGETS = 4;
+
+struct Resolution {
+	const char* name;
+	int width, height;
+};
+const Resolution RESOLUTIONS[] = { { "1080p", 1920, 1080 }, { "4K", 3840, 2160 } };
+
+// a texture of the G-buffer
+struct Target {
+	GLenum internalFormat, format, type;
+	unsigned int bytes;
+};
+
+const Target RGB32F = { GL_RGB32F, GL_RGB, GL_FLOAT, 12 };
+const Target RGBA32F = { GL_RGBA32F, GL_RGBA, GL_FLOAT, 16 };
+const Target RGB16F = { GL_RGB16F, GL_RGB, GL_FLOAT, 6 };
+const Target RGBA16F = { GL_RGBA16F, GL_RGBA, GL_FLOAT, 8 };
+const Target RGB8 = { GL_RGB8, GL_RGB, GL_UNSIGNED_BYTE, 3 };
+const Target RGBA8 = { GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4 };
+const Target RG16 = { GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 4 };
+const Target DEPTH24 = { GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT, GL_FLOAT, 4 };
+const Target DEPTH32F = { GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, 4 };
+const Target DEPTH32F_STENCIL8 = { GL_DEPTH32F_STENCIL8, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, 8 };
+
+struct Layout {
+	const char* name;
+	std::vector<Target> targets;
+	Target depth;
+	// the light passes read the depth instead of a position target
+	bool reconstruct;
+
+	unsigned int bytesPerPixel() const
+	{
+		unsigned int bytes = depth.bytes;
+		for (const Target& target : targets)
+			bytes += target.bytes;
+		return bytes;
+	}
+};
+
+// the layouts of the samples, each before and after the compact layout
+const Layout LAYOUTS[] = {
+	// position, normal, albedo/spec, texcoord
+	{ "Deferred_Shading (before)", { RGB32F, RGB32F, RGBA32F, RGB32F }, DEPTH32F_STENCIL8, false },
+	// normal, albedo/spec
+	{ "Deferred_Shading (compact)", { RG16, RGBA8 }, DEPTH32F_STENCIL8, true },
+	// position, normal, albedo
+	{ "SSAO (before)", { RGB16F, RGB16F, RGB8 }, DEPTH24, false },
+	// normal, albedo
+	{ "SSAO (compact)", { RG16, RGBA8 }, DEPTH32F, true },
+	// color, reflection, normal (already reconstructs the position)
+	{ "Compute_Shader (before)", { RGBA8, RGBA16F, RGBA8 }, DEPTH24, true },
+	// color, reflection with log shininess, normal
+	{ "Compute_Shader (compact)", { RGBA8, RGBA8, RG16 }, DEPTH24, true },
+};
+
+// the framebuffer of a layout at one resolution
+struct GBuffer {
+	GLuint fbo = 0;
+	GLuint textures[MAX_TARGETS] = {};
+	GLuint depth = 0;
+	bool complete = false;
+};
+
+GLuint createTexture(const Target& target, int width, int height)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, target.internalFormat, width, height, 0, target.format, target.type, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	return texture;
+}
+
+GBuffer createGBuffer(const Layout& layout, int width, int height)
+{
+	GBuffer gBuffer;
+	glGenFramebuffers(1, &gBuffer.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
+	GLenum drawBuffers[MAX_TARGETS];
+	for (size_t i = 0; i < layout.targets.size(); i++)
+	{
+		gBuffer.textures[i] = createTexture(layout.targets[i], width, height);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + (GLenum)i, GL_TEXTURE_2D, gBuffer.textures[i], 0);
+		drawBuffers[i] = GL_COLOR_ATTACHMENT0 + (GLenum)i;
+	}
+	glDrawBuffers((GLsizei)layout.targets.size(), drawBuffers);
+	gBuffer.depth = createTexture(layout.depth, width, height);
+	GLenum depthAttachment = layout.depth.format == GL_DEPTH_STENCIL ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT;
+	glFramebufferTexture2D(GL_FRAMEBUFFER, depthAttachment, GL_TEXTURE_2D, gBuffer.depth, 0);
+	// the RGB float formats don't have to be renderable
+	gBuffer.complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return gBuffer;
+}
+
+void deleteGBuffer(GBuffer& gBuffer)
+{
+	glDeleteFramebuffers(1, &gBuffer.fbo);
+	glDeleteTextures(MAX_TARGETS, gBuffer.textures);
+	glDeleteTextures(1, &gBuffer.depth);
+}
+
+// full-screen quad, the depth changes over the screen
+GLuint createQuad()
+{
+	float vertices[] = {
+		-1.0f, -1.0f, -0.5f,
+		 1.0f, -1.0f,  0.5f,
+		 1.0f,  1.0f,  0.5f,
+		-1.0f, -1.0f, -0.5f,
+		 1.0f,  1.0f,  0.5f,
+		-1.0f,  1.0f, -0.5f,
+	};
+	GLuint vao, vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+	return vao;
+}
+
+// average GPU time of a pass in milliseconds, a query per pass
+template<typename Pass>
+double measure(GLuint query, Pass pass)
+{
+	for (int i = 0; i < WARM_UP_ITERATIONS; i++)
+		pass();
+	double milliseconds = 0.0;
+	for (int i = 0; i < ITERATIONS; i++)
+	{
+		glBeginQuery(GL_TIME_ELAPSED, query);
+		pass();
+		glEndQuery(GL_TIME_ELAPSED);
+		GLuint64 nanoseconds = 0;
+		glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+		milliseconds += nanoseconds / 1000000.0;
+	}
+	return milliseconds / ITERATIONS;
+}
+
+// normal encodings, the same math as the shaders of the samples
+// ---------------------------------------------------------------
+float signNotZero(float v)
+{
+	return v >= 0.0f ? 1.0f : -1.0f;
+}
+
+// octahedral, two 16 bit unorm channels (gBufferShader.frag)
+glm::vec3 roundTripOctahedral(glm::vec3 n)
+{
+	n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	glm::vec2 e(n.x, n.y);
+	if (n.z < 0.0f)
+		e = (glm::vec2(1.0f) - glm::abs(glm::vec2(n.y, n.x))) * glm::vec2(signNotZero(n.x), signNotZero(n.y));
+	e = e * 0.5f + 0.5f;
+	// unorm16 quantization
+	e = glm::round(e * 65535.0f) / 65535.0f;
+
+	e = e * 2.0f - 1.0f;
+	glm::vec3 d(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+	float t = std::max(-d.z, 0.0f);
+	d.x += d.x >= 0.0f ? -t : t;
+	d.y += d.y >= 0.0f ? -t : t;
+	return glm::normalize(d);
+}
+
+// n*0.5 + 0.5 in an 8 bit unorm channel each (Compute_Shader before)
+glm::vec3 roundTripUnorm8(glm::vec3 n)
+{
+	glm::vec3 e = glm::round((n * 0.5f + 0.5f) * 255.0f) / 255.0f;
+	return glm::normalize(e * 2.0f - 1.0f);
+}
+
+// half float each (SSAO before)
+glm::vec3 roundTripHalf(glm::vec3 n)
+{
+	glm::vec3 d(glm::unpackHalf1x16(glm::packHalf1x16(n.x)),
+		glm::unpackHalf1x16(glm::packHalf1x16(n.y)),
+		glm::unpackHalf1x16(glm::packHalf1x16(n.z)));
+	return glm::normalize(d);
+}
+
+template<typename RoundTrip>
+void printNormalError(const char* name, unsigned int bytes, const std::vector<glm::vec3>& normals, RoundTrip roundTrip)
+{
+	double sum = 0.0, maximum = 0.0;
+	for (const glm::vec3& n : normals)
+	{
+		double angle = glm::degrees(std::acos(glm::clamp((double)glm::dot(n, roundTrip(n)), -1.0, 1.0)));
+		sum += angle;
+		maximum = std::max(maximum, angle);
+	}
+	std::cout << std::left << std::setw(28) << name
+		<< std::right << std::setw(6) << bytes
+		<< std::fixed << std::setprecision(5)
+		<< std::setw(14) << sum / normals.size()
+		<< std::setw(14) << maximum << std::endl;
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// the benchmark only needs a context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	GLFWwindow* window = glfwCreateWindow(256, 256, "Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+
+	const std::string shaderDirectory = FileSystem::getPath("samples/Benchmarks/G_Buffer_Layout/shader/");
+	Shader writeShader((shaderDirectory + "fullscreen.vert").c_str(), (shaderDirectory + "gBufferWrite.frag").c_str());
+	Shader readShader((shaderDirectory + "fullscreen.vert").c_str(), (shaderDirectory + "gBufferRead.frag").c_str());
+	readShader.use();
+	for (int i = 0; i < MAX_TARGETS; i++)
+		readShader.setInt("target" + std::to_string(i), i);
+	readShader.setInt("depth", MAX_TARGETS);
+
+	GLuint quad = createQuad();
+	GLuint query;
+	glGenQueries(1, &query);
+
+	// G-buffer layouts
+	// ----------------
+	std::cout << std::left << std::setw(28) << "Layout"
+		<< std::setw(8) << "Size"
+		<< std::right << std::setw(8) << "B/px"
+		<< std::setw(10) << "MB"
+		<< std::setw(12) << "Write [ms]"
+		<< std::setw(12) << "Read [ms]"
+		<< std::setw(12) << "Saved" << std::endl;
+
+	for (const Resolution& resolution : RESOLUTIONS)
+	{
+		const int width = resolution.width, height = resolution.height;
+		const double pixels = (double)width * height;
+		glViewport(0, 0, width, height);
+
+		// lit result of the read pass, the same for every layout
+		GLuint output = createTexture(RGBA8, width, height), outputFbo;
+		glGenFramebuffers(1, &outputFbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, output, 0);
+
+		glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 100.0f);
+		glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 5.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		readShader.use();
+		readShader.setMat4("inverseViewProjection", glm::inverse(projection * view));
+
+		unsigned int beforeBytes = 0;
+		for (const Layout& layout : LAYOUTS)
+		{
+			const bool compact = std::string(layout.name).find("compact") != std::string::npos;
+			if (!compact)
+				beforeBytes = layout.bytesPerPixel();
+
+			std::cout << std::left << std::setw(28) << layout.name
+				<< std::setw(8) << resolution.name
+				<< std::right << std::setw(8) << layout.bytesPerPixel()
+				<< std::fixed << std::setprecision(1)
+				<< std::setw(10) << layout.bytesPerPixel() * pixels / (1024.0 * 1024.0);
+
+			GBuffer gBuffer = createGBuffer(layout, width, height);
+			if (!gBuffer.complete)
+			{
+				std::cout << std::setw(24) << "not renderable" << std::endl;
+				deleteGBuffer(gBuffer);
+				continue;
+			}
+
+			// geometry pass: clear and write every target and the depth of every pixel
+			double writeTime = measure(query, [&] {
+				glBindFramebuffer(GL_FRAMEBUFFER, gBuffer.fbo);
+				glEnable(GL_DEPTH_TEST);
+				glDepthFunc(GL_ALWAYS);
+				glDepthMask(GL_TRUE);
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				writeShader.use();
+				glBindVertexArray(quad);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+			});
+
+			// light pass: read every texel once (the depth only if the position is reconstructed)
+			for (size_t i = 0; i < layout.targets.size(); i++)
+			{
+				glActiveTexture(GL_TEXTURE0 + (GLenum)i);
+				glBindTexture(GL_TEXTURE_2D, gBuffer.textures[i]);
+			}
+			glActiveTexture(GL_TEXTURE0 + MAX_TARGETS);
+			glBindTexture(GL_TEXTURE_2D, gBuffer.depth);
+			readShader.use();
+			readShader.setInt("targetCount", (int)layout.targets.size());
+			readShader.setBool("reconstruct", layout.reconstruct);
+			double readTime = measure(query, [&] {
+				glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+				glDisable(GL_DEPTH_TEST);
+				readShader.use();
+				glBindVertexArray(quad);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+			});
+
+			std::cout << std::setprecision(3)
+				<< std::setw(12) << writeTime
+				<< std::setw(12) << readTime;
+			if (compact)
+				std::cout << std::setw(11) << std::setprecision(0) << 100.0 * (1.0 - (double)layout.bytesPerPixel() / beforeBytes) << "%";
+			std::cout << std::endl;
+
+			deleteGBuffer(gBuffer);
+		}
+
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glDeleteFramebuffers(1, &outputFbo);
+		glDeleteTextures(1, &output);
+	}
+
+	// normal encodings
+	// ----------------
+	std::mt19937 generator(1);
+	std::normal_distribution<float> gaussian(0.0f, 1.0f);
+	std::vector<glm::vec3> normals(NORMAL_SAMPLES);
+	for (glm::vec3& n : normals)
+	{
+		do
+			n = glm::vec3(gaussian(generator), gaussian(generator), gaussian(generator));
+		while (glm::dot(n, n) < 1e-6f);
+		n = glm::normalize(n);
+	}
+
+	std::cout << std::endl << "Normal encoding error (" << NORMAL_SAMPLES << " random normals)" << std::endl;
+	std::cout << std::left << std::setw(28) << "Encoding"
+		<< std::right << std::setw(6) << "B/px"
+		<< std::setw(14) << "Mean [deg]"
+		<< std::setw(14) << "Max [deg]" << std::endl;
+	printNormalError("RGB16F", 6, normals, roundTripHalf);
+	printNormalError("RGBA8 (n*0.5+0.5)", 4, normals, roundTripUnorm8);
+	printNormalError("RG16 octahedral", 4, normals, roundTripOctahedral);
+
+	glDeleteQueries(1, &query);
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * Keyframe Sampling Benchmark
+ * samples a synthetic 60 bone clip with 1000 keys per track for many animation instances and compares
+ * the linear key search from the first key (array of structures, TRS as matrix products) to the
+ * Skeletal_Animation Bone with structure of arrays tracks and a playback cursor per instance
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../../../Model/Skeletal_Animation/src/bone.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const int BONE_COUNT = 60;
+const int KEY_COUNT = 1000;
+const int INSTANCE_COUNT = 256;
+// measured frames per variant
+const int FRAMES = 60;
+// clip in ticks, one key per tick
+const float DURATION = (float)(KEY_COUNT - 1);
+// advance per frame, 30 ticks per second at 60 fps
+const float TICKS_PER_FRAME = 0.5f;
+
+/* reference: keys as array of structures, linear search from the first key as before */
+
+struct KeyPosition {
+	glm::vec3 position;
+	float timeStamp;
+};
+
+struct KeyRotation {
+	glm::quat orientation;
+	float timeStamp;
+};
+
+struct KeyScale {
+	glm::vec3 scale;
+	float timeStamp;
+};
+
+struct LinearBone {
+	std::vector<KeyPosition> positions;
+	std::vector<KeyRotation> rotations;
+	std::vector<KeyScale> scales;
+
+	explicit LinearBone(const aiNodeAnim* channel)
+	{
+		for (unsigned int i = 0; i < channel->mNumPositionKeys; i++)
+			positions.push_back({ AssimpGLMHelpers::GetGLMVec(channel->mPositionKeys[i].mValue), (float)channel->mPositionKeys[i].mTime });
+		for (unsigned int i = 0; i < channel->mNumRotationKeys; i++)
+			rotations.push_back({ AssimpGLMHelpers::GetGLMQuat(channel->mRotationKeys[i].mValue), (float)channel->mRotationKeys[i].mTime });
+		for (unsigned int i = 0; i < channel->mNumScalingKeys; i++)
+			scales.push_back({ AssimpGLMHelpers::GetGLMVec(channel->mScalingKeys[i].mValue), (float)channel->mScalingKeys[i].mTime });
+	}
+
+	template<typename Key>
+	static int index(const std::vector<Key>& keys, float time)
+	{
+		for (int i = 0; i < (int)keys.size() - 1; i++)
+			if (time < keys[i + 1].timeStamp)
+				return i;
+		return (int)keys.size() - 2;
+	}
+
+	template<typename Key>
+	static float factor(const std::vector<Key>& keys, int i, float time)
+	{
+		return (time - keys[i].timeStamp) / (keys[i + 1].timeStamp - keys[i].timeStamp);
+	}
+
+	glm::mat4 sample(float time) const
+	{
+		int p = index(positions, time), r = index(rotations, time), s = index(scales, time);
+		glm::mat4 translation = glm::translate(glm::mat4(1.0f), glm::mix(positions[p].position, positions[p + 1].position, factor(positions, p, time)));
+		glm::mat4 rotation = glm::toMat4(glm::normalize(glm::slerp(rotations[r].orientation, rotations[r + 1].orientation, factor(rotations, r, time))));
+		glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::mix(scales[s].scale, scales[s + 1].scale, factor(scales, s, time)));
+		return translation * rotation * scale;
+	}
+};
+
+struct Result {
+	double microseconds = 0.0;	// per frame
+	double checksum = 0.0;		// keeps the results alive and compares the variants
+};
+
+// animation time of an instance in a frame, instances start at different points of the clip
+float instanceTime(int instance, int frame)
+{
+	return std::fmod(instance * (DURATION / INSTANCE_COUNT) + frame * TICKS_PER_FRAME, DURATION);
+}
+
+template<typename Sample>
+Result measure(Sample sample)
+{
+	Result result;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int frame = 0; frame < FRAMES; frame++)
+		for (int instance = 0; instance < INSTANCE_COUNT; instance++)
+			for (int bone = 0; bone < BONE_COUNT; bone++)
+				result.checksum += sample(instance, bone, frame)[3][0];
+	auto end = std::chrono::high_resolution_clock::now();
+	result.microseconds = std::chrono::duration<double, std::micro>(end - start).count() / FRAMES;
+	return result;
+}
+
+void print(const char* name, const Result& result)
+{
+	std::cout << std::left << std::setw(32) << name
+		<< std::right << std::fixed << std::setprecision(1)
+		<< std::setw(14) << result.microseconds
+		<< std::setw(18) << std::setprecision(0) << (double)INSTANCE_COUNT * BONE_COUNT * 1000.0 / result.microseconds << std::endl;
+}
+
+int main()
+{
+	std::mt19937 generator(42);
+	std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+	// synthetic clip, one key per tick on every track
+	std::vector<aiNodeAnim*> channels;
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		aiNodeAnim* channel = new aiNodeAnim();
+		channel->mNodeName = aiString("bone" + std::to_string(bone));
+		channel->mNumPositionKeys = channel->mNumRotationKeys = channel->mNumScalingKeys = KEY_COUNT;
+		channel->mPositionKeys = new aiVectorKey[KEY_COUNT];
+		channel->mRotationKeys = new aiQuatKey[KEY_COUNT];
+		channel->mScalingKeys = new aiVectorKey[KEY_COUNT];
+		for (int key = 0; key < KEY_COUNT; key++)
+		{
+			channel->mPositionKeys[key] = aiVectorKey(key, aiVector3D(value(generator), value(generator), value(generator)));
+			aiQuaternion rotation(value(generator), value(generator), value(generator), value(generator));
+			rotation.Normalize();
+			channel->mRotationKeys[key] = aiQuatKey(key, rotation);
+			channel->mScalingKeys[key] = aiVectorKey(key, aiVector3D(1.0f + 0.1f * value(generator)));
+		}
+		channels.push_back(channel);
+	}
+
+	std::vector<LinearBone> linearBones;
+	std::vector<Bone> bones;
+	for (int bone = 0; bone < BONE_COUNT; bone++)
+	{
+		linearBones.emplace_back(channels[bone]);
+		bones.emplace_back(channels[bone]->mNodeName.data, bone, channels[bone]);
+	}
+	for (aiNodeAnim* channel : channels)
+		delete channel;
+
+	std::cout << BONE_COUNT << " bones, " << KEY_COUNT << " keys, " << INSTANCE_COUNT << " instances, " << FRAMES << " frames" << std::endl;
+	std::cout << std::left << std::setw(32) << "Variant"
+		<< std::right << std::setw(14) << "us/frame"
+		<< std::setw(18) << "samples/ms" << std::endl;
+
+	Result linear = measure([&](int instance, int bone, int frame) {
+		return linearBones[bone].sample(instanceTime(instance, frame));
+	});
+	print("linear search, AoS", linear);
+
+	// a fresh cursor every sample: forward steps fail and the binary search is used
+	Result seek = measure([&](int instance, int bone, int frame) {
+		BoneCursor cursor;
+		return bones[bone].Sample(instanceTime(instance, frame), cursor);
+	});
+	print("binary search (seek), SoA", seek);
+
+	// one cursor per instance and bone, as kept by the Animator
+	std::vector<BoneCursor> cursors(INSTANCE_COUNT * BONE_COUNT);
+	Result playback = measure([&](int instance, int bone, int frame) {
+		return bones[bone].Sample(instanceTime(instance, frame), cursors[instance * BONE_COUNT + bone]);
+	});
+	print("cursor (playback), SoA", playback);
+
+	// results differ in the last bits only, matrix products vs. direct composition
+	if (std::fabs(linear.checksum - playback.checksum) > 1e-2 || std::fabs(seek.checksum - playback.checksum) > 1e-2)
+		std::cout << "ERROR: results differ (" << linear.checksum << " / " << seek.checksum << " / " << playback.checksum << ")" << std::endl;
+	std::cout << "cursor speedup: " << std::setprecision(2) << linear.microseconds / playback.microseconds << "x" << std::endl;
+	return 0;
+}
@@ -0,0 +1,244 @@
+/*
+ * Light Culling Benchmark
+ * runs the CPU light culling of Forward_Plus (LightCuller, same lists as tile.comp and cluster.comp)
+ * with scalar code, SSE and AVX on one thread and on the job pool, with and without the depth bounds
+ * of a depth pre-pass. The depth buffer is ray traced from a hall with pillars around the lights.
+ * Every variant is checked against the scalar lists of the same mode. Needs no GPU.
+ */
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "modules/job_pool.h"
+
+#include "../../../Lighting/Forward_Plus/src/light_culling.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+const unsigned int LIGHT_COUNTS[] = { 1024, 4096, 16384 };
+const int ITERATIONS = 5;
+const glm::ivec2 FRAMEBUFFER_SIZE(1920, 1080);
+// same settings as Forward_Plus
+const int TILE_SIZE = 16;
+const unsigned int MAX_LIGHTS_PER_TILE = 1024;
+const int CLUSTER_TILE_SIZE = 64;
+const unsigned int CLUSTER_SLICES = 32;
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;
+const float NEAR_PLANE = 0.001f;
+const float FAR_PLANE = 100.0f;
+const float CLUSTER_NEAR = 0.1f;
+
+// hall around the lights and the pillars inside of it
+const glm::vec3 HALL_MIN(-14.0f, 0.0f, -6.0f);
+const glm::vec3 HALL_MAX(14.0f, 12.0f, 6.0f);
+const float PILLAR_SIZE = 0.4f;
+
+float randFloat() { return (float)rand() / (float)RAND_MAX; }
+
+// lights of Forward_Plus (createLights)
+std::vector<PointLight> createLights(unsigned int count)
+{
+	float radiusScale = std::cbrt(100.0f / count);
+	std::vector<PointLight> lights(count);
+	for (PointLight& light : lights)
+	{
+		light.position = glm::vec3(5 * (2 * randFloat() - 1), 5 * randFloat(), 3 * (2 * randFloat() - 1));
+		light.radius = radiusScale * (1.5f + 1.5f * randFloat());
+		light.color = glm::vec4(randFloat(), randFloat(), randFloat(), 1.0f);
+	}
+	return lights;
+}
+
+// distances along the ray where it enters and leaves the box (slab test)
+bool intersectBox(const glm::vec3& origin, const glm::vec3& direction, const glm::vec3& min, const glm::vec3& max, float& enter, float& leave)
+{
+	glm::vec3 t0 = (min - origin) / direction;
+	glm::vec3 t1 = (max - origin) / direction;
+	glm::vec3 tNear = glm::min(t0, t1), tFar = glm::max(t0, t1);
+	enter = std::max(std::max(tNear.x, tNear.y), tNear.z);
+	leave = std::min(std::min(tFar.x, tFar.y), tFar.z);
+	return enter <= leave && leave > 0.0f;
+}
+
+// window space depth of the hall and the pillars, bottom row first
+std::vector<float> traceDepth(const glm::mat4& projection, const glm::mat4& view, const glm::vec3& cameraPosition)
+{
+	std::vector<glm::vec3> pillars;
+	for (float x = -10.0f; x <= 10.0f; x += 2.5f)
+		for (float z : { -3.5f, 3.5f })
+			pillars.push_back(glm::vec3(x, 0.0f, z));
+
+	const glm::mat4 viewProjection = projection * view;
+	const glm::mat4 inverseViewProjection = glm::inverse(viewProjection);
+	std::vector<float> depth((size_t)FRAMEBUFFER_SIZE.x * FRAMEBUFFER_SIZE.y);
+	for (int y = 0; y < FRAMEBUFFER_SIZE.y; y++)
+		for (int x = 0; x < FRAMEBUFFER_SIZE.x; x++)
+		{
+			glm::vec2 ndc = 2.0f * (glm::vec2(x, y) + 0.5f) / glm::vec2(FRAMEBUFFER_SIZE) - 1.0f;
+			glm::vec4 farPoint = inverseViewProjection * glm::vec4(ndc, 1.0f, 1.0f);
+			glm::vec3 direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - cameraPosition);
+
+			// the camera is inside of the hall, the ray leaves it
+			float enter, leave, distance = FAR_PLANE;
+			if (intersectBox(cameraPosition, direction, HALL_MIN, HALL_MAX, enter, leave))
+				distance = leave;
+			for (const glm::vec3& pillar : pillars)
+			{
+				glm::vec3 min = pillar - glm::vec3(PILLAR_SIZE, 0.0f, PILLAR_SIZE);
+				glm::vec3 max = pillar + glm::vec3(PILLAR_SIZE, HALL_MAX.y, PILLAR_SIZE);
+				if (intersectBox(cameraPosition, direction, min, max, enter, leave) && enter > 0.0f)
+					distance = std::min(distance, enter);
+			}
+
+			glm::vec4 clip = viewProjection * glm::vec4(cameraPosition + direction * distance, 1.0f);
+			depth[(size_t)y * FRAMEBUFFER_SIZE.x + x] = std::min(0.5f * clip.z / clip.w + 0.5f, 1.0f);
+		}
+	return depth;
+}
+
+// same light count and lights in every tile, the entries behind the lights of a tile are undefined
+bool sameTiles(const std::vector<int>& lists, const std::vector<int>& reference, unsigned int capacity)
+{
+	if (lists.size() != reference.size())
+		return false;
+	for (size_t tile = 0; tile < lists.size(); tile += capacity + 1)
+	{
+		if (lists[tile] != reference[tile])
+			return false;
+		if (!std::equal(lists.begin() + tile + 1, lists.begin() + tile + 1 + lists[tile], reference.begin() + tile + 1))
+			return false;
+	}
+	return true;
+}
+
+struct Result {
+	double milliseconds = 0.0;
+	double lightsPerCell = 0.0;		// per tile or cluster
+	bool valid = true;
+};
+
+template<typename Cull>
+Result measure(Cull cull, unsigned int cells)
+{
+	Result result;
+	unsigned int total = cull();
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < ITERATIONS; i++)
+		cull();
+	auto end = std::chrono::high_resolution_clock::now();
+	result.milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / ITERATIONS;
+	result.lightsPerCell = (double)total / cells;
+	return result;
+}
+
+void print(const std::string& name, const Result& result, const Result& reference)
+{
+	std::cout << std::left << std::setw(46) << name
+		<< std::right << std::fixed << std::setprecision(3)
+		<< std::setw(12) << result.milliseconds
+		<< std::setw(10) << std::setprecision(2) << reference.milliseconds / result.milliseconds << "x"
+		<< std::setw(14) << std::setprecision(1) << result.lightsPerCell
+		<< std::setw(8) << (result.valid ? "yes" : "NO") << std::endl;
+}
+
+int main()
+{
+	// start position of the camera of Forward_Plus
+	const glm::vec3 cameraPosition(-6.8981f, 0.965631f, -0.312417f);
+	const float yaw = glm::radians(-2.95f), pitch = glm::radians(-3.55f);
+	const glm::vec3 front(std::cos(yaw) * std::cos(pitch), std::sin(pitch), std::sin(yaw) * std::cos(pitch));
+	const glm::mat4 view = glm::lookAt(cameraPosition, cameraPosition + front, glm::vec3(0.0f, 1.0f, 0.0f));
+	const glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)FRAMEBUFFER_SIZE.x / FRAMEBUFFER_SIZE.y, NEAR_PLANE, FAR_PLANE);
+	const std::vector<float> depth = traceDepth(projection, view, cameraPosition);
+
+	const glm::ivec2 numTiles = (FRAMEBUFFER_SIZE + TILE_SIZE - 1) / TILE_SIZE;
+	const glm::ivec2 numClusterTiles = (FRAMEBUFFER_SIZE + CLUSTER_TILE_SIZE - 1) / CLUSTER_TILE_SIZE;
+	const unsigned int tileCount = numTiles.x * numTiles.y;
+	const unsigned int clusterCount = numClusterTiles.x * numClusterTiles.y * CLUSTER_SLICES;
+
+	JobPool singleThread(1);
+	JobPool& pool = JobPool::instance();
+	const char* setNames[] = { "scalar", "SSE", "AVX" };
+	const LightCuller::InstructionSet best = LightCuller::bestInstructionSet();
+
+	std::cout << FRAMEBUFFER_SIZE.x << "x" << FRAMEBUFFER_SIZE.y << ", " << tileCount << " tiles, " << clusterCount << " clusters, "
+		<< pool.getThreadCount() << " threads, widest instruction set: " << setNames[best] << std::endl;
+
+	srand(1);
+	for (unsigned int lightCount : LIGHT_COUNTS)
+	{
+		std::vector<PointLight> lights = createLights(lightCount);
+		const unsigned int tileCapacity = std::min(lightCount, MAX_LIGHTS_PER_TILE);
+		LightCuller culler;
+		culler.setLights(lights.data(), lightCount, view);
+
+		std::cout << std::endl << lightCount << " lights" << std::endl;
+		std::cout << std::left << std::setw(46) << "Variant"
+			<< std::right << std::setw(12) << "ms"
+			<< std::setw(11) << "speedup"
+			<< std::setw(14) << "lights/cell"
+			<< std::setw(8) << "valid" << std::endl;
+
+		// tiles: every depth mode against the scalar lists on one thread
+		Result tileReference;
+		for (int mode = DEPTH_BOUNDS_OFF; mode <= DEPTH_BOUNDS_MASK; mode++)
+		{
+			const char* modeNames[] = { "", ", min/max depth", ", depth mask" };
+			const float* tileDepth = mode == DEPTH_BOUNDS_OFF ? nullptr : depth.data();
+			std::vector<int> reference, lists;
+
+			culler.setInstructionSet(LightCuller::SCALAR);
+			culler.cullTiles(projection, FRAMEBUFFER_SIZE, TILE_SIZE, tileCapacity, reference, tileDepth, mode, singleThread);
+			for (int set = LightCuller::SCALAR; set <= best; set++)
+			{
+				culler.setInstructionSet((LightCuller::InstructionSet)set);
+				for (JobPool* jobs : { &singleThread, &pool })
+				{
+					// only the widest instruction set on all threads
+					if (jobs == &pool && set != best)
+						continue;
+					Result result = measure([&]() {
+						return culler.cullTiles(projection, FRAMEBUFFER_SIZE, TILE_SIZE, tileCapacity, lists, tileDepth, mode, *jobs);
+					}, tileCount);
+					result.valid = sameTiles(lists, reference, tileCapacity);
+					if (mode == DEPTH_BOUNDS_OFF && set == LightCuller::SCALAR && jobs == &singleThread)
+						tileReference = result;
+					print(std::string("tiles, ") + setNames[set] + (jobs == &pool ? ", all threads" : ", 1 thread") + modeNames[mode], result, tileReference);
+				}
+			}
+		}
+
+		// clusters: the candidates of a column are found with SIMD, the slices are tested per light
+		Result clusterReference;
+		for (bool withDepth : { false, true })
+		{
+			const float* clusterDepth = withDepth ? depth.data() : nullptr;
+			std::vector<glm::uvec2> referenceGrid, grid;
+			std::vector<unsigned int> referenceLights, clusterLights;
+			culler.setInstructionSet(LightCuller::SCALAR);
+			culler.cullClusters(projection, FRAMEBUFFER_SIZE, CLUSTER_TILE_SIZE, CLUSTER_SLICES, CLUSTER_NEAR, FAR_PLANE,
+				MAX_LIGHTS_PER_CLUSTER, referenceGrid, referenceLights, clusterDepth, singleThread);
+			for (JobPool* jobs : { &singleThread, &pool })
+			{
+				culler.setInstructionSet(jobs == &singleThread ? LightCuller::SCALAR : best);
+				Result result = measure([&]() {
+					return culler.cullClusters(projection, FRAMEBUFFER_SIZE, CLUSTER_TILE_SIZE, CLUSTER_SLICES, CLUSTER_NEAR, FAR_PLANE,
+						MAX_LIGHTS_PER_CLUSTER, grid, clusterLights, clusterDepth, *jobs);
+				}, clusterCount);
+				result.valid = grid == referenceGrid && clusterLights == referenceLights;
+				if (!withDepth && jobs == &singleThread)
+					clusterReference = result;
+				print(std::string("clusters, ") + (jobs == &pool ? std::string(setNames[best]) + ", all threads" : "scalar, 1 thread")
+					+ (withDepth ? ", occupied slices" : ""), result, clusterReference);
+			}
+		}
+	}
+	return 0;
+}
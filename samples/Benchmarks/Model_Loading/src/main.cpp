@@ -0,0 +1,217 @@
+/*
+ * Model Loading Benchmark
+ * compares cold loads through assimp with warm loads from the binary mesh cache (meshes only,
+ * the texture loading is reported separately) and the size/upload time of the different vertex formats
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include "stb_image.h"
+
+#include "modules/model.h"
+#include "modules/filesystem.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+// number of measured loads per model and mode
+const int ITERATIONS = 3;
+
+// bundled models used by the samples
+const char* MODELS[] = {
+	"content/models/rock/rock.obj",
+	"content/models/planet/planet.obj",
+	"content/models/MineCart/Part2[minecart].obj",
+	"content/models/bear/bear.obj",
+	"content/models/nanosuit/nanosuit.obj",
+	"content/models/sponza_crytek/sponza.obj",
+};
+
+// vertex formats compared in the upload benchmark
+struct FormatInfo {
+	const char* name;
+	unsigned int format;
+};
+const FormatInfo FORMATS[] = {
+	{ "default (88 B)", VERTEX_FORMAT_DEFAULT },
+	{ "float, static", 0 },
+	{ "compact", VERTEX_FORMAT_COMPACT },
+	{ "compact, skinned", VERTEX_FORMAT_COMPACT_SKINNED },
+};
+
+/// <summary>
+/// Deletes the buffers and textures of a model, Model has no destructor.
+/// </summary>
+void releaseModel(Model& model)
+{
+	for (Mesh& mesh : model.meshes)
+		mesh.release();
+	for (const Texture& texture : model.textures_loaded)
+		glDeleteTextures(1, &texture.id);
+}
+
+struct LoadTimes {
+	double meshes;		// import through assimp or the cache, including the buffer uploads
+	double textures;	// the texture loading still pending after the meshes
+	bool fromCache;
+};
+
+/// <summary>
+/// Loads a model and returns the elapsed times in milliseconds.
+/// The textures stream in while the meshes are imported, the texture time is the wait for the rest of them.
+/// glFinish makes sure the uploads are part of the measurement.
+/// </summary>
+LoadTimes timeLoad(const std::string& path)
+{
+	LoadTimes times;
+	auto start = std::chrono::high_resolution_clock::now();
+	Model model(path.c_str(), false, true);
+	glFinish();
+	auto meshesLoaded = std::chrono::high_resolution_clock::now();
+	TextureLoader::instance().finish();
+	glFinish();
+	auto end = std::chrono::high_resolution_clock::now();
+	times.meshes = std::chrono::duration<double, std::milli>(meshesLoaded - start).count();
+	times.textures = std::chrono::duration<double, std::milli>(end - meshesLoaded).count();
+	times.fromCache = model.loadedFromCache;
+
+	// free the GL objects outside of the measurement, every load starts with the same GPU memory
+	releaseModel(model);
+	return times;
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// the benchmark only needs a context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	GLFWwindow* window = glfwCreateWindow(64, 64, "Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+
+	std::cout << std::left << std::setw(48) << "Model"
+		<< std::right << std::setw(14) << "Assimp [ms]"
+		<< std::setw(14) << "Cache [ms]"
+		<< std::setw(10) << "Speedup"
+		<< std::setw(16) << "Textures [ms]" << std::endl;
+
+	for (const char* model : MODELS)
+	{
+		std::string path = FileSystem::getPath(model);
+		if (!std::ifstream(path).good())
+		{
+			std::cout << std::left << std::setw(48) << model << " not found, skipped" << std::endl;
+			continue;
+		}
+
+		double cold = 0.0, warm = 0.0, textures = 0.0;
+		bool valid = true;
+		for (int i = 0; i < ITERATIONS; i++)
+		{
+			// cold: remove the cache so the model is imported through assimp (and the cache is rewritten)
+			std::remove(ModelCache::cachePath(path).c_str());
+			LoadTimes times = timeLoad(path);
+			cold += times.meshes;
+			textures += times.textures;
+			valid &= !times.fromCache;
+			// warm: the cache written by the cold load is mapped
+			times = timeLoad(path);
+			warm += times.meshes;
+			textures += times.textures;
+			valid &= times.fromCache;
+		}
+		cold /= ITERATIONS;
+		warm /= ITERATIONS;
+		// the textures are loaded the same way in both modes
+		textures /= 2 * ITERATIONS;
+
+		std::cout << std::left << std::setw(48) << model
+			<< std::right << std::fixed << std::setprecision(2)
+			<< std::setw(14) << cold
+			<< std::setw(14) << warm
+			<< std::setw(9) << cold / warm << "x"
+			<< std::setw(16) << textures
+			<< (valid ? "" : "  (cache was not used)") << std::endl;
+	}
+
+	// vertex formats
+	// --------------
+	std::cout << std::endl << std::left << std::setw(48) << "Model" << std::setw(20) << "Vertex format"
+		<< std::right << std::setw(12) << "Bytes/vert"
+		<< std::setw(12) << "Size [MB]"
+		<< std::setw(14) << "Upload [ms]" << std::endl;
+
+	for (const char* model : MODELS)
+	{
+		std::string path = FileSystem::getPath(model);
+		if (!std::ifstream(path).good())
+			continue;
+
+		Model source(path.c_str());
+		size_t vertexCount = 0;
+		for (const Mesh& mesh : source.meshes)
+			vertexCount += mesh.vertices.size();
+
+		for (const FormatInfo& info : FORMATS)
+		{
+			// convert & upload all meshes of the model with the given format
+			double upload = 0.0;
+			unsigned int vertexSize = 0;
+			for (int i = 0; i < ITERATIONS; i++)
+			{
+				std::vector<Mesh> converted;
+				converted.reserve(source.meshes.size());
+				auto start = std::chrono::high_resolution_clock::now();
+				for (const Mesh& mesh : source.meshes)
+				{
+					converted.emplace_back(mesh.vertices.data(), mesh.vertices.size(), mesh.indices.data(), mesh.indices.size(), std::vector<Texture>(), info.format);
+					vertexSize = converted.back().vertexSize;
+				}
+				glFinish();
+				auto end = std::chrono::high_resolution_clock::now();
+				upload += std::chrono::duration<double, std::milli>(end - start).count();
+				// free the buffers outside of the measurement, every iteration starts with the same GPU memory
+				for (Mesh& mesh : converted)
+					mesh.release();
+			}
+			upload /= ITERATIONS;
+
+			std::cout << std::left << std::setw(48) << model << std::setw(20) << info.name
+				<< std::right << std::fixed << std::setprecision(2)
+				<< std::setw(12) << vertexSize
+				<< std::setw(12) << (double)vertexCount * vertexSize / (1024.0 * 1024.0)
+				<< std::setw(14) << upload << std::endl;
+		}
+		releaseModel(source);
+	}
+
+	glfwTerminate();
+	return 0;
+}
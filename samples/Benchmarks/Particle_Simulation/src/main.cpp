@@ -0,0 +1,90 @@
+/*
+ * Particle Simulation Benchmark
+ * runs the CPU particle simulation of Transform_Feedback_Particles without a window or GL context
+ * on a job pool with an increasing number of threads and reports particles per millisecond,
+ * the result has to be the same for every thread count
+ */
+
+#include <glm/glm.hpp>
+
+#include "../../../Advanced_OpenGL/Transform_Feedback_Particles/src/particle_simulation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+const unsigned int PARTICLE_COUNTS[] = { 100000, 1000000, 4000000 };
+// mean lifetime in seconds, the birth rate keeps about count particles alive
+const float LIFETIME = 1.0f;
+const float FRAME_TIME = 1.0f / 60.0f;
+// frames simulated before measuring, until births and deaths are balanced
+const int WARM_UP_FRAMES = 90;
+const int FRAMES = 60;
+
+// positions and lifetimes of the alive particles
+std::vector<float> snapshot(const ParticleSimulation& simulation)
+{
+	std::vector<float> state;
+	for (const float* component : { simulation.getX(), simulation.getY(), simulation.getZ(), simulation.getLife() })
+		state.insert(state.end(), component, component + simulation.size());
+	return state;
+}
+
+int main()
+{
+	std::vector<unsigned int> threadCounts;
+	unsigned int cores = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned int threads = 1; threads < cores; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(cores);
+
+	std::cout << ParticleSimulation::PARTICLES_PER_CHUNK << " particles per chunk, " << FRAMES << " frames" << std::endl;
+	std::cout << std::left << std::setw(12) << "Particles"
+		<< std::setw(10) << "Threads"
+		<< std::right << std::setw(14) << "ms/frame"
+		<< std::setw(18) << "particles/ms"
+		<< std::setw(12) << "speedup" << std::endl;
+
+	for (unsigned int count : PARTICLE_COUNTS)
+	{
+		std::vector<float> reference;
+		double singleThreaded = 0.0;
+		for (unsigned int threads : threadCounts)
+		{
+			JobPool pool(threads);
+			// twice the capacity, so the births are not limited by the pool
+			ParticleSimulation simulation(2 * count, glm::vec3(0.0f), count / LIFETIME, LIFETIME);
+			simulation.emit(count, pool);
+			for (int frame = 0; frame < WARM_UP_FRAMES; frame++)
+				simulation.update(FRAME_TIME, pool);
+
+			auto start = std::chrono::high_resolution_clock::now();
+			for (int frame = 0; frame < FRAMES; frame++)
+				simulation.update(FRAME_TIME, pool);
+			auto end = std::chrono::high_resolution_clock::now();
+			double milliseconds = std::chrono::duration<double, std::milli>(end - start).count() / FRAMES;
+			if (threads == 1)
+				singleThreaded = milliseconds;
+
+			std::cout << std::left << std::setw(12) << count
+				<< std::setw(10) << threads
+				<< std::right << std::fixed << std::setprecision(3)
+				<< std::setw(14) << milliseconds
+				<< std::setw(18) << std::setprecision(0) << simulation.size() / milliseconds
+				<< std::setw(11) << std::setprecision(2) << singleThreaded / milliseconds << "x" << std::endl;
+
+			// the chunks and their generators don't depend on the threads, the particles have to match bit for bit
+			std::vector<float> state = snapshot(simulation);
+			if (reference.empty())
+				reference = state;
+			else if (state.size() != reference.size() || memcmp(state.data(), reference.data(), state.size() * sizeof(float)) != 0)
+				std::cout << "ERROR: particles differ from the single threaded update" << std::endl;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,150 @@
+/*
+ * Particle Sort Benchmark
+ * measures the GPU sort of Compute_Shader_Particles (depth keys and bitonic sort) with timer queries
+ * and checks the sorted pairs: ascending keys, the padding behind the particles and every particle exactly once,
+ * all particles are alive, the list of particles is the identity
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include "modules/filesystem.h"
+
+#include "../../../Advanced_OpenGL/Compute_Shader_Particles/src/particle_sort.h"
+
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const GLuint PARTICLE_COUNTS[] = { 100000, 1000000, 4000000 };
+const int WARM_UP_ITERATIONS = 3;
+const int ITERATIONS = 20;
+// screen the positions are spread over, the depth origin is its center
+const glm::vec2 SCREEN(1280.0f, 720.0f);
+
+// reads the sorted pairs back and checks them
+bool validate(const ParticleSort& sort, GLuint count)
+{
+	const GLuint padded = sort.getPaddedCount();
+	std::vector<GLuint> pairs(2 * padded);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, sort.getBuffer());
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, pairs.size() * sizeof(GLuint), pairs.data());
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	std::vector<bool> seen(padded, false);
+	for (GLuint i = 0; i < padded; i++)
+	{
+		GLuint key = pairs[2 * i], index = pairs[2 * i + 1];
+		if (index >= padded || seen[index])
+			return false;
+		seen[index] = true;
+		// the particles come first, the padding sorts behind them
+		if ((i < count) != (index < count))
+			return false;
+		if (i > 0 && key < pairs[2 * (i - 1)])
+			return false;
+	}
+	return true;
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);	// compute shaders
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// the benchmark only needs a context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+	GLFWwindow* window = glfwCreateWindow(256, 256, "Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+
+	const std::string shaderDirectory = FileSystem::getPath("samples/Advanced_OpenGL/Compute_Shader_Particles/shader/");
+	GLuint query;
+	glGenQueries(1, &query);
+
+	std::cout << std::left << std::setw(12) << "Particles"
+		<< std::right << std::setw(10) << "Padded"
+		<< std::setw(12) << "Sort [ms]"
+		<< std::setw(14) << "Mkeys/s"
+		<< std::setw(10) << "Valid" << std::endl;
+
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	for (GLuint count : PARTICLE_COUNTS)
+	{
+		std::vector<glm::vec2> positions(count);
+		for (glm::vec2& position : positions)
+			position = glm::vec2(unit(generator), unit(generator)) * SCREEN;
+		GLuint positionBuffer;
+		glGenBuffers(1, &positionBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, positionBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(glm::vec2), positions.data(), GL_STATIC_DRAW);
+		std::vector<GLuint> indices(count);
+		for (GLuint i = 0; i < count; i++)
+			indices[i] = i;
+		GLuint indexBuffer, countBuffer;
+		glGenBuffers(1, &indexBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, indexBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, count * sizeof(GLuint), indices.data(), GL_STATIC_DRAW);
+		glGenBuffers(1, &countBuffer);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, countBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), &count, GL_STATIC_DRAW);
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+		double milliseconds = 0.0;
+		bool valid;
+		{
+			ParticleSort sort(count, shaderDirectory);
+			for (int i = 0; i < WARM_UP_ITERATIONS; i++)
+				sort.sort(positionBuffer, indexBuffer, countBuffer, 0, SCREEN * 0.5f);
+
+			// a query per sort, waiting for each result keeps the sorts from overlapping
+			for (int i = 0; i < ITERATIONS; i++)
+			{
+				glBeginQuery(GL_TIME_ELAPSED, query);
+				sort.sort(positionBuffer, indexBuffer, countBuffer, 0, SCREEN * 0.5f);
+				glEndQuery(GL_TIME_ELAPSED);
+				GLuint64 nanoseconds = 0;
+				glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+				milliseconds += nanoseconds / 1000000.0;
+			}
+			milliseconds /= ITERATIONS;
+			valid = validate(sort, count);
+
+			std::cout << std::left << std::setw(12) << count
+				<< std::right << std::setw(10) << sort.getPaddedCount()
+				<< std::fixed << std::setprecision(3)
+				<< std::setw(12) << milliseconds
+				<< std::setw(14) << std::setprecision(1) << count / milliseconds / 1000.0
+				<< std::setw(10) << (valid ? "yes" : "NO") << std::endl;
+		}
+		glDeleteBuffers(1, &positionBuffer);
+		glDeleteBuffers(1, &indexBuffer);
+		glDeleteBuffers(1, &countBuffer);
+	}
+
+	glDeleteQueries(1, &query);
+	glfwTerminate();
+	return 0;
+}
@@ -0,0 +1,297 @@
+/*
+ * Particle System Benchmark
+ * compares the update and submit cost of the CPU particle system of Transform_Feedback_Particles
+ * (structure of arrays, chunks on the job pool, SSE integration, one instanced draw) to the former
+ * array of structures with a free slot search and a draw call per particle
+ */
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "modules/shader_m.h"
+#include "modules/filesystem.h"
+
+#include "../../../Advanced_OpenGL/Transform_Feedback_Particles/src/particle.h"
+#include "../../../Advanced_OpenGL/Transform_Feedback_Particles/src/particles.h"
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+const GLuint PARTICLE_COUNTS[] = { 10000, 100000, 1000000 };
+// mean lifetime in seconds, the birth rate keeps about count particles alive
+const float LIFETIME = 1.0f;
+const float FRAME_TIME = 1.0f / 60.0f;
+// frames simulated before measuring, until births and deaths are balanced
+const int WARM_UP_FRAMES = 90;
+const int UPDATE_FRAMES = 60;
+// a draw call per particle takes long at 1M particles
+const int SUBMIT_FRAMES = 5;
+
+/* reference: the former particle system, array of structures with a search for a free slot and a draw per particle */
+
+class LegacyParticleSystem {
+public:
+	LegacyParticleSystem(GLuint maxParticles, float birthRate, float lifetime)
+		: maxParticles(maxParticles), birthRate(birthRate), lifetime(lifetime)
+	{
+		GLfloat particle_quad[] = {
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f,
+			0.0f, 0.0f, 0.0f, 0.0f,
+
+			0.0f, 1.0f, 0.0f, 1.0f,
+			1.0f, 1.0f, 1.0f, 1.0f,
+			1.0f, 0.0f, 1.0f, 0.0f
+		};
+		glGenVertexArrays(1, &particleVAO);
+		glGenBuffers(1, &VBO);
+		glBindVertexArray(particleVAO);
+		glBindBuffer(GL_ARRAY_BUFFER, VBO);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(particle_quad), particle_quad, GL_STATIC_DRAW);
+		glEnableVertexAttribArray(0);
+		glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+		glBindVertexArray(0);
+	}
+
+	~LegacyParticleSystem()
+	{
+		glDeleteVertexArrays(1, &particleVAO);
+		glDeleteBuffers(1, &VBO);
+	}
+
+	void emit(GLuint count)
+	{
+		for (GLuint i = 0; i < count; i++)
+		{
+			int unusedParticle = FirstUnusedParticle();
+			if (unusedParticle >= 0)
+				RespawnParticle(particles[unusedParticle]);
+		}
+	}
+
+	void update(float dt)
+	{
+		births += birthRate * dt;
+		GLuint count = (GLuint)births;
+		births -= count;
+		emit(count);
+
+		for (GLuint i = 0; i < particles.size(); ++i)
+		{
+			Particle& p = particles[i];
+			p.LifetimeMillis -= dt;
+			if (p.LifetimeMillis > 0.0f)
+				p.P += p.v * dt;
+		}
+	}
+
+	void draw(Shader* shader)
+	{
+		shader->use();
+		for (Particle particle : particles) {
+			if (particle.LifetimeMillis > 0.0f)
+			{
+				shader->setVec3("offset", particle.P);
+				glBindVertexArray(particleVAO);
+				glDrawArrays(GL_TRIANGLES, 0, 6);
+				glBindVertexArray(0);
+			}
+		}
+	}
+
+	GLuint size() const
+	{
+		GLuint alive = 0;
+		for (const Particle& particle : particles)
+			alive += particle.LifetimeMillis > 0.0f;
+		return alive;
+	}
+
+private:
+	std::vector<Particle> particles;
+	GLuint maxParticles;
+	GLuint lastUsedParticle = 0;
+	float birthRate, lifetime, births = 0.0f;
+	std::mt19937 generator;
+	GLuint particleVAO, VBO;
+
+	int FirstUnusedParticle()
+	{
+		for (GLuint i = lastUsedParticle; i < particles.size(); ++i) {
+			if (particles[i].LifetimeMillis <= 0.0f) {
+				lastUsedParticle = i;
+				return i;
+			}
+		}
+		for (GLuint i = 0; i < lastUsedParticle; ++i) {
+			if (particles[i].LifetimeMillis <= 0.0f) {
+				lastUsedParticle = i;
+				return i;
+			}
+		}
+		if (particles.size() < maxParticles) {
+			particles.push_back(Particle());
+			return (int)particles.size() - 1;
+		}
+		return -1;
+	}
+
+	void RespawnParticle(Particle& particle)
+	{
+		std::uniform_real_distribution<float> offset(-5.0f, 5.0f);
+		std::uniform_real_distribution<float> age(0.5f, 1.5f);
+		particle.P = glm::vec3(offset(generator), offset(generator), offset(generator));
+		particle.v = glm::vec3(0.0f, -0.1f, 0.0f);
+		particle.LifetimeMillis = lifetime * age(generator);
+	}
+};
+
+struct Result {
+	double update;	// ms per frame
+	double submit;	// ms per frame on the CPU
+	double frame;	// ms per frame including the GPU (glFinish)
+	GLuint alive;
+};
+
+template<typename System>
+Result measure(System& system, Shader& shader, GLuint count)
+{
+	// start full, then run until the lifetimes are spread out
+	system.emit(count);
+	for (int i = 0; i < WARM_UP_FRAMES; i++)
+		system.update(FRAME_TIME);
+
+	Result result;
+	auto start = std::chrono::high_resolution_clock::now();
+	for (int i = 0; i < UPDATE_FRAMES; i++)
+		system.update(FRAME_TIME);
+	auto end = std::chrono::high_resolution_clock::now();
+	result.update = std::chrono::duration<double, std::milli>(end - start).count() / UPDATE_FRAMES;
+	result.alive = system.size();
+
+	glFinish();
+	result.submit = result.frame = 0.0;
+	for (int i = 0; i < SUBMIT_FRAMES; i++)
+	{
+		glClear(GL_COLOR_BUFFER_BIT);
+		auto submitStart = std::chrono::high_resolution_clock::now();
+		system.draw(&shader);
+		auto submitEnd = std::chrono::high_resolution_clock::now();
+		glFinish();
+		auto frameEnd = std::chrono::high_resolution_clock::now();
+		result.submit += std::chrono::duration<double, std::milli>(submitEnd - submitStart).count();
+		result.frame += std::chrono::duration<double, std::milli>(frameEnd - submitStart).count();
+	}
+	result.submit /= SUBMIT_FRAMES;
+	result.frame /= SUBMIT_FRAMES;
+	return result;
+}
+
+std::string shaderPath(const char* file)
+{
+	return FileSystem::getPath(std::string("samples/Advanced_OpenGL/Transform_Feedback_Particles/shader/") + file);
+}
+
+int main()
+{
+	// glfw: initialize and configure
+	// ------------------------------
+	glfwInit();
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+	// the benchmark only needs a context
+	glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+#ifdef __APPLE__
+	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+
+	GLFWwindow* window = glfwCreateWindow(256, 256, "Benchmark", NULL, NULL);
+	if (window == NULL)
+	{
+		std::cout << "Failed to create GLFW window" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	glfwMakeContextCurrent(window);
+	glfwSwapInterval(0);
+
+	// glad: load all OpenGL function pointers
+	// ---------------------------------------
+	if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+	{
+		std::cout << "Failed to initialize GLAD" << std::endl;
+		return -1;
+	}
+
+	glEnable(GL_BLEND);
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1.0f, 0.1f, 100.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 0.0f, 15.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+
+	Shader legacyShader(shaderPath("particleVis.vert").c_str(), shaderPath("particleVis.frag").c_str());
+	legacyShader.link();
+	legacyShader.use();
+	legacyShader.setMat4("projection", projection);
+	legacyShader.setMat4("view", view);
+	legacyShader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(0.01f)));
+
+	Shader instancedShader(shaderPath("particleInstanced.vert").c_str(), shaderPath("particleBillboard.frag").c_str());
+	instancedShader.link();
+	instancedShader.use();
+	instancedShader.setMat4("projection", projection);
+	instancedShader.setMat4("view", view);
+	instancedShader.setVec3("gCameraPos", glm::vec3(0.0f, 0.0f, 15.0f));
+	instancedShader.setFloat("gBillboardSize", 0.01f);
+	instancedShader.setInt("gColorMap", 0);
+
+	std::cout << std::left << std::setw(12) << "Particles"
+		<< std::setw(10) << "System"
+		<< std::right << std::setw(10) << "Alive"
+		<< std::setw(14) << "Update [ms]"
+		<< std::setw(14) << "Submit [ms]"
+		<< std::setw(14) << "Frame [ms]"
+		<< std::setw(12) << "Draws" << std::endl;
+
+	for (GLuint count : PARTICLE_COUNTS)
+	{
+		// twice the capacity, the search for a free slot of the legacy system must not run into a full pool
+		const float birthRate = count / LIFETIME;
+		Result legacy, soa;
+		{
+			LegacyParticleSystem system(2 * count, birthRate, LIFETIME);
+			legacy = measure(system, legacyShader, count);
+		}
+		{
+			ParticleSystem system(2 * count, glm::vec3(0.0f), birthRate, LIFETIME);
+			soa = measure(system, instancedShader, count);
+		}
+
+		for (int i = 0; i < 2; i++)
+		{
+			const Result& r = i == 0 ? legacy : soa;
+			std::cout << std::left << std::setw(12) << count
+				<< std::setw(10) << (i == 0 ? "AoS" : "SoA")
+				<< std::right << std::setw(10) << r.alive
+				<< std::fixed << std::setprecision(3)
+				<< std::setw(14) << r.update
+				<< std::setw(14) << r.submit
+				<< std::setw(14) << r.frame
+				<< std::setw(12) << (i == 0 ? r.alive : 1) << std::endl;
+		}
+		std::cout << std::left << std::setw(22) << "" << std::right << std::setw(10) << "speedup"
+			<< std::setprecision(2)
+			<< std::setw(13) << legacy.update / soa.update << "x"
+			<< std::setw(13) << legacy.submit / soa.submit << "x"
+			<< std::setw(13) << legacy.frame / soa.frame << "x" << std::endl;
+	}
+
+	glfwTerminate();
+	return 0;
+}
@@ -1,9 +1,8 @@
 #version 330 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec4 gAlbedoSpec;
-layout (location = 3) out vec3 TexCoordOut;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec4 gAlbedoSpec;
 // tells OpenGL to which colorbuffer of the currently active FB to render
+// (the position is not stored, the light passes reconstruct it from the depth buffer)
 
 in vec2 TexCoords;
 in vec3 FragPos;
@@ -12,19 +11,27 @@ in vec3 Normal;
 uniform sampler2D texture_diffuse1;
 uniform sampler2D texture_specular1;
 
+/**
+ * Octahedral encoding: the unit normal is projected onto an octahedron and unfolded into
+ * the square [0, 1]^2, two 16 bit channels keep it more precise than three 32 bit floats need
+ */
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
 /**
  * it's extremly important to keep all variables in the same coord. space!!!!!!!
  */
 void main() 
 {
-	// store the frag position vec. in the first gbuffers texture
-	gPosition = FragPos;
 	// store per-fragment normals into the gBuffer
-	gNormal = normalize(Normal);
+	gNormal = encodeNormal(normalize(Normal));
 	// diffuse per-fragment color 
 	gAlbedoSpec.rgb = texture(texture_diffuse1, TexCoords).rgb;
 	// specular intensity in gAlbedoSpec's alpha component
 	gAlbedoSpec.a = texture(texture_specular1, TexCoords).r;
-
-	TexCoordOut = vec3(TexCoords, 0.0); 
-}
\ No newline at end of file
+}
@@ -1,30 +1,47 @@
-#version 330 core
+#version 430 core
 out vec4 FragColor;
 
 in vec2 TexCoords;
 
-// G-buffer Input
-uniform sampler2D gPosition;
+// G-buffer Input, the position is reconstructed from the depth buffer
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
+// transformation from clipping to world space
+uniform mat4 inverseViewProjection;
 
-struct Light {
-	vec3 Position;
-	vec3 Color;
-
-	float Linear;
-	float Quadratic;
-	float Radius;
+// layout of LightBuffer (include/modules/light_buffer.h)
+struct GPULight {
+	vec4 position;		// xyz position, w type
+	vec4 direction;		// xyz direction, w cutOff
+	vec4 ambient;		// rgb ambient, w outerCutOff
+	vec4 diffuse;		// rgb diffuse, w constant
+	vec4 specular;		// rgb specular, w linear
+	vec4 attenuation;	// x quadratic, y radius
 };
 
-const int NR_LIGHTS = 32;
-uniform Light lights[NR_LIGHTS];
+// any number of lights, the count is set by main.cpp (up/down)
+layout (std430, binding = 0) buffer LightBlock {
+	ivec4 lightCount;
+	GPULight lights[];
+};
 uniform vec3 viewPos;
 
+// inverse of the octahedral encoding of gBufferShader.frag
+vec3 decodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
 void main() {
 	// retrieve data from G-buffer
-	vec3 FragPos = texture(gPosition, TexCoords).rgb;
-	vec3 Normal = texture(gNormal, TexCoords).rgb;
+	float Depth = texture(gDepth, TexCoords).r;
+	vec4 WorldPos = inverseViewProjection * vec4(vec3(TexCoords, Depth) * 2.0 - 1.0, 1.0);
+	vec3 FragPos = WorldPos.xyz / WorldPos.w;
+	vec3 Normal = decodeNormal(texture(gNormal, TexCoords).rg);
 	vec3 Albedo = texture(gAlbedoSpec, TexCoords).rgb;
 	float Specular = texture(gAlbedoSpec, TexCoords).a;
 
@@ -32,19 +49,21 @@ void main() {
 	vec3 lighting = Albedo * 0.1; // hard-corded ambient component
 	vec3 viewDir = normalize(viewPos - FragPos);
 
-	for(int i = 0; i < NR_LIGHTS; ++i){
+	for(int i = 0; i < lightCount.x; ++i){
+		vec3 lightPosition = lights[i].position.xyz;
+		vec3 lightColor = lights[i].diffuse.rgb;
 		// calc distance between light source and curr. fragment
-		float distance = length(lights[i].Position - FragPos);
-		if(distance < lights[i].Radius){
+		float distance = length(lightPosition - FragPos);
+		if(distance < lights[i].attenuation.y){
 			// diffuse
-			vec3 lightDir = normalize(lights[i].Position - FragPos);
-			vec3 diffuse = max(dot(Normal, lightDir), 0.0)*Albedo*lights[i].Color;
+			vec3 lightDir = normalize(lightPosition - FragPos);
+			vec3 diffuse = max(dot(Normal, lightDir), 0.0)*Albedo*lightColor;
 			// specular
 			vec3 halfwayDir = normalize(lightDir + viewDir);  
 			float spec = pow(max(dot(Normal, halfwayDir), 0.0), 16.0);
-			vec3 specular = lights[i].Color * spec * Specular;
+			vec3 specular = lightColor * spec * Specular;
 			// attenuation
-			float attenuation = 1.0 / (1.0 + lights[i].Linear * distance + lights[i].Quadratic * distance * distance);
+			float attenuation = 1.0 / (1.0 + lights[i].specular.w * distance + lights[i].attenuation.x * distance * distance);
 			diffuse *= attenuation;
 			specular *= attenuation;
 			lighting += diffuse + specular;  
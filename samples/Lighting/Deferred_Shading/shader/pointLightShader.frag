@@ -29,10 +29,12 @@ struct PointLight
     Attenuation Atten;
 };
 
-// G-buffer Input
-uniform sampler2D gPosition;
+// G-buffer Input, the position is reconstructed from the depth buffer
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedoSpec;
+// transformation from clipping to world space
+uniform mat4 inverseViewProjection;
 
 uniform DirectionalLight gDirectionalLight;
 uniform PointLight gPointLight;
@@ -84,6 +86,28 @@ vec4 CalcPointLight(vec3 WorldPos, vec3 Normal)
     return Color / Attenuation;
 }
 
+/**
+ * Inverse of the octahedral encoding of gBufferShader.frag
+ */
+vec3 decodeNormal(vec2 e)
+{
+    e = e * 2.0 - 1.0;
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+    return normalize(n);
+}
+
+/**
+ * World position of the pixel, from its depth in the G-buffer and its texture coordinate
+ */
+vec3 CalcWorldPos(vec2 TexCoord)
+{
+    float Depth = texture(gDepth, TexCoord).r;
+    vec4 WorldPos = inverseViewProjection * vec4(vec3(TexCoord, Depth) * 2.0 - 1.0, 1.0);
+    return WorldPos.xyz / WorldPos.w;
+}
+
 vec2 CalcTexCoord()
 {
    return gl_FragCoord.xy / gScreenSize;
@@ -92,11 +116,10 @@ vec2 CalcTexCoord()
 void main()
 {
     vec2 TexCoord = CalcTexCoord();
-    vec3 WorldPos = texture(gPosition, TexCoord).xyz;
+    vec3 WorldPos = CalcWorldPos(TexCoord);
     vec3 Color = texture(gAlbedoSpec, TexCoord).xyz;
-    vec3 Normal = texture(gNormal, TexCoord).xyz;
+    vec3 Normal = decodeNormal(texture(gNormal, TexCoord).xy);
 	float spec = texture(gAlbedoSpec, TexCoord).a;
-    Normal = normalize(Normal);
 
     FragColor = vec4(Color, 1.0) * CalcPointLight(WorldPos, Normal);
 } 
\ No newline at end of file
@@ -9,11 +9,14 @@
 
 class GBuffer {
 	public:
+		/*
+		 * Compact layout: the position is reconstructed from the depth texture by the light passes,
+		 * so a pixel costs 4 (normal) + 4 (albedo/spec) + 8 (depth/stencil) = 16 bytes instead of
+		 * 3*12 + 16 + 8 = 60 with the float position, normal and texcoord buffers
+		 */
 		enum GBUFFER_TEXTURE_TYPE {
-			GBUFFER_TEXTURE_TYPE_POSITION,	//position color buffer 
-			GBUFFER_TEXTURE_TYPE_NORMAL, // normals color buffer
+			GBUFFER_TEXTURE_TYPE_NORMAL, // octahedral encoded normals, two 16 bit channels
 			GBUFFER_TEXTURE_TYPE_ALBEDOSPEC, // color(diffuse) + spec color buffer (Store Albedo & specular in a single texture) 
-			GBUFFER_TEXTURE_TYPE_TEXCOORD,
 			GBUFFER_NUM_TEXTURES
 		};
 
@@ -57,7 +60,10 @@ class GBuffer {
 				// creates the storage area of the texture (without initializing it)
 				glBindTexture(GL_TEXTURE_2D, m_textures[i]);
 					//if texture id is ALBEDOSPEC using RGBA
-				glTexImage2D(GL_TEXTURE_2D, 0, (i == GBUFFER_TEXTURE_TYPE_ALBEDOSPEC) ? GL_RGBA32F : GL_RGB32F, WindowWidth, WindowHeight, 0, (i == GBUFFER_TEXTURE_TYPE_ALBEDOSPEC) ? GL_RGBA : GL_RGB, GL_FLOAT, NULL);
+				if (i == GBUFFER_TEXTURE_TYPE_ALBEDOSPEC)
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowWidth, WindowHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+				else
+					glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, WindowWidth, WindowHeight, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST); // prevents unnecessary interpolation between the texels that might create some fine distortions
 				glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 				// attaches the texture to the FBO as a target
@@ -66,17 +72,20 @@ class GBuffer {
 
 			// depth (explicitly, because it requires diff. format and is attached to the FBO at a diff. spot)
 			glBindTexture(GL_TEXTURE_2D, m_depthTexture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, WindowWidth, WindowHeight, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL); // leaves a full byte for the stencile value in each pixel
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH32F_STENCIL8, WindowWidth, WindowHeight, 0, GL_DEPTH_STENCIL, GL_FLOAT_32_UNSIGNED_INT_24_8_REV, NULL); // leaves a full byte for the stencile value in each pixel
+			// sampled by the light passes to reconstruct the position (reads the depth, not the stencil)
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, m_depthTexture, 0);// attached to Depth & Stencil attachment
 		
-			//final 
+			//final (sized format, the tiled light pass writes it as an image)
 			glBindTexture(GL_TEXTURE_2D, m_finalTexture);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, WindowWidth, WindowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, WindowWidth, WindowHeight, 0, GL_RGBA, GL_FLOAT, NULL);
 			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT4, GL_TEXTURE_2D, m_finalTexture, 0); // attacht to number 4
 
 			// explicitly tell OpenGl which color attachments to be used (of. FB)
-			// enable writing to all four textures
-			GLenum drawBuffer[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3};
+			// enable writing to both textures
+			GLenum drawBuffer[] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1};
 			glDrawBuffers(sizeof(drawBuffer)/sizeof(drawBuffer[0]), drawBuffer); // supplying array if attchment locations 
 
 			// finally check if FB is complete
@@ -102,9 +111,7 @@ class GBuffer {
 			// now we keep changing the FBO, config the draw buffers for the attributes !
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
 			GLenum drawBuffer[] = { GL_COLOR_ATTACHMENT0,
-				GL_COLOR_ATTACHMENT1,
-				GL_COLOR_ATTACHMENT2,
-				GL_COLOR_ATTACHMENT3 };
+				GL_COLOR_ATTACHMENT1 };
 			glDrawBuffers(sizeof(drawBuffer) / sizeof(drawBuffer[0]), drawBuffer); // supplying array if attchment locations 
 		};
 		void bindForStencilPass() {
@@ -113,13 +120,22 @@ class GBuffer {
 			glDrawBuffer(GL_NONE);
 			// avoid garbaging the final buffer with a black image of the bounding sphere!
 		};
+		/**
+		 * Binds the depth texture to unit 0 and the textures to the units behind it.
+		 * The depth texture stays attached while it is read, the light passes must not write depth or stencil.
+		 */
 		void bindForLightPass() {
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_fbo);
 			glDrawBuffer(GL_COLOR_ATTACHMENT4);
-			for (unsigned int i = 0; i < sizeof(m_textures) / sizeof(m_textures[0]); i++) {
-				glActiveTexture(GL_TEXTURE0 + i); // Binding default 3 textures
-				glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_POSITION + i]);
-			}
+			bindTextures();
+		};
+		/**
+		 * Binds the textures as input of the tiled light pass (compute shader)
+		 * and the final texture as its output image (image unit 0)
+		 */
+		void bindForTiledLightPass() {
+			bindTextures();
+			glBindImageTexture(0, m_finalTexture, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
 		};
 		void bindForFinalPass() {
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -150,13 +166,19 @@ class GBuffer {
 
 		void bindForReadingTex() {
 			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); // disconnecting it from the GL_DRAW_FRAMEBUFFER (binding default FB)
+			bindTextures();
+		}
+
+	private:
+		void bindTextures() {
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_2D, m_depthTexture);
 			for (unsigned int i = 0; i < sizeof(m_textures) / sizeof(m_textures[0]); i++) {
-				glActiveTexture(GL_TEXTURE0 + i); // Binding default 3 textures
-				glBindTexture(GL_TEXTURE_2D, m_textures[GBUFFER_TEXTURE_TYPE_POSITION]+i);
+				glActiveTexture(GL_TEXTURE1 + i);
+				glBindTexture(GL_TEXTURE_2D, m_textures[i]);
 			}
 		}
 
-	private:
 		GLuint m_fbo;
 		GLuint m_textures[GBUFFER_NUM_TEXTURES]; // Textures for the vertex attributes
 		GLuint m_depthTexture; // Texture to serve as the depth buffer
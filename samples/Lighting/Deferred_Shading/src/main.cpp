@@ -20,9 +20,12 @@
 #include "modules/model.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/light_buffer.h"
+#include "modules/render_state.h"
 
 #include "gBuffer.h"
 
+#include <algorithm>
 #include <iostream>
 
 // callbacks
@@ -50,6 +53,26 @@ bool firstMouse = true;
 bool debug = false;
 bool debugKeyPressed = false;
 
+// lighting pass (T), the strategies only differ in how the lights find the pixels
+enum LightingStrategy {
+	LIGHTING_VOLUMES,		// stencil test and bounding sphere per light, a draw per light (ogldev)
+	LIGHTING_FULLSCREEN,	// full-screen quad, every pixel loops over all lights (learnopengl)
+	LIGHTING_TILED,			// compute shader, lights culled per 16x16 tile in shared memory, one dispatch
+	LIGHTING_STRATEGY_COUNT
+};
+const char* lightingStrategyNames[LIGHTING_STRATEGY_COUNT] = { "light volumes", "full-screen loop", "tiled compute" };
+LightingStrategy lightingStrategy = LEARNOPENGL ? LIGHTING_FULLSCREEN : LIGHTING_VOLUMES;
+bool strategyKeyPressed = false;
+
+// number of lights (up/down), the radius and the falloff of the lights shrink with the count so a pixel gets about the same light
+const unsigned int NR_LIGHTS = 32;
+const unsigned int MAX_LIGHTS = 4096;
+unsigned int lightCount = NR_LIGHTS;
+bool lightCountKeyPressed = false;
+bool lightsChanged = true;
+// tile of the tiled compute lighting, has to match tiledLightingShader.comp
+const unsigned int TILE_SIZE = 16;
+
 // timing 
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f; // time of last frame
@@ -59,7 +82,7 @@ int main()
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
-	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+	glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);	// compute shader and storage buffer of the lights
 	glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 	glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 	// Resizable Window 
@@ -96,6 +119,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -113,6 +137,7 @@ int main()
 	Shader pointLightShader(FileSystem::getSamplePath("shader/pointLightShader.vert").c_str(), FileSystem::getSamplePath("shader/pointLightShader.frag").c_str());
 	Shader dirLightShader(FileSystem::getSamplePath("shader/dirLightShader.vert").c_str(), FileSystem::getSamplePath("shader/dirLightShader.frag").c_str());
 	Shader stencilTestShader(FileSystem::getSamplePath("shader/stencilTestShader.vert").c_str(), FileSystem::getSamplePath("shader/stencilTestShader.frag").c_str());
+	Shader tiledLightingShader(FileSystem::getSamplePath("shader/tiledLightingShader.comp").c_str());
 
 	// load models
 	// -----------
@@ -152,44 +177,38 @@ int main()
 	unsigned int gBuffer;
 	glGenFramebuffers(1, &gBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-	unsigned int gPosition, gNormal, gAlbedoSpec;
-
-	// position color buffer
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL); // RGB only 3 Channels !
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
+	unsigned int gDepth, gNormal, gAlbedoSpec;
+	// no position buffer, the lighting pass reconstructs the position from the depth texture
 
-	// normal color buffer
+	// normal color buffer (octahedral encoded, 2 Channels !)
 	glGenTextures(1, &gNormal);
 	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL); // RGB only 3 Channels !
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, SCR_WIDTH, SCR_HEIGHT, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
 
 	// color + spec color buffer
 	glGenTextures(1, &gAlbedoSpec);
 	glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // needs RGBA only 4 Channels !
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL); // needs RGBA only 4 Channels !
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedoSpec, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedoSpec, 0);
 	// Store Albedo & specular in a single texture!! 
 	// it's possible to combine data in single tex. espac. in a complex pipeline
 
 	// explicitly tell OpenGl which color attachments to be used (of. FB)
-	unsigned int attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2 };
-	glDrawBuffers(3, attachments);
-
-	// set up render buffer obj. as depth buffer & check for completeness
-	unsigned int rboDepth;
-	glGenRenderbuffers(1, &rboDepth);
-	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+	unsigned int attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+
+	// depth texture (read by the lighting pass) & check for completeness
+	glGenTextures(1, &gDepth);
+	glBindTexture(GL_TEXTURE_2D, gDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 	// finally check if FB is complete
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cout << "Framebuffer not complete!" << std::endl;
@@ -205,12 +224,12 @@ int main()
 
 	// lighting info
 	// -------------
-	const unsigned int NR_LIGHTS = 32;
+	// all lights are created up front, up/down only changes how many of them are used
 	std::vector<glm::vec3> lightPositions;
 	std::vector<glm::vec3> lightColors;
 	srand(13);
 
-	for (unsigned int i = 0; i < NR_LIGHTS; i++)
+	for (unsigned int i = 0; i < MAX_LIGHTS; i++)
 	{
 		// calculate slightly random offsets
         float xPos = static_cast<float>(((rand() % 100) / 100.0) * 6.0 - 3.0);
@@ -227,10 +246,102 @@ int main()
 	// shader configuration
 	// --------------------
 	lightingPassShader.use();
-	lightingPassShader.setInt("gPosition", 0);
+	lightingPassShader.setInt("gDepth", 0);
 	lightingPassShader.setInt("gNormal", 1);
 	lightingPassShader.setInt("gAlbedoSpec", 2);
 
+	// attenuation of the light volumes (same for all lights)
+	const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
+	const float linear = 0.7;
+	const float quadratic = 1.8;
+
+	// values that don't change per frame are set once, the others through handles resolved here,
+	// so the render loop neither builds uniform names nor asks the driver for locations
+	Uniform<glm::mat4> gBufferProjection = gBufferShader.uniform<glm::mat4>("projection");
+	Uniform<glm::mat4> gBufferView = gBufferShader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> gBufferModel = gBufferShader.uniform<glm::mat4>("model");
+
+	Uniform<glm::mat4> lightBoxProjection = shaderLightBox.uniform<glm::mat4>("projection");
+	Uniform<glm::mat4> lightBoxView = shaderLightBox.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> lightBoxModel = shaderLightBox.uniform<glm::mat4>("model");
+	Uniform<glm::vec3> lightBoxColor = shaderLightBox.uniform<glm::vec3>("lightColor");
+
+	Uniform<glm::vec3> lightingPassViewPos = lightingPassShader.uniform<glm::vec3>("viewPos");
+	Uniform<glm::mat4> lightingPassInverseViewProjection = lightingPassShader.uniform<glm::mat4>("inverseViewProjection");
+
+	tiledLightingShader.use();
+	tiledLightingShader.setInt("gDepth", 0);
+	tiledLightingShader.setInt("gNormal", 1);
+	tiledLightingShader.setInt("gAlbedoSpec", 2);
+	Uniform<glm::vec3> tiledLightingViewPos = tiledLightingShader.uniform<glm::vec3>("viewPos");
+	Uniform<glm::mat4> tiledLightingView = tiledLightingShader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> tiledLightingInverseProjection = tiledLightingShader.uniform<glm::mat4>("inverseProjection");
+	Uniform<glm::mat4> tiledLightingInverseViewProjection = tiledLightingShader.uniform<glm::mat4>("inverseViewProjection");
+
+#if !LEARNOPENGL
+	pointLightShader.use();
+	pointLightShader.setInt("gDepth", 0);
+	pointLightShader.setInt("gNormal", 1);
+	pointLightShader.setInt("gAlbedoSpec", 2);
+	pointLightShader.setVec2("gScreenSize", glm::vec2(SCR_WIDTH, SCR_HEIGHT));
+	pointLightShader.setFloat("gPointLight.Base.AmbientIntensity", 0.1);
+	pointLightShader.setFloat("gPointLight.Base.DiffuseIntensity", 0.1);
+	pointLightShader.setFloat("gPointLight.Atten.Constant", constant);
+	pointLightShader.setFloat("gPointLight.Atten.Linear", linear);
+	pointLightShader.setFloat("gPointLight.Atten.Exp", quadratic);
+	Uniform<glm::mat4> pointLightProjection = pointLightShader.uniform<glm::mat4>("projection");
+	Uniform<glm::mat4> pointLightView = pointLightShader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> pointLightModel = pointLightShader.uniform<glm::mat4>("model");
+	Uniform<glm::vec3> pointLightViewPos = pointLightShader.uniform<glm::vec3>("viewPos");
+	Uniform<glm::mat4> pointLightInverseViewProjection = pointLightShader.uniform<glm::mat4>("inverseViewProjection");
+	Uniform<glm::vec3> pointLightColor = pointLightShader.uniform<glm::vec3>("gPointLight.Base.Color");
+	Uniform<glm::vec3> pointLightPosition = pointLightShader.uniform<glm::vec3>("gPointLight.Position");
+
+	stencilTestShader.use();
+	Uniform<glm::mat4> stencilProjection = stencilTestShader.uniform<glm::mat4>("projection");
+	Uniform<glm::mat4> stencilView = stencilTestShader.uniform<glm::mat4>("view");
+	Uniform<glm::mat4> stencilModel = stencilTestShader.uniform<glm::mat4>("model");
+
+	dirLightShader.use();
+	dirLightShader.setInt("gDepth", 0);
+	dirLightShader.setInt("gNormal", 1);
+	dirLightShader.setInt("gAlbedoSpec", 2);
+	dirLightShader.setVec2("gScreenSize", glm::vec2(SCR_WIDTH, SCR_HEIGHT));
+	dirLightShader.setVec3("gDirectionalLight.Base.Color", glm::vec3(1.0, 1.0, 1.0));
+	dirLightShader.setFloat("gDirectionalLight.Base.AmbientIntensity", 0.05f * 2);
+	dirLightShader.setFloat("gDirectionalLight.Base.DiffuseIntensity", 0.05f * 2);
+	dirLightShader.setVec3("gDirectionalLight.Direction", glm::vec3(0, 0, -1.0));
+	Uniform<glm::vec3> dirLightViewPos = dirLightShader.uniform<glm::vec3>("viewPos");
+	Uniform<glm::mat4> dirLightInverseViewProjection = dirLightShader.uniform<glm::mat4>("inverseViewProjection");
+#endif
+
+	// radius of the light volumes, returns values roughly between 1.0 and 5.0 (based on light's max intensity)
+	std::vector<float> lightRadii;
+	for (unsigned int i = 0; i < MAX_LIGHTS; i++)
+	{
+		float lightMax = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
+		lightRadii.push_back(
+			(-linear + std::sqrtf(linear * linear - 4 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
+			/ (2 * quadratic));
+	}
+
+	// all lights in one storage buffer (binding 0) for the full-screen loop and the tiled compute pass,
+	// the lights don't move so it is only written when their number changes
+	LightBuffer lightBuffer(MAX_LIGHTS, GL_SHADER_STORAGE_BUFFER, 0);
+	float lightRadiusScale = 1.0f;
+
+	// lighting pass time, a query per frame in flight so reading the result doesn't stall
+	GLuint lightingQueries[2];
+	glGenQueries(2, lightingQueries);
+	unsigned int frameIndex = 0;
+	// first frame of the current strategy and light count, the queries of earlier frames are discarded
+	unsigned int measuredSince = 0;
+	double lightingTime = 0.0;
+	unsigned int measuredFrames = 0;
+	LightingStrategy measuredStrategy = lightingStrategy;
+
+	std::cout << "T: lighting strategy, Up/Down: number of lights, D: G-buffer" << std::endl;
+
 	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
 
 	// render loop
@@ -251,6 +362,34 @@ int main()
 		// Check and call events
 		processInput(window);
 
+		if (lightsChanged)
+		{
+			lightsChanged = false;
+			lightRadiusScale = std::cbrt((float)NR_LIGHTS / lightCount);
+			// the attenuation is scaled with the radius, so every light still fades out at its cutoff
+			float scaledLinear = linear / lightRadiusScale;
+			float scaledQuadratic = quadratic / (lightRadiusScale * lightRadiusScale);
+			for (unsigned int i = 0; i < lightCount; i++)
+			{
+				GPULight light = {};
+				light.position = glm::vec4(lightPositions[i], POINTLIGHT);
+				light.diffuse = glm::vec4(lightColors[i], constant);
+				light.specular = glm::vec4(lightColors[i], scaledLinear);
+				light.attenuation = glm::vec4(scaledQuadratic, lightRadii[i] * lightRadiusScale, 0.0f, 0.0f);
+				lightBuffer.set(i, light);
+			}
+			lightBuffer.setCount(lightCount);
+#if !LEARNOPENGL
+			pointLightShader.use();
+			pointLightShader.setFloat("gPointLight.Atten.Linear", scaledLinear);
+			pointLightShader.setFloat("gPointLight.Atten.Exp", scaledQuadratic);
+#endif
+			// the times of the last setup are no longer comparable
+			lightingTime = 0.0;
+			measuredFrames = 0;
+			measuredSince = frameIndex;
+		}
+
 		// render
 		// ------
 
@@ -280,16 +419,18 @@ int main()
 
 			glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 			glm::mat4 view = camera.GetViewMatrix();
+			// the light passes reconstruct the world position from the depth buffer with it
+			glm::mat4 inverseViewProjection = glm::inverse(projection * view);
 			glm::mat4 model(1.0);
 			gBufferShader.use();
-			gBufferShader.setMat4("projection", projection);
-			gBufferShader.setMat4("view", view);
+			gBufferShader.set(gBufferProjection, projection);
+			gBufferShader.set(gBufferView, view);
 			//For each object
 			for (unsigned int i = 0; i < objectPositions.size(); i++) {
 				model = glm::mat4(1.0);
 				model = glm::translate(model, objectPositions[i]);
 				model = glm::scale(model, glm::vec3(0.25f));
-				gBufferShader.setMat4("model", model);
+				gBufferShader.set(gBufferModel, model);
 				object.Draw(gBufferShader);
 			}
 #if !LEARNOPENGL
@@ -302,6 +443,9 @@ int main()
 
 			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 			// 2. lighting pass: use g-buffer to calculate the scene's lighting
+			glBeginQuery(GL_TIME_ELAPSED, lightingQueries[frameIndex % 2]);
+			// lights are read from the storage buffer, only changed lights are uploaded
+			lightBuffer.update();
 #if LEARNOPENGL
 			
 			//learnopengl.com
@@ -312,31 +456,14 @@ int main()
 			lightingPassShader.use();
 			// bind all gBuffer Textures
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, gPosition);
+			glBindTexture(GL_TEXTURE_2D, gDepth);
 			glActiveTexture(GL_TEXTURE1);
 			glBindTexture(GL_TEXTURE_2D, gNormal);
 			glActiveTexture(GL_TEXTURE2);
 			glBindTexture(GL_TEXTURE_2D, gAlbedoSpec);
 
-			// send light relevant uniforms
-			for (unsigned int i = 0; i < lightPositions.size(); i++)
-			{
-				lightingPassShader.setVec3("lights[" + std::to_string(i) + "].Position", lightPositions[i]);
-				lightingPassShader.setVec3("lights[" + std::to_string(i) + "].Color", lightColors[i]);
-				// update attenuation parameters and calculate radius
-				const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
-				const float linear = 0.7;
-				const float quadratic = 1.8;
-				lightingPassShader.setFloat("lights[" + std::to_string(i) + "].Linear", linear);
-				lightingPassShader.setFloat("lights[" + std::to_string(i) + "].Quadratic", quadratic);
-				// then calculate radius of light volume/sphere
-				float lightMax = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-				float radius =
-					(-linear + std::sqrtf(linear * linear - 4 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
-					/ (2 * quadratic); // return value roughly between 1.0 and 5.0 (based on light's max intensity)
-				lightingPassShader.setFloat("lights[" + std::to_string(i) + "].Radius", radius);
-	}
-			lightingPassShader.setVec3("viewPos", camera.Position);
+			lightingPassShader.set(lightingPassViewPos, camera.Position);
+			lightingPassShader.set(lightingPassInverseViewProjection, inverseViewProjection);
 			renderQuad(); // Render Quad to draw on */
 
 			// copy depth information stored in the geometry pass into the default 
@@ -354,155 +481,161 @@ int main()
 #else
 			//OpenGLDev
 
-			/*
-			 * We need stencil to be enabled in the stencil pass to get the stencil
-			 * buffer updated and we also need it in the light pass because we render light
-			 * only if the stencil passes.
-			 */
-			glEnable(GL_STENCIL_TEST); // enable stencil test
-			
 			gBuffer.bindForReading(); // set Buffer for reading
 			glClear(GL_COLOR_BUFFER_BIT); // clear color buffer
 
-			/*
-			 * Its better to use separate shaders than adding banch inside the shader 
-			 */
+			if (lightingStrategy == LIGHTING_VOLUMES) {
+				/*
+				 * We need stencil to be enabled in the stencil pass to get the stencil
+				 * buffer updated and we also need it in the light pass because we render light
+				 * only if the stencil passes.
+				 */
+				glEnable(GL_STENCIL_TEST); // enable stencil test
 
-			/*
-			 * Problems with current implementation:
-			 *	-> when camera enters the light volume the light disappears
-			 *			reas: only render front face of the bounding sphere 
-			 *				if disable Backface cull. due to blending we will get an increased light (render twice)
-			 *				and only half of it when inse 
-			 *	-> second problem is that the bounding sphere doesn't really bound the light and sometimes obj. that are outside of it are also lit beause the sphere covers them in screen space so we calc. lighting on them
-			 *
-			 */
+				/*
+				 * Its better to use separate shaders than adding banch inside the shader 
+				 */
 
-			// For POINT LIGHTS
-			pointLightShader.use();
-			pointLightShader.setMat4("projection", projection);
-			pointLightShader.setMat4("view", view);
-			pointLightShader.setVec3("viewPos", camera.Position);
-			pointLightShader.setInt("gPosition", 0);
-			pointLightShader.setInt("gNormal", 1);
-			pointLightShader.setInt("gAlbedoSpec", 2);
-			pointLightShader.setVec2("gScreenSize", glm::vec2(SCR_WIDTH, SCR_HEIGHT));
-
-			stencilTestShader.use();
-			stencilTestShader.setMat4("projection", projection);
-			stencilTestShader.setMat4("view", view);
-
-			// Render bounding sphere for each point light
-			for (unsigned int i = 0; i < lightPositions.size(); i++) {
-
-				/* Setup Point Light Volume */
-				model = glm::mat4(1.0);
-				model = glm::translate(model, lightPositions[i]);
-				const float constant = 1.0; // note that we don't send this to the shader, we assume it is always 1.0 (in our case)
-				const float linear = 0.7;
-				const float quadratic = 1.8;
-				float lightMax = std::fmaxf(std::fmaxf(lightColors[i].r, lightColors[i].g), lightColors[i].b);
-				float radius =
-					(-linear + std::sqrtf(linear * linear - 4 * quadratic * (constant - (256.0 / 5.0) * lightMax)))
-					/ (2 * quadratic); // return value roughly between 1.0 and 5.0 (based on light's max intensity)
-				model = glm::scale(model, glm::vec3(radius));
+				/*
+				 * Problems with current implementation:
+				 *	-> when camera enters the light volume the light disappears
+				 *			reas: only render front face of the bounding sphere 
+				 *				if disable Backface cull. due to blending we will get an increased light (render twice)
+				 *				and only half of it when inse 
+				 *	-> second problem is that the bounding sphere doesn't really bound the light and sometimes obj. that are outside of it are also lit beause the sphere covers them in screen space so we calc. lighting on them
+				 *
+				 */
 
+				// For POINT LIGHTS
+				pointLightShader.use();
+				pointLightShader.set(pointLightProjection, projection);
+				pointLightShader.set(pointLightView, view);
+				pointLightShader.set(pointLightViewPos, camera.Position);
+				pointLightShader.set(pointLightInverseViewProjection, inverseViewProjection);
 
-				// 2.5 BEGINN Stencil Pass
 				stencilTestShader.use();
-				// Disable color/depth write and enable stencil
-				gBuffer.bindForStencilPass(); // only bind stencil buffer
-				glEnable(GL_DEPTH_TEST);
+				stencilTestShader.set(stencilProjection, projection);
+				stencilTestShader.set(stencilView, view);
 
-				glDisable(GL_CULL_FACE); // disable culling because we want to process both, the front and the 
-										// back faces on each polygon
+				// Render bounding sphere for each point light
+				for (unsigned int i = 0; i < lightCount; i++) {
 
-				glClear(GL_STENCIL_BUFFER_BIT); // clear stencil buffer
+					/* Setup Point Light Volume */
+					model = glm::mat4(1.0);
+					model = glm::translate(model, lightPositions[i]);
+					model = glm::scale(model, glm::vec3(lightRadii[i] * lightRadiusScale));
 
-				// enable Stencil test, but succeed always (only dpeth test matters)
-				glStencilFunc(GL_ALWAYS, 0, 0);
 
-				glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
-				glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
-				stencilTestShader.setMat4("model", model);
-				renderSphere(); // render bounding sphere based on the light params 
+					// 2.5 BEGINN Stencil Pass
+					stencilTestShader.use();
+					// Disable color/depth write and enable stencil
+					gBuffer.bindForStencilPass(); // only bind stencil buffer
+					glEnable(GL_DEPTH_TEST);
 
-				gBuffer.bindForReadingTex();
-				
-				// END Stencil Pass
+					glDisable(GL_CULL_FACE); // disable culling because we want to process both, the front and the 
+											// back faces on each polygon
 
-				// for each light we do a stencil pass (marks the relevant pixel)
-				// for each, becuase if stencil vlaue gets greater than zero due to one of the lights, we cannt tell whether another light src
-				// which also overlaps the sampe pixel is relevant or not
-				// point light pass, depends on the stencil value
+					glStencilMask(0xFF); // the light pass masked the stencil writes
+					glClear(GL_STENCIL_BUFFER_BIT); // clear stencil buffer
 
-				gBuffer.bindForLightPass(); // setup GBuffer
-				pointLightShader.use();
+					// enable Stencil test, but succeed always (only dpeth test matters)
+					glStencilFunc(GL_ALWAYS, 0, 0);
 
-				glStencilFunc(GL_NOTEQUAL, 0, 0xFF); // set up stencil 
-				// test to pass, when the stencil value is not equal to zero
-
-				glDisable(GL_DEPTH_TEST); // disable depth test dont need; on some GPUs performance +
-				/* Blending for both light types, each light Source handled by its own
-				   draw call.
-				   Blending: takes a SRCcolor (out of FS) abd a DESTcolor (FB)
-							performs calc. on them
-				 */
-				glEnable(GL_BLEND); // Enable Blending
-				glBlendEquation(GL_FUNC_ADD); // GPU will simply add the source and the destination
-				glBlendFunc(GL_ONE, GL_ONE); // true addition
-				/*
-					Res: 1 * src + 1 * dst
-				 */
+					glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+					glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+					stencilTestShader.set(stencilModel, model);
+					renderSphere(); // render bounding sphere based on the light params 
 
-				glEnable(GL_CULL_FACE); // enable culling of the front face polygons
-				glCullFace(GL_FRONT); // because the camera may be inside the light volume
-				// and if we do back face culling as normally we will not see the light until we exit its
-				// colume 
+					gBuffer.bindForReadingTex();
+				
+					// END Stencil Pass
+
+					// for each light we do a stencil pass (marks the relevant pixel)
+					// for each, becuase if stencil vlaue gets greater than zero due to one of the lights, we cannt tell whether another light src
+					// which also overlaps the sampe pixel is relevant or not
+					// point light pass, depends on the stencil value
+
+					gBuffer.bindForLightPass(); // setup GBuffer
+					pointLightShader.use();
+
+					glStencilFunc(GL_NOTEQUAL, 0, 0xFF); // set up stencil 
+					// test to pass, when the stencil value is not equal to zero
+					// the shader samples the depth of the same texture, so nothing may be written to it
+					glStencilMask(0x00);
+
+					glDisable(GL_DEPTH_TEST); // disable depth test dont need; on some GPUs performance +
+					/* Blending for both light types, each light Source handled by its own
+					   draw call.
+					   Blending: takes a SRCcolor (out of FS) abd a DESTcolor (FB)
+								performs calc. on them
+					 */
+					glEnable(GL_BLEND); // Enable Blending
+					glBlendEquation(GL_FUNC_ADD); // GPU will simply add the source and the destination
+					glBlendFunc(GL_ONE, GL_ONE); // true addition
+					/*
+						Res: 1 * src + 1 * dst
+					 */
+
+					glEnable(GL_CULL_FACE); // enable culling of the front face polygons
+					glCullFace(GL_FRONT); // because the camera may be inside the light volume
+					// and if we do back face culling as normally we will not see the light until we exit its
+					// colume 
 		
-				// Render bounding sphere as usual
-				pointLightShader.setMat4("model", model);
-				pointLightShader.setVec3("gPointLight.Base.Color", lightColors[i]);
-				pointLightShader.setFloat("gPointLight.Base.AmbientIntensity", 0.1);
-				pointLightShader.setFloat("gPointLight.Base.DiffuseIntensity", 0.1);
-				pointLightShader.setVec3("gPointLight.Position", lightPositions[i]);
-				pointLightShader.setFloat("gPointLight.Atten.Constant", constant);
-				pointLightShader.setFloat("gPointLight.Atten.Linear", linear);
-				pointLightShader.setFloat("gPointLight.Atten.Exp", quadratic);
-				renderSphere(); // Render bounding sphere for each point light
-				glCullFace(GL_BACK);
+					// Render bounding sphere as usual
+					pointLightShader.set(pointLightModel, model);
+					pointLightShader.set(pointLightColor, lightColors[i]);
+					pointLightShader.set(pointLightPosition, lightPositions[i]);
+					renderSphere(); // Render bounding sphere for each point light
+					glCullFace(GL_BACK);
 		
+					glDisable(GL_BLEND);
+				}
+
+				/*
+				 * The directional light does not need a stencil test because
+				 * its volume is unlimited and the final pass simply copies
+				 * the texture.
+				 */
+				glDisable(GL_STENCIL_TEST); // disable stencil test
+				glStencilMask(0xFF);
+
+				gBuffer.bindForLightPass();
+				// For DIRECTIONAL LIGHTS
+				/* Render Quad from (-1,-1) to (1,1) after Multilication with identity Matrix: after persp. devide and screen space transform 
+					result as Quad from (0,0) to (SCREEN_WIDTH, SCREEN_HEIGHT) */
+				dirLightShader.use();
+				//gBuffer.bindForReadingTex();
+				dirLightShader.set(dirLightViewPos, camera.Position);
+				dirLightShader.set(dirLightInverseViewProjection, inverseViewProjection);
+				glDisable(GL_DEPTH_TEST);
+				glEnable(GL_BLEND);
+				glBlendEquation(GL_FUNC_ADD);
+				glBlendFunc(GL_ONE, GL_ONE);
+				renderQuad();
 				glDisable(GL_BLEND);
 			}
-
-			/*
-			 * The directional light does not need a stencil test because
-			 * its volume is unlimited and the final pass simply copies
-			 * the texture.
-			 */
-			glDisable(GL_STENCIL_TEST); // disable stencil test
-
-			gBuffer.bindForLightPass();
-			// For DIRECTIONAL LIGHTS
-			/* Render Quad from (-1,-1) to (1,1) after Multilication with identity Matrix: after persp. devide and screen space transform 
-				result as Quad from (0,0) to (SCREEN_WIDTH, SCREEN_HEIGHT) */
-			dirLightShader.use();
-			//gBuffer.bindForReadingTex();
-			dirLightShader.setVec3("viewPos", camera.Position);
-			dirLightShader.setInt("gPosition", 0);
-			dirLightShader.setInt("gNormal", 1);
-			dirLightShader.setInt("gAlbedoSpec", 2);
-			dirLightShader.setVec2("gScreenSize", glm::vec2(SCR_WIDTH, SCR_HEIGHT));
-			dirLightShader.setVec3("gDirectionalLight.Base.Color", glm::vec3(1.0,1.0,1.0));
-			dirLightShader.setFloat("gDirectionalLight.Base.AmbientIntensity", 0.05f*2);
-			dirLightShader.setFloat("gDirectionalLight.Base.DiffuseIntensity", 0.05f*2);
-			dirLightShader.setVec3("gDirectionalLight.Direction", glm::vec3(0, 0, -1.0));
-			glDisable(GL_DEPTH_TEST);
-			glEnable(GL_BLEND);
-			glBlendEquation(GL_FUNC_ADD);
-			glBlendFunc(GL_ONE, GL_ONE);
-			renderQuad();
-			glDisable(GL_BLEND);
+			else if (lightingStrategy == LIGHTING_FULLSCREEN) {
+				// every pixel loops over all lights (lightingPassShader), ambient instead of the directional light
+				gBuffer.bindForLightPass();
+				lightingPassShader.use();
+				lightingPassShader.set(lightingPassViewPos, camera.Position);
+				lightingPassShader.set(lightingPassInverseViewProjection, inverseViewProjection);
+				glDisable(GL_DEPTH_TEST);
+				renderQuad();
+			}
+			else {
+				// a work group per tile reads the G-buffer of its pixels once, culls the lights
+				// against the tile in shared memory and writes the lit pixels into the final texture
+				gBuffer.bindForTiledLightPass();
+				tiledLightingShader.use();
+				tiledLightingShader.set(tiledLightingViewPos, camera.Position);
+				tiledLightingShader.set(tiledLightingView, view);
+				tiledLightingShader.set(tiledLightingInverseProjection, glm::inverse(projection));
+				tiledLightingShader.set(tiledLightingInverseViewProjection, inverseViewProjection);
+				glDispatchCompute((SCR_WIDTH + TILE_SIZE - 1) / TILE_SIZE, (SCR_HEIGHT + TILE_SIZE - 1) / TILE_SIZE, 1);
+				// the final pass reads the image through the framebuffer
+				glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+			}
 			/* DS FINAL PASS */
 			gBuffer.bindForFinalPass();
 			glBlitFramebuffer(0,0, SCR_WIDTH, SCR_HEIGHT,
@@ -522,24 +655,26 @@ int main()
 			// due to complexity of the GBuffer class
 
 #endif
+			glEndQuery(GL_TIME_ELAPSED);
 			
 			// render all light cubes with forward rendering as we'd normally do
 			shaderLightBox.use();
-			shaderLightBox.setMat4("projection", projection);
-			shaderLightBox.setMat4("view", view);
-			for (unsigned int i = 0; i < lightPositions.size(); i++) {
+			shaderLightBox.set(lightBoxProjection, projection);
+			shaderLightBox.set(lightBoxView, view);
+			for (unsigned int i = 0; i < lightCount; i++) {
 				model = glm::mat4(1.0);
 				model = glm::translate(model, lightPositions[i]);
-				model = glm::scale(model, glm::vec3(0.125f));
-				shaderLightBox.setMat4("model", model);
-				shaderLightBox.setVec3("lightColor", lightColors[i]);
+				model = glm::scale(model, glm::vec3(0.125f * lightRadiusScale));
+				shaderLightBox.set(lightBoxModel, model);
+				shaderLightBox.set(lightBoxColor, lightColors[i]);
 				renderCube();
 			}
 
 			if (debug) {
 				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT); // clear the current FBO (G buffer)
 
-				// draw 4 GBuffer Textures as quads on full screen
+				// draw the GBuffer Textures as quads on the upper half of the screen
+				// (the position is not stored, it is reconstructed from the depth buffer)
 #if LEARNOPENGL
 				glBindFramebuffer(GL_READ_FRAMEBUFFER, gBuffer);
 #else
@@ -550,42 +685,56 @@ int main()
 
 
 				// copy from the G buffer textures into the screen 
-#if LEARNOPENGL
-				glReadBuffer(GL_COLOR_ATTACHMENT0);
-#else
-				gBuffer.setReadBuffer(GBuffer::GBUFFER_TEXTURE_TYPE_POSITION); // Bind specific texture to GL_READ_BUFFER (only can copy from a single Texture at a time)
-#endif
-				glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, // SRC_RECTANGLE
-					0, 0, HalfWidth, HalfHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);// Destination Rectangle; SRC {Color, Depth or Stenticle Buffer}; Handle possible scaling {GL_NEAREST, GL_LINEAR (only for GL_COLOR_BUFFER_BIT)}
-
 #if LEARNOPENGL
 				glReadBuffer(GL_COLOR_ATTACHMENT1);
 #else
-				gBuffer.setReadBuffer(GBuffer::GBUFFER_TEXTURE_TYPE_ALBEDOSPEC);
+				gBuffer.setReadBuffer(GBuffer::GBUFFER_TEXTURE_TYPE_ALBEDOSPEC); // Bind specific texture to GL_READ_BUFFER (only can copy from a single Texture at a time)
 #endif
-				glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT,
-					0, HalfHeight, HalfWidth, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+				glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT, // SRC_RECTANGLE
+					0, HalfHeight, HalfWidth, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_LINEAR);// Destination Rectangle; SRC {Color, Depth or Stenticle Buffer}; Handle possible scaling {GL_NEAREST, GL_LINEAR (only for GL_COLOR_BUFFER_BIT)}
 
+				// octahedral encoded normals (red/green only)
 #if LEARNOPENGL
-				glReadBuffer(GL_COLOR_ATTACHMENT2);
+				glReadBuffer(GL_COLOR_ATTACHMENT0);
 #else
 				gBuffer.setReadBuffer(GBuffer::GBUFFER_TEXTURE_TYPE_NORMAL);
 #endif
 				glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT,
 					HalfWidth, HalfHeight, SCR_WIDTH, SCR_HEIGHT, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-
-#if !LEARNOPENGL
-				gBuffer.setReadBuffer(GBuffer::GBUFFER_TEXTURE_TYPE_TEXCOORD);
-				glBlitFramebuffer(0, 0, SCR_WIDTH, SCR_HEIGHT,
-					HalfWidth, 0, SCR_WIDTH, HalfHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-#endif
 			}
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
+
+		// the times of another strategy are not comparable
+		if (lightingStrategy != measuredStrategy)
+		{
+			measuredStrategy = lightingStrategy;
+			lightingTime = 0.0;
+			measuredFrames = 0;
+			measuredSince = frameIndex;
+		}
+		// lighting time of the previous frame, its query is done by now (skipped if it timed the last setup)
+		if (frameIndex > measuredSince)
+		{
+			GLuint64 nanoseconds = 0;
+			glGetQueryObjectui64v(lightingQueries[(frameIndex + 1) % 2], GL_QUERY_RESULT, &nanoseconds);
+			lightingTime += nanoseconds / 1000000.0;
+			if (++measuredFrames == 60)
+			{
+				std::cout << lightingStrategyNames[lightingStrategy] << ", " << lightCount << " lights: "
+					<< lightingTime / measuredFrames << " ms lighting" << std::endl;
+				lightingTime = 0.0;
+				measuredFrames = 0;
+			}
+		}
+		frameIndex++;
 	}
 
+	glDeleteQueries(2, lightingQueries);
+
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
 	
@@ -827,6 +976,39 @@ void processInput(GLFWwindow *window)
 	{
 		debugKeyPressed = false;
 	}
+
+#if !LEARNOPENGL
+	// the learnopengl G-buffer only has the full-screen loop
+	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS && !strategyKeyPressed)
+	{
+		lightingStrategy = (LightingStrategy)((lightingStrategy + 1) % LIGHTING_STRATEGY_COUNT);
+		std::cout << "lighting: " << lightingStrategyNames[lightingStrategy] << std::endl;
+		strategyKeyPressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_T) == GLFW_RELEASE)
+	{
+		strategyKeyPressed = false;
+	}
+#endif
+
+	// double or halve the number of lights
+	bool up = glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS;
+	bool down = glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS;
+	if ((up || down) && !lightCountKeyPressed)
+	{
+		unsigned int count = up ? std::min(lightCount * 2, MAX_LIGHTS) : std::max(lightCount / 2, NR_LIGHTS);
+		if (count != lightCount)
+		{
+			lightCount = count;
+			lightsChanged = true;
+			std::cout << "lights: " << lightCount << std::endl;
+		}
+		lightCountKeyPressed = true;
+	}
+	if (!up && !down)
+	{
+		lightCountKeyPressed = false;
+	}
 }
 
 // glfw: whenever the mouse moves, this callback is called
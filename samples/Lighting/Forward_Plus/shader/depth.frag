@@ -0,0 +1,43 @@
+#version 430 core
+
+// depth pre-pass: only writes depth, the alpha test has to match main.frag
+
+// ----------------------------------------------------------------------------
+//
+// Attributes
+//
+// ----------------------------------------------------------------------------
+
+in vec2 fTexCoord;
+
+// ----------------------------------------------------------------------------
+//
+// Types
+//
+// ----------------------------------------------------------------------------
+
+struct Material {
+	//Textures
+	sampler2D texture_diffuse1;
+};
+
+// ----------------------------------------------------------------------------
+//
+// Uniforms
+//
+// ----------------------------------------------------------------------------
+
+//Materials
+uniform Material material;
+
+// ----------------------------------------------------------------------------
+//
+// Functions
+//
+// ----------------------------------------------------------------------------
+
+void main() {
+    // remove alpha
+    if (texture(material.texture_diffuse1, fTexCoord).a < 0.1)
+        discard;
+}
@@ -0,0 +1,55 @@
+#version 430 core
+#extension GL_ARB_bindless_texture : require
+
+// depth pre-pass for merged models with bindless textures (ModelBatch),
+// only writes depth, the alpha test has to match main_bindless.frag
+
+// ----------------------------------------------------------------------------
+//
+// Attributes
+//
+// ----------------------------------------------------------------------------
+
+in vec2 fTexCoord;
+flat in uint fMaterial;
+
+// ----------------------------------------------------------------------------
+//
+// Types
+//
+// ----------------------------------------------------------------------------
+
+/**
+ * Bindless texture handles of a material (GPUMaterial in model_batch.h)
+ */
+struct Material {
+    uvec2 diffuse;
+    uvec2 specular;
+    uvec2 normal;
+    uvec2 height;
+};
+
+// ----------------------------------------------------------------------------
+//
+// Uniforms
+//
+// ----------------------------------------------------------------------------
+
+/**
+ * Materials of the merged model, indexed by fMaterial
+ */
+layout (std430, binding = 2) readonly buffer MaterialBuffer {
+    Material materials[];
+};
+
+// ----------------------------------------------------------------------------
+//
+// Functions
+//
+// ----------------------------------------------------------------------------
+
+void main() {
+    // remove alpha
+    if (materials[fMaterial].diffuse != uvec2(0) && texture(sampler2D(materials[fMaterial].diffuse), fTexCoord).a < 0.1)
+        discard;
+}
@@ -55,6 +55,19 @@ uniform int NumLights;
 uniform ivec2 TileSize;
 // amount tiles vec2(x, y)
 uniform ivec2 NumTiles;
+// capacity of the light list of a tile
+uniform int TileCapacity;
+// read the light list of the cluster (cluster.comp) instead of the tile (tile.comp)
+uniform bool Clustered;
+// size of a cluster on the screen
+uniform ivec2 ClusterTileSize;
+// amount of clusters vec3(x, y, slices)
+uniform ivec3 NumClusters;
+// depth of the first slice border and of the back of the last slice
+uniform float ClusterNear;
+uniform float ClusterFar;
+// capacity of the light list of a cluster
+uniform int ClusterCapacity;
 // flag if heatmap should be overlayed
 uniform bool RenderHeatmap;
 
@@ -83,7 +96,8 @@ layout (std430, binding = 0) buffer LightsBuffer {
  *
  * N - amount of light sources
  * [0...(K)] - indicies of the lights 
- * The Capacity (K) is equal for each Tile and is the number of overall light sources.
+ * The Capacity (K, TileCapacity) is equal for each Tile, the number of overall light sources up to
+ * MAX_LIGHTS_PER_TILE (main.cpp), further lights of a tile are dropped.
  * This avoids the need for an atomic counter to reserve a unique memory-amount 
  * for each tile.
  * This avoids the need for Indice pointers in a seperate texture/buffer.
@@ -95,6 +109,20 @@ layout (std430, binding = 1) buffer VisibleLightIndicesBuffer {
     int visibleLightIndices[];
 };
 
+/**
+ * @brief Light list of every cluster, (offset in clusterLightIndices, number of lights)
+ */
+layout (std430, binding = 4) buffer ClusterGridBuffer {
+    uvec2 clusterGrid[];
+};
+
+/**
+ * @brief Pool of the light lists of all clusters
+ */
+layout (std430, binding = 5) buffer ClusterLightIndicesBuffer {
+    uint clusterLightIndices[];
+};
+
 // ----------------------------------------------------------------------------
 //
 // Functions
@@ -202,17 +230,36 @@ void main() {
         discard;
 
     // calculate position of the light indicies in the buffer object
-    ivec2 tilePosition = ivec2(gl_FragCoord.xy) / TileSize.xy;
-    uint linearWorkGroupIndex = uint(NumTiles.x*tilePosition.y + tilePosition.x);
+    int listStart;
+    int numLights;
+    int listCapacity;
+    if (Clustered) {
+        // depth slice of the fragment, the slices grow exponentially with the distance
+        float viewDepth = -wdiv(ViewMatrix*fWorldPosition).z;
+        int slice = int(floor(log(viewDepth / ClusterNear) / log(ClusterFar / ClusterNear) * NumClusters.z));
+        slice = clamp(slice, 0, NumClusters.z - 1);
+        ivec2 clusterPosition = ivec2(gl_FragCoord.xy) / ClusterTileSize;
+        uint clusterIndex = uint((slice*NumClusters.y + clusterPosition.y)*NumClusters.x + clusterPosition.x);
 
-    // amount of lights are stored in the buffer as first component
-    int numLights = visibleLightIndices[(NumLights + 1)*linearWorkGroupIndex];
+        uvec2 cluster = clusterGrid[clusterIndex];
+        listStart = int(cluster.x);
+        numLights = int(cluster.y);
+        listCapacity = ClusterCapacity;
+    } else {
+        ivec2 tilePosition = ivec2(gl_FragCoord.xy) / TileSize.xy;
+        uint linearWorkGroupIndex = uint(NumTiles.x*tilePosition.y + tilePosition.x);
+
+        // amount of lights are stored in the buffer as first component
+        listStart = (TileCapacity + 1)*int(linearWorkGroupIndex) + 1;
+        numLights = visibleLightIndices[listStart - 1];
+        listCapacity = TileCapacity;
+    }
 
     // calculate the contribution of each light to the global lighting of the surface pointLight
     // accumulate the intensity
     vec4 color = vec4(0, 0, 0, 1);    
     for (int lightIndex = 0; lightIndex < numLights; ++lightIndex) {
-        int index = visibleLightIndices[(NumLights + 1)*linearWorkGroupIndex + lightIndex + 1];
+        int index = Clustered ? int(clusterLightIndices[listStart + lightIndex]) : visibleLightIndices[listStart + lightIndex];
         PointLight light = lights[index];
 
         vec4 illumination = shadePointLight(material,
@@ -229,6 +276,6 @@ void main() {
 
     // layer heatmap semi-transparent on top of the scene.
     if (RenderHeatmap) {
-      FragColor = mix(FragColor, heatmap(float(numLights)/NumLights), 0.7);
+      FragColor = mix(FragColor, heatmap(float(numLights)/listCapacity), 0.7);
     }
 }
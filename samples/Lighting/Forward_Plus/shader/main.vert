@@ -9,10 +9,15 @@
 layout (location = 0) in vec3 vPosition;    
 layout (location = 1) in vec3 vNormal;      
 layout (location = 2) in vec2 vTexCoord;    
+// material index of the draw, only set by merged models (ModelBatch)
+layout (location = 7) in uint vMaterial;
 
 out vec4 fWorldPosition;                    
 out vec3 fWorldNormal;                      
 out vec2 fTexCoord;                         
+flat out uint fMaterial;
+// the depth pre-pass uses this shader too, the main pass tests for equal depth
+invariant gl_Position;
 
 // ----------------------------------------------------------------------------
 //
@@ -35,5 +40,6 @@ void main() {
     fWorldPosition = ModelMatrix*vec4(vPosition, 1.0);
     fWorldNormal = normalize(NormalMatrix*vNormal);
     fTexCoord = vTexCoord;
+    fMaterial = vMaterial;
     gl_Position = ProjectionMatrix*ViewMatrix*fWorldPosition;
 }
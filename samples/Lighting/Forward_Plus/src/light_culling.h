@@ -0,0 +1,460 @@
+#ifndef LIGHT_CULLING_H
+#define LIGHT_CULLING_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "modules/job_pool.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define LIGHT_CULLING_AVX
+#endif
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define LIGHT_CULLING_SSE
+#endif
+
+struct PointLight {
+	// Memorylayout:
+	//
+	// position    radius
+	// |           |   color
+	// |           |   |
+	// v           v   v
+	// +---+---+---+---+---+---+---+---+
+	// | x | y | z | R | r | g | b | a |
+	// +---+---+---+---+---+---+---+---+
+	// 0   4   8   12  16  20  24  28  32 Byte
+	glm::vec3 position;
+	// this would need padding to align "color" correct.
+	// adding radius as float parm to fill the 16 bytes
+	// Vec4 has an alginmtn of 4*N, where N is the count of bytes (basic machine units)
+	// per component. Even if "position" fills only the bytes 0 to 11,
+	// "color" would begin at byte 16.
+	// The bytes 12 to 15 would be unused.
+	// The C-Compiler would not add this gap and tho the Memorylayout would be offseted.
+	// To avoid this problem radius will be added there.
+	// This way both the C-Compiler and the GLSL compiler would create the same memory layout.
+	float radius;
+	glm::vec4 color;
+};
+
+// depth bounds of the tiles/clusters from the depth pre-pass, has to match tile.comp
+enum DepthBounds {
+	DEPTH_BOUNDS_OFF = 0,		// no pre-pass, the tiles reach from the near to the far plane
+	DEPTH_BOUNDS_MIN_MAX = 1,	// pre-pass, tiles limited to the nearest and farthest pixel, clusters without pixels are empty
+	DEPTH_BOUNDS_MASK = 2		// additionally a mask of the depths between min and max (2.5D culling) for the tiles
+};
+
+/// <summary>
+/// CPU version of the light culling of tile.comp and cluster.comp, without any GL state.
+/// It writes the same buffers as the shaders, so it can check their results on machines without a
+/// GPU and replace them on software rendered contexts, where the compute shaders are slow.
+///	- setLights transforms the lights to viewspace once and stores them as structure of arrays
+///	  (one array per component, padded with lights that are never visible)
+///	- every tile (or column of clusters) tests 4 lights at a time with SSE or 8 with AVX against the
+///	  side planes of its frustum, the near plane and its depth range
+///	- the tiles run in parallel on a job pool, each one only writes its own part of the output
+/// The light lists are in ascending order, the shaders append in any order: compare them as sets.
+/// The light count of a tile is clamped to its capacity like in tile.comp.
+/// </summary>
+class LightCuller {
+public:
+	enum InstructionSet { SCALAR, SSE, AVX };
+
+	// bins of the depth mask, has to match tile.comp
+	static const unsigned int DEPTH_MASK_BINS = 32;
+	// tiles per job, the tiles of a job test all lights
+	static const unsigned int TILES_PER_JOB = 16;
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="LightCuller"/> class, with the widest instruction set available.
+	/// </summary>
+	LightCuller() : instructionSet(bestInstructionSet()) {}
+
+	static InstructionSet bestInstructionSet()
+	{
+#if defined(LIGHT_CULLING_AVX)
+		return AVX;
+#elif defined(LIGHT_CULLING_SSE)
+		return SSE;
+#else
+		return SCALAR;
+#endif
+	}
+
+	/// <summary>
+	/// Selects the instruction set of the light tests, limited to the ones compiled in.
+	/// </summary>
+	void setInstructionSet(InstructionSet set) { instructionSet = std::min(set, bestInstructionSet()); }
+	InstructionSet getInstructionSet() const { return instructionSet; }
+
+	/// <summary>
+	/// Transforms the lights to viewspace, they are culled until the next setLights.
+	/// </summary>
+	void setLights(const PointLight* lights, unsigned int count, const glm::mat4& view)
+	{
+		lightCount = count;
+		const unsigned int padded = (count + 7) & ~7u;
+		x.resize(padded); y.resize(padded); z.resize(padded); r.resize(padded);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			glm::vec4 position = view * glm::vec4(lights[i].position, 1.0f);
+			x[i] = position.x / position.w;
+			y[i] = position.y / position.w;
+			z[i] = position.z / position.w;
+			r[i] = lights[i].radius;
+		}
+		// the padding fails every plane test
+		for (unsigned int i = count; i < padded; i++)
+		{
+			x[i] = y[i] = z[i] = 0.0f;
+			r[i] = -FLT_MAX;
+		}
+	}
+
+	/// <summary>
+	/// Culls the lights per tile, same layout as VisibleLightIndicesBuffer of tile.comp:
+	/// for every tile (row by row) the number of lights followed by capacity light indices.
+	/// The entries behind the lights of a tile are left as they are, like in the buffer.
+	/// </summary>
+	/// <param name="depth">Window space depth of the pixels (bottom row first) for the depth bounds, nullptr without.</param>
+	/// <returns>The sum of the light counts of all tiles.</returns>
+	unsigned int cullTiles(const glm::mat4& projection, glm::ivec2 framebufferSize, int tileSize, unsigned int capacity,
+		std::vector<int>& visibleLightIndices, const float* depth = nullptr, int depthBounds = DEPTH_BOUNDS_OFF,
+		JobPool& pool = JobPool::instance()) const
+	{
+		const glm::ivec2 numTiles = (framebufferSize + tileSize - 1) / tileSize;
+		const unsigned int tileCount = numTiles.x * numTiles.y;
+		visibleLightIndices.resize((size_t)tileCount * (capacity + 1));
+		if (!depth)
+			depthBounds = DEPTH_BOUNDS_OFF;
+		const glm::mat4 inverseProjection = glm::inverse(projection);
+		const DepthLinearization linearization(inverseProjection);
+
+		std::vector<unsigned int> tileLights(tileCount);
+		pool.parallelFor(tileCount, TILES_PER_JOB, [&](size_t firstTile, size_t lastTile) {
+			// distances of the pixels of a tile, for min/max and the mask
+			std::vector<float> tileDepths;
+			for (size_t tile = firstTile; tile < lastTile; tile++)
+			{
+				const glm::ivec2 tilePosition((int)(tile % numTiles.x), (int)(tile / numTiles.x));
+				// tile.comp doesn't clamp the last tiles to the framebuffer
+				const glm::ivec2 tileMin = tilePosition * tileSize;
+				const glm::ivec2 tileMax = tileMin + tileSize;
+				Frustum frustum = tileFrustum(inverseProjection, framebufferSize, tileMin, tileMax);
+
+				// nearest and farthest pixel, without pixels no light passes
+				float minDepth = 0.0f, maxDepth = FLT_MAX;
+				uint32_t depthMask = 0;
+				if (depthBounds != DEPTH_BOUNDS_OFF)
+				{
+					const glm::ivec2 pixelMax = glm::min(tileMax, framebufferSize);
+					minDepth = FLT_MAX;
+					maxDepth = 0.0f;
+					tileDepths.clear();
+					for (int py = tileMin.y; py < pixelMax.y; py++)
+						for (int px = tileMin.x; px < pixelMax.x; px++)
+						{
+							float d = linearization.viewDepth(depth[(size_t)py * framebufferSize.x + px]);
+							if (d >= 0.0f)
+							{
+								minDepth = std::min(minDepth, d);
+								maxDepth = std::max(maxDepth, d);
+								tileDepths.push_back(d);
+							}
+						}
+					if (depthBounds == DEPTH_BOUNDS_MASK)
+						for (float d : tileDepths)
+							depthMask |= 1u << depthBin(d, minDepth, maxDepth);
+				}
+
+				int* list = &visibleLightIndices[tile * (capacity + 1)];
+				unsigned int count = 0;
+				forEachLight(frustum, minDepth, maxDepth, [&](unsigned int light) {
+					if (depthBounds == DEPTH_BOUNDS_MASK)
+					{
+						// same as tile.comp
+						int first = depthBin(-z[light] - r[light], minDepth, maxDepth);
+						int last = depthBin(-z[light] + r[light], minDepth, maxDepth);
+						uint32_t lightMask = (0xFFFFFFFFu >> (DEPTH_MASK_BINS - 1 - last)) & (0xFFFFFFFFu << first);
+						if ((lightMask & depthMask) == 0)
+							return;
+					}
+					if (count < capacity)
+						list[1 + count++] = (int)light;
+				});
+				list[0] = (int)count;
+				tileLights[tile] = count;
+			}
+		});
+
+		unsigned int total = 0;
+		for (unsigned int count : tileLights)
+			total += count;
+		return total;
+	}
+
+	/// <summary>
+	/// Culls the lights per cluster like cluster.comp: screen tiles of tileSize pixels cut into slices
+	/// exponential depth slices between clusterNear and clusterFar (the first slice starts at the camera).
+	/// grid holds (offset in indices, light count) per cluster, index (slice*numTiles.y + tile.y)*numTiles.x + tile.x.
+	/// The lists are packed in the order of the clusters, cluster.comp in the order of their atomic reservation.
+	/// </summary>
+	/// <param name="depth">Window space depth of the pixels (bottom row first), only the clusters containing pixels get lights, nullptr for all.</param>
+	/// <returns>The number of light indices.</returns>
+	unsigned int cullClusters(const glm::mat4& projection, glm::ivec2 framebufferSize, int tileSize, unsigned int slices,
+		float clusterNear, float clusterFar, unsigned int capacity, std::vector<glm::uvec2>& grid, std::vector<unsigned int>& indices,
+		const float* depth = nullptr, JobPool& pool = JobPool::instance()) const
+	{
+		const glm::ivec2 numTiles = (framebufferSize + tileSize - 1) / tileSize;
+		const unsigned int tileCount = numTiles.x * numTiles.y;
+		const glm::mat4 inverseProjection = glm::inverse(projection);
+		const DepthLinearization linearization(inverseProjection);
+		slices = std::min(slices, 32u);
+		// borders of the slices, a pixel is assigned by a search instead of a logarithm
+		std::vector<float> sliceBorders(slices + 1);
+		for (unsigned int slice = 0; slice <= slices; slice++)
+			sliceBorders[slice] = sliceDepth(slice, slices, clusterNear, clusterFar);
+		grid.resize((size_t)tileCount * slices);
+		// the lists of a column are collected at a fixed place, then packed
+		columnLights.resize((size_t)tileCount * slices * capacity);
+
+		pool.parallelFor(tileCount, 1, [&](size_t firstTile, size_t lastTile) {
+			std::vector<unsigned int> candidates;
+			for (size_t tile = firstTile; tile < lastTile; tile++)
+			{
+				const glm::ivec2 tilePosition((int)(tile % numTiles.x), (int)(tile / numTiles.x));
+				const glm::ivec2 tileMin = tilePosition * tileSize;
+				const glm::ivec2 tileMax = glm::min(tileMin + tileSize, framebufferSize);
+				Frustum frustum = tileFrustum(inverseProjection, framebufferSize, tileMin, tileMax);
+
+				// slices containing pixels of the tile
+				uint32_t occupied = 0xFFFFFFFFu;
+				if (depth)
+				{
+					occupied = 0;
+					for (int py = tileMin.y; py < tileMax.y; py++)
+						for (int px = tileMin.x; px < tileMax.x; px++)
+						{
+							float d = linearization.viewDepth(depth[(size_t)py * framebufferSize.x + px]);
+							if (d >= 0.0f)
+							{
+								// first border behind the pixel, the pixels behind the last slice are in the last one
+								size_t slice = std::upper_bound(sliceBorders.begin() + 1, sliceBorders.end() - 1, d) - (sliceBorders.begin() + 1);
+								occupied |= 1u << slice;
+							}
+						}
+				}
+
+				// lights touching the frustum of the tile, then the box of every slice
+				candidates.clear();
+				if (occupied != 0)
+					forEachLight(frustum, 0.0f, FLT_MAX, [&](unsigned int light) { candidates.push_back(light); });
+
+				for (unsigned int slice = 0; slice < slices; slice++)
+				{
+					unsigned int* list = &columnLights[((size_t)tile * slices + slice) * capacity];
+					unsigned int count = 0;
+					if (occupied & (1u << slice))
+					{
+						const float zNear = sliceDepth(slice, slices, clusterNear, clusterFar);
+						const float zFar = sliceDepth(slice + 1, slices, clusterNear, clusterFar);
+						glm::vec3 boxMin(FLT_MAX), boxMax(-FLT_MAX);
+						for (int i = 0; i < 4; i++)
+						{
+							boxMin = glm::min(boxMin, glm::min(frustum.corners[i] * zNear, frustum.corners[i] * zFar));
+							boxMax = glm::max(boxMax, glm::max(frustum.corners[i] * zNear, frustum.corners[i] * zFar));
+						}
+						for (unsigned int light : candidates)
+						{
+							if (count == capacity)
+								break;
+							glm::vec3 center(x[light], y[light], z[light]);
+							glm::vec3 d = center - glm::clamp(center, boxMin, boxMax);
+							if (glm::dot(d, d) <= r[light] * r[light])
+								list[count++] = light;
+						}
+					}
+					grid[((size_t)slice * numTiles.y + tilePosition.y) * numTiles.x + tilePosition.x] = glm::uvec2(0, count);
+				}
+			}
+		});
+
+		// offsets of the lists in the order of the clusters
+		unsigned int total = 0;
+		for (glm::uvec2& cluster : grid)
+		{
+			cluster.x = total;
+			total += cluster.y;
+		}
+		indices.resize(total);
+		pool.parallelFor(tileCount, TILES_PER_JOB, [&](size_t firstTile, size_t lastTile) {
+			for (size_t tile = firstTile; tile < lastTile; tile++)
+			{
+				const glm::ivec2 tilePosition((int)(tile % numTiles.x), (int)(tile / numTiles.x));
+				for (unsigned int slice = 0; slice < slices; slice++)
+				{
+					const glm::uvec2 cluster = grid[((size_t)slice * numTiles.y + tilePosition.y) * numTiles.x + tilePosition.x];
+					std::copy_n(&columnLights[((size_t)tile * slices + slice) * capacity], cluster.y, indices.begin() + cluster.x);
+				}
+			}
+		});
+		return total;
+	}
+
+private:
+	// side planes of the frustum of a tile in viewspace, through the camera, the normals point inside
+	struct Frustum {
+		glm::vec3 normals[4];
+		glm::vec3 corners[4];	// rays through the corners of the tile, at depth 1
+	};
+
+	InstructionSet instructionSet;
+	unsigned int lightCount = 0;
+	// lights in viewspace, padded to a multiple of 8
+	std::vector<float> x, y, z, r;
+	mutable std::vector<unsigned int> columnLights;
+
+	static Frustum tileFrustum(const glm::mat4& inverseProjection, glm::ivec2 framebufferSize, glm::ivec2 tileMin, glm::ivec2 tileMax)
+	{
+		const glm::vec2 ndcMin = 2.0f * glm::vec2(tileMin) / glm::vec2(framebufferSize) - 1.0f;
+		const glm::vec2 ndcMax = 2.0f * glm::vec2(tileMax) / glm::vec2(framebufferSize) - 1.0f;
+		const glm::vec2 ndc[4] = { ndcMin, glm::vec2(ndcMax.x, ndcMin.y), ndcMax, glm::vec2(ndcMin.x, ndcMax.y) };
+
+		Frustum frustum;
+		glm::vec3 center(0.0f);
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec4 corner = inverseProjection * glm::vec4(ndc[i], -1.0f, 1.0f);
+			frustum.corners[i] = glm::vec3(corner) / corner.w;
+			frustum.corners[i] /= -frustum.corners[i].z;
+			center += frustum.corners[i];
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			glm::vec3 normal = glm::normalize(glm::cross(frustum.corners[i], frustum.corners[(i + 1) % 4]));
+			frustum.normals[i] = glm::dot(normal, center) < 0.0f ? -normal : normal;
+		}
+		return frustum;
+	}
+
+	// the z and w row of the inverse projection, applied to (0, 0, ndc depth, 1)
+	struct DepthLinearization {
+		float z0, z1, w0, w1;
+
+		explicit DepthLinearization(const glm::mat4& inverseProjection)
+			: z0(inverseProjection[3][2]), z1(inverseProjection[2][2]), w0(inverseProjection[3][3]), w1(inverseProjection[2][3]) {}
+
+		// distance of a pixel of the depth buffer to the camera, negative for the background
+		float viewDepth(float depth) const
+		{
+			if (depth == 1.0f)
+				return -1.0f;
+			float ndc = 2.0f * depth - 1.0f;
+			return -(z1 * ndc + z0) / (w1 * ndc + w0);
+		}
+	};
+
+	static int depthBin(float depth, float minDepth, float maxDepth)
+	{
+		float range = std::max(maxDepth - minDepth, 1e-6f);
+		return std::min(std::max((int)((depth - minDepth) / range * DEPTH_MASK_BINS), 0), (int)DEPTH_MASK_BINS - 1);
+	}
+
+	static float sliceDepth(unsigned int slice, unsigned int slices, float clusterNear, float clusterFar)
+	{
+		if (slice == 0)
+			return 0.0f;
+		return clusterNear * std::pow(clusterFar / clusterNear, (float)slice / slices);
+	}
+
+	/// <summary>
+	/// Calls visit(light) in ascending order for the lights in front of the camera, inside the depth range
+	/// [minDepth, maxDepth] and not outside of a side plane of the frustum.
+	/// </summary>
+	template<typename Visit>
+	void forEachLight(const Frustum& frustum, float minDepth, float maxDepth, Visit visit) const
+	{
+		const unsigned int padded = (unsigned int)r.size();
+		unsigned int i = 0;
+#ifdef LIGHT_CULLING_AVX
+		if (instructionSet == AVX)
+		{
+			const __m256 zero = _mm256_setzero_ps();
+			const __m256 nearest = _mm256_set1_ps(minDepth), farthest = _mm256_set1_ps(maxDepth);
+			__m256 nx[4], ny[4], nz[4];
+			for (int p = 0; p < 4; p++)
+			{
+				nx[p] = _mm256_set1_ps(frustum.normals[p].x);
+				ny[p] = _mm256_set1_ps(frustum.normals[p].y);
+				nz[p] = _mm256_set1_ps(frustum.normals[p].z);
+			}
+			for (; i < padded; i += 8)
+			{
+				const __m256 px = _mm256_loadu_ps(&x[i]), py = _mm256_loadu_ps(&y[i]), pz = _mm256_loadu_ps(&z[i]), pr = _mm256_loadu_ps(&r[i]);
+				// distance to the camera, the sphere has to reach into [minDepth, maxDepth]
+				const __m256 distance = _mm256_sub_ps(zero, pz);
+				__m256 inside = _mm256_and_ps(_mm256_cmp_ps(_mm256_add_ps(distance, pr), nearest, _CMP_GE_OQ),
+					_mm256_cmp_ps(_mm256_sub_ps(distance, pr), farthest, _CMP_LE_OQ));
+				for (int p = 0; p < 4; p++)
+				{
+					__m256 d = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx[p], px), _mm256_mul_ps(ny[p], py)), _mm256_mul_ps(nz[p], pz)), pr);
+					inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, zero, _CMP_GE_OQ));
+				}
+				for (unsigned int mask = (unsigned int)_mm256_movemask_ps(inside), lane = 0; mask != 0; mask >>= 1, lane++)
+					if (mask & 1)
+						visit(i + lane);
+			}
+		}
+#endif
+#ifdef LIGHT_CULLING_SSE
+		if (instructionSet != SCALAR)
+		{
+			const __m128 zero = _mm_setzero_ps();
+			const __m128 nearest = _mm_set1_ps(minDepth), farthest = _mm_set1_ps(maxDepth);
+			__m128 nx[4], ny[4], nz[4];
+			for (int p = 0; p < 4; p++)
+			{
+				nx[p] = _mm_set1_ps(frustum.normals[p].x);
+				ny[p] = _mm_set1_ps(frustum.normals[p].y);
+				nz[p] = _mm_set1_ps(frustum.normals[p].z);
+			}
+			for (; i < padded; i += 4)
+			{
+				const __m128 px = _mm_loadu_ps(&x[i]), py = _mm_loadu_ps(&y[i]), pz = _mm_loadu_ps(&z[i]), pr = _mm_loadu_ps(&r[i]);
+				const __m128 distance = _mm_sub_ps(zero, pz);
+				__m128 inside = _mm_and_ps(_mm_cmpge_ps(_mm_add_ps(distance, pr), nearest), _mm_cmple_ps(_mm_sub_ps(distance, pr), farthest));
+				for (int p = 0; p < 4; p++)
+				{
+					__m128 d = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(nx[p], px), _mm_mul_ps(ny[p], py)), _mm_mul_ps(nz[p], pz)), pr);
+					inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+				}
+				for (unsigned int mask = (unsigned int)_mm_movemask_ps(inside), lane = 0; mask != 0; mask >>= 1, lane++)
+					if (mask & 1)
+						visit(i + lane);
+			}
+		}
+#endif
+		// same arithmetic as the SIMD paths, so all of them give the same results
+		for (; i < lightCount; i++)
+		{
+			const float distance = 0.0f - z[i];
+			bool inside = distance + r[i] >= minDepth && distance - r[i] <= maxDepth;
+			for (int p = 0; p < 4; p++)
+			{
+				const glm::vec3& n = frustum.normals[p];
+				inside &= n.x * x[i] + n.y * y[i] + n.z * z[i] + r[i] >= 0.0f;
+			}
+			if (inside)
+				visit(i);
+		}
+	}
+};
+
+#endif // !LIGHT_CULLING_H
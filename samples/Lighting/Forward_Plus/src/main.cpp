@@ -19,7 +19,13 @@
 #include "modules/model.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
+#include "modules/render_queue.h"
 
+#include "light_culling.h"
+
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #define randFloat() (float)rand() / (float)RAND_MAX
@@ -36,6 +42,9 @@ void renderSphere();
 
 // helper functions
 void repareTilesMemory(int width, int height);
+void prepareClustersMemory(int width, int height);
+void createLights(GLuint lightsBuffer, unsigned int count);
+void prepareSceneFramebuffer(int width, int height);
 
 // settings
 const unsigned int SCR_WIDTH = 1920;
@@ -44,10 +53,44 @@ const unsigned int SCR_HEIGHT = 1080;
 // allocate enough storage for debug buffer
 const unsigned int DEBUG_POSITIONS_BUFFER_SIZE = 5000000;
 const unsigned int TILE_SIZE = 16;
-
-const unsigned int NR_LIGHTS = 100;
+// capacity of the light list of a tile, the tile buffer grows with the number of lights up to this
+const unsigned int MAX_LIGHTS_PER_TILE = 1024;
+
+// clusters: screen tiles of CLUSTER_TILE_SIZE pixels, cut into CLUSTER_SLICES exponential depth slices
+const unsigned int CLUSTER_TILE_SIZE = 64;
+const unsigned int CLUSTER_SLICES = 32;				// has to match cluster.comp
+const unsigned int MAX_LIGHTS_PER_CLUSTER = 128;	// has to match cluster.comp
+// light indices in the pool per cluster on average
+const unsigned int CLUSTER_INDICES_PER_CLUSTER = 64;
+
+const float NEAR_PLANE = 0.001f;
+const float FAR_PLANE = 100.0f;
+// border of the first depth slice, the slices in front of it would be too thin
+const float CLUSTER_NEAR = 0.1f;
+
+// capacity of the lights buffer
+const unsigned int MAX_LIGHTS = 16384;
+// up/down doubles/halves the number of lights
+unsigned int numLights = 1024;
 
 GLuint visibleLightsBuffer = NULL;
+GLuint clusterGridBuffer = 0;
+GLuint clusterLightIndicesBuffer = 0;
+GLuint clusterCounterBuffer = 0;
+unsigned int clusterIndexCapacity = 0;
+GLuint tileStatsBuffer = 0;
+
+// the depth pre-pass renders the scene into this framebuffer, its depth texture is read by the culling
+GLuint sceneFramebuffer = 0;
+GLuint sceneColorRenderbuffer = 0;
+GLuint sceneDepthTexture = 0;
+// texture unit of the depth texture in the culling shaders, above the units of the materials
+const unsigned int DEPTH_TEXTURE_UNIT = 8;
+
+const char* DEPTH_BOUNDS_NAMES[] = { "off", "min/max", "min/max + mask" };
+
+// CPU copy of the lights, for the culling on the CPU (LightCuller)
+std::vector<PointLight> lights;
 
 int framebufferWidth = SCR_WIDTH;
 int framebufferHeight = SCR_HEIGHT;
@@ -66,42 +109,31 @@ bool m_pressed = false;
 bool t_pressed = false;
 bool l_pressed = false;
 bool u_pressed = false;
+bool b_pressed = false;
+bool c_pressed = false;
+bool up_pressed = false;
+bool down_pressed = false;
+bool p_pressed = false;
+bool g_pressed = false;
+bool v_pressed = false;
 
 bool wireframe = false;		// render wireframe flag
 bool heatmapVis = false;	// render heatmap over the scene
 bool tileVis = false;		// render tiles as grid (renderGrid)
 bool lightVis = false;		// render light sources as spheres
 bool updateGrid = true;		// if tile-grid has to be recalculated per frame
+bool batchDraw = false;		// draw the model merged into one multi draw indirect (ModelBatch)
+bool clustered = true;		// cull the lights per cluster (cluster.comp) instead of per tile (tile.comp)
+bool lightsChanged = false;	// number of lights changed, recreate lights and tile buffer
+int depthBounds = DEPTH_BOUNDS_OFF;	// depth pre-pass and depth bounds of the culling (DepthBounds)
+bool cpuCulling = false;	// cull the lights on the CPU (LightCuller) and upload the lists
+bool checkCulling = false;	// compare the lists of the compute shaders to the ones of the CPU once
 
 
 // timing 
 float deltaTime = 0.0f; // time between current frame and last frame
 float lastFrame = 0.0f; // time of last frame
 
-struct PointLight {
-	// Memorylayout:
-	//
-	// position    radius
-	// |           |   color
-	// |           |   |
-	// v           v   v
-	// +---+---+---+---+---+---+---+---+
-	// | x | y | z | R | r | g | b | a |
-	// +---+---+---+---+---+---+---+---+
-	// 0   4   8   12  16  20  24  28  32 Byte
-	glm::vec3 position;
-	// this would need padding to align "color" correct.
-	// adding radius as float parm to fill the 16 bytes
-	// Vec4 has an alginmtn of 4*N, where N is the count of bytes (basic machine units)
-	// per component. Even if "position" fills only the bytes 0 to 11,
-	// "color" would begin at byte 16.
-	// The bytes 12 to 15 would be unused. 
-	// The C-Compiler would not add this gap and tho the Memorylayout would be offseted.
-	// To avoid this problem radius will be added there.
-	// This way both the C-Compiler and the GLSL compiler would create the same memory layout.
-	float radius;
-	glm::vec4 color;
-};
 
 
 int main()
@@ -147,9 +179,18 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	std::cout << "OpenGL-Version: " << glGetString(GL_VERSION) << std::endl;
 
+	// compute shaders are slow on software rasterizers, the lights are culled on the CPU there
+	std::string renderer = (const char*)glGetString(GL_RENDERER);
+	if (renderer.find("llvmpipe") != std::string::npos || renderer.find("softpipe") != std::string::npos
+		|| renderer.find("SwiftShader") != std::string::npos || renderer.find("Software") != std::string::npos) {
+		cpuCulling = true;
+		std::cout << "Software renderer " << renderer << ", culling the lights on the CPU" << std::endl;
+	}
+
 	icon(window);
 
 	// configure global opengl state
@@ -174,12 +215,35 @@ int main()
 	Shader colorProgram(FileSystem::getSamplePath("shader/color.vert").c_str(), FileSystem::getSamplePath("shader/color.frag").c_str());
 	Shader uniformColorProgram(FileSystem::getSamplePath("shader/uniformcolor.vert").c_str(), FileSystem::getSamplePath("shader/uniformcolor.frag").c_str());
 	Shader tileProgram(FileSystem::getSamplePath("shader/tile.comp").c_str());
+	Shader clusterProgram(FileSystem::getSamplePath("shader/cluster.comp").c_str());
+	Shader depthProgram(FileSystem::getSamplePath("shader/main.vert").c_str(), FileSystem::getSamplePath("shader/depth.frag").c_str());
+	// main program for the merged model with bindless textures, compiled when the model is merged
+	Shader bindlessProgram;
+	Shader depthBindlessProgram;
 
 	// load models
 	// -----------
 	std::cout << "Loading Model" << std::endl;
-	Model object(FileSystem::getPath("content/models/sponza_crytek/sponza.obj").c_str());
+	// textures are streamed in while the first frames are rendered,
+	// main.vert only reads position, normal & texCoords so the compact vertex layout is sufficient
+	Model object(FileSystem::getPath("content/models/sponza_crytek/sponza.obj").c_str(), false, true, VERTEX_FORMAT_COMPACT);
 	std::cout << "Finished Model Loading" << std::endl;
+	// the meshes are drawn sorted by material and front-to-back
+	RenderQueue renderQueue("ModelMatrix", "NormalMatrix");
+
+	// culling on the CPU and its results
+	LightCuller lightCuller;
+	std::vector<float> depthPixels;
+	// the depth is read back through two pixel pack buffers, the CPU culling uses the depth of the previous frame
+	// so glReadPixels doesn't wait for the pre-pass (a fast camera may miss a light at a depth edge for a frame)
+	GLuint depthReadBuffers[2];
+	glGenBuffers(2, depthReadBuffers);
+	size_t depthReadPixels = 0;		// size of the pixel pack buffers
+	int depthReadFrames = 0;		// frames read back since the buffers were (re)allocated
+	double cpuCullingTime = 0.0;	// time of the CPU culling in the last frame, without the read back
+	std::vector<int> cpuTileLights;
+	std::vector<glm::uvec2> cpuClusterGrid;
+	std::vector<unsigned int> cpuClusterLights;
 
 	// set up buffers
 	// --------------
@@ -215,25 +279,21 @@ int main()
 	
 	// lighting info
 	// -------------
-	std::vector<PointLight> lights;
-	for (unsigned int i = 0; i < NR_LIGHTS; i++)
-	{
-		// calculate slightly random offsets
-		PointLight light;
-		light.position = glm::vec3(5 * (2 * randFloat() - 1), 5 * randFloat(), 3 * (2 * randFloat() - 1));
-		light.radius = 1.5f + 1.5f * randFloat();
-		light.color = glm::vec4(randFloat(), randFloat(), randFloat(), 1.0f);
-		
-		lights.push_back(light);
-	}
-
 	// set up buffer to store lights
 	GLuint lightsBuffer;
 	glGenBuffers(1, &lightsBuffer);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lightsBuffer);
-	glBufferData(GL_SHADER_STORAGE_BUFFER, NR_LIGHTS * sizeof(PointLight), lights.data(), GL_STATIC_DRAW);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, MAX_LIGHTS * sizeof(PointLight), NULL, GL_STATIC_DRAW);
+	createLights(lightsBuffer, numLights);
 
 	repareTilesMemory(SCR_WIDTH, SCR_HEIGHT);
+	prepareClustersMemory(SCR_WIDTH, SCR_HEIGHT);
+	prepareSceneFramebuffer(SCR_WIDTH, SCR_HEIGHT);
+
+	// sum of the lights of all tiles, for statistics
+	glGenBuffers(1, &tileStatsBuffer);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 7, tileStatsBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_READ);
 
 	// shader configuration
 	// --------------------
@@ -246,6 +306,13 @@ int main()
 	// get dummy time for timerQuery[1]
 	glBeginQuery(GL_TIME_ELAPSED, timerQuery[1]);
 	glEndQuery(GL_TIME_ELAPSED);
+
+	// timestamps of the passes, begin & end of the depth pre-pass and the main pass
+	// (time elapsed queries can't be nested in the one of the frame)
+	GLuint passQueries[2][4];
+	glGenQueries(8, &passQueries[0][0]);
+	for (int i = 0; i < 4; i++)
+		glQueryCounter(passQueries[1][i], GL_TIMESTAMP);
 	
 	static int frameIndex = 0;
 
@@ -261,9 +328,23 @@ int main()
 		// Check and call events
 		processInput(window);
 
+		// upload textures decoded since the last frame
+		TextureLoader::instance().update();
+
+		if (lightsChanged)
+		{
+			createLights(lightsBuffer, numLights);
+			repareTilesMemory(framebufferWidth, framebufferHeight);
+			lightsChanged = false;
+		}
+
 		// begin timer
 		glBeginQuery(GL_TIME_ELAPSED, timerQuery[frameIndex % 2]);
 
+		// with the pre-pass the depth has to be readable, the scene is rendered into a texture and copied to the screen
+		if (depthBounds != DEPTH_BOUNDS_OFF)
+			glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+
 		// clear Framebuffer
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 		// select either wireframe or shaded
@@ -272,29 +353,238 @@ int main()
 		// calulate amount of tiles based on framebuffer size
 		int numTilesX = (framebufferWidth + (TILE_SIZE - 1)) / TILE_SIZE;
 		int numTilesY = (framebufferHeight + (TILE_SIZE - 1)) / TILE_SIZE;
+		int numClustersX = (framebufferWidth + (CLUSTER_TILE_SIZE - 1)) / CLUSTER_TILE_SIZE;
+		int numClustersY = (framebufferHeight + (CLUSTER_TILE_SIZE - 1)) / CLUSTER_TILE_SIZE;
 
 		// calc projectiong & view matrix
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.001f, 100.0f);
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, NEAR_PLANE, FAR_PLANE);
 		glm::mat4 view = camera.GetViewMatrix();
 		// identity model matrix
 		glm::mat4 identityMatrix(1.0);
 
+		glm::mat4 model(1.0f);
+		model = glm::scale(model, glm::vec3(0.005f));
+		if (batchDraw && !object.batch)
+		{
+			// merged on first use, bindless textures have to wait for the streamed textures
+			object.Merge();
+			if (object.batch->isBindless())
+			{
+				bindlessProgram = Shader(FileSystem::getSamplePath("shader/main.vert").c_str(), FileSystem::getSamplePath("shader/main_bindless.frag").c_str());
+				depthBindlessProgram = Shader(FileSystem::getSamplePath("shader/main.vert").c_str(), FileSystem::getSamplePath("shader/depth_bindless.frag").c_str());
+			}
+		}
+		bool bindless = batchDraw && object.batch->isBindless();
+		// skip the meshes outside of the view frustum, for the pre-pass and the main pass
+		unsigned int visibleMeshes = object.Cull(projection * view, model);
+
+		// ----------------------------------------------------------------------------
+		// Depth Pre-Pass
+		// ----------------------------------------------------------------------------
+
+		glQueryCounter(passQueries[frameIndex % 2][0], GL_TIMESTAMP);
+		if (depthBounds != DEPTH_BOUNDS_OFF) {
+			Shader& prepassProgram = bindless ? depthBindlessProgram : depthProgram;
+			prepassProgram.use();
+			prepassProgram.setMat4("ViewMatrix", view);
+			prepassProgram.setMat4("ProjectionMatrix", projection);
+
+			glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+			if (batchDraw)
+			{
+				prepassProgram.setMat4("ModelMatrix", model);
+				prepassProgram.setMat3("NormalMatrix", glm::inverseTranspose(glm::mat3(model)));
+				object.Draw(prepassProgram);
+			}
+			else
+			{
+				renderQueue.begin(view);
+				object.Submit(renderQueue, prepassProgram, model);
+				renderQueue.flush();
+			}
+			glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+			// the culling reads the depth texture
+			glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+			glActiveTexture(GL_TEXTURE0 + DEPTH_TEXTURE_UNIT);
+			glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		glQueryCounter(passQueries[frameIndex % 2][1], GL_TIMESTAMP);
+
 		// ----------------------------------------------------------------------------
 		// Light Culling
 		// ----------------------------------------------------------------------------
 
-		glm::mat4 invViewProjMat = glm::inverse(projection * view);
-		tileProgram.use();
+		// the merged model binds its materials to binding 2
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, debugPositions);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, debugColors);
 
-		// set shader parms
-		tileProgram.setMat4("InverseViewProjectionMatrix", invViewProjMat);
-		tileProgram.setMat4("ViewMatrix", view);
-		tileProgram.setInt2("FramebufferSize", framebufferWidth, framebufferHeight);
-		tileProgram.setInt2("TileSize", TILE_SIZE, TILE_SIZE);
-		tileProgram.setBool("UpdateGrid", updateGrid);
+		glm::mat4 inverseProjection = glm::inverse(projection);
+		unsigned int tileCapacity = std::min(numLights, MAX_LIGHTS_PER_TILE);
 
-		// run compute shader
-		glDispatchCompute(numTilesX, numTilesY, 1);
+		// the tiles are culled while the grid is shown as well, it visualizes them (only the compute shader writes the grid)
+		bool cullTiles = !clustered || (tileVis && !cpuCulling);
+		bool gridUpdated = false;
+
+		// the check compares the lists of the compute shaders, there are none while the CPU culls
+		if (checkCulling && cpuCulling) {
+			std::cout << "Culling check needs the GPU culling (G)" << std::endl;
+			checkCulling = false;
+		}
+
+		bool haveDepth = false;
+		if (cpuCulling || checkCulling) {
+			// depth of the pre-pass, bottom row first
+			size_t pixels = (size_t)framebufferWidth * framebufferHeight;
+			if (depthBounds != DEPTH_BOUNDS_OFF && checkCulling) {
+				// the check compares with the lists of this frame, it waits for the depth once
+				depthPixels.resize(pixels);
+				glReadPixels(0, 0, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT, GL_FLOAT, depthPixels.data());
+				haveDepth = true;
+				depthReadFrames = 0;
+			}
+			else if (depthBounds != DEPTH_BOUNDS_OFF) {
+				if (depthReadPixels != pixels) {
+					for (GLuint buffer : depthReadBuffers) {
+						glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+						glBufferData(GL_PIXEL_PACK_BUFFER, pixels * sizeof(float), NULL, GL_STREAM_READ);
+					}
+					depthReadPixels = pixels;
+					depthReadFrames = 0;
+				}
+				// start the read back of this frame, fetch the one of the previous frame
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, depthReadBuffers[frameIndex % 2]);
+				glReadPixels(0, 0, framebufferWidth, framebufferHeight, GL_DEPTH_COMPONENT, GL_FLOAT, 0);
+				if (depthReadFrames > 0) {
+					glBindBuffer(GL_PIXEL_PACK_BUFFER, depthReadBuffers[(frameIndex + 1) % 2]);
+					const float* previous = (const float*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, pixels * sizeof(float), GL_MAP_READ_BIT);
+					if (previous) {
+						depthPixels.assign(previous, previous + pixels);
+						glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+						haveDepth = true;
+					}
+				}
+				glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+				depthReadFrames++;
+			}
+			lightCuller.setLights(lights.data(), numLights, view);
+		}
+		// the depth of the previous frame is stale once the pre-pass was off
+		if (!cpuCulling || depthBounds == DEPTH_BOUNDS_OFF)
+			depthReadFrames = 0;
+		// without a depth (first frame of the read back) the lists are culled against the whole frustum
+		const float* cullingDepth = haveDepth ? depthPixels.data() : nullptr;
+
+		if (cpuCulling) {
+			double cullingStart = glfwGetTime();
+			// same buffers as the compute shaders
+			if (cullTiles) {
+				GLuint tileLights = lightCuller.cullTiles(projection, glm::ivec2(framebufferWidth, framebufferHeight), TILE_SIZE, tileCapacity,
+					cpuTileLights, cullingDepth, depthBounds);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleLightsBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cpuTileLights.size() * sizeof(GLint), cpuTileLights.data());
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileStatsBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &tileLights);
+			}
+			if (clustered) {
+				GLuint usedIndices = lightCuller.cullClusters(projection, glm::ivec2(framebufferWidth, framebufferHeight), CLUSTER_TILE_SIZE, CLUSTER_SLICES,
+					CLUSTER_NEAR, FAR_PLANE, MAX_LIGHTS_PER_CLUSTER, cpuClusterGrid, cpuClusterLights, cullingDepth);
+				// the lists beyond the pool are dropped like in cluster.comp
+				for (glm::uvec2& cluster : cpuClusterGrid)
+					cluster.y = cluster.x >= clusterIndexCapacity ? 0 : std::min(cluster.y, clusterIndexCapacity - cluster.x);
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterGridBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, cpuClusterGrid.size() * sizeof(glm::uvec2), cpuClusterGrid.data());
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterLightIndicesBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, std::min(usedIndices, clusterIndexCapacity) * sizeof(GLuint), cpuClusterLights.data());
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterCounterBuffer);
+				glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &usedIndices);
+			}
+			cpuCullingTime = glfwGetTime() - cullingStart;
+		}
+		else {
+			if (cullTiles) {
+				glm::mat4 invViewProjMat = glm::inverse(projection * view);
+				tileProgram.use();
+
+				// set shader parms
+				tileProgram.setMat4("InverseViewProjectionMatrix", invViewProjMat);
+				tileProgram.setMat4("ViewMatrix", view);
+				tileProgram.setInt2("FramebufferSize", framebufferWidth, framebufferHeight);
+				tileProgram.setInt2("TileSize", TILE_SIZE, TILE_SIZE);
+				tileProgram.setBool("UpdateGrid", updateGrid);
+				tileProgram.setInt("NumLights", numLights);
+				tileProgram.setInt("TileCapacity", tileCapacity);
+				tileProgram.setMat4("InverseProjectionMatrix", inverseProjection);
+				tileProgram.setInt("DepthBounds", depthBounds);
+				tileProgram.setInt("DepthMap", DEPTH_TEXTURE_UNIT);
+
+				GLuint zero = 0;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileStatsBuffer);
+				glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+				// run compute shader
+				glDispatchCompute(numTilesX, numTilesY, 1);
+				gridUpdated = true;
+			}
+
+			if (clustered) {
+				// the lists are reserved from the start of the pool every frame
+				GLuint zero = 0;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterCounterBuffer);
+				glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+				clusterProgram.use();
+				clusterProgram.setMat4("InverseProjectionMatrix", inverseProjection);
+				clusterProgram.setMat4("ViewMatrix", view);
+				clusterProgram.setInt2("FramebufferSize", framebufferWidth, framebufferHeight);
+				clusterProgram.setInt2("TileSize", CLUSTER_TILE_SIZE, CLUSTER_TILE_SIZE);
+				clusterProgram.setInt("NumLights", numLights);
+				clusterProgram.setFloat("ClusterNear", CLUSTER_NEAR);
+				clusterProgram.setFloat("ClusterFar", FAR_PLANE);
+				clusterProgram.setInt("IndexCapacity", clusterIndexCapacity);
+				clusterProgram.setBool("DepthBounds", depthBounds != DEPTH_BOUNDS_OFF);
+				clusterProgram.setInt("DepthMap", DEPTH_TEXTURE_UNIT);
+
+				// a work group per screen tile, an invocation per depth slice
+				glDispatchCompute(numClustersX, numClustersY, 1);
+			}
+
+			// compare the lists of the compute shaders to the ones of the CPU as sets, the shaders append in any order
+			if (checkCulling) {
+				glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+				if (cullTiles) {
+					lightCuller.cullTiles(projection, glm::ivec2(framebufferWidth, framebufferHeight), TILE_SIZE, tileCapacity, cpuTileLights, cullingDepth, depthBounds);
+					std::vector<GLint> gpuTileLights(cpuTileLights.size());
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleLightsBuffer);
+					glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuTileLights.size() * sizeof(GLint), gpuTileLights.data());
+					unsigned int differentTiles = 0;
+					for (size_t tile = 0; tile < cpuTileLights.size(); tile += tileCapacity + 1) {
+						std::sort(gpuTileLights.begin() + tile + 1, gpuTileLights.begin() + tile + 1 + gpuTileLights[tile]);
+						differentTiles += !std::equal(cpuTileLights.begin() + tile, cpuTileLights.begin() + tile + 1 + cpuTileLights[tile], gpuTileLights.begin() + tile);
+					}
+					std::cout << "Culling check tiles: " << differentTiles << " of " << numTilesX * numTilesY << " tiles differ from the CPU" << std::endl;
+				}
+				if (clustered) {
+					lightCuller.cullClusters(projection, glm::ivec2(framebufferWidth, framebufferHeight), CLUSTER_TILE_SIZE, CLUSTER_SLICES,
+						CLUSTER_NEAR, FAR_PLANE, MAX_LIGHTS_PER_CLUSTER, cpuClusterGrid, cpuClusterLights, cullingDepth);
+					std::vector<glm::uvec2> gpuClusterGrid(cpuClusterGrid.size());
+					std::vector<GLuint> gpuClusterLights(clusterIndexCapacity);
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterGridBuffer);
+					glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuClusterGrid.size() * sizeof(glm::uvec2), gpuClusterGrid.data());
+					glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterLightIndicesBuffer);
+					glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, gpuClusterLights.size() * sizeof(GLuint), gpuClusterLights.data());
+					unsigned int differentClusters = 0;
+					for (size_t cluster = 0; cluster < cpuClusterGrid.size(); cluster++) {
+						glm::uvec2 cpu = cpuClusterGrid[cluster], gpu = gpuClusterGrid[cluster];
+						std::sort(gpuClusterLights.begin() + gpu.x, gpuClusterLights.begin() + gpu.x + gpu.y);
+						differentClusters += cpu.y != gpu.y || !std::equal(cpuClusterLights.begin() + cpu.x, cpuClusterLights.begin() + cpu.x + cpu.y, gpuClusterLights.begin() + gpu.x);
+					}
+					std::cout << "Culling check clusters: " << differentClusters << " of " << cpuClusterGrid.size() << " clusters differ from the CPU" << std::endl;
+				}
+				checkCulling = false;
+			}
+		}
 
 		// ----------------------------------------------------------------------------
 		// Grid Rendering
@@ -302,7 +592,7 @@ int main()
 
 		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
 
-		if (tileVis) {
+		if (tileVis && !cpuCulling) {
 
 			colorProgram.use();
 			colorProgram.setMat4("ModelMatrix", identityMatrix);
@@ -328,7 +618,7 @@ int main()
 
 			PointLight* lightsPointer = (PointLight*) glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
 
-			for (int lightIndex = 0; lightIndex < NR_LIGHTS; ++lightIndex) {
+			for (unsigned int lightIndex = 0; lightIndex < numLights; ++lightIndex) {
 				PointLight light = lightsPointer[lightIndex];
 				glm::mat4 model(1.0f);
 				model = glm::translate(model, light.position);
@@ -345,23 +635,55 @@ int main()
 		// Rendering of the scene
 		// ----------------------------------------------------------------------------
 
-		glm::mat4 model(1.0f);
-		model = glm::scale(model, glm::vec3(0.005f));
-		glm::mat3 normal = glm::inverseTranspose(glm::mat3(model));
-		mainProgram.use();
-		mainProgram.setMat4("ViewMatrix", view);
-		mainProgram.setMat4("ProjectionMatrix", projection);
-		mainProgram.setInt("NumLights", NR_LIGHTS);
-		mainProgram.setInt2("TileSize", TILE_SIZE, TILE_SIZE);
-		mainProgram.setInt2("NumTiles", numTilesX, numTilesY);
-		mainProgram.setInt("RenderHeatmap", heatmapVis);
-		mainProgram.setMat4("ModelMatrix", model);
-		mainProgram.setMat4("NormalMatrix", normal);
+		Shader& sceneProgram = bindless ? bindlessProgram : mainProgram;
+		sceneProgram.use();
+		sceneProgram.setMat4("ViewMatrix", view);
+		sceneProgram.setMat4("ProjectionMatrix", projection);
+		sceneProgram.setInt("NumLights", numLights);
+		sceneProgram.setInt2("TileSize", TILE_SIZE, TILE_SIZE);
+		sceneProgram.setInt2("NumTiles", numTilesX, numTilesY);
+		sceneProgram.setInt("TileCapacity", std::min(numLights, MAX_LIGHTS_PER_TILE));
+		sceneProgram.setBool("Clustered", clustered);
+		sceneProgram.setInt2("ClusterTileSize", CLUSTER_TILE_SIZE, CLUSTER_TILE_SIZE);
+		sceneProgram.setInt3("NumClusters", numClustersX, numClustersY, CLUSTER_SLICES);
+		sceneProgram.setFloat("ClusterNear", CLUSTER_NEAR);
+		sceneProgram.setFloat("ClusterFar", FAR_PLANE);
+		sceneProgram.setInt("ClusterCapacity", MAX_LIGHTS_PER_CLUSTER);
+		sceneProgram.setInt("RenderHeatmap", heatmapVis);
 
 		// Synchronization direkt vor dem Rendern des Modells, damit der Compute Shader so lange wie mglich unabhngig von dem
 		// Draw Command arbeiten kann.
 		glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
-		object.Draw(mainProgram);
+		// the depth is already complete, only the visible fragment of every pixel is shaded
+		if (depthBounds != DEPTH_BOUNDS_OFF) {
+			glDepthFunc(GL_EQUAL);
+			glDepthMask(GL_FALSE);
+		}
+		glQueryCounter(passQueries[frameIndex % 2][2], GL_TIMESTAMP);
+		if (batchDraw)
+		{
+			sceneProgram.setMat4("ModelMatrix", model);
+			sceneProgram.setMat3("NormalMatrix", glm::inverseTranspose(glm::mat3(model)));
+			object.Draw(sceneProgram);
+		}
+		else
+		{
+			renderQueue.begin(view);
+			object.Submit(renderQueue, mainProgram, model);
+			renderQueue.flush();
+		}
+		glQueryCounter(passQueries[frameIndex % 2][3], GL_TIMESTAMP);
+
+		if (depthBounds != DEPTH_BOUNDS_OFF) {
+			glDepthFunc(GL_LESS);
+			glDepthMask(GL_TRUE);
+
+			// copy the scene to the screen
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFramebuffer);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, framebufferWidth, framebufferHeight, 0, 0, framebufferWidth, framebufferHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
 
 		glEndQuery(GL_TIME_ELAPSED);
 
@@ -378,16 +700,58 @@ int main()
 		double time = static_cast<double>(elapsed_time_in_nanoseconds) / 1000000.0;
 		// print render time every 60 frames
 		if (frameIndex%60 == 0) {
-			std::cout << "Rendering time: " << time << "ms | " << "FPS: " << 1.0 / time * 1000.0 << std::endl;
+			std::cout << "Rendering time: " << time << "ms | " << "FPS: " << 1.0 / time * 1000.0
+				<< " | visible meshes: " << visibleMeshes << "/" << object.meshes.size() << std::endl;
+			GLuint64 passTimes[4];
+			for (int i = 0; i < 4; i++)
+				glGetQueryObjectui64v(passQueries[(frameIndex + 1) % 2][i], GL_QUERY_RESULT, &passTimes[i]);
+			std::cout << "Depth pre-pass: " << DEPTH_BOUNDS_NAMES[depthBounds]
+				<< " | pre-pass time: " << (passTimes[1] - passTimes[0]) / 1000000.0 << "ms"
+				<< " | main pass time: " << (passTimes[3] - passTimes[2]) / 1000000.0 << "ms" << std::endl;
+			std::cout << "Lights: " << numLights << " | culling: " << (clustered ? "clusters" : "tiles") << (cpuCulling ? " (CPU)" : "");
+			if (cpuCulling)
+				std::cout << " | CPU culling time: " << cpuCullingTime * 1000.0 << "ms";
+			if (cullTiles)
+			{
+				GLuint tileLights = 0;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, tileStatsBuffer);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &tileLights);
+				std::cout << " | lights per tile: " << (float)tileLights / (numTilesX * numTilesY);
+			}
+			if (clustered)
+			{
+				// waits for the culling of this frame, only every 60 frames
+				GLuint usedIndices = 0;
+				glBindBuffer(GL_SHADER_STORAGE_BUFFER, clusterCounterBuffer);
+				glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &usedIndices);
+				GLuint numClusters = numClustersX * numClustersY * CLUSTER_SLICES;
+				std::cout << " | lights per cluster: " << (float)usedIndices / numClusters
+					<< " | index pool: " << usedIndices << "/" << clusterIndexCapacity
+					<< (usedIndices > clusterIndexCapacity ? " (overflow)" : "");
+			}
+			std::cout << std::endl;
+			if (batchDraw)
+			{
+				std::cout << "Merged draws: " << object.batch->getDrawCount() << " in " << object.batch->getDrawCalls() << " draw calls"
+					<< (object.batch->isBindless() ? " (bindless)" : "") << std::endl;
+			}
+			else
+			{
+				const RenderQueue::Stats& stats = renderQueue.getStats();
+				std::cout << "Draws: " << stats.draws << " | material changes: " << stats.materialChangesSubmitted << " -> " << stats.materialChanges
+					<< " | texture binds: " << stats.textureBindsSubmitted << " -> " << stats.textureBinds << std::endl;
+			}
 		}
 		
 		++frameIndex;
 
-		// reset update grid 
-		updateGrid = false;
+		// reset update grid, once the tiles have been culled
+		if (gridUpdated)
+			updateGrid = false;
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -398,6 +762,15 @@ int main()
 	glDeleteBuffers(1, &visibleLightsBuffer);
 
 	glDeleteBuffers(1, &lightsBuffer);
+	glDeleteBuffers(1, &clusterGridBuffer);
+	glDeleteBuffers(1, &clusterLightIndicesBuffer);
+	glDeleteBuffers(1, &clusterCounterBuffer);
+	glDeleteBuffers(1, &tileStatsBuffer);
+	glDeleteBuffers(2, depthReadBuffers);
+	glDeleteQueries(8, &passQueries[0][0]);
+	glDeleteFramebuffers(1, &sceneFramebuffer);
+	glDeleteRenderbuffers(1, &sceneColorRenderbuffer);
+	glDeleteTextures(1, &sceneDepthTexture);
 	glDeleteBuffers(1, &debugColors);
 	glDeleteBuffers(1, &debugPositions);
 	glDeleteVertexArrays(1, &debugPositionsVertexArray);
@@ -530,12 +903,99 @@ void repareTilesMemory(int width, int height) {
 	glGenBuffers(1, &visibleLightsBuffer);
 	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleLightsBuffer);
 	// +1 since the number of light sources per tiles will be save in front of the indice
-	glBufferData(GL_SHADER_STORAGE_BUFFER, (NR_LIGHTS + 1) * numTiles * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	unsigned int tileCapacity = std::min(numLights, MAX_LIGHTS_PER_TILE);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, (tileCapacity + 1) * numTiles * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
 
-	std::cout << "Create Visible Lights Buffer Lights: " << NR_LIGHTS << " Tiles: " << numTiles << std::endl;
+	std::cout << "Create Visible Lights Buffer Lights: " << numLights << " Tiles: " << numTiles << std::endl;
 
 }
 
+/// <summary>
+/// Prepares the clusters memory.
+/// create the light list of every cluster (offset & count) and the pool of light indices
+/// the lists are reserved in, its size depends on the number of clusters not on the number of lights
+/// </summary>
+/// <param name="width">The framebuffer width.</param>
+/// <param name="height">The framebuffer height.</param>
+void prepareClustersMemory(int width, int height) {
+	int numClustersX = (width + (CLUSTER_TILE_SIZE - 1)) / CLUSTER_TILE_SIZE;
+	int numClustersY = (height + (CLUSTER_TILE_SIZE - 1)) / CLUSTER_TILE_SIZE;
+
+	int numClusters = numClustersX * numClustersY * CLUSTER_SLICES;
+	clusterIndexCapacity = numClusters * CLUSTER_INDICES_PER_CLUSTER;
+
+	if (clusterGridBuffer == 0) {
+		glGenBuffers(1, &clusterGridBuffer);
+		glGenBuffers(1, &clusterLightIndicesBuffer);
+		glGenBuffers(1, &clusterCounterBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 6, clusterCounterBuffer);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(GLuint), NULL, GL_DYNAMIC_READ);
+	}
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, clusterGridBuffer);
+	// (offset, count) per cluster
+	glBufferData(GL_SHADER_STORAGE_BUFFER, numClusters * 2 * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, clusterLightIndicesBuffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, clusterIndexCapacity * sizeof(GLuint), NULL, GL_DYNAMIC_DRAW);
+
+	std::cout << "Create Cluster Buffers Clusters: " << numClusters << " Light Indices: " << clusterIndexCapacity << std::endl;
+}
+
+/// <summary>
+/// Prepares the scene framebuffer.
+/// the depth pre-pass and the main pass render into it instead of the default framebuffer,
+/// since the depth texture of the pre-pass is read by the culling shaders
+/// </summary>
+/// <param name="width">The framebuffer width.</param>
+/// <param name="height">The framebuffer height.</param>
+void prepareSceneFramebuffer(int width, int height) {
+	if (sceneFramebuffer == 0) {
+		glGenFramebuffers(1, &sceneFramebuffer);
+		glGenRenderbuffers(1, &sceneColorRenderbuffer);
+		glGenTextures(1, &sceneDepthTexture);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, sceneColorRenderbuffer);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glBindTexture(GL_TEXTURE_2D, sceneDepthTexture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, width, height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, sceneFramebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, sceneColorRenderbuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, sceneDepthTexture, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		std::cout << "Scene Framebuffer not complete!" << std::endl;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+/// <summary>
+/// Creates the lights.
+/// random lights in the atrium of sponza, the radius shrinks with the number of lights
+/// so a point is lit by about as many lights as with 100 lights
+/// </summary>
+/// <param name="lightsBuffer">The lights buffer, with a capacity of MAX_LIGHTS.</param>
+/// <param name="count">The number of lights.</param>
+void createLights(GLuint lightsBuffer, unsigned int count) {
+	float radiusScale = std::cbrt(100.0f / count);
+
+	lights.clear();
+	for (unsigned int i = 0; i < count; i++)
+	{
+		// calculate slightly random offsets
+		PointLight light;
+		light.position = glm::vec3(5 * (2 * randFloat() - 1), 5 * randFloat(), 3 * (2 * randFloat() - 1));
+		light.radius = radiusScale * (1.5f + 1.5f * randFloat());
+		light.color = glm::vec4(randFloat(), randFloat(), randFloat(), 1.0f);
+
+		lights.push_back(light);
+	}
+
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, lightsBuffer);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, count * sizeof(PointLight), lights.data());
+}
+
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
 // ---------------------------------------------------------------------------------------------------------
 void processInput(GLFWwindow *window)
@@ -558,6 +1018,12 @@ void processInput(GLFWwindow *window)
 		std::cout << " M: Toggle Heatmap" << std::endl;
 		std::cout << " T: Toggle Show Tiles" << std::endl;
 		std::cout << " L: Toggle Show Lights" << std::endl;
+		std::cout << " B: Toggle Merged Multi Draw Indirect" << std::endl;
+		std::cout << " C: Toggle Clustered / Tiled Light Culling" << std::endl;
+		std::cout << " Up/Down: Double/Halve Number of Lights" << std::endl;
+		std::cout << " P: Depth Pre-Pass Off / Min-Max Depth Bounds / Min-Max + Depth Mask" << std::endl;
+		std::cout << " G: Toggle Light Culling on the CPU" << std::endl;
+		std::cout << " V: Compare the Light Lists of the GPU to the CPU" << std::endl;
 		h_pressed = false;
 	}
 
@@ -592,6 +1058,69 @@ void processInput(GLFWwindow *window)
 		lightVis = !lightVis;
 		l_pressed = false;
 	}
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+		b_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE && b_pressed) {
+		batchDraw = !batchDraw;
+		b_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+		c_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE && c_pressed) {
+		clustered = !clustered;
+		c_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
+		p_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_P) == GLFW_RELEASE && p_pressed) {
+		depthBounds = (depthBounds + 1) % 3;
+		p_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_PRESS) {
+		g_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_G) == GLFW_RELEASE && g_pressed) {
+		cpuCulling = !cpuCulling;
+		std::cout << "Light culling on the " << (cpuCulling ? "CPU" : "GPU") << std::endl;
+		g_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
+		v_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_V) == GLFW_RELEASE && v_pressed) {
+		checkCulling = true;
+		v_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) {
+		up_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_RELEASE && up_pressed) {
+		if (numLights < MAX_LIGHTS) {
+			numLights *= 2;
+			lightsChanged = true;
+		}
+		up_pressed = false;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) {
+		down_pressed = true;
+	}
+	if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_RELEASE && down_pressed) {
+		if (numLights > 1) {
+			numLights /= 2;
+			lightsChanged = true;
+		}
+		down_pressed = false;
+	}
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -716,6 +1245,8 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height)
 	glViewport(0, 0, width, height);
 
 	repareTilesMemory(width, height);
+	prepareClustersMemory(width, height);
+	prepareSceneFramebuffer(width, height);
 
 	// update grid on viewport change
 	updateGrid = true;
@@ -1,7 +1,6 @@
 #version 330 core
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gAlbedoSpec;
+layout (location = 0) out vec2 gNormal;
+layout (location = 1) out vec3 gAlbedoSpec;
 
 /*
  * GBuffer Shader 
@@ -12,11 +11,21 @@ in vec2 TexCoords;
 in vec3 FragPos;
 in vec3 Normal;
 
+/*
+ * Octahedral encoding of a unit vector into [0, 1]^2 (two 16 bit channels)
+ */
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 e = n.xy;
+	if (n.z < 0.0)
+		e = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	return e * 0.5 + 0.5;
+}
+
 void main() {
-	// store the fragment position vector in the first gbufer texture
-	gPosition = FragPos;
-	// also store the per-fragment normals into the gbuffer
-	gNormal = normalize(Normal);
+	// the position is not stored, the later passes reconstruct it from the depth buffer
+	// store the per-fragment normals (viewspace) into the gbuffer
+	gNormal = encodeNormal(normalize(Normal));
 	// and the diffuse per-framgent color 
 	gAlbedoSpec.rgb = vec3(0.95); // NOTE: albedo/diff color hard coded here
 }
\ No newline at end of file
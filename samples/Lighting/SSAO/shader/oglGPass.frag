@@ -1,9 +1,6 @@
 #version 330
 
-in vec3 ViewPos;
-
-layout (location = 0) out vec3 PosOut;
+// only the depth buffer is written, the SSAO pass reconstructs the view space position from it
 
 void main() {
-	PosOut = ViewPos; // write view space position to the texture
 }
\ No newline at end of file
@@ -4,16 +4,23 @@ in vec2 TexCoord;
 
 out vec4 FragColor;
 
-uniform sampler2D gPositionMap;
+uniform sampler2D gDepthMap;
 uniform float gSampleRad;
 uniform mat4 projection;
+uniform mat4 inverseProjection;
 
 const int MAX_KERNEL_SIZE = 64;
 uniform vec3 gKernel[MAX_KERNEL_SIZE]; // array of uniform vectors
 
+vec3 CalcViewPos(vec2 Coord)
+{
+	vec4 Pos = inverseProjection * vec4(vec3(Coord, texture(gDepthMap, Coord).r) * 2.0 - 1.0, 1.0);
+	return Pos.xyz / Pos.w;
+}
+
 void main() 
 {
-	vec3 Pos = texture(gPositionMap, TexCoord).xyz; // fetch Viewspace Position
+	vec3 Pos = CalcViewPos(TexCoord); // reconstruct Viewspace Position from the depth
 
 	float AO = 0.0;
 
@@ -25,7 +32,7 @@ void main()
 		offset.xy /= offset.w;	// perform perspective devide 
 		offset.xy = offset.xy * 0.5 + vec2(0.5); // transform to (0,1) range
 
-		float sampleDepth = texture(gPositionMap, offset.xy).b;
+		float sampleDepth = CalcViewPos(offset.xy).z;
 
 		if (abs(Pos.z - sampleDepth) < gSampleRad) {// check that the distance is not too far ogg
             AO += step(sampleDepth,samplePos.z);// compare depth of the virtual point with the one from the actual geometry
@@ -3,13 +3,15 @@ out float FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition; 
+uniform sampler2D gDepth; 
 uniform sampler2D gNormal; 
 uniform sampler2D texNoise;
 
 uniform vec3 samples[64];
 uniform bool use_hammersley;
 uniform mat4 projection;
+// transformation from clipping to viewspace
+uniform mat4 inverseProjection;
 uniform float radius;
 
 // parameters (probably usefull as uniforms to more easily tweak the effect)
@@ -82,11 +84,35 @@ vec2 hammersley(uint i, uint N) {
 }
 
 
+/**
+ * Inverse of the octahedral encoding of gBufferShader.frag
+ */
+vec3 decodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+/**
+ * Viewspace position of a pixel, reconstructed from the depth buffer
+ *
+ * @param uv                    texture coordinate of the pixel
+ *
+ * @return position in viewspace
+ */
+vec3 viewPosition(vec2 uv) {
+	vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+	return position.xyz / position.w;
+}
+
+
 void main() 
 {
 	// get input for SSAO algorithm
-	vec3 fragPos = texture(gPosition, TexCoords).xyz;
-	vec3 normal = normalize(texture(gNormal, TexCoords).rgb);
+	vec3 fragPos = viewPosition(TexCoords);
+	vec3 normal = decodeNormal(texture(gNormal, TexCoords).rg);
 	vec3 randomVec = normalize(texture(texNoise, TexCoords * noiseScale).xyz);
 	// random values are repeated all over the screen.
 
@@ -142,8 +168,8 @@ void main()
 		offset.xyz = offset.xyz * 0.5 + 0.5;	// transform to range 0.0 - 1.0
 
 		// get sample depth
-		// we now can use them to sample the position texture
-		float sampleDepth = texture(gPosition, offset.xy).z; // use x + y component to sample the position textue to 
+		// we now can use them to sample the depth buffer
+		float sampleDepth = viewPosition(offset.xy).z; // use x + y component to sample the depth buffer to 
 		// retrieve the (depth) z value of the (kernel) sample position as seen from the viewer's perspective
 
 		// Range Check 
@@ -3,10 +3,12 @@ out vec4 FragColor;
 
 in vec2 TexCoords;
 
-uniform sampler2D gPosition;
+uniform sampler2D gDepth;
 uniform sampler2D gNormal;
 uniform sampler2D gAlbedo;
 uniform sampler2D ssao;
+// transformation from clipping to viewspace
+uniform mat4 inverseProjection;
 
 struct Light {
 	vec3 Position;
@@ -18,11 +20,34 @@ struct Light {
 
 uniform Light light;
 
+/**
+ * Inverse of the octahedral encoding of gBufferShader.frag
+ */
+vec3 decodeNormal(vec2 e) {
+	e = e * 2.0 - 1.0;
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	float t = max(-n.z, 0.0);
+	n.xy += vec2(n.x >= 0.0 ? -t : t, n.y >= 0.0 ? -t : t);
+	return normalize(n);
+}
+
+/**
+ * Viewspace position of a pixel, reconstructed from the depth buffer
+ *
+ * @param uv                    texture coordinate of the pixel
+ *
+ * @return position in viewspace
+ */
+vec3 viewPosition(vec2 uv) {
+	vec4 position = inverseProjection * vec4(vec3(uv, texture(gDepth, uv).r) * 2.0 - 1.0, 1.0);
+	return position.xyz / position.w;
+}
+
 void main()
 {
 	// retrieve data from gbuffer
-	vec3 FragPos = texture(gPosition, TexCoords).rgb;
-	vec3 Normal = texture(gNormal, TexCoords).rgb;
+	vec3 FragPos = viewPosition(TexCoords);
+	vec3 Normal = decodeNormal(texture(gNormal, TexCoords).rg);
 	vec3 Diffuse = texture(gAlbedo, TexCoords).rgb;
 	float AmbientOcclusion = texture(ssao, TexCoords).r;
 
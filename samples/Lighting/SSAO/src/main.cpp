@@ -18,6 +18,7 @@
 #include "modules/light.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 #include <random>
@@ -130,6 +131,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -169,43 +171,38 @@ int main()
 	GLuint gBuffer;
 	glGenFramebuffers(1, &gBuffer);
 	glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
-	GLuint gPosition, gNormal, gAlbedo;
-	// position color buffer
-	glGenTextures(1, &gPosition);
-	glBindTexture(GL_TEXTURE_2D, gPosition);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
-	// floating point, positions aren't clamped to [0.0, 1.0]
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-
-	// ensure not accidentally oversample position/depth values in 
-	// screen-space outside the texture's default coordinate region
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gPosition, 0);
-	// normal color buffer
+	// compact layout: 4 (depth) + 4 (normal) + 4 (albedo) bytes per pixel,
+	// the viewspace position is reconstructed from the depth instead of stored as RGB16F
+	GLuint gDepth, gNormal, gAlbedo;
+	// normal color buffer (viewspace, octahedral encoded)
 	glGenTextures(1, &gNormal);
 	glBindTexture(GL_TEXTURE_2D, gNormal);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_FLOAT, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16, SCR_WIDTH, SCR_HEIGHT, 0, GL_RG, GL_UNSIGNED_SHORT, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gNormal, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, gNormal, 0);
 	// color buffer
 	glGenTextures(1, &gAlbedo);
 	glBindTexture(GL_TEXTURE_2D, gAlbedo);
-	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
 	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT2, GL_TEXTURE_2D, gAlbedo, 0);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, gAlbedo, 0);
 	// tell OpenGL which color attachments we'll use (of this framebuffer) for rendering
-	GLuint attachments[3] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
-	glDrawBuffers(3, attachments);
-	// create and attach depth buffer (renderbuffer)
-	GLuint rboDepth;
-	glGenRenderbuffers(1, &rboDepth);
-	glBindRenderbuffer(GL_RENDERBUFFER, rboDepth);
-	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT, SCR_WIDTH, SCR_HEIGHT);
-	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, rboDepth);
+	GLuint attachments[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+	glDrawBuffers(2, attachments);
+	// create and attach depth buffer (texture, the SSAO and lighting pass read it)
+	// 32 bit float keeps the reconstructed positions precise at the far plane of 500
+	glGenTextures(1, &gDepth);
+	glBindTexture(GL_TEXTURE_2D, gDepth);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT32F, SCR_WIDTH, SCR_HEIGHT, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	// ensure not accidentally oversample depth values in 
+	// screen-space outside the texture's default coordinate region
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, gDepth, 0);
 	// finally check if framebuffer is complete
 	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
 		std::cout << "Framebuffer not complete!" << std::endl;
@@ -336,12 +333,12 @@ int main()
 	// --------------------
 #if LEARNOPENGL
 	shaderLightingPass.use();
-	shaderLightingPass.setInt("gPosition", 0);
+	shaderLightingPass.setInt("gDepth", 0);
 	shaderLightingPass.setInt("gNormal", 1);
 	shaderLightingPass.setInt("gAlbedo", 2);
 	shaderLightingPass.setInt("ssao", 3);
 	shaderSSAO.use();
-	shaderSSAO.setInt("gPosition", 0);
+	shaderSSAO.setInt("gDepth", 0);
 	shaderSSAO.setInt("gNormal", 1);
 	shaderSSAO.setInt("texNoise", 2);
 	shaderSSAOBlur.use();
@@ -349,7 +346,7 @@ int main()
 
 #else 
 	shaderSSAO.use();
-	shaderSSAO.setInt("gPositionMap", 0);
+	shaderSSAO.setInt("gDepthMap", 0);
 	shaderSSAOBlur.use();
 	shaderSSAOBlur.setInt("gColorMap", 0);
 	shaderLightingPass.use();
@@ -383,6 +380,8 @@ int main()
 
 		glm::mat4 projection = glm::perspective(fov, width / height, zNear, zFar);
 		glm::mat4 view = camera.GetViewMatrix();
+		// the positions are reconstructed from the depth buffer with it
+		glm::mat4 inverseProjection = glm::inverse(projection);
 
 #if LEARNOPENGL
 		// LEARNOPENGL SOURCE
@@ -406,10 +405,11 @@ int main()
 			for (unsigned int i = 0; i < 64; ++i)
 				shaderSSAO.setVec3("samples[" + std::to_string(i) + "]", ssaoKernel[i]);
 			shaderSSAO.setMat4("projection", projection);
+			shaderSSAO.setMat4("inverseProjection", inverseProjection);
 			shaderSSAO.setBool("use_hammersley", hammersley);
 			shaderSSAO.setFloat("radius", radius);
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, gPosition);
+			glBindTexture(GL_TEXTURE_2D, gDepth);
 			glActiveTexture(GL_TEXTURE1);
 			glBindTexture(GL_TEXTURE_2D, gNormal);
 			glActiveTexture(GL_TEXTURE2);
@@ -456,8 +456,9 @@ int main()
 			const float quadratic = 0.032;
 			shaderLightingPass.setFloat("light.Linear", linear);
 			shaderLightingPass.setFloat("light.Quadratic", quadratic);
+			shaderLightingPass.setMat4("inverseProjection", inverseProjection);
 			glActiveTexture(GL_TEXTURE0);
-			glBindTexture(GL_TEXTURE_2D, gPosition);
+			glBindTexture(GL_TEXTURE_2D, gDepth);
 			glActiveTexture(GL_TEXTURE1);
 			glBindTexture(GL_TEXTURE_2D, gNormal);
 			glActiveTexture(GL_TEXTURE2);
@@ -494,10 +495,11 @@ int main()
 					for (unsigned int i = 0; i < KERNEL_SIZE; ++i)
 						shaderSSAO.setVec3("gKernel[" + std::to_string(i) + "]", kernel[i]);
 					shaderSSAO.setMat4("projection", projection);
+					shaderSSAO.setMat4("inverseProjection", inverseProjection);
 					shaderSSAO.setFloat("gSampleRad", radius);
-					shaderSSAO.setInt("gPositionMap", 0);
+					shaderSSAO.setInt("gDepthMap", 0);
 					glActiveTexture(GL_TEXTURE0);
-					glBindTexture(GL_TEXTURE_2D, gPosition);
+					glBindTexture(GL_TEXTURE_2D, gDepth);
 
 					renderQuad(); // Render to a Full Screen Quad
 				glBindFramebuffer(GL_FRAMEBUFFER, 0);
@@ -559,6 +561,7 @@ int main()
 #endif
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -45,6 +45,16 @@ struct SpotLight {
     vec3 specular;       
 };
 
+// layout of LightBuffer (include/modules/light_buffer.h)
+struct GPULight {
+	vec4 position;		// xyz position, w type
+	vec4 direction;		// xyz direction, w cutOff
+	vec4 ambient;		// rgb ambient, w outerCutOff
+	vec4 diffuse;		// rgb diffuse, w constant
+	vec4 specular;		// rgb specular, w linear
+	vec4 attenuation;	// x quadratic, y radius
+};
+
 #define NR_POINT_LIGHTS 4
 
 in vec3 FragPos;
@@ -58,7 +68,10 @@ uniform vec3 cameraPos;
 uniform vec3 viewPos;
 //Lights
 uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
+layout (std140) uniform PointLightBlock {
+	ivec4 pointLightCount;
+	GPULight pointLights[NR_POINT_LIGHTS];
+};
 uniform SpotLight spotLight;
 //Materials
 uniform Material material;
@@ -70,6 +83,7 @@ vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 CalcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
 vec3 reflection(vec2 texCoords);
+PointLight unpackPointLight(GPULight light);
 
 void main()
 {    
@@ -87,8 +101,8 @@ void main()
     // phase 1: directional lighting
     result = CalcDirLight(dirLight, norm, viewDir);
     // phase 2: point lights
-    for(int i = 0; i < NR_POINT_LIGHTS; i++)
-       result += CalcPointLight(pointLights[i], norm, FragPos, viewDir);    
+    for(int i = 0; i < pointLightCount.x; i++)
+       result += CalcPointLight(unpackPointLight(pointLights[i]), norm, FragPos, viewDir);    
     // phase 3: spot light
     result += CalcSpotLight(spotLight, norm, FragPos, viewDir);    
 	//result = vec3(texture(material.texture_height1, TexCoords));
@@ -112,6 +126,18 @@ vec3 reflection(vec2 texCoords) {
 	//return  mix(reflectColor, reflectOnModel, 0.5) * texture(material.texture_height1, texCoords).rgb;
 }
 
+PointLight unpackPointLight(GPULight light) {
+	PointLight pointLight;
+	pointLight.position = light.position.xyz;
+	pointLight.constant = light.diffuse.w;
+	pointLight.linear = light.specular.w;
+	pointLight.quadratic = light.attenuation.x;
+	pointLight.ambient = light.ambient.rgb;
+	pointLight.diffuse = light.diffuse.rgb;
+	pointLight.specular = light.specular.rgb;
+	return pointLight;
+}
+
 // calculates the color when using a directional light.
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir)
 {
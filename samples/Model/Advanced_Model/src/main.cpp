@@ -11,9 +11,11 @@
 #include "modules/model.h"
 
 #include "modules/light.h"
+#include "modules/light_buffer.h"
 #include "modules/material.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
 #include <iostream>
 
@@ -83,6 +85,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -447,6 +450,12 @@ int main()
 		pointLights[i].initialise();
 	}
 
+	// the point lights are read from a uniform buffer instead of one uniform per light member
+	LightBuffer pointLightBuffer(pointLightsCount);
+	pointLightBuffer.bindBlock(modelShader, "PointLightBlock");
+	for (int i = 0; i < pointLightsCount; i++)
+		pointLightBuffer.set(i, pointLights[i]);
+
 	// load and create a texture 
 	// -------------------------
 
@@ -511,8 +520,7 @@ int main()
 
 		modelShader.use();
 		dirLight.use(modelShader);
-		for (int i = 0; i < pointLightsCount; i++)
-			pointLights[i].use(modelShader);
+		pointLightBuffer.update(); // uploads lights changed with set() since the last frame
 		spotLight.use(modelShader);
 
 		modelShader.setVec3("viewPos", camera.Position);
@@ -560,6 +568,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// ------------------------------------------------------------------------------_
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -19,8 +19,15 @@ uniform mat4 model;
 const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
 
-// stores transformations of all bones
-uniform mat4 finalBonesMatrices[MAX_BONES];
+// 3x4 affine transformations of all bones, rows 0..2 of bone i at 3 * i
+layout (std140) uniform BonePalette {
+    vec4 boneRows[MAX_BONES * 3];
+};
+
+vec3 transformBone(int bone, vec4 position)
+{
+    return vec3(dot(boneRows[bone * 3], position), dot(boneRows[bone * 3 + 1], position), dot(boneRows[bone * 3 + 2], position));
+}
 
 out vec2 TexCoords;
 
@@ -36,9 +43,8 @@ void main()
             totalPosition = vec4(pos,1.0f);
             break;
         }
-        vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
+        vec4 localPosition = vec4(transformBone(boneIds[i], vec4(pos,1.0f)), 1.0f);
         totalPosition += localPosition * weights[i];
-        vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
    }
 	
     mat4 viewModel = view * model;
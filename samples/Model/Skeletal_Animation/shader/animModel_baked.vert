@@ -0,0 +1,70 @@
+#version 330 core
+
+/**
+ * Bone Deformation from baked animations
+ * the bone matrices of every frame are read from a texture, no bone data is uploaded per frame
+ */
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 bitangent;
+// indices to be used to read the array & apply transformations
+layout(location = 5) in ivec4 boneIds; 
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform float time;		// seconds
+
+const int MAX_BONE_INFLUENCE = 4;
+
+// one row per frame, 3 texels (the affine rows) per bone
+uniform sampler2D bakedBones;
+// one model matrix per instance, 4 texels per matrix
+uniform samplerBuffer modelMatrices;
+// per instance: first row of the clip, frames of the clip, frames per second, start frame
+uniform samplerBuffer instanceClips;
+uniform int boneCount;
+
+out vec2 TexCoords;
+
+mat4 fetchMatrix(samplerBuffer matrices, int index)
+{
+    return mat4(texelFetch(matrices, index * 4),
+                texelFetch(matrices, index * 4 + 1),
+                texelFetch(matrices, index * 4 + 2),
+                texelFetch(matrices, index * 4 + 3));
+}
+
+void main()
+{
+    vec4 clip = texelFetch(instanceClips, gl_InstanceID);
+    // position between two frames, linear filtering interpolates the rows
+    float frame = mod(clip.w + time * clip.z, clip.y);
+    vec2 size = vec2(textureSize(bakedBones, 0));
+    float v = (clip.x + frame + 0.5f) / size.y;
+
+    vec4 position = vec4(pos, 1.0f);
+    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(boneIds[i] == -1) 
+            continue;
+        if(boneIds[i] >= boneCount) 
+        {
+            totalPosition = position;
+            break;
+        }
+        float u = (boneIds[i] * 3 + 0.5f) / size.x;
+        vec4 row0 = texture(bakedBones, vec2(u, v));
+        vec4 row1 = texture(bakedBones, vec2(u + 1.0f / size.x, v));
+        vec4 row2 = texture(bakedBones, vec2(u + 2.0f / size.x, v));
+        vec4 localPosition = vec4(dot(row0, position), dot(row1, position), dot(row2, position), 1.0f);
+        totalPosition += localPosition * weights[i];
+    }
+
+    mat4 model = fetchMatrix(modelMatrices, gl_InstanceID);
+    gl_Position =  projection * view * model * totalPosition;
+	TexCoords = tex;
+}
@@ -0,0 +1,59 @@
+#version 330 core
+
+/**
+ * Bone Deformation for a crowd of instances
+ * every instance reads its bone matrices and model matrix from texture buffers
+ */
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec3 norm;
+layout(location = 2) in vec2 tex;
+layout(location = 3) in vec3 tangent;
+layout(location = 4) in vec3 bitangent;
+// indices to be used to read the array & apply transformations
+layout(location = 5) in ivec4 boneIds; 
+layout(location = 6) in vec4 weights;
+
+uniform mat4 projection;
+uniform mat4 view;
+
+const int MAX_BONE_INFLUENCE = 4;
+
+// boneCount matrices per instance of the batch, 4 texels per matrix
+uniform samplerBuffer bonePalettes;
+// one model matrix per instance of the crowd
+uniform samplerBuffer modelMatrices;
+uniform int boneCount;
+// the crowd is drawn in batches that fit the texture buffer size, index of the first instance of the batch
+uniform int firstInstance;
+
+out vec2 TexCoords;
+
+mat4 fetchMatrix(samplerBuffer matrices, int index)
+{
+    return mat4(texelFetch(matrices, index * 4),
+                texelFetch(matrices, index * 4 + 1),
+                texelFetch(matrices, index * 4 + 2),
+                texelFetch(matrices, index * 4 + 3));
+}
+
+void main()
+{
+    int paletteStart = gl_InstanceID * boneCount;
+    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(boneIds[i] == -1) 
+            continue;
+        if(boneIds[i] >= boneCount) 
+        {
+            totalPosition = vec4(pos,1.0f);
+            break;
+        }
+        vec4 localPosition = fetchMatrix(bonePalettes, paletteStart + boneIds[i]) * vec4(pos,1.0f);
+        totalPosition += localPosition * weights[i];
+    }
+
+    mat4 model = fetchMatrix(modelMatrices, firstInstance + gl_InstanceID);
+    gl_Position =  projection * view * model * totalPosition;
+	TexCoords = tex;
+}
@@ -20,6 +20,18 @@ struct AssimpNodeData
 	std::vector<AssimpNodeData> children;
 };
 
+/// <summary>
+/// Node of the flattened hierarchy, nodes are stored parents first
+/// </summary>
+struct SkeletonNode
+{
+	glm::mat4 transformation;	// used if the node has no bone channel
+	glm::mat4 offset;			// bone offset matrix, only valid with a boneID
+	int parent;					// index of the parent node, -1 for the root
+	int bone;					// index into the bone channels of the animation, -1 if not animated
+	int boneID;					// index into the final bone matrices, -1 if the node is no bone
+};
+
 /// <summary>
 /// Reads data from aiAnimation (assimp) and creates a hierarchical record of bones
 /// </summary>
@@ -39,22 +51,56 @@ public:
 		Assimp::Importer importer;
 		const aiScene* scene = importer.ReadFile(animationPath, aiProcess_Triangulate);
 		assert(scene && scene->mRootNode);
-		auto animation = scene->mAnimations[0];
-		// get duration of the animation
-		duration = animation->mDuration;
-		// get speed of animation
-		ticksPerSecond = animation->mTicksPerSecond;
-		// get global transformation matrix for bone
-		aiMatrix4x4 globalTransformation = scene->mRootNode->mTransformation;
-		globalTransformation = globalTransformation.Inverse();
-		ReadHierarchyData(rootNode, scene->mRootNode);
-		ReadMissingBones(animation, *model);
+		Load(scene->mAnimations[0], scene->mRootNode, model->GetBoneInfoMap(), model->GetBoneCount());
+	}
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="Animation"/> class from assimp data in memory,
+	/// e.g. of a generated skeleton.
+	/// </summary>
+	/// <param name="animation">The animation.</param>
+	/// <param name="root">The root node of the hierarchy.</param>
+	/// <param name="boneInfoMap">The bones of the model, bones only found in the animation are added.</param>
+	/// <param name="boneCount">The bone count of the model, incremented for every added bone.</param>
+	Animation(const aiAnimation* animation, const aiNode* root, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
+	{
+		Load(animation, root, boneInfoMap, boneCount);
+	}
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="Animation"/> class from decoded data, e.g. of a compressed clip.
+	/// </summary>
+	/// <param name="duration">The duration in ticks.</param>
+	/// <param name="ticksPerSecond">The ticks per second.</param>
+	/// <param name="root">The root node of the hierarchy.</param>
+	/// <param name="channels">The animated bones, their ids registered with RegisterBone.</param>
+	/// <param name="boneInfoMap">The bones of the model.</param>
+	Animation(float duration, int ticksPerSecond, const AssimpNodeData& root, std::vector<Bone>&& channels, const std::map<std::string, BoneInfo>& boneInfoMap)
+		: duration(duration), ticksPerSecond(ticksPerSecond), bones(std::move(channels)), rootNode(root), boneInfoMap(boneInfoMap)
+	{
+		FlattenHierarchy(rootNode, -1);
 	}
 
 	~Animation()
 	{
 	}
 
+	/// <summary>
+	/// Returns the id of a bone, bones the model doesn't have get the next free id.
+	/// </summary>
+	/// <param name="boneInfoMap">The bones of the model.</param>
+	/// <param name="boneCount">The bone count of the model, incremented for every added bone.</param>
+	static int RegisterBone(const std::string& name, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
+	{
+		auto info = boneInfoMap.find(name);
+		if (info != boneInfoMap.end())
+			return info->second.id;
+		BoneInfo& bone = boneInfoMap[name];
+		bone.id = boneCount;
+		bone.offset = glm::mat4(1.0f);
+		return boneCount++;
+	}
+
 	Bone* FindBone(const std::string& name)
 	{
 		auto iter = std::find_if(bones.begin(), bones.end(),
@@ -68,21 +114,35 @@ public:
 	}
 
 
+	inline std::vector<Bone>& GetBones() { return bones; }
+	inline int GetBoneIndex(const Bone* bone) const { return (int)(bone - bones.data()); }
 	inline float GetTicksPerSecond() { return ticksPerSecond; }
 	inline float GetDuration() { return duration; }
 	inline const AssimpNodeData& GetRootNode() { return rootNode; }
+	inline const std::vector<SkeletonNode>& GetSkeleton() { return skeleton; }
 	inline const std::map<std::string, BoneInfo>& GetBoneIDMap()
 	{
 		return boneInfoMap;
 	}
 
 private:
-	void ReadMissingBones(const aiAnimation* animation, Model& model)
+	void Load(const aiAnimation* animation, const aiNode* root, std::map<std::string, BoneInfo>& boneInfoMapModel, int& boneCount)
 	{
-		int size = animation->mNumChannels;
+		// get duration of the animation
+		duration = animation->mDuration;
+		// get speed of animation
+		ticksPerSecond = animation->mTicksPerSecond;
+		// get global transformation matrix for bone
+		aiMatrix4x4 globalTransformation = root->mTransformation;
+		globalTransformation = globalTransformation.Inverse();
+		ReadHierarchyData(rootNode, root);
+		ReadMissingBones(animation, boneInfoMapModel, boneCount);
+		FlattenHierarchy(rootNode, -1);
+	}
 
-		auto& boneInfoMapModel = model.GetBoneInfoMap();//getting m_BoneInfoMap from Model class
-		int& boneCount = model.GetBoneCount(); //getting the m_BoneCounter from Model class
+	void ReadMissingBones(const aiAnimation* animation, std::map<std::string, BoneInfo>& boneInfoMapModel, int& boneCount)
+	{
+		int size = animation->mNumChannels;
 
 		//reading channels(bones engaged in an animation and their keyframes)
 		for (int i = 0; i < size; i++)
@@ -90,13 +150,8 @@ private:
 			auto channel = animation->mChannels[i];
 			std::string boneName = channel->mNodeName.data;
 
-			if (boneInfoMapModel.find(boneName) == boneInfoMapModel.end())
-			{
-				boneInfoMapModel[boneName].id = boneCount;
-				boneCount++;
-			}
-			bones.push_back(Bone(channel->mNodeName.data,
-				boneInfoMapModel[channel->mNodeName.data].id, channel));
+			int id = RegisterBone(boneName, boneInfoMapModel, boneCount);
+			bones.push_back(Bone(boneName, id, channel));
 		}
 
 		boneInfoMap = boneInfoMapModel;
@@ -122,10 +177,39 @@ private:
 			dest.children.push_back(newData);
 		}
 	}
+	/// <summary>
+	/// Stores the hierarchy in depth first order with parent indices and resolves
+	/// the bone channels and offsets of the nodes, so a pose is evaluated in a single loop.
+	/// </summary>
+	/// <param name="node">The node to add with its children.</param>
+	/// <param name="parent">Index of the parent node.</param>
+	void FlattenHierarchy(const AssimpNodeData& node, int parent)
+	{
+		SkeletonNode flat;
+		flat.transformation = node.transformation;
+		flat.offset = glm::mat4(1.0f);
+		flat.parent = parent;
+		Bone* bone = FindBone(node.name);
+		flat.bone = bone ? GetBoneIndex(bone) : -1;
+		flat.boneID = -1;
+		auto info = boneInfoMap.find(node.name);
+		if (info != boneInfoMap.end())
+		{
+			flat.boneID = info->second.id;
+			flat.offset = info->second.offset;
+		}
+		skeleton.push_back(flat);
+
+		int index = (int)skeleton.size() - 1;
+		for (int i = 0; i < node.childrenCount; i++)
+			FlattenHierarchy(node.children[i], index);
+	}
+
 	float duration;
 	int ticksPerSecond;
 	std::vector<Bone> bones;
 	AssimpNodeData rootNode;
+	std::vector<SkeletonNode> skeleton;
 	std::map<std::string, BoneInfo> boneInfoMap;
 };
 
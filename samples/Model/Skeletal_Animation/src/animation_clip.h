@@ -0,0 +1,634 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include <assimp/scene.h>
+#include <assimp/Importer.hpp>
+#include <assimp/postprocess.h>
+#include "animation.h"
+#include "modules/model_cache.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+// how the keys of a track are stored
+enum TrackEncoding {
+	TRACK_CONSTANT = 0,		// a single full precision key
+	TRACK_UNIFORM = 1,		// a quantized key per frame, no timestamps
+	TRACK_SPARSE = 2,		// the quantized keys that can't be interpolated from their neighbours, with 16 bit frame numbers
+};
+
+/// <summary>
+/// Compact binary animation clip written next to a source asset (e.g. dancing_vampire.dae -> dancing_vampire.dae.animclip).
+///
+/// File layout (all offsets are relative to the start of the file):
+/// +--------+-------------+----------------+------------+---------+
+/// | Header | NodeRecords | ChannelRecords | Track data | Strings |
+/// +--------+-------------+----------------+------------+---------+
+/// The channels are resampled at a fixed rate over the duration of the clip, so the keys of a track
+/// are frames and need no float timestamps. Every track is stored as
+///	- constant: all frames are within the tolerance of the first one
+///	- uniform: every frame, quantized
+///	- sparse: only the frames linear interpolation can't reproduce within the tolerance, quantized,
+///	  with their frame numbers, if this is smaller than the uniform track.
+/// Positions and scales are quantized to 16 bits per component over the range of the track,
+/// rotations to 48 bits (smallest three: the largest component is dropped and rebuilt from the unit length).
+/// The clip is keyed by a hash of the source file and read from a memory mapping.
+/// </summary>
+class AnimationClip
+{
+public:
+	static const uint32_t MAGIC = 0x50494C43; // "CLIP"
+	static const uint32_t VERSION = 1;
+
+	struct Settings {
+		float sampleRate = 30.0f;			// frames per second of playback
+		float positionTolerance = 1e-3f;	// in model units
+		float rotationTolerance = 1e-3f;	// in radians
+		float scaleTolerance = 1e-4f;
+	};
+
+	struct Stats {
+		unsigned int sourceKeys = 0;		// keys of the source channels
+		size_t sourceBytes = 0;				// the source keys as Bone stores them, float timestamp + value
+		size_t compressedBytes = 0;			// the clip file
+		unsigned int storedKeys = 0;
+		unsigned int constantTracks = 0;
+		unsigned int uniformTracks = 0;
+		unsigned int sparseTracks = 0;
+		// largest difference between the decoded and the resampled tracks over all frames
+		float maxPositionError = 0.0f;
+		float maxRotationError = 0.0f;
+		float maxScaleError = 0.0f;
+	};
+
+	struct Header {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceHash;
+		float duration;				// in ticks
+		float ticksPerSecond;
+		uint32_t frameCount;		// frames over [0, duration], both ends included
+		uint32_t nodeCount;
+		uint32_t channelCount;
+		uint32_t padding;
+		uint64_t nodeOffset;
+		uint64_t channelOffset;
+		uint64_t stringOffset;
+		uint64_t stringSize;
+	};
+
+	struct NodeRecord {
+		int32_t parent;				// nodes are stored depth first, -1 for the root node
+		uint32_t nameOffset;		// offset/length into the string block
+		uint32_t nameLength;
+		float transformation[16];	// column major
+	};
+
+	struct TrackRecord {
+		uint64_t dataOffset;
+		uint32_t encoding;			// TrackEncoding
+		uint32_t keyCount;
+		float min[3];				// quantization range of positions and scales
+		float extent[3];
+	};
+
+	struct ChannelRecord {
+		uint32_t nameOffset;
+		uint32_t nameLength;
+		TrackRecord tracks[3];		// position, rotation, scale
+	};
+
+	/// <summary>
+	/// Returns the path of the clip file belonging to a source asset.
+	/// </summary>
+	static std::string clipPath(const std::string& sourcePath)
+	{
+		return sourcePath + ".animclip";
+	}
+
+	/// <summary>
+	/// Loads the first animation of a source asset from its clip file.
+	/// The clip is converted from the source with assimp and written if it is missing or out of date.
+	/// </summary>
+	/// <param name="sourcePath">The path of the source asset.</param>
+	/// <param name="model">The model for this animation.</param>
+	static Animation Load(const std::string& sourcePath, Model* model, const Settings& settings = Settings())
+	{
+		uint64_t sourceHash = 0;
+		ModelCache::sourceKey(sourcePath, sourceHash);
+
+		MappedFile clip;
+		if (clip.open(clipPath(sourcePath)) && validate(clip.data(), clip.size(), sourceHash))
+			return decode(clip.data(), model->GetBoneInfoMap(), model->GetBoneCount());
+		// release the stale clip before it is replaced, a mapped file can't be replaced on Windows
+		clip.close();
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(sourcePath, aiProcess_Triangulate);
+		assert(scene && scene->mRootNode && scene->mNumAnimations > 0);
+		std::vector<unsigned char> bytes = encode(scene->mAnimations[0], scene->mRootNode, sourceHash, settings);
+		if (!write(clipPath(sourcePath), bytes))
+			std::cout << "ERROR::ANIMATIONCLIP::WRITE_FAILED " << clipPath(sourcePath) << std::endl;
+		return decode(bytes.data(), model->GetBoneInfoMap(), model->GetBoneCount());
+	}
+
+	/// <summary>
+	/// Resamples, reduces and quantizes an animation.
+	/// </summary>
+	/// <param name="animation">The animation.</param>
+	/// <param name="root">The root node of the hierarchy.</param>
+	/// <param name="sourceHash">The hash of the source asset, stored as key.</param>
+	/// <param name="stats">Receives sizes and errors, can be nullptr.</param>
+	/// <returns>The content of the clip file.</returns>
+	static std::vector<unsigned char> encode(const aiAnimation* animation, const aiNode* root, uint64_t sourceHash, const Settings& settings = Settings(), Stats* stats = nullptr)
+	{
+		Stats localStats;
+		Stats& s = stats ? *stats : localStats;
+		s = Stats();
+
+		Header header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.sourceHash = sourceHash;
+		header.duration = (float)animation->mDuration;
+		// assimp leaves the rate at 0 if the file doesn't specify it
+		header.ticksPerSecond = animation->mTicksPerSecond != 0.0 ? (float)animation->mTicksPerSecond : 25.0f;
+		float seconds = header.duration / header.ticksPerSecond;
+		// frame numbers of sparse tracks are 16 bits
+		header.frameCount = (uint32_t)std::min(65535.0f, std::max(2.0f, std::round(seconds * settings.sampleRate) + 1.0f));
+		float tickStep = header.duration / (header.frameCount - 1);
+
+		std::vector<NodeRecord> nodes;
+		std::string strings;
+		collectNodes(root, -1, nodes, strings);
+
+		std::vector<ChannelRecord> channels(animation->mNumChannels);
+		std::vector<unsigned char> trackData;
+		std::vector<glm::vec3> positions(header.frameCount), scales(header.frameCount);
+		std::vector<glm::quat> rotations(header.frameCount);
+		for (unsigned int c = 0; c < animation->mNumChannels; c++)
+		{
+			const aiNodeAnim* channel = animation->mChannels[c];
+			ChannelRecord& record = channels[c];
+			std::string name = channel->mNodeName.data;
+			record.nameOffset = (uint32_t)strings.size();
+			record.nameLength = (uint32_t)name.size();
+			strings += name;
+
+			// resample the channel with the interpolation used for playback
+			Bone bone(name, 0, channel);
+			BoneCursor cursor;
+			for (uint32_t f = 0; f < header.frameCount; f++)
+			{
+				float time = std::min(f * tickStep, header.duration);
+				positions[f] = bone.InterpolatePosition(time, cursor.position);
+				rotations[f] = bone.InterpolateRotation(time, cursor.rotation);
+				scales[f] = bone.InterpolateScaling(time, cursor.scale);
+			}
+
+			s.sourceKeys += channel->mNumPositionKeys + channel->mNumRotationKeys + channel->mNumScalingKeys;
+			s.sourceBytes += channel->mNumPositionKeys * (sizeof(float) + sizeof(glm::vec3))
+				+ channel->mNumRotationKeys * (sizeof(float) + sizeof(glm::quat))
+				+ channel->mNumScalingKeys * (sizeof(float) + sizeof(glm::vec3));
+
+			encodeTrack(positions, settings.positionTolerance, record.tracks[0], trackData, s.maxPositionError, s);
+			encodeTrack(rotations, settings.rotationTolerance, record.tracks[1], trackData, s.maxRotationError, s);
+			encodeTrack(scales, settings.scaleTolerance, record.tracks[2], trackData, s.maxScaleError, s);
+		}
+
+		header.nodeCount = (uint32_t)nodes.size();
+		header.channelCount = (uint32_t)channels.size();
+		header.nodeOffset = sizeof(Header);
+		header.channelOffset = align(header.nodeOffset + nodes.size() * sizeof(NodeRecord), 8);
+		uint64_t dataOffset = align(header.channelOffset + channels.size() * sizeof(ChannelRecord), 8);
+		header.stringOffset = dataOffset + trackData.size();
+		header.stringSize = strings.size();
+		for (ChannelRecord& channel : channels)
+			for (TrackRecord& track : channel.tracks)
+				track.dataOffset += dataOffset;
+
+		std::vector<unsigned char> bytes((size_t)(header.stringOffset + header.stringSize), 0);
+		memcpy(bytes.data(), &header, sizeof(Header));
+		if (!nodes.empty())
+			memcpy(bytes.data() + header.nodeOffset, nodes.data(), nodes.size() * sizeof(NodeRecord));
+		if (!channels.empty())
+			memcpy(bytes.data() + header.channelOffset, channels.data(), channels.size() * sizeof(ChannelRecord));
+		if (!trackData.empty())
+			memcpy(bytes.data() + dataOffset, trackData.data(), trackData.size());
+		if (!strings.empty())
+			memcpy(bytes.data() + header.stringOffset, strings.data(), strings.size());
+		s.compressedBytes = bytes.size();
+		return bytes;
+	}
+
+	/// <summary>
+	/// Writes a clip file. The clip is written to a temporary file first and renamed over the old one,
+	/// so a crash or a second process never leaves a half written clip behind.
+	/// </summary>
+	static bool write(const std::string& path, const std::vector<unsigned char>& bytes)
+	{
+		std::string tmpPath = path + ".tmp";
+		{
+			std::ofstream file(tmpPath, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+			file.write((const char*)bytes.data(), bytes.size());
+			if (!file) {
+				file.close();
+				std::remove(tmpPath.c_str());
+				return false;
+			}
+		}
+		std::remove(path.c_str());
+		if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+			std::remove(tmpPath.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Checks a clip before decoding it, a truncated or outdated clip is treated like a missing one.
+	/// </summary>
+	static bool validate(const unsigned char* data, size_t size, uint64_t sourceHash)
+	{
+		if (size < sizeof(Header))
+			return false;
+		const Header* header = (const Header*)data;
+		if (header->magic != MAGIC ||
+			header->version != VERSION ||
+			header->sourceHash != sourceHash ||
+			header->frameCount < 2 ||
+			header->nodeOffset + (uint64_t)header->nodeCount * sizeof(NodeRecord) > size ||
+			header->channelOffset + (uint64_t)header->channelCount * sizeof(ChannelRecord) > size ||
+			header->stringOffset + header->stringSize > size)
+			return false;
+		const ChannelRecord* channels = (const ChannelRecord*)(data + header->channelOffset);
+		for (uint32_t c = 0; c < header->channelCount; c++)
+		{
+			for (int t = 0; t < 3; t++)
+			{
+				const TrackRecord& track = channels[c].tracks[t];
+				if (track.keyCount == 0 || track.dataOffset + trackSize(track, t == 1) > size)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Creates the animation from a validated clip.
+	/// </summary>
+	/// <param name="boneInfoMap">The bones of the model, bones only found in the clip are added.</param>
+	/// <param name="boneCount">The bone count of the model, incremented for every added bone.</param>
+	static Animation decode(const unsigned char* data, std::map<std::string, BoneInfo>& boneInfoMap, int& boneCount)
+	{
+		const Header* header = (const Header*)data;
+		const NodeRecord* nodes = (const NodeRecord*)(data + header->nodeOffset);
+		const ChannelRecord* channels = (const ChannelRecord*)(data + header->channelOffset);
+		const char* strings = (const char*)(data + header->stringOffset);
+		float tickStep = header->duration / (header->frameCount - 1);
+
+		std::vector<Bone> bones;
+		bones.reserve(header->channelCount);
+		for (uint32_t c = 0; c < header->channelCount; c++)
+		{
+			const ChannelRecord& channel = channels[c];
+			std::string name(strings + channel.nameOffset, channel.nameLength);
+			KeyTrack<glm::vec3> positions;
+			KeyTrack<glm::quat> rotations;
+			KeyTrack<glm::vec3> scales;
+			decodeTrack(data, channel.tracks[0], tickStep, positions);
+			decodeTrack(data, channel.tracks[1], tickStep, rotations);
+			decodeTrack(data, channel.tracks[2], tickStep, scales);
+			int id = Animation::RegisterBone(name, boneInfoMap, boneCount);
+			bones.emplace_back(name, id, std::move(positions), std::move(rotations), std::move(scales));
+		}
+
+		AssimpNodeData root;
+		uint32_t next = 0;
+		if (header->nodeCount > 0)
+			readNode(nodes, header->nodeCount, strings, next, root);
+		return Animation(header->duration, (int)header->ticksPerSecond, root, std::move(bones), boneInfoMap);
+	}
+
+private:
+	static uint64_t align(uint64_t offset, uint64_t alignment)
+	{
+		return (offset + alignment - 1) / alignment * alignment;
+	}
+
+	static void pad(std::vector<unsigned char>& data, size_t alignment)
+	{
+		data.resize((size_t)align(data.size(), alignment), 0);
+	}
+
+	static void append(std::vector<unsigned char>& data, const void* bytes, size_t size)
+	{
+		const unsigned char* begin = (const unsigned char*)bytes;
+		data.insert(data.end(), begin, begin + size);
+	}
+
+	// bytes of the track data, frame numbers are padded to 4 bytes
+	static uint64_t trackSize(const TrackRecord& track, bool rotation)
+	{
+		if (track.encoding == TRACK_CONSTANT)
+			return rotation ? 4 * sizeof(float) : 3 * sizeof(float);
+		uint64_t size = (uint64_t)track.keyCount * 3 * sizeof(uint16_t);
+		if (track.encoding == TRACK_SPARSE)
+			size += align((uint64_t)track.keyCount * sizeof(uint16_t), 4);
+		return size;
+	}
+
+	/* Hierarchy */
+
+	static void collectNodes(const aiNode* node, int parent, std::vector<NodeRecord>& nodes, std::string& strings)
+	{
+		NodeRecord record;
+		record.parent = parent;
+		record.nameOffset = (uint32_t)strings.size();
+		record.nameLength = (uint32_t)node->mName.length;
+		strings.append(node->mName.data, node->mName.length);
+		glm::mat4 transformation = AssimpGLMHelpers::ConvertMatrixToGLMFormat(node->mTransformation);
+		memcpy(record.transformation, &transformation[0][0], sizeof(record.transformation));
+		nodes.push_back(record);
+
+		int index = (int)nodes.size() - 1;
+		for (unsigned int i = 0; i < node->mNumChildren; i++)
+			collectNodes(node->mChildren[i], index, nodes, strings);
+	}
+
+	// rebuilds the tree, the children of a node follow it directly in depth first order
+	static void readNode(const NodeRecord* nodes, uint32_t count, const char* strings, uint32_t& next, AssimpNodeData& dest)
+	{
+		uint32_t index = next++;
+		dest.name = std::string(strings + nodes[index].nameOffset, nodes[index].nameLength);
+		memcpy(&dest.transformation[0][0], nodes[index].transformation, sizeof(nodes[index].transformation));
+		while (next < count && nodes[next].parent == (int32_t)index)
+		{
+			dest.children.push_back(AssimpNodeData());
+			readNode(nodes, count, strings, next, dest.children.back());
+		}
+		dest.childrenCount = (int)dest.children.size();
+	}
+
+	/* Keys: error, interpolation and quantization of both key types */
+
+	static float keyError(const glm::vec3& a, const glm::vec3& b)
+	{
+		return glm::length(a - b);
+	}
+
+	// angle between the rotations, q and -q are the same rotation
+	static float keyError(const glm::quat& a, const glm::quat& b)
+	{
+		float d = std::min(1.0f, std::fabs(glm::dot(a, b)));
+		return 2.0f * std::acos(d);
+	}
+
+	// same as Bone
+	static glm::vec3 interpolate(const glm::vec3& a, const glm::vec3& b, float factor)
+	{
+		return glm::mix(a, b, factor);
+	}
+
+	static glm::quat interpolate(const glm::quat& a, const glm::quat& b, float factor)
+	{
+		return glm::normalize(glm::slerp(a, b, factor));
+	}
+
+	static void setRange(const std::vector<glm::vec3>& samples, TrackRecord& track)
+	{
+		glm::vec3 lo = samples[0], hi = samples[0];
+		for (const glm::vec3& sample : samples)
+		{
+			lo = glm::min(lo, sample);
+			hi = glm::max(hi, sample);
+		}
+		for (int i = 0; i < 3; i++)
+		{
+			track.min[i] = lo[i];
+			track.extent[i] = hi[i] - lo[i];
+		}
+	}
+
+	static void setRange(const std::vector<glm::quat>&, TrackRecord& track)
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			track.min[i] = -1.0f;
+			track.extent[i] = 2.0f;
+		}
+	}
+
+	static uint16_t quantize(float value, float maximum)
+	{
+		return (uint16_t)std::round(std::min(1.0f, std::max(0.0f, value)) * maximum);
+	}
+
+	static void pack(const glm::vec3& value, const TrackRecord& track, uint16_t* out)
+	{
+		for (int i = 0; i < 3; i++)
+			out[i] = track.extent[i] > 0.0f ? quantize((value[i] - track.min[i]) / track.extent[i], 65535.0f) : 0;
+	}
+
+	static void unpack(const uint16_t* in, const TrackRecord& track, glm::vec3& value)
+	{
+		for (int i = 0; i < 3; i++)
+			value[i] = track.min[i] + in[i] / 65535.0f * track.extent[i];
+	}
+
+	// smallest three: the other components of a unit quaternion are within +-1/sqrt(2),
+	// 15 bits each, the index of the dropped component in the top bits of the first two
+	static void pack(const glm::quat& value, const TrackRecord&, uint16_t* out)
+	{
+		glm::quat q = glm::normalize(value);
+		float components[4] = { q.x, q.y, q.z, q.w };
+		int largest = 0;
+		for (int i = 1; i < 4; i++)
+			if (std::fabs(components[i]) > std::fabs(components[largest]))
+				largest = i;
+		// q and -q are the same rotation, the dropped component is always positive
+		float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+		uint16_t small[3];
+		for (int i = 0, j = 0; i < 4; i++)
+			if (i != largest)
+				small[j++] = quantize((components[i] * sign * SQRT2 + 1.0f) * 0.5f, 32767.0f);
+		out[0] = (uint16_t)(small[0] | (largest & 1) << 15);
+		out[1] = (uint16_t)(small[1] | (largest >> 1) << 15);
+		out[2] = small[2];
+	}
+
+	static void unpack(const uint16_t* in, const TrackRecord&, glm::quat& value)
+	{
+		int largest = (in[0] >> 15) | (in[1] >> 15) << 1;
+		float small[3];
+		for (int i = 0; i < 3; i++)
+			small[i] = ((in[i] & 0x7FFF) / 32767.0f * 2.0f - 1.0f) / SQRT2;
+		float components[4];
+		float sum = 0.0f;
+		for (int i = 0, j = 0; i < 4; i++)
+		{
+			if (i == largest)
+				continue;
+			components[i] = small[j++];
+			sum += components[i] * components[i];
+		}
+		components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+		value = glm::normalize(glm::quat(components[3], components[0], components[1], components[2]));
+	}
+
+	static void writeConstant(std::vector<unsigned char>& data, const glm::vec3& value)
+	{
+		float components[3] = { value.x, value.y, value.z };
+		append(data, components, sizeof(components));
+	}
+
+	static void writeConstant(std::vector<unsigned char>& data, const glm::quat& value)
+	{
+		float components[4] = { value.x, value.y, value.z, value.w };
+		append(data, components, sizeof(components));
+	}
+
+	static void readConstant(const unsigned char* data, glm::vec3& value)
+	{
+		float components[3];
+		memcpy(components, data, sizeof(components));
+		value = glm::vec3(components[0], components[1], components[2]);
+	}
+
+	static void readConstant(const unsigned char* data, glm::quat& value)
+	{
+		float components[4];
+		memcpy(components, data, sizeof(components));
+		value = glm::quat(components[3], components[0], components[1], components[2]);
+	}
+
+	static constexpr float SQRT2 = 1.41421356f;
+
+	/* Tracks */
+
+	// largest error of the frames between two kept keys
+	template<typename T>
+	static float segmentError(const std::vector<T>& decoded, const std::vector<T>& samples, uint32_t first, uint32_t last)
+	{
+		float error = 0.0f;
+		for (uint32_t f = first + 1; f < last; f++)
+		{
+			T value = interpolate(decoded[first], decoded[last], (float)(f - first) / (last - first));
+			error = std::max(error, keyError(value, samples[f]));
+		}
+		return error;
+	}
+
+	template<typename T>
+	static void encodeTrack(const std::vector<T>& samples, float tolerance, TrackRecord& track, std::vector<unsigned char>& data, float& maxError, Stats& stats)
+	{
+		const uint32_t frameCount = (uint32_t)samples.size();
+		track = TrackRecord();
+		pad(data, 4);
+		track.dataOffset = data.size();
+
+		// constant track
+		float constantError = 0.0f;
+		for (const T& sample : samples)
+			constantError = std::max(constantError, keyError(samples[0], sample));
+		if (constantError <= tolerance)
+		{
+			track.encoding = TRACK_CONSTANT;
+			track.keyCount = 1;
+			writeConstant(data, samples[0]);
+			maxError = std::max(maxError, constantError);
+			stats.constantTracks++;
+			stats.storedKeys++;
+			return;
+		}
+
+		setRange(samples, track);
+		std::vector<uint16_t> quantized(frameCount * 3);
+		std::vector<T> decoded(frameCount);
+		for (uint32_t f = 0; f < frameCount; f++)
+		{
+			pack(samples[f], track, &quantized[f * 3]);
+			unpack(&quantized[f * 3], track, decoded[f]);
+		}
+
+		// redundant keys: every segment is extended as long as the frames it skips are interpolated within the tolerance
+		std::vector<uint16_t> kept(1, 0);
+		float sparseError = keyError(decoded[0], samples[0]);
+		for (uint32_t first = 0; first < frameCount - 1;)
+		{
+			uint32_t last = first + 1;
+			while (last + 1 < frameCount && segmentError(decoded, samples, first, last + 1) <= tolerance)
+				last++;
+			sparseError = std::max(sparseError, std::max(segmentError(decoded, samples, first, last), keyError(decoded[last], samples[last])));
+			kept.push_back((uint16_t)last);
+			first = last;
+		}
+
+		size_t uniformSize = frameCount * 3 * sizeof(uint16_t);
+		size_t sparseSize = (size_t)align(kept.size() * sizeof(uint16_t), 4) + kept.size() * 3 * sizeof(uint16_t);
+		if (sparseSize < uniformSize)
+		{
+			track.encoding = TRACK_SPARSE;
+			track.keyCount = (uint32_t)kept.size();
+			append(data, kept.data(), kept.size() * sizeof(uint16_t));
+			pad(data, 4);
+			for (uint16_t frame : kept)
+				append(data, &quantized[frame * 3], 3 * sizeof(uint16_t));
+			maxError = std::max(maxError, sparseError);
+			stats.sparseTracks++;
+		}
+		else
+		{
+			track.encoding = TRACK_UNIFORM;
+			track.keyCount = frameCount;
+			append(data, quantized.data(), quantized.size() * sizeof(uint16_t));
+			for (uint32_t f = 0; f < frameCount; f++)
+				maxError = std::max(maxError, keyError(decoded[f], samples[f]));
+			stats.uniformTracks++;
+		}
+		stats.storedKeys += track.keyCount;
+	}
+
+	template<typename T>
+	static void decodeTrack(const unsigned char* data, const TrackRecord& track, float tickStep, KeyTrack<T>& keys)
+	{
+		const unsigned char* bytes = data + track.dataOffset;
+		keys.timeStamps.resize(track.keyCount);
+		keys.values.resize(track.keyCount);
+		if (track.encoding == TRACK_CONSTANT)
+		{
+			keys.timeStamps[0] = 0.0f;
+			readConstant(bytes, keys.values[0]);
+			return;
+		}
+
+		if (track.encoding == TRACK_SPARSE)
+		{
+			const uint16_t* frames = (const uint16_t*)bytes;
+			for (uint32_t i = 0; i < track.keyCount; i++)
+				keys.timeStamps[i] = frames[i] * tickStep;
+			bytes += align(track.keyCount * sizeof(uint16_t), 4);
+		}
+		else
+		{
+			for (uint32_t i = 0; i < track.keyCount; i++)
+				keys.timeStamps[i] = i * tickStep;
+		}
+
+		const uint16_t* quantized = (const uint16_t*)bytes;
+		for (uint32_t i = 0; i < track.keyCount; i++)
+			unpack(quantized + i * 3, track, keys.values[i]);
+	}
+};
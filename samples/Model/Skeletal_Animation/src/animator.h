@@ -8,6 +8,9 @@
 #include "animation.h"
 #include "bone.h"
 
+// size of the bone matrix array of the shaders
+const int MAX_BONES = 100;
+
 /// <summary>
 /// reads the hierarchy of AssimpNodeData, Interpolate all bones in a recursive manner &
 /// then prepare final bone transformation matrices
@@ -19,20 +22,34 @@ public:
 	/// Initializes a new instance of the <see cref="Animator"/> class.
 	/// </summary>
 	/// <param name="animation">The animation ot play</param>
-	Animator(Animation* animation)
+	/// <param name="ownBoneMatrices">false for animators that only write to external memory (crowds, baking),
+	/// they skip the MAX_BONES matrices of UpdateAnimation(dt) and GetFinalBoneMatrices().</param>
+	Animator(Animation* animation, bool ownBoneMatrices = true)
 	{
 		currentTime = 0.0;
 		currentAnimation = animation;
-
-		// reserve memory for final bone matrices
-		finalBoneMatrices.reserve(100);
+		ResetCursors();
 
 		// init bone matrices with 1.0
-		for (int i = 0; i < 100; i++)
-			finalBoneMatrices.push_back(glm::mat4(1.0f));
+		if (ownBoneMatrices)
+			finalBoneMatrices.assign(MAX_BONES, glm::mat4(1.0f));
 	}
 
+	/// <summary>
+	/// Advances the animation and writes the bone matrices to the animator's own matrices.
+	/// Only valid for animators constructed with ownBoneMatrices.
+	/// </summary>
 	void UpdateAnimation(float dt)
+	{
+		UpdateAnimation(dt, finalBoneMatrices.data());
+	}
+
+	/// <summary>
+	/// Advances the animation and writes the bone matrices to external memory,
+	/// e.g. the part of a crowd's shared palette buffer that belongs to this animator.
+	/// </summary>
+	/// <param name="boneMatrices">Receives the matrix of every bone id of the animation.</param>
+	void UpdateAnimation(float dt, glm::mat4* boneMatrices)
 	{
 		deltaTime = dt;
 		// if animation is existing
@@ -42,57 +59,70 @@ public:
 			currentTime += currentAnimation->GetTicksPerSecond() * dt;
 			currentTime = fmod(currentTime, currentAnimation->GetDuration());
 			// calculates bone transform for current time
-			// start with identity matrix glm::mat4(1.0f) & root node of currentAnimation
-			CalculateBoneTransform(&currentAnimation->GetRootNode(), glm::mat4(1.0f));
+			CalculateBoneTransform(boneMatrices);
 		}
 	}
 
+	/// <summary>
+	/// Jumps to a point of the animation, the pose is calculated by the next update.
+	/// </summary>
+	/// <param name="time">The animation time in ticks.</param>
+	void SetCurrentTime(float time)
+	{
+		currentTime = time;
+	}
+
 	void PlayAnimation(Animation* pAnimation)
 	{
 		currentAnimation = pAnimation;
 		currentTime = 0.0f;	// reset current time
+		ResetCursors();
 	}
 
-	void CalculateBoneTransform(const AssimpNodeData* node, glm::mat4 parentTransform)
+	/// <summary>
+	/// Evaluates the pose at the current time over the flattened skeleton of the animation.
+	/// Parents are stored before their children, so their global transform is always ready.
+	/// </summary>
+	void CalculateBoneTransform(glm::mat4* boneMatrices)
 	{
-		std::string nodeName = node->name;
-		glm::mat4 nodeTransform = node->transformation;
-
-		// find bone name in current animation
-		Bone* Bone = currentAnimation->FindBone(nodeName);
-
-		if (Bone)
+		const std::vector<SkeletonNode>& skeleton = currentAnimation->GetSkeleton();
+		std::vector<Bone>& bones = currentAnimation->GetBones();
+		for (size_t i = 0; i < skeleton.size(); i++)
 		{
-			// interpolates all bone transforms
-			Bone->Update(currentTime);
-			// query bone's local transform
-			nodeTransform = Bone->GetLocalTransform();
-		}
+			const SkeletonNode& node = skeleton[i];
+			glm::mat4 nodeTransform = node.transformation;
+			if (node.bone >= 0)
+			{
+				// interpolates the bone transform, starting at the keys of the last frame of this animator
+				nodeTransform = bones[node.bone].Sample(currentTime, boneCursors[node.bone]);
+			}
 
-		// multiply bone with parent transform to bring from local space to global space
-		glm::mat4 globalTransformation = parentTransform * nodeTransform;
+			// multiply bone with parent transform to bring from local space to global space
+			glm::mat4& globalTransformation = globalTransforms[i];
+			globalTransformation = node.parent >= 0 ? globalTransforms[node.parent] * nodeTransform : nodeTransform;
 
-		auto boneInfoMap = currentAnimation->GetBoneIDMap();
-		if (boneInfoMap.find(nodeName) != boneInfoMap.end())
-		{
-			int index = boneInfoMap[nodeName].id;
-			glm::mat4 offset = boneInfoMap[nodeName].offset;
-			finalBoneMatrices[index] = globalTransformation * offset;
-		}
-
-		// recursively loop over children bones
-		for (int i = 0; i < node->childrenCount; i++) {
-			CalculateBoneTransform(&node->children[i], globalTransformation);
+			if (node.boneID >= 0)
+				boneMatrices[node.boneID] = globalTransformation * node.offset;
 		}
 	}
 
-	std::vector<glm::mat4> GetFinalBoneMatrices()
+	const std::vector<glm::mat4>& GetFinalBoneMatrices() const
 	{
 		return finalBoneMatrices;
 	}
 
 private:
+	// one playback position per bone, several animators can play the same animation
+	void ResetCursors()
+	{
+		boneCursors.assign(currentAnimation ? currentAnimation->GetBones().size() : 0, BoneCursor());
+		globalTransforms.resize(currentAnimation ? currentAnimation->GetSkeleton().size() : 0);
+	}
+
 	std::vector<glm::mat4> finalBoneMatrices;
+	std::vector<BoneCursor> boneCursors;
+	// global transform per skeleton node of the current pose
+	std::vector<glm::mat4> globalTransforms;
 	Animation* currentAnimation;
 	float currentTime;
 	float deltaTime;
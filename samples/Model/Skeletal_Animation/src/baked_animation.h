@@ -0,0 +1,114 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include "animator.h"
+
+/// <summary>
+/// Animation clips sampled at a fixed rate into a float texture of bone matrices, so the vertex
+/// shader evaluates the pose of an instance by texture fetches, without any Animator work on the CPU.
+/// Every frame is one texture row with the 3 affine rows of every bone (3 * boneCount RGBA32F texels),
+/// the clips are stacked on top of each other. Each clip ends with a copy of its first frame, so
+/// linear filtering between two rows also interpolates over the loop.
+/// </summary>
+class BakedAnimation
+{
+public:
+	struct Clip {
+		unsigned int firstRow;		// row of frame 0
+		unsigned int frameCount;	// frames of the loop, without the copy of frame 0
+		float framesPerSecond;		// frames per second of playback at speed 1
+	};
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="BakedAnimation"/> class.
+	/// </summary>
+	/// <param name="boneCount">Bone matrices per frame, the bone count of the model after loading all clips.</param>
+	/// <param name="sampleRate">Frames per second the clips are sampled at.</param>
+	BakedAnimation(int boneCount, float sampleRate = 30.0f)
+		: boneCount(boneCount), sampleRate(sampleRate)
+	{
+	}
+
+	~BakedAnimation()
+	{
+		if (texture)
+			glDeleteTextures(1, &texture);
+	}
+
+	BakedAnimation(const BakedAnimation&) = delete;
+	BakedAnimation& operator=(const BakedAnimation&) = delete;
+
+	/// <summary>
+	/// Samples a clip. Works on the CPU data only, call Upload() afterwards.
+	/// </summary>
+	/// <returns>The index of the clip.</returns>
+	unsigned int AddClip(Animation* animation)
+	{
+		// whole frames over the loop, the rate is adjusted slightly so the last frame meets the first
+		float seconds = animation->GetDuration() / animation->GetTicksPerSecond();
+		Clip clip;
+		clip.firstRow = GetRowCount();
+		clip.frameCount = (unsigned int)std::max(1.0f, std::round(seconds * sampleRate));
+		clip.framesPerSecond = clip.frameCount / seconds;
+		clips.push_back(clip);
+
+		Animator animator(animation, false);
+		texels.reserve(texels.size() + (clip.frameCount + 1) * GetWidth());
+		std::vector<glm::mat4> matrices(boneCount, glm::mat4(1.0f));
+		const size_t width = GetWidth();
+		for (unsigned int frame = 0; frame < clip.frameCount; frame++)
+		{
+			animator.SetCurrentTime(animation->GetDuration() * frame / clip.frameCount);
+			animator.CalculateBoneTransform(matrices.data());
+			for (int bone = 0; bone < boneCount; bone++)
+			{
+				const glm::mat4& m = matrices[bone];
+				// glm is column major, the rows are gathered from the columns
+				texels.push_back(glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]));
+				texels.push_back(glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]));
+				texels.push_back(glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]));
+			}
+		}
+		// copy of frame 0 to interpolate over the loop, the space is reserved so the source stays valid
+		for (size_t i = 0; i < width; i++)
+			texels.push_back(texels[clip.firstRow * width + i]);
+		return (unsigned int)clips.size() - 1;
+	}
+
+	/// <summary>
+	/// Creates (or replaces) the texture from the sampled clips. Must be called on the GL thread.
+	/// </summary>
+	/// <returns>The GL name of the texture.</returns>
+	unsigned int Upload()
+	{
+		if (!texture)
+			glGenTextures(1, &texture);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, GetWidth(), GetRowCount(), 0, GL_RGBA, GL_FLOAT, texels.data());
+		// linear filtering interpolates between frames, lookups at texel centers keep the bones apart
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texture;
+	}
+
+	const Clip& GetClip(unsigned int index) const { return clips[index]; }
+	unsigned int GetClipCount() const { return (unsigned int)clips.size(); }
+	int GetBoneCount() const { return boneCount; }
+	unsigned int GetWidth() const { return (unsigned int)boneCount * 3; }
+	unsigned int GetRowCount() const { return (unsigned int)(texels.size() / GetWidth()); }
+	unsigned int GetTexture() const { return texture; }
+	const std::vector<glm::vec4>& GetTexels() const { return texels; }
+
+private:
+	int boneCount;
+	float sampleRate;
+	std::vector<Clip> clips;
+	std::vector<glm::vec4> texels;
+	unsigned int texture = 0;
+};
@@ -3,6 +3,7 @@
 /* Container for bone data */
 
 #include <vector>
+#include <algorithm>
 #include <assimp/scene.h>
 #include <list>
 #include <glm/glm.hpp>
@@ -10,25 +11,71 @@
 #include <glm/gtx/quaternion.hpp>
 #include "assimp_glm_helpers.h"
 
-// structs for each keyframe type 
-// translation, rotation & scale
-
-struct KeyPosition
+/// <summary>
+/// keyframes of one transformation type (translation, rotation or scale)
+/// stored as structure of arrays: the key lookup only touches the timestamps,
+/// the values are read once the segment has been found
+/// </summary>
+template<typename T>
+struct KeyTrack
 {
-	glm::vec3 position;
-	float timeStamp; // tells at what point of an animation the value needs to be used for interpolation
-};
+	std::vector<float> timeStamps;	// tells at what point of an animation the value needs to be used for interpolation
+	std::vector<T> values;
 
-struct KeyRotation
-{
-	glm::quat orientation;
-	float timeStamp;
+	int size() const { return (int)timeStamps.size(); }
+
+	/// <summary>
+	/// Finds the segment [index, index + 1] containing animationTime.
+	/// Starts at the cursor of the last lookup, so forward playback only checks the next key(s);
+	/// seeks backwards (e.g. the loop of the animation) or far ahead use a binary search.
+	/// </summary>
+	/// <param name="cursor">Segment of the last lookup of the same playback, updated.</param>
+	int FindSegment(float animationTime, int& cursor) const
+	{
+		const int last = size() - 2;
+		int index = cursor < 0 ? 0 : (cursor > last ? last : cursor);
+		if (animationTime >= timeStamps[index])
+		{
+			// forward playback: usually the same or the next segment
+			const int MAX_STEPS = 4;
+			int steps = 0;
+			while (index < last && animationTime >= timeStamps[index + 1] && steps < MAX_STEPS)
+			{
+				index++;
+				steps++;
+			}
+			if (steps < MAX_STEPS || index == last || animationTime < timeStamps[index + 1])
+			{
+				cursor = index;
+				return index;
+			}
+		}
+		// first key after animationTime, the segment starts one before
+		index = (int)(std::upper_bound(timeStamps.begin(), timeStamps.end(), animationTime) - timeStamps.begin()) - 1;
+		index = index < 0 ? 0 : (index > last ? last : index);
+		cursor = index;
+		return index;
+	}
+
+	/// <summary>
+	/// Ratio between timestamp of the segment keys based on anim time in range [0,1]
+	/// </summary>
+	float GetScaleFactor(int index, float animationTime) const
+	{
+		float midWayLength = animationTime - timeStamps[index];
+		float framesDiff = timeStamps[index + 1] - timeStamps[index];
+		return glm::clamp(midWayLength / framesDiff, 0.0f, 1.0f);
+	}
 };
 
-struct KeyScale
+/// <summary>
+/// playback position of an animation instance in the key tracks of a bone
+/// </summary>
+struct BoneCursor
 {
-	glm::vec3 scale;
-	float timeStamp;
+	int position = 0;
+	int rotation = 0;
+	int scale = 0;
 };
 
 /// <summary>
@@ -53,57 +100,78 @@ public:
 		localTransform(1.0f)
 	{
 		// read & store position
-		numPositions = channel->mNumPositionKeys;
-
-		for (int positionIndex = 0; positionIndex < numPositions; ++positionIndex)
+		positions.timeStamps.reserve(channel->mNumPositionKeys);
+		positions.values.reserve(channel->mNumPositionKeys);
+		for (unsigned int positionIndex = 0; positionIndex < channel->mNumPositionKeys; ++positionIndex)
 		{
-			aiVector3D aiPosition = channel->mPositionKeys[positionIndex].mValue;
-			float timeStamp = channel->mPositionKeys[positionIndex].mTime;
-			KeyPosition data;
-			data.position = AssimpGLMHelpers::GetGLMVec(aiPosition);
-			data.timeStamp = timeStamp;
-			positions.push_back(data);	
+			positions.timeStamps.push_back((float)channel->mPositionKeys[positionIndex].mTime);
+			positions.values.push_back(AssimpGLMHelpers::GetGLMVec(channel->mPositionKeys[positionIndex].mValue));
 		}
 
 		// read & store rotation
-		numRotations = channel->mNumRotationKeys;
-		for (int rotationIndex = 0; rotationIndex < numRotations; ++rotationIndex)
+		rotations.timeStamps.reserve(channel->mNumRotationKeys);
+		rotations.values.reserve(channel->mNumRotationKeys);
+		for (unsigned int rotationIndex = 0; rotationIndex < channel->mNumRotationKeys; ++rotationIndex)
 		{
-			aiQuaternion aiOrientation = channel->mRotationKeys[rotationIndex].mValue;
-			float timeStamp = channel->mRotationKeys[rotationIndex].mTime;
-			KeyRotation data;
-			data.orientation = AssimpGLMHelpers::GetGLMQuat(aiOrientation);
-			data.timeStamp = timeStamp;
-			rotations.push_back(data);
+			rotations.timeStamps.push_back((float)channel->mRotationKeys[rotationIndex].mTime);
+			rotations.values.push_back(AssimpGLMHelpers::GetGLMQuat(channel->mRotationKeys[rotationIndex].mValue));
 		}
 
 		// read & store scaling
-		numScalings = channel->mNumScalingKeys;
-		for (int keyIndex = 0; keyIndex < numScalings; ++keyIndex)
+		scales.timeStamps.reserve(channel->mNumScalingKeys);
+		scales.values.reserve(channel->mNumScalingKeys);
+		for (unsigned int keyIndex = 0; keyIndex < channel->mNumScalingKeys; ++keyIndex)
 		{
-			aiVector3D scale = channel->mScalingKeys[keyIndex].mValue;
-			float timeStamp = channel->mScalingKeys[keyIndex].mTime;
-			KeyScale data;
-			data.scale = AssimpGLMHelpers::GetGLMVec(scale);
-			data.timeStamp = timeStamp;
-			scales.push_back(data);
+			scales.timeStamps.push_back((float)channel->mScalingKeys[keyIndex].mTime);
+			scales.values.push_back(AssimpGLMHelpers::GetGLMVec(channel->mScalingKeys[keyIndex].mValue));
 		}
 	}
-	
+
+	/// <summary>
+	/// Initializes a new instance of the <see cref="Bone"/> class from decoded key tracks, e.g. of a compressed clip.
+	/// </summary>
+	Bone(const std::string& name, int ID, KeyTrack<glm::vec3>&& positions, KeyTrack<glm::quat>&& rotations, KeyTrack<glm::vec3>&& scales)
+		:
+		positions(std::move(positions)),
+		rotations(std::move(rotations)),
+		scales(std::move(scales)),
+		localTransform(1.0f),
+		name(name),
+		ID(ID)
+	{
+	}
+
 	/// <summary>
 	/// Main Interpolation process
 	/// Get's called every frame
+	/// Uses the cursor of the bone, animations played by several animators use Sample with their own cursors.
 	/// </summary>
 	/// <param name="animationTime">The animation time.</param>
 	void Update(float animationTime)
+	{
+		localTransform = Sample(animationTime, cursor);
+	}
+
+	/// <summary>
+	/// Interpolates the local transform at animationTime.
+	/// </summary>
+	/// <param name="cursor">Playback position of the calling animation instance, updated.</param>
+	glm::mat4 Sample(float animationTime, BoneCursor& cursor) const
 	{
 		// call of Interpolation for each Transformation
-		glm::mat4 translation = InterpolatePosition(animationTime);
-		glm::mat4 rotation = InterpolateRotation(animationTime);
-		glm::mat4 scale = InterpolateScaling(animationTime);
+		glm::vec3 translation = InterpolatePosition(animationTime, cursor.position);
+		glm::quat rotation = InterpolateRotation(animationTime, cursor.rotation);
+		glm::vec3 scale = InterpolateScaling(animationTime, cursor.scale);
 		// Combine final Interpolation Transformations to a single localTransform matrix
-		// NOTE: TRS-Transform 
-		localTransform = translation * rotation * scale;
+		// NOTE: TRS-Transform, composed directly: the columns of the rotation are scaled
+		// and the translation is the last column, no matrix products needed
+		glm::mat3 rotationMatrix = glm::mat3_cast(rotation);
+		glm::mat4 transform;
+		transform[0] = glm::vec4(rotationMatrix[0] * scale.x, 0.0f);
+		transform[1] = glm::vec4(rotationMatrix[1] * scale.y, 0.0f);
+		transform[2] = glm::vec4(rotationMatrix[2] * scale.z, 0.0f);
+		transform[3] = glm::vec4(translation, 1.0f);
+		return transform;
 	}
 
 	glm::mat4 GetLocalTransform() { return localTransform; }
@@ -114,118 +182,69 @@ public:
 
 	int GetPositionIndex(float animationTime)
 	{
-		for (int index = 0; index < numPositions - 1; ++index)
-		{
-			if (animationTime < positions[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return positions.FindSegment(animationTime, cursor.position);
 	}
 
 	int GetRotationIndex(float animationTime)
 	{
-		for (int index = 0; index < numRotations - 1; ++index)
-		{
-			if (animationTime < rotations[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return rotations.FindSegment(animationTime, cursor.rotation);
 	}
 
 	int GetScaleIndex(float animationTime)
 	{
-		for (int index = 0; index < numScalings - 1; ++index)
-		{
-			if (animationTime < scales[index + 1].timeStamp)
-				return index;
-		}
-		assert(0);
+		return scales.FindSegment(animationTime, cursor.scale);
 	}
 
 
-private:
-
-	/// <summary>
-	/// Calculates ratio between timestamp of p0 and p1 based on anim time
-	/// </summary>
-	/// <param name="lastTimeStamp">The last time stamp.</param>
-	/// <param name="nextTimeStamp">The next time stamp.</param>
-	/// <param name="animationTime">The animation time.</param>
-	/// <returns>Ratio between timestamps for interpolation in range [0,1]</returns>
-	float GetScaleFactor(float lastTimeStamp, float nextTimeStamp, float animationTime)
-	{
-		float scaleFactor = 0.0f;
-		float midWayLength = animationTime - lastTimeStamp;
-		float framesDiff = nextTimeStamp - lastTimeStamp;
-		scaleFactor = midWayLength / framesDiff;
-		return scaleFactor;
-	}
-
 	/* Interpolation functions */
 
-	glm::mat4 InterpolatePosition(float animationTime)
+	glm::vec3 InterpolatePosition(float animationTime, int& cursor) const
 	{
-		if (1 == numPositions)
-			return glm::translate(glm::mat4(1.0f), positions[0].position);
+		if (1 == positions.size())
+			return positions.values[0];
 
-		int p0Index = GetPositionIndex(animationTime);
-		int p1Index = p0Index + 1;
-
-		float scaleFactor = GetScaleFactor(positions[p0Index].timeStamp, positions[p1Index].timeStamp, animationTime);
+		int p0Index = positions.FindSegment(animationTime, cursor);
+		float scaleFactor = positions.GetScaleFactor(p0Index, animationTime);
 		// using mix/linear interpolation
-		glm::vec3 finalPosition = glm::mix(positions[p0Index].position, positions[p1Index].position, scaleFactor);
-		return glm::translate(glm::mat4(1.0f), finalPosition);
+		return glm::mix(positions.values[p0Index], positions.values[p0Index + 1], scaleFactor);
 	}
 
-	glm::mat4 InterpolateRotation(float animationTime)
+	glm::quat InterpolateRotation(float animationTime, int& cursor) const
 	{
-		if (1 == numRotations)
-		{
-			auto rotation = glm::normalize(rotations[0].orientation);
-			return glm::toMat4(rotation);
-		}
-
-		int p0Index = GetRotationIndex(animationTime);
-		int p1Index = p0Index + 1;
+		if (1 == rotations.size())
+			return glm::normalize(rotations.values[0]);
 
-		float scaleFactor = GetScaleFactor(rotations[p0Index].timeStamp, rotations[p1Index].timeStamp, animationTime);
+		int p0Index = rotations.FindSegment(animationTime, cursor);
+		float scaleFactor = rotations.GetScaleFactor(p0Index, animationTime);
 		// using spherical linear interpolation for rotation interpolation of quaternions
 		// first argument	- last key
 		// second argument	- next key
 		// third argument	- interpolation in range [0,1]
-		glm::quat finalRotation = glm::slerp(rotations[p0Index].orientation, rotations[p1Index].orientation, scaleFactor);
-		finalRotation = glm::normalize(finalRotation);
-		return glm::toMat4(finalRotation);
-
+		glm::quat finalRotation = glm::slerp(rotations.values[p0Index], rotations.values[p0Index + 1], scaleFactor);
+		return glm::normalize(finalRotation);
 	}
 
-	glm::mat4 InterpolateScaling(float animationTime)
+	glm::vec3 InterpolateScaling(float animationTime, int& cursor) const
 	{
-		if (1 == numScalings)
-			return glm::scale(glm::mat4(1.0f), scales[0].scale);
-
-		int p0Index = GetScaleIndex(animationTime);
-		int p1Index = p0Index + 1;
-
-		float scaleFactor = GetScaleFactor(scales[p0Index].timeStamp, scales[p1Index].timeStamp, animationTime);
+		if (1 == scales.size())
+			return scales.values[0];
 
+		int p0Index = scales.FindSegment(animationTime, cursor);
+		float scaleFactor = scales.GetScaleFactor(p0Index, animationTime);
 		// using mix/linear interpolation
-		glm::vec3 finalScale = glm::mix(scales[p0Index].scale, scales[p1Index].scale, scaleFactor);
-		return glm::scale(glm::mat4(1.0f), finalScale);
+		return glm::mix(scales.values[p0Index], scales.values[p0Index + 1], scaleFactor);
 	}
 
-	// keyframes list
-	std::vector<KeyPosition> positions;
-	std::vector<KeyRotation> rotations;
-	std::vector<KeyScale> scales;
+private:
+	// keyframe tracks
+	KeyTrack<glm::vec3> positions;
+	KeyTrack<glm::quat> rotations;
+	KeyTrack<glm::vec3> scales;
 
-	// length of each list
-	int numPositions;
-	int numRotations;
-	int numScalings;
+	// playback position of Update
+	BoneCursor cursor;
 
 	glm::mat4 localTransform;
 	std::string name;
 	int ID;
 };
-
@@ -0,0 +1,183 @@
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "modules/shader_m.h"
+
+#include <vector>
+
+enum BoneFormat {
+	BONE_FORMAT_MAT4,		// 4 columns, 64 bytes per bone
+	BONE_FORMAT_AFFINE,		// rows 0..2, 48 bytes per bone, the last row of a bone matrix is always (0, 0, 0, 1)
+};
+
+/// <summary>
+/// Bone matrices of a character in one uniform or shader storage buffer, written once per frame
+/// and bound with a single glBindBufferRange instead of a glUniform call per bone.
+/// GLSL:
+///		layout (std140) uniform BonePalette {	// BONE_FORMAT_AFFINE
+///			vec4 boneRows[MAX_BONES * 3];		// rows 0..2 of bone i at 3 * i
+///		};
+///		layout (std140) uniform BonePalette {	// BONE_FORMAT_MAT4
+///			mat4 bones[MAX_BONES];
+///		};
+/// With GL 4.4 the buffer is persistently mapped and split into REGIONS copies (see LightBuffer),
+/// the matrices are converted straight into the mapped copy the GPU is done with.
+/// Otherwise they are converted into a CPU copy and uploaded with glBufferSubData.
+/// </summary>
+class BonePalette
+{
+public:
+	// number of copies of a persistently mapped buffer (frames in flight)
+	static const unsigned int REGIONS = 3;
+
+	/// <param name="capacity">Bones of the palette, the array size of the shader block.</param>
+	BonePalette(unsigned int capacity, BoneFormat format = BONE_FORMAT_AFFINE, GLenum target = GL_UNIFORM_BUFFER, GLuint binding = 0)
+		: format(format), target(target), binding(binding), capacity(capacity)
+	{
+		stride = format == BONE_FORMAT_AFFINE ? 3 * sizeof(glm::vec4) : sizeof(glm::mat4);
+		dataSize = capacity * stride;
+
+		// every region must start at a valid offset for glBindBufferRange
+		GLint alignment = 1;
+		glGetIntegerv(target == GL_UNIFORM_BUFFER ? GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT : GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+		if (alignment < 1)
+			alignment = 1;
+		regionSize = (dataSize + alignment - 1) / alignment * alignment;
+
+		glGenBuffers(1, &buffer);
+		glBindBuffer(target, buffer);
+#ifdef GL_VERSION_4_4
+		if (GLAD_GL_VERSION_4_4)
+		{
+			regionCount = REGIONS;
+			GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+			glBufferStorage(target, regionSize * regionCount, NULL, flags);
+			mapped = (unsigned char*)glMapBufferRange(target, 0, regionSize * regionCount, flags);
+		}
+#endif
+		if (!mapped)
+		{
+			regionCount = 1;
+			staging.resize(dataSize);
+			glBufferData(target, regionSize, NULL, GL_DYNAMIC_DRAW);
+		}
+		glBindBuffer(target, 0);
+
+		for (unsigned int i = 0; i < REGIONS; i++)
+			fences[i] = 0;
+	}
+
+	~BonePalette()
+	{
+		for (unsigned int i = 0; i < REGIONS; i++)
+			if (fences[i])
+				glDeleteSync(fences[i]);
+		if (mapped)
+		{
+			glBindBuffer(target, buffer);
+			glUnmapBuffer(target);
+			glBindBuffer(target, 0);
+		}
+		glDeleteBuffers(1, &buffer);
+	}
+
+	BonePalette(const BonePalette&) = delete;
+	BonePalette& operator=(const BonePalette&) = delete;
+
+	BoneFormat getFormat() const { return format; }
+	bool isPersistent() const { return mapped != nullptr; }
+
+	/// <summary>
+	/// Writes the bone matrices of this frame and binds them to the binding point.
+	/// Call once per frame before the draws of the character.
+	/// </summary>
+	/// <param name="count">Number of matrices to write, the bone count of the model.</param>
+	void update(const glm::mat4* matrices, unsigned int count)
+	{
+		if (count > capacity)
+			count = capacity;
+
+		unsigned char* destination = staging.data();
+		if (mapped)
+		{
+			// the draws issued since the last update read the current region
+			if (fences[region])
+				glDeleteSync(fences[region]);
+			fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+			region = (region + 1) % regionCount;
+			if (fences[region])
+			{
+				glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+				glDeleteSync(fences[region]);
+				fences[region] = 0;
+			}
+			destination = mapped + region * regionSize;
+		}
+
+		if (format == BONE_FORMAT_AFFINE)
+		{
+			glm::vec4* rows = (glm::vec4*)destination;
+			for (unsigned int i = 0; i < count; i++)
+			{
+				const glm::mat4& m = matrices[i];
+				// glm is column major, the rows are gathered from the columns
+				rows[3 * i] = glm::vec4(m[0][0], m[1][0], m[2][0], m[3][0]);
+				rows[3 * i + 1] = glm::vec4(m[0][1], m[1][1], m[2][1], m[3][1]);
+				rows[3 * i + 2] = glm::vec4(m[0][2], m[1][2], m[2][2], m[3][2]);
+			}
+		}
+		else
+		{
+			glm::mat4* bones = (glm::mat4*)destination;
+			for (unsigned int i = 0; i < count; i++)
+				bones[i] = matrices[i];
+		}
+
+		if (!mapped)
+		{
+			glBindBuffer(target, buffer);
+			glBufferSubData(target, 0, count * stride, staging.data());
+			glBindBuffer(target, 0);
+		}
+
+		glBindBufferRange(target, binding, buffer, region * regionSize, dataSize);
+	}
+
+	/// <summary>
+	/// Connects the palette block of a shader to the binding point of the buffer.
+	/// Not needed if the shader declares layout(binding = N) itself (GL 4.2+).
+	/// </summary>
+	void bindBlock(const Shader& shader, const char* blockName) const
+	{
+		if (target == GL_UNIFORM_BUFFER)
+		{
+			GLuint index = glGetUniformBlockIndex(shader.ID, blockName);
+			if (index != GL_INVALID_INDEX)
+				glUniformBlockBinding(shader.ID, index, binding);
+		}
+		else
+		{
+			GLuint index = glGetProgramResourceIndex(shader.ID, GL_SHADER_STORAGE_BLOCK, blockName);
+			if (index != GL_INVALID_INDEX)
+				glShaderStorageBlockBinding(shader.ID, index, binding);
+		}
+	}
+
+private:
+	BoneFormat format;
+	GLenum target;
+	GLuint binding;
+	GLuint buffer = 0;
+	unsigned int capacity;
+	unsigned int stride;		// bytes per bone
+	unsigned int dataSize;		// capacity * stride
+	unsigned int regionSize;	// dataSize rounded up to the offset alignment
+	unsigned int regionCount = 1;
+	unsigned int region = 0;	// region bound by the last update
+	unsigned char* mapped = nullptr;
+	GLsync fences[REGIONS];
+	// conversion target without a mapped buffer
+	std::vector<unsigned char> staging;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <random>
+#include <vector>
+#include "animator.h"
+#include "modules/job_pool.h"
+
+/// <summary>
+/// Many independent characters, each with its own animator playing one of the clips
+/// at its own time and speed. The characters are updated in parallel on a job pool and
+/// write their bone matrices into one contiguous palette buffer, boneCount matrices per
+/// character, which is uploaded for instanced rendering.
+/// </summary>
+class Crowd
+{
+public:
+	/// <summary>
+	/// Initializes a new instance of the <see cref="Crowd"/> class.
+	/// </summary>
+	/// <param name="clips">The animations, shared by the characters.</param>
+	/// <param name="count">The number of characters.</param>
+	/// <param name="boneCount">Bone matrices per character, the bone count of the model after loading all clips.</param>
+	/// <param name="seed">Seed for the clip, start time and speed of the characters.</param>
+	Crowd(const std::vector<Animation*>& clips, unsigned int count, int boneCount, unsigned int seed = 1)
+		: boneCount(boneCount)
+	{
+		std::mt19937 generator(seed);
+		std::uniform_int_distribution<size_t> clip(0, clips.size() - 1);
+		std::uniform_real_distribution<float> speed(0.75f, 1.25f);
+		std::uniform_real_distribution<float> start(0.0f, 1.0f);
+
+		palettes.assign((size_t)count * boneCount, glm::mat4(1.0f));
+		animators.reserve(count);
+		speeds.reserve(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			Animation* animation = clips[clip(generator)];
+			// the characters write into the palette buffer, they don't need bone matrices of their own
+			animators.emplace_back(animation, false);
+			speeds.push_back(speed(generator));
+			// start at a random point of the clip
+			animators.back().UpdateAnimation(start(generator) * animation->GetDuration() / animation->GetTicksPerSecond(), GetBoneMatrices(i));
+		}
+	}
+
+	/// <summary>
+	/// Advances all characters, blocks until the palette buffer is complete.
+	/// </summary>
+	void Update(float dt, JobPool& pool = JobPool::instance())
+	{
+		// enough characters per job to make taking a job cheap, few enough to balance the threads
+		const size_t CHARACTERS_PER_JOB = 16;
+		pool.parallelFor(animators.size(), CHARACTERS_PER_JOB, [this, dt](size_t begin, size_t end) {
+			for (size_t i = begin; i < end; i++)
+				animators[i].UpdateAnimation(dt * speeds[i], GetBoneMatrices((unsigned int)i));
+		});
+	}
+
+	unsigned int size() const { return (unsigned int)animators.size(); }
+
+	int GetBoneCount() const { return boneCount; }
+
+	glm::mat4* GetBoneMatrices(unsigned int character) { return &palettes[(size_t)character * boneCount]; }
+
+	/// <summary>
+	/// Bone matrices of all characters, character i starts at i * GetBoneCount().
+	/// </summary>
+	const std::vector<glm::mat4>& GetBonePalettes() const { return palettes; }
+
+private:
+	std::vector<Animator> animators;
+	std::vector<float> speeds;
+	std::vector<glm::mat4> palettes;
+	int boneCount;
+};
@@ -18,12 +18,19 @@
 #include "modules/shader_m.h"
 #include "modules/camera.h"
 #include "animator.h"
+#include "animation_clip.h"
+#include "crowd.h"
+#include "bone_palette.h"
+#include "baked_animation.h"
 #include "model_animation.h"
 #include "modules/filesystem.h"
 #include "modules/material.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
 
+#include <algorithm>
 #include <iostream>
+#include <random>
 
 // callbacks
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -38,7 +45,19 @@ const unsigned int SCR_HEIGHT = 1080;
 
 bool Wpressed = false;
 bool Fpressed = false;
+bool Cpressed = false;
+bool Bpressed = false;
 bool wireframe = false;
+bool crowdMode = false;
+bool bakedMode = false;
+
+// crowd: CROWD_ROWS x CROWD_ROWS characters
+const unsigned int CROWD_ROWS = 32;
+// texture units of the crowd buffers, above the units of the model textures
+const int PALETTE_UNIT = 8;
+const int MODEL_MATRIX_UNIT = 9;
+const int BAKED_UNIT = 10;
+const int CLIP_UNIT = 11;
 
 // camera
 Camera camera(glm::vec3(0.0f, 0.0f, 3.0f));
@@ -91,6 +110,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -111,9 +131,89 @@ int main()
 	// set up vertex data (and buffer(s)) and configure vertex attributes
 	// ------------------------------------------------------------------
 	Model ourModel(FileSystem::getPath("content/models/vampire/dancing_vampire.dae"));
-	Animation danceAnimation(FileSystem::getPath("content/models/vampire/dancing_vampire.dae"), &ourModel);
+	// keyframes from the compressed clip next to the model, converted on the first run
+	Animation danceAnimation = AnimationClip::Load(FileSystem::getPath("content/models/vampire/dancing_vampire.dae"), &ourModel);
 	Animator animator(&danceAnimation);
 
+	// bone matrices of the single character, written once per frame as 3x4 rows
+	BonePalette bonePalette(MAX_BONES, BONE_FORMAT_AFFINE);
+	bonePalette.bindBlock(shader, "BonePalette");
+	const unsigned int paletteBones = std::min(ourModel.GetBoneCount(), MAX_BONES);
+
+	// crowd mode: independent animators updated on the job pool, drawn instanced
+	// --------------------------------------------------------------------------
+	Shader crowdShader(FileSystem::getSamplePath("shader/animModel_crowd.vert").c_str(), FileSystem::getSamplePath("shader/animModel.frag").c_str());
+	std::vector<Animation*> clips = { &danceAnimation };
+	Crowd crowd(clips, CROWD_ROWS * CROWD_ROWS, ourModel.GetBoneCount());
+
+	std::vector<glm::mat4> crowdMatrices;
+	for (unsigned int x = 0; x < CROWD_ROWS; x++)
+	{
+		for (unsigned int z = 0; z < CROWD_ROWS; z++)
+		{
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3((x - CROWD_ROWS * 0.5f) * 1.0f, -0.4f, -(float)z * 1.0f));
+			model = glm::scale(model, glm::vec3(.5f, .5f, .5f));
+			crowdMatrices.push_back(model);
+		}
+	}
+
+	// texture buffers: 0 bone palettes (rewritten every frame), 1 model matrices
+	unsigned int crowdBuffers[2], crowdTextures[2];
+	glGenBuffers(2, crowdBuffers);
+	glGenTextures(2, crowdTextures);
+	glBindBuffer(GL_TEXTURE_BUFFER, crowdBuffers[1]);
+	glBufferData(GL_TEXTURE_BUFFER, crowdMatrices.size() * sizeof(glm::mat4), crowdMatrices.data(), GL_STATIC_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, crowdTextures[1]);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, crowdBuffers[1]);
+	// GL 3.3 only guarantees 65536 texels per texture buffer, less than the palettes of the whole crowd,
+	// so the crowd is drawn in batches of as many characters as one palette buffer can hold
+	GLint maxTextureBufferTexels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTextureBufferTexels);
+	const unsigned int crowdBatchSize = std::min(crowd.size(), std::max(1u, (unsigned int)maxTextureBufferTexels / (unsigned int)(crowd.GetBoneCount() * 4)));
+	const size_t crowdBatchBytes = (size_t)crowdBatchSize * crowd.GetBoneCount() * sizeof(glm::mat4);
+	glBindBuffer(GL_TEXTURE_BUFFER, crowdBuffers[0]);
+	glBufferData(GL_TEXTURE_BUFFER, crowdBatchBytes, NULL, GL_STREAM_DRAW);
+	glBindTexture(GL_TEXTURE_BUFFER, crowdTextures[0]);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, crowdBuffers[0]);
+	crowdShader.use();
+	crowdShader.setInt("bonePalettes", PALETTE_UNIT);
+	crowdShader.setInt("modelMatrices", MODEL_MATRIX_UNIT);
+	crowdShader.setInt("boneCount", crowd.GetBoneCount());
+	double crowdUpdateTime = 0.0;
+
+	// baked mode: the same crowd, the poses are read from a texture of sampled clips
+	// -------------------------------------------------------------------------------
+	Shader bakedShader(FileSystem::getSamplePath("shader/animModel_baked.vert").c_str(), FileSystem::getSamplePath("shader/animModel.frag").c_str());
+	BakedAnimation bakedAnimation(ourModel.GetBoneCount());
+	for (Animation* clip : clips)
+		bakedAnimation.AddClip(clip);
+	bakedAnimation.Upload();
+
+	// per instance: first row, frame count, frames per second (with speed), start frame
+	std::vector<glm::vec4> instanceClips;
+	std::mt19937 generator(1);
+	std::uniform_int_distribution<unsigned int> clipIndex(0, bakedAnimation.GetClipCount() - 1);
+	std::uniform_real_distribution<float> speed(0.75f, 1.25f);
+	std::uniform_real_distribution<float> start(0.0f, 1.0f);
+	for (unsigned int i = 0; i < CROWD_ROWS * CROWD_ROWS; i++)
+	{
+		const BakedAnimation::Clip& clip = bakedAnimation.GetClip(clipIndex(generator));
+		instanceClips.push_back(glm::vec4((float)clip.firstRow, (float)clip.frameCount, clip.framesPerSecond * speed(generator), start(generator) * clip.frameCount));
+	}
+	unsigned int clipBuffer, clipTexture;
+	glGenBuffers(1, &clipBuffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, clipBuffer);
+	glBufferData(GL_TEXTURE_BUFFER, instanceClips.size() * sizeof(glm::vec4), instanceClips.data(), GL_STATIC_DRAW);
+	glGenTextures(1, &clipTexture);
+	glBindTexture(GL_TEXTURE_BUFFER, clipTexture);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, clipBuffer);
+	bakedShader.use();
+	bakedShader.setInt("bakedBones", BAKED_UNIT);
+	bakedShader.setInt("modelMatrices", MODEL_MATRIX_UNIT);
+	bakedShader.setInt("instanceClips", CLIP_UNIT);
+	bakedShader.setInt("boneCount", bakedAnimation.GetBoneCount());
+
 	int frameCount = 0;
 	double previousTime = glfwGetTime();
 	// render loop
@@ -135,6 +235,10 @@ int main()
 			if (currentFrame - previousTime >= 1.0)
 			{
 				std::cout << "FPS:" << frameCount << std::endl;
+				if (crowdMode)
+					std::cout << "crowd update: " << crowdUpdateTime * 1000.0 / frameCount << " ms (" << crowd.size() << " characters, "
+						<< JobPool::instance().getThreadCount() << " threads)" << std::endl;
+				crowdUpdateTime = 0.0;
 				frameCount = 0;
 				previousTime = currentFrame;
 			}
@@ -146,42 +250,91 @@ int main()
 		// Check and call events
 		processInput(window);
 
-		animator.UpdateAnimation(deltaTime);
+		if (crowdMode)
+		{
+			double updateStart = glfwGetTime();
+			crowd.Update(deltaTime);
+			crowdUpdateTime += glfwGetTime() - updateStart;
+		}
+		else if (!bakedMode)
+		{
+			animator.UpdateAnimation(deltaTime);
+		}
 
 		// render
 		// ------
 		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-		// enable shader before setting uniforms
-		shader.use();
-
 		// view/projection transformations
 		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
 		glm::mat4 view = camera.GetViewMatrix();
-		shader.setMat4("projection", projection);
-		shader.setMat4("view", view);
 
-		auto transforms = animator.GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i) {
-			shader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+		if (crowdMode)
+		{
+			crowdShader.use();
+			crowdShader.setMat4("projection", projection);
+			crowdShader.setMat4("view", view);
+			glActiveTexture(GL_TEXTURE0 + PALETTE_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, crowdTextures[0]);
+			glActiveTexture(GL_TEXTURE0 + MODEL_MATRIX_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, crowdTextures[1]);
+			glBindBuffer(GL_TEXTURE_BUFFER, crowdBuffers[0]);
+			for (unsigned int first = 0; first < crowd.size(); first += crowdBatchSize)
+			{
+				// orphan the palette buffer, the previous batch may still read it
+				unsigned int count = std::min(crowdBatchSize, crowd.size() - first);
+				glBufferData(GL_TEXTURE_BUFFER, crowdBatchBytes, NULL, GL_STREAM_DRAW);
+				glBufferSubData(GL_TEXTURE_BUFFER, 0, (size_t)count * crowd.GetBoneCount() * sizeof(glm::mat4), crowd.GetBoneMatrices(first));
+				crowdShader.setInt("firstInstance", (int)first);
+				ourModel.DrawInstanced(crowdShader, count);
+			}
+		}
+		else if (bakedMode)
+		{
+			// no animation work on the CPU, the instances only need the time
+			bakedShader.use();
+			bakedShader.setMat4("projection", projection);
+			bakedShader.setMat4("view", view);
+			bakedShader.setFloat("time", currentFrame);
+			glActiveTexture(GL_TEXTURE0 + BAKED_UNIT);
+			glBindTexture(GL_TEXTURE_2D, bakedAnimation.GetTexture());
+			glActiveTexture(GL_TEXTURE0 + MODEL_MATRIX_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, crowdTextures[1]);
+			glActiveTexture(GL_TEXTURE0 + CLIP_UNIT);
+			glBindTexture(GL_TEXTURE_BUFFER, clipTexture);
+			ourModel.DrawInstanced(bakedShader, (unsigned int)instanceClips.size());
+		}
+		else
+		{
+			// enable shader before setting uniforms
+			shader.use();
+			shader.setMat4("projection", projection);
+			shader.setMat4("view", view);
+
+			bonePalette.update(animator.GetFinalBoneMatrices().data(), paletteBones);
+
+			// render the loaded model
+			glm::mat4 model = glm::mat4(1.0f);
+			model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
+			model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
+			shader.setMat4("model", model);
+			ourModel.Draw(shader);
 		}
-
-		// render the loaded model
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
-		model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
-		shader.setMat4("model", model);
-		ourModel.Draw(shader);
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
 
 	// optional: de-allocate all resources once they've outlived their purpose:
 	// ------------------------------------------------------------------------
+	glDeleteTextures(2, crowdTextures);
+	glDeleteBuffers(2, crowdBuffers);
+	glDeleteTextures(1, &clipTexture);
+	glDeleteBuffers(1, &clipBuffer);
 
 	// glfw: terminate, clearing all previously allocated GLFW resources.
 	// ------------------------------------------------------------------
@@ -228,6 +381,28 @@ void processInput(GLFWwindow *window)
 		printFPS = !printFPS;
 	}
 
+	if (glfwGetKey(window, GLFW_KEY_C) == GLFW_PRESS) {
+		Cpressed = true;
+	}
+
+	if (Cpressed && glfwGetKey(window, GLFW_KEY_C) == GLFW_RELEASE) {
+		Cpressed = false;
+		crowdMode = !crowdMode;
+		bakedMode = false;
+		std::cout << (crowdMode ? "CROWD" : "SINGLE") << std::endl;
+	}
+
+	if (glfwGetKey(window, GLFW_KEY_B) == GLFW_PRESS) {
+		Bpressed = true;
+	}
+
+	if (Bpressed && glfwGetKey(window, GLFW_KEY_B) == GLFW_RELEASE) {
+		Bpressed = false;
+		bakedMode = !bakedMode;
+		crowdMode = false;
+		std::cout << (bakedMode ? "BAKED CROWD" : "SINGLE") << std::endl;
+	}
+
 }
 
 // glfw: whenever the mouse moves, this callback is called
@@ -46,6 +46,18 @@ public:
 			meshes[i].Draw(shader);
 	}
 
+	// draws amount instances of the model, the shader reads the per instance data with gl_InstanceID
+	void DrawInstanced(Shader& shader, unsigned int amount)
+	{
+		for (unsigned int i = 0; i < meshes.size(); i++)
+		{
+			meshes[i].BindMaterial(shader);
+			glBindVertexArray(meshes[i].VAO);
+			glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)meshes[i].indices.size(), GL_UNSIGNED_INT, 0, amount);
+		}
+		glActiveTexture(GL_TEXTURE0);
+	}
+
 	auto& GetBoneInfoMap() { return boneInfoMap; }
 	int& GetBoneCount() { return boneCounter; }
 
@@ -17,6 +17,8 @@
 #include "modules/material.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
+#include "modules/frustum.h"
 
 #include <iostream>
 #include <random>
@@ -38,7 +40,7 @@ void processInput(GLFWwindow *window);
 void drawPlane(void);
 /* load texture */
 unsigned int loadTexture(const char *path, bool gammaCorrection);
-void renderScene(const Shader &shader);
+void renderScene(const Shader &shader, const std::vector<glm::mat4> &viewProjections);
 void renderCube();
 void renderQuad();
 
@@ -135,6 +137,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -339,7 +342,7 @@ int main()
 			glEnable(GL_CULL_FACE);
 			glCullFace(GL_FRONT);	// peter panning
 #endif
-			renderScene(simpleDepthShader);		// render scene into depth map
+			renderScene(simpleDepthShader, lightMatrices);		// render scene into depth map, the geometry shader writes every cascade
 #ifdef PETERPANING
 			glCullFace(GL_BACK); // don't forget to reset original culling face
 			glDisable(GL_CULL_FACE);
@@ -355,7 +358,7 @@ int main()
 			glEnable(GL_CULL_FACE);
 			glCullFace(GL_FRONT);	// peter panning
 #endif
-			renderScene(simpleDepthShader);		// render scene into depth map
+			renderScene(simpleDepthShader, { lightMatrices[i] });		// render scene into depth map
 #ifdef PETERPANING
 			glCullFace(GL_BACK); // don't forget to reset original culling face
 			glDisable(GL_CULL_FACE);
@@ -404,7 +407,7 @@ int main()
 		glActiveTexture(GL_TEXTURE4);
 		glBindTexture(GL_TEXTURE_2D, lightDepthMaps[3]);
 #endif
-		renderScene(shader);
+		renderScene(shader, { projection * view });
 
 		if (lightMatricesCache.size() != 0)
 		{
@@ -437,6 +440,7 @@ int main()
 		
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -453,8 +457,9 @@ int main()
 }
 
 // renders the 3D scene
+// cubes outside of all frustums of viewProjections (camera or light space) are skipped
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, const std::vector<glm::mat4> &viewProjections)
 {
 	// floor
 	glm::mat4 model = glm::mat4(1.0f);
@@ -479,9 +484,26 @@ void renderScene(const Shader &shader)
 		}
 	}
 
-	for (const auto& model : modelMatrices)
+	// world space bounds of the cubes (renderCube spans -1 to 1)
+	static FrustumCuller cubeCuller;
+	static std::vector<unsigned char> visibleCubes;
+	if (cubeCuller.size() != modelMatrices.size())
 	{
-		shader.setMat4("model", model);
+		for (const auto& model : modelMatrices)
+		{
+			glm::vec3 min, max;
+			Frustum::transformBounds(glm::vec3(-1.0f), glm::vec3(1.0f), model, min, max);
+			cubeCuller.add(min, max);
+		}
+	}
+	for (size_t i = 0; i < viewProjections.size(); i++)
+		cubeCuller.cull(Frustum(viewProjections[i]), visibleCubes, FrustumCuller::BOX, i > 0);
+
+	for (size_t i = 0; i < modelMatrices.size(); i++)
+	{
+		if (!visibleCubes[i])
+			continue;
+		shader.setMat4("model", modelMatrices[i]);
 		renderCube();
 	}
 }
@@ -23,6 +23,8 @@
 #include "modules/material.h"
 #include "modules/filesystem.h"
 #include "modules/window.h"
+#include "modules/render_state.h"
+#include "modules/frustum.h"
 
 #include <iostream>
 
@@ -35,7 +37,7 @@ void processInput(GLFWwindow *window);
 
 /* load texture */
 unsigned int loadTexture(const char *path, bool gammaCorrection);
-void renderScene(const Shader &shader);
+void renderScene(const Shader &shader, const glm::mat4 &viewProjection);
 void renderCube();
 void renderQuad();
 
@@ -112,6 +114,7 @@ int main()
 		std::cout << "Failed to initialize GLAD" << std::endl;
 		return -1;
 	}
+	RenderState::install(); // filter redundant state changes
 
 	icon(window);
 
@@ -240,7 +243,7 @@ int main()
 				glEnable(GL_CULL_FACE);
 				glCullFace(GL_FRONT);
 			}
-			renderScene(simpleDepthShader);
+			renderScene(simpleDepthShader, lightSpaceMatrix);
 			if (peterPanning) {
 				glCullFace(GL_BACK); // don't forget to reset original culling face
 				glDisable(GL_CULL_FACE);
@@ -272,7 +275,7 @@ int main()
 		glBindTexture(GL_TEXTURE_2D, woodTexture);
 		glActiveTexture(GL_TEXTURE1);
 		glBindTexture(GL_TEXTURE_2D, depthMap);
-		renderScene(shadowShader);	
+		renderScene(shadowShader, projection * view);
 		
 		// reset draw mode
 		glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -291,6 +294,7 @@ int main()
 
 		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
 		// -------------------------------------------------------------------------------
+		RenderState::endFrame(); // count state changes of this frame
 		glfwSwapBuffers(window);
 		glfwPollEvents();
 	}
@@ -307,8 +311,9 @@ int main()
 }
 
 // renders the 3D scene
+// cubes outside of the frustum of viewProjection (camera or light space) are skipped
 // --------------------
-void renderScene(const Shader &shader)
+void renderScene(const Shader &shader, const glm::mat4 &viewProjection)
 {
 	// floor
 	glm::mat4 model(1.0f);
@@ -316,22 +321,42 @@ void renderScene(const Shader &shader)
 	glBindVertexArray(planeVAO);
 	glDrawArrays(GL_TRIANGLES, 0, 6);
 	// cubes
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
-	model = glm::scale(model, glm::vec3(0.5f));
-	shader.setMat4("model", model);
-	renderCube();
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
-	model = glm::scale(model, glm::vec3(0.5f));
-	shader.setMat4("model", model);
-	renderCube();
-	model = glm::mat4(1.0f);
-	model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
-	model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
-	model = glm::scale(model, glm::vec3(0.25));
-	shader.setMat4("model", model);
-	renderCube();
+	static std::vector<glm::mat4> cubeMatrices;
+	static FrustumCuller cubeCuller;
+	static std::vector<unsigned char> visibleCubes;
+	if (cubeMatrices.empty())
+	{
+		model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(0.0f, 1.5f, 0.0));
+		model = glm::scale(model, glm::vec3(0.5f));
+		cubeMatrices.push_back(model);
+		model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(2.0f, 0.0f, 1.0));
+		model = glm::scale(model, glm::vec3(0.5f));
+		cubeMatrices.push_back(model);
+		model = glm::mat4(1.0f);
+		model = glm::translate(model, glm::vec3(-1.0f, 0.0f, 2.0));
+		model = glm::rotate(model, glm::radians(60.0f), glm::normalize(glm::vec3(1.0, 0.0, 1.0)));
+		model = glm::scale(model, glm::vec3(0.25));
+		cubeMatrices.push_back(model);
+
+		// world space bounds of the cubes (renderCube spans -1 to 1)
+		for (const glm::mat4& cube : cubeMatrices)
+		{
+			glm::vec3 min, max;
+			Frustum::transformBounds(glm::vec3(-1.0f), glm::vec3(1.0f), cube, min, max);
+			cubeCuller.add(min, max);
+		}
+	}
+
+	cubeCuller.cull(Frustum(viewProjection), visibleCubes);
+	for (size_t i = 0; i < cubeMatrices.size(); i++)
+	{
+		if (!visibleCubes[i])
+			continue;
+		shader.setMat4("model", cubeMatrices[i]);
+		renderCube();
+	}
 }
 
 // renderCube() renders a 1x1 3D cube in NDC.